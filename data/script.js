@@ -1,6 +1,8 @@
 // 延迟初始化DOM元素，避免在某些页面（如OTA页面）中因元素不存在而导致错误
 let bcf, bandSelect, channelSelect, freqOutput, announcerSelect, announcerRateInput;
-let enterRssiInput, exitRssiInput, enterRssiSpan, exitRssiSpan, droneSizeSelect;
+let enterRssiInput, exitRssiInput, enterRssiSpan, exitRssiSpan, droneSizeSelect, detectorSelect;
+let floorTrackSelect, enterOffsetInput, exitOffsetInput, trackMaxInput, scanFreqsInput;
+let sectorIndexInput, sectorCountInput, lapCastSelect, raceLinkSelect, serialLinkSelect;
 let gateDiameterDisplay, calibSamplesInput, pilotNameInput, ssidInput, pwdInput;
 let minLapInput, alarmThreshold;
 
@@ -51,6 +53,17 @@ function initializeDOMElements() {
   enterRssiSpan = document.getElementById("enterSpan");
   exitRssiSpan = document.getElementById("exitSpan");
   droneSizeSelect = document.getElementById("droneSizeSelect");
+  detectorSelect = document.getElementById("detectorSelect");
+  floorTrackSelect = document.getElementById("floorTrackSelect");
+  enterOffsetInput = document.getElementById("enterOffset");
+  exitOffsetInput = document.getElementById("exitOffset");
+  trackMaxInput = document.getElementById("trackMax");
+  scanFreqsInput = document.getElementById("scanFreqs");
+  sectorIndexInput = document.getElementById("sectorIndex");
+  sectorCountInput = document.getElementById("sectorCount");
+  lapCastSelect = document.getElementById("lapCastSelect");
+  raceLinkSelect = document.getElementById("raceLinkSelect");
+  serialLinkSelect = document.getElementById("serialLinkSelect");
   gateDiameterDisplay = document.getElementById("gateDiameterDisplay");
   calibSamplesInput = document.getElementById("calibSamples");
   pilotNameInput = document.getElementById("pname");
@@ -162,7 +175,8 @@ let originalPwd = "";
 let calibMaxNoise = 0;
 let calibMaxPeak = 0;
 let calibPollInterval = null;
-let calibNoiseSamples = 0;
+let raceNetPollInterval = null;
+let sectorLastSeq = 0;
 let calibCrossingSamples = 0;
 let calibTargetSamples = 20;
 
@@ -184,6 +198,15 @@ function getCalibrationSamplesTarget() {
   return v;
 }
 
+// 扫描频率列表：逗号或空格分隔的MHz值，固件只保留5300 - 5950之间的值，不足2个即单频模式
+function parseScanFrequencies(text) {
+  return text
+    .split(/[\s,，]+/)
+    .map((f) => parseInt(f))
+    .filter((f) => Number.isFinite(f) && f >= 5300 && f <= 5950)
+    .slice(0, 8);
+}
+
 function updateGateDiameterUi() {
   const droneSize = getSelectedDroneSize();
   const diameterMm = getGateDiameterMm(droneSize);
@@ -285,7 +308,13 @@ function toggleAdvancedSettings() {
   }
 }
 
-// 新的自动校准函数
+// 自动校准：设备以全速率采集RSSI并计算分布和推荐阈值，网页只轮询进度
+function getCalibrationDropPercent() {
+  const dropPercentageEl = document.getElementById('calibDropPercentage');
+  const v = dropPercentageEl ? parseInt(dropPercentageEl.value) : 30;
+  return Number.isFinite(v) ? clamp(v, 10, 100) : 30;
+}
+
 function startCalib() {
   // 更新当前设置显示
   updateCurrentSettings();
@@ -293,7 +322,6 @@ function startCalib() {
   // 添加元素存在性检查，避免在某些页面中因元素不存在而导致错误
   const calibStep1El = document.getElementById("calibStep1");
   const calibStep2El = document.getElementById("calibStep2");
-  const calibNoiseTargetEl = document.getElementById("calibNoiseTarget");
   const calibNoiseSamplesEl = document.getElementById("calibNoiseSamples");
   const liveRecEnterNoiseEl = document.getElementById("liveRecEnterNoise");
   const liveRecExitNoiseEl = document.getElementById("liveRecExitNoise");
@@ -302,10 +330,6 @@ function startCalib() {
   if (calibStep2El) calibStep2El.style.display = "block";
 
   calibMaxNoise = 0;
-  calibNoiseSamples = 0;
-  calibTargetSamples = getCalibrationSamplesTarget();
-
-  if (calibNoiseTargetEl) calibNoiseTargetEl.innerText = calibTargetSamples;
   if (calibNoiseSamplesEl) calibNoiseSamplesEl.innerText = "0";
   if (liveRecEnterNoiseEl) liveRecEnterNoiseEl.innerText = "-";
   if (liveRecExitNoiseEl) liveRecExitNoiseEl.innerText = "-";
@@ -315,91 +339,66 @@ function startCalib() {
 
   console.log("开始自动校准");
 
-  // 发送自动校准请求
-  fetch(esp32BaseUrl + "/calibration/noise/start", {
-    method: "POST"
-  })
-    .then((r) => r.json())
+  // 校准时长由设备按“采样次数”计算，到时自动停止
+  saveConfig()
+    .then(() => fetch(esp32BaseUrl + "/calibration/noise/start", { method: "POST" }))
+    .then((r) => {
+      if (!r.ok) throw new Error("HTTP " + r.status);
+    })
     .then(() => {
-      // 记录采样的RSSI值，用于后续分析
-      const rssiSamples = [];
-
+      let seenRunning = false;
       calibPollInterval = setInterval(() => {
-        const calibNoiseValEl = document.getElementById("calibNoiseVal");
-        if (calibNoiseValEl) {
-          calibNoiseValEl.innerText = rssiValue;
-        }
-
-        // 记录RSSI值
-        rssiSamples.push(rssiValue);
-
-        calibNoiseSamples += 1;
-        const calibNoiseSamplesEl = document.getElementById("calibNoiseSamples");
-        if (calibNoiseSamplesEl) {
-          calibNoiseSamplesEl.innerText = calibNoiseSamples;
-        }
-
-        // 更新实时推荐值
-        if (rssiValue > calibMaxNoise) calibMaxNoise = rssiValue;
-        const rec = computeRecommendedEnterExit(calibMaxNoise, rssiValue, getSelectedDroneSize());
-        updateLiveRecommendation("noise", rec);
-
-        // 实时更新滑块值
-        updateSliderValues(rec.enter, rec.exit);
-
-        if (stopBtn) stopBtn.disabled = calibNoiseSamples < calibTargetSamples;
-
-        // 如果达到目标采样次数，自动停止校准
-        if (calibNoiseSamples >= calibTargetSamples) {
-          stopCalib(rssiSamples);
-        }
-      }, 200);
+        fetch(esp32BaseUrl + "/calibration/noise/status?drop=" + getCalibrationDropPercent())
+          .then((r) => r.json())
+          .then((data) => {
+            if (data.running) seenRunning = true;
+            const progress = data.target > 0 ? Math.min(100, Math.floor((data.samples * 100) / data.target)) : 0;
+            const calibNoiseValEl = document.getElementById("calibNoiseVal");
+            const calibNoiseSamplesEl = document.getElementById("calibNoiseSamples");
+            if (calibNoiseValEl) calibNoiseValEl.innerText = data.p50;
+            if (calibNoiseSamplesEl) calibNoiseSamplesEl.innerText = seenRunning ? progress : 0;
+            if (!seenRunning) return;
+            updateLiveRecommendation("noise", data);
+            updateSliderValues(data.enter, data.exit);
+            if (stopBtn) stopBtn.disabled = !data.ok;
+            if (!data.running) {
+              stopCalib();
+            }
+          })
+          .catch((error) => console.log("校准进度查询失败", error));
+      }, 500);
+    })
+    .catch((error) => {
+      console.error("开始校准失败:", error);
+      showToast("开始校准失败", "error");
     });
 }
 
-// 新的停止校准函数
-function stopCalib(rssiSamples) {
+// 停止命令在计时核上异步执行，设备先回PENDING，轮询到running为false后再取直方图
+async function fetchCalibNoiseResult() {
+  const drop = getCalibrationDropPercent();
+  const r = await fetch(esp32BaseUrl + "/calibration/noise/stop?drop=" + drop, { method: "POST" });
+  if (!r.ok) throw new Error("HTTP " + r.status);
+  let data = await r.json();
+  while (data.running) {
+    await new Promise((r) => setTimeout(r, 100));
+    data = await (await fetch(esp32BaseUrl + "/calibration/noise/status?hist=1&drop=" + drop)).json();
+  }
+  return data;
+}
+
+function stopCalib() {
   clearInterval(calibPollInterval);
 
-  // 发送停止校准请求
-  fetch(esp32BaseUrl + "/calibration/noise/stop", { method: "POST" })
-    .then((r) => r.json())
+  // 设备返回分布统计和推荐阈值
+  fetchCalibNoiseResult()
     .then((data) => {
-      calibMaxNoise = Number.isFinite(data.maxNoise) ? data.maxNoise : calibMaxNoise;
-
-      // 获取用户设置的参数
-      const calibDropPercentageEl = document.getElementById('calibDropPercentage');
-      const dropPercentage = calibDropPercentageEl ? parseFloat(calibDropPercentageEl.value) / 100 : 0.3;
-
-      const calibDropDurationEl = document.getElementById('calibDropDuration');
-      const dropDuration = calibDropDurationEl ? parseFloat(calibDropDurationEl.value) : 10;
-
-      // 分析采样的RSSI值，优先使用后端返回的samples，如无则使用本地收集的
-      const allSamples = (data.samples && Array.isArray(data.samples)) ? data.samples : rssiSamples;
-
-      // 1. 过滤掉异常值（比如特别低的值）
-      const filteredSamples = allSamples.filter(val => val > calibMaxNoise + 5);
-
-      // 2. 计算峰值（最大值）和平均峰值
-      const maxPeak = Math.max(...filteredSamples);
-      const avgPeak = filteredSamples.length > 0 ? Math.round(filteredSamples.reduce((sum, val) => sum + val, 0) / filteredSamples.length) : calibMaxNoise;
-
-      // 3. 计算delta值
-      const delta = maxPeak - calibMaxNoise;
-
-      // 4. 获取用户设置的采样次数
-      const calibSamplesEl = document.getElementById('calibSamples');
-      const userSampleCount = calibSamplesEl ? parseInt(calibSamplesEl.value) : 20;
-
-      // 5. 自动尝试不同的进入和退出RSSI值组合
-      const bestCombination = findBestEnterExitCombination(filteredSamples, calibMaxNoise, maxPeak,
-        dropPercentage, dropDuration, userSampleCount);
-
-      // 6. 计算最终推荐值（使用找到的最佳组合或默认计算）
-      const rec = bestCombination || computeRecommendedEnterExit(calibMaxNoise, maxPeak, getSelectedDroneSize());
+      calibMaxNoise = data.maxNoise;
+      console.log("校准结果: 样本=" + data.samples + " p50=" + data.p50 + " p99.9=" + data.p999 +
+        " 最大=" + data.maxNoise + " 直方图起点=" + data.histStart + " " + JSON.stringify(data.hist));
 
       // 实时更新滑块值
-      updateSliderValues(rec.enter, rec.exit);
+      updateSliderValues(data.enter, data.exit);
 
       // 保存校准后的阈值到设备
       saveConfig()
@@ -422,119 +421,31 @@ function stopCalib(rssiSamples) {
       const calibStep2El = document.getElementById("calibStep2");
       const calibStep5El = document.getElementById("calibStep5");
 
-      if (resNoiseEl) resNoiseEl.innerText = calibMaxNoise;
-      if (resPeakEl) resPeakEl.innerText = maxPeak;
-      if (resDeltaEl) resDeltaEl.innerText = delta;
-
-      const tuning = getCalibrationTuning(getSelectedDroneSize());
-      if (resMinDeltaEl) resMinDeltaEl.innerText = tuning.minDelta;
+      if (resNoiseEl) resNoiseEl.innerText = data.p50 + " / " + data.noise;
+      if (resPeakEl) resPeakEl.innerText = data.maxNoise;
+      if (resDeltaEl) resDeltaEl.innerText = data.delta;
+      if (resMinDeltaEl) resMinDeltaEl.innerText = data.minDelta;
 
       if (recEnterEl) {
-        recEnterEl.innerText = rec.enter;
-        recEnterEl.dataset.val = rec.enter;
+        recEnterEl.innerText = data.enter;
+        recEnterEl.dataset.val = data.enter;
       }
       if (recExitEl) {
-        recExitEl.innerText = rec.exit;
-        recExitEl.dataset.val = rec.exit;
+        recExitEl.innerText = data.exit;
+        recExitEl.dataset.val = data.exit;
       }
       if (calibStep2El) calibStep2El.style.display = "none";
       // 修改为显示步骤3（结果确认）
       const calibStep3El = document.getElementById("calibStep3");
       if (calibStep3El) calibStep3El.style.display = "block";
       if (calibStep5El) calibStep5El.style.display = "none";
-
-      // 已在步骤5中显示校准确认选项，无需弹出对话框
+    })
+    .catch((error) => {
+      console.error("停止校准失败:", error);
+      showToast("获取校准结果失败", "error");
     });
 }
 
-// 查找最佳的进入和退出RSSI值组合
-function findBestEnterExitCombination(rssiSamples, noise, peak, dropPercentage, dropDuration, sampleCount) {
-  // 如果没有足够的样本，直接返回null
-  if (rssiSamples.length < sampleCount) {
-    return null;
-  }
-
-  const delta = peak - noise;
-  const baseEnter = Math.round(noise + delta * 0.7);
-  const baseExit = Math.round(noise + delta * 0.4);
-
-  // 生成要尝试的进入/退出组合
-  const combinations = [];
-  const testCount = Math.min(sampleCount, 20); // 限制最大尝试次数
-
-  for (let i = 0; i < testCount; i++) {
-    // 根据用户设置的降低量百分比调整组合
-    const percentageAdjustment = (i - Math.floor(testCount / 2)) * 0.05;
-    const adjustedDropPercentage = Math.max(0.1, Math.min(0.9, dropPercentage + percentageAdjustment));
-
-    // 计算进入和退出值
-    const enterValue = Math.round(noise + delta * (1 - adjustedDropPercentage * 0.7));
-    const exitValue = Math.round(noise + delta * (1 - adjustedDropPercentage * 1.3));
-
-    combinations.push({ enter: enterValue, exit: exitValue, dropPercentage: adjustedDropPercentage });
-  }
-
-  // 评估每个组合
-  let bestCombination = null;
-  let bestScore = 0;
-
-  combinations.forEach(comb => {
-    // 计算组合的得分
-    const score = evaluateCombination(rssiSamples, comb.enter, comb.exit, dropDuration);
-
-    if (score > bestScore) {
-      bestScore = score;
-      bestCombination = comb;
-    }
-  });
-
-  return bestCombination;
-}
-
-// 评估进入/退出组合的得分
-function evaluateCombination(rssiSamples, enter, exit, dropDuration) {
-  // 简单的评估逻辑：
-  // 1. 检查进入阈值是否在合理范围内
-  // 2. 检查退出阈值是否在合理范围内
-  // 3. 检查进入阈值是否大于退出阈值
-  // 4. 检查RSSI值在退出阈值以下的持续时间是否符合要求
-
-  let score = 0;
-
-  // 基本合理性检查
-  if (enter > exit) score += 10;
-  if (enter > -100 && enter < 0) score += 5;
-  if (exit > -100 && exit < 0) score += 5;
-
-  // 检查退出持续时间
-  let consecutiveBelowExit = 0;
-  let maxConsecutive = 0;
-
-  for (let i = 0; i < rssiSamples.length; i++) {
-    if (rssiSamples[i] < exit) {
-      consecutiveBelowExit++;
-      maxConsecutive = Math.max(maxConsecutive, consecutiveBelowExit);
-    } else {
-      consecutiveBelowExit = 0;
-    }
-  }
-
-  // 计算采样率（假设每200ms采样一次）
-  const sampleRate = 5; // 每秒5个样本
-  const requiredSamples = dropDuration * sampleRate;
-
-  // 根据持续时间接近要求来调整得分
-  if (maxConsecutive >= requiredSamples) {
-    score += 15;
-  } else if (maxConsecutive >= requiredSamples * 0.8) {
-    score += 10;
-  } else if (maxConsecutive >= requiredSamples * 0.5) {
-    score += 5;
-  }
-
-  return score;
-}
-
 function startCalibCrossing() {
   // 添加元素存在性检查，避免在某些页面中因元素不存在而导致错误
   const calibStep3El = document.getElementById("calibStep3");
@@ -843,6 +754,39 @@ window.onload = function (e) {
         const ds = parseInt(config.droneSize);
         droneSizeSelect.value = ds === 2 ? "2" : "5";
       }
+      if (detectorSelect) {
+        detectorSelect.value = parseInt(config.detector) === 1 ? "1" : "0";
+      }
+      if (floorTrackSelect) {
+        floorTrackSelect.value = parseInt(config.floorTrack) === 1 ? "1" : "0";
+      }
+      if (enterOffsetInput && config.enterOffset !== undefined) {
+        enterOffsetInput.value = config.enterOffset;
+      }
+      if (exitOffsetInput && config.exitOffset !== undefined) {
+        exitOffsetInput.value = config.exitOffset;
+      }
+      if (trackMaxInput && config.trackMax !== undefined) {
+        trackMaxInput.value = config.trackMax;
+      }
+      if (scanFreqsInput) {
+        scanFreqsInput.value = Array.isArray(config.scanFreqs) ? config.scanFreqs.join(",") : "";
+      }
+      if (sectorIndexInput && config.sector !== undefined) {
+        sectorIndexInput.value = config.sector;
+      }
+      if (sectorCountInput && config.sectors !== undefined) {
+        sectorCountInput.value = config.sectors;
+      }
+      if (lapCastSelect && config.lapCast !== undefined) {
+        lapCastSelect.value = String(config.lapCast);
+      }
+      if (raceLinkSelect && config.raceLink !== undefined) {
+        raceLinkSelect.value = String(config.raceLink);
+      }
+      if (serialLinkSelect && config.serialLink !== undefined) {
+        serialLinkSelect.value = String(config.serialLink);
+      }
       if (calibSamplesInput) {
         const cs = parseInt(config.calibSamples);
         calibSamplesInput.value = String(Number.isFinite(cs) && cs >= 10 ? cs : 20);
@@ -878,6 +822,102 @@ window.onload = function (e) {
     });
 };
 
+// /events推送的底噪和生效阈值（见Webserver::sendNoiseEvent）
+var noiseStatus = null;
+
+function appliedEnterRssi() {
+  return noiseStatus && noiseStatus.tracking ? noiseStatus.enter : enterRssi;
+}
+
+function appliedExitRssi() {
+  return noiseStatus && noiseStatus.tracking ? noiseStatus.exit : exitRssi;
+}
+
+function updateNoiseStatus(status) {
+  noiseStatus = status;
+  const floorSpan = document.getElementById("noiseFloorSpan");
+  const enterSpan = document.getElementById("appliedEnterSpan");
+  const exitSpan = document.getElementById("appliedExitSpan");
+  if (floorSpan) floorSpan.textContent = status.valid ? status.floor : "估计中";
+  if (enterSpan) enterSpan.textContent = status.enter;
+  if (exitSpan) exitSpan.textContent = status.exit;
+}
+
+// 频谱扫描：结果由"spectrum"事件逐个频率推送，结束后再取一次完整结果
+function spectrumSetRunning(running) {
+  const startBtn = document.getElementById("spectrumStartBtn");
+  const stopBtn = document.getElementById("spectrumStopBtn");
+  if (startBtn) startBtn.disabled = running;
+  if (stopBtn) stopBtn.disabled = !running;
+}
+
+function spectrumStatus(text) {
+  const span = document.getElementById("spectrumStatus");
+  if (span) span.textContent = text;
+}
+
+function drawSpectrumChannel(ch) {
+  const chart = document.getElementById("spectrumChart");
+  if (!chart) return;
+  const bar = document.createElement("div");
+  bar.className = "spectrum-bar" + (ch.freq == frequency ? " current" : "");
+  bar.style.height = Math.max(2, (ch.peak / 255) * 100) + "%";
+  bar.title = ch.freq + " MHz: 峰值 " + ch.peak + ", 平均 " + ch.mean;
+  const mean = document.createElement("div");
+  mean.className = "spectrum-mean";
+  mean.style.height = (ch.peak > 0 ? Math.min(100, (ch.mean / ch.peak) * 100) : 0) + "%";
+  const label = document.createElement("span");
+  label.textContent = ch.freq;
+  bar.appendChild(mean);
+  bar.appendChild(label);
+  chart.appendChild(bar);
+}
+
+function startSpectrum() {
+  const select = document.getElementById("spectrumBandSelect");
+  const value = select ? select.value : "ABEFR";
+  const query = value === "range" ? "from=5645&to=5945&step=5" : "band=" + value;
+  const chart = document.getElementById("spectrumChart");
+  if (chart) chart.innerHTML = "";
+  fetch(esp32BaseUrl + "/spectrum/start?" + query, { method: "POST" })
+    .then((response) => response.json())
+    .then((response) => {
+      if (response.status !== "OK") {
+        const reasons = { TIMER_RUNNING: "请先停止计时或校准", SCAN_MODE: "多频扫描模式下不可用", BUSY: "扫描进行中" };
+        spectrumStatus(reasons[response.status] || response.status);
+        return;
+      }
+      spectrumSetRunning(true);
+      spectrumStatus("扫描中 0/" + response.count);
+    })
+    .catch((err) => spectrumStatus("请求失败"));
+}
+
+function stopSpectrum() {
+  fetch(esp32BaseUrl + "/spectrum/stop", { method: "POST" }).catch((err) => console.log("spectrum stop", err));
+}
+
+function onSpectrumChannel(ch) {
+  drawSpectrumChannel(ch);
+  spectrumStatus("扫描中 " + (ch.index + 1) + "/" + ch.count);
+}
+
+function onSpectrumDone(done) {
+  spectrumSetRunning(false);
+  spectrumStatus((done.aborted ? "已停止 " : "完成 ") + done.completed + "/" + done.count + "，用时 " +
+    (done.elapsedMs / 1000).toFixed(1) + " 秒");
+  // 事件可能丢失，以设备上的完整结果为准重画
+  fetch(esp32BaseUrl + "/spectrum")
+    .then((response) => response.json())
+    .then((result) => {
+      const chart = document.getElementById("spectrumChart");
+      if (!chart) return;
+      chart.innerHTML = "";
+      result.channels.forEach((ch) => drawSpectrumChannel(ch));
+    })
+    .catch((err) => console.log("spectrum result", err));
+}
+
 function addRssiPoint() {
   if (calib.style.display != "none") {
     if (!rssiChart) {
@@ -888,9 +928,9 @@ function addRssiPoint() {
     }
     if (rssiBuffer.length > 0) {
       rssiValue = parseInt(rssiBuffer.shift());
-      if (crossing && rssiValue < exitRssi) {
+      if (crossing && rssiValue < appliedExitRssi()) {
         crossing = false;
-      } else if (!crossing && rssiValue > enterRssi) {
+      } else if (!crossing && rssiValue > appliedEnterRssi()) {
         crossing = true;
       }
       maxRssiValue = Math.max(maxRssiValue, rssiValue);
@@ -903,6 +943,13 @@ function addRssiPoint() {
         { color: "hsl(8.2, 86.5%, 53.7%)", lineWidth: 1.7, value: enterRssi }, // red
         { color: "hsl(25, 85%, 55%)", lineWidth: 1.7, value: exitRssi }, // orange
       ];
+      // 底噪跟随抬高了阈值时，另画出计时器实际使用的阈值
+      if (noiseStatus && noiseStatus.tracking) {
+        rssiChart.options.horizontalLines.push(
+          { color: "hsl(8.2, 40%, 65%)", lineWidth: 1, value: noiseStatus.enter },
+          { color: "hsl(25, 40%, 65%)", lineWidth: 1, value: noiseStatus.exit }
+        );
+      }
 
       rssiChart.options.maxValue = Math.max(maxRssiValue, enterRssi + 10);
 
@@ -968,7 +1015,12 @@ function refreshNodes() {
         const ip = n.ip || '';
         const product = n.product || '';
         const mac = n.mac || '';
-        return `<div>${product} ${host} (${ip}) ${mac}</div>`;
+        const pilot = n.pilot ? ` ${n.pilot}` : '';
+        const state = n.online ? (n.running ? '计时中' : '在线') : '离线';
+        const self = n.self ? ' (本机)' : '';
+        const sync = n.syncUs === null || n.syncUs === undefined ? '未同步' : `同步 ±${(n.syncUs / 1000).toFixed(2)} ms`;
+        return `<div>${product} ${host} (${ip}) ${mac}${self}${pilot} ${n.freq || ''}MHz ${state}，` +
+          `${sync}，事件 ${n.events || 0}，丢失 ${n.lost || 0}</div>`;
       }).join('') || '<div>未发现设备</div>';
     })
     .catch(e => {
@@ -977,6 +1029,82 @@ function refreshNodes() {
     });
 }
 
+function refreshRace() {
+  const table = document.getElementById("raceNetTable");
+  if (!table) return;
+  fetch(esp32BaseUrl + "/race")
+    .then(r => r.json())
+    .then(data => {
+      while (table.rows.length > 1) table.deleteRow(1);
+      (data.laps || []).forEach(l => {
+        const row = table.insertRow(1);
+        // 未同步的节点按网络延迟换算，误差不确定，加"~"提示
+        row.insertCell(0).textContent = (l.uncUs === null ? "~" : "") + (l.timeMs / 1000).toFixed(3) + " s";
+        row.insertCell(1).textContent = l.pilot || l.host || l.mac;
+        row.insertCell(2).textContent = l.freq;
+        row.insertCell(3).textContent = l.lap;
+        row.insertCell(4).textContent = (l.lapUs / 1000000).toFixed(3) + " s";
+      });
+      const status = document.getElementById("raceNetStatus");
+      status.textContent = `共 ${data.count} 圈` + (data.dropped ? `，溢出丢弃 ${data.dropped}` : '');
+    })
+    .catch(e => console.error(e));
+}
+
+// 分段结果按序号增量拉取，表格只保留最近的若干行
+function refreshSectors() {
+  const table = document.getElementById("sectorTable");
+  if (!table) return;
+  fetch(esp32BaseUrl + "/sectors?after=" + sectorLastSeq)
+    .then(r => r.json())
+    .then(data => {
+      if (data.last < sectorLastSeq) sectorLastSeq = 0;
+      (data.results || []).forEach(s => {
+        if (s.seq <= sectorLastSeq) return;
+        sectorLastSeq = s.seq;
+        const row = table.insertRow(1);
+        row.insertCell(0).textContent = s.freq;
+        row.insertCell(1).textContent = s.lap;
+        row.insertCell(2).textContent = s.sector === 0 ? "整圈" : `${s.sector}/${s.sectors}`;
+        row.insertCell(3).textContent = (s.uncUs === null ? "~" : "") + (s.us / 1000000).toFixed(3) + " s";
+        row.insertCell(4).textContent = { ok: "", missing: "漏段", repeat: "重复", late: "迟到" }[s.status] || s.status;
+      });
+      while (table.rows.length > 41) table.deleteRow(table.rows.length - 1);
+      const status = document.getElementById("sectorStatus");
+      status.textContent = data.gates >= 2 ?
+        `分段：本机门 ${data.gate}/${data.gates}，正常 ${data.ok}，漏段 ${data.missing}，重复 ${data.repeat}，迟到 ${data.late}` : '';
+    })
+    .catch(e => console.error(e));
+}
+
+function clearRaceNet() {
+  fetch(esp32BaseUrl + "/race/clear", { method: "POST" })
+    .then(() => {
+      const table = document.getElementById("sectorTable");
+      while (table && table.rows.length > 1) table.deleteRow(1);
+      refreshRace();
+    })
+    .catch(e => console.error(e));
+}
+
+// 比赛页打开时轮询节点和合并圈速，设备在请求后一段时间内担任汇总方
+function startRaceNetPoll() {
+  if (raceNetPollInterval) return;
+  refreshNodes();
+  refreshRace();
+  refreshSectors();
+  raceNetPollInterval = setInterval(() => {
+    refreshNodes();
+    refreshRace();
+    refreshSectors();
+  }, 2000);
+}
+
+function stopRaceNetPoll() {
+  clearInterval(raceNetPollInterval);
+  raceNetPollInterval = null;
+}
+
 function openTab(evt, tabName) {
   // Declare all variables
   var i, tabcontent, tablinks;
@@ -997,6 +1125,9 @@ function openTab(evt, tabName) {
   document.getElementById(tabName).style.display = "block";
   evt.currentTarget.className += " active";
 
+  if (tabName === "race") startRaceNetPoll();
+  else stopRaceNetPoll();
+
   // if event comes from calibration tab, signal to start sending RSSI events
   if (tabName === "calib" && !rssiSending) {
     fetch(esp32BaseUrl + "/timer/rssiStart", {
@@ -1061,6 +1192,17 @@ function saveConfig() {
       enterRssi: enterRssi,
       exitRssi: exitRssi,
       droneSize: getSelectedDroneSize(),
+      detector: parseInt(detectorSelect?.value || "0"),
+      floorTrack: parseInt(floorTrackSelect?.value || "0"),
+      enterOffset: parseInt(enterOffsetInput?.value || "50"),
+      exitOffset: parseInt(exitOffsetInput?.value || "30"),
+      trackMax: parseInt(trackMaxInput?.value || "40"),
+      scanFreqs: parseScanFrequencies(scanFreqsInput?.value || ""),
+      sector: parseInt(sectorIndexInput?.value || "0"),
+      sectors: parseInt(sectorCountInput?.value || "0"),
+      lapCast: parseInt(lapCastSelect?.value || "0"),
+      raceLink: parseInt(raceLinkSelect?.value || "0"),
+      serialLink: parseInt(serialLinkSelect?.value || "0"),
       calibSamples: getCalibrationSamplesTarget(),
       name: pilotNameInput.value,
       pilotId: pilotIdInput.value,
@@ -1508,6 +1650,42 @@ function initEventStream() {
     false
   );
 
+  source.addEventListener(
+    "noise",
+    function (e) {
+      try {
+        updateNoiseStatus(JSON.parse(e.data));
+      } catch (err) {
+        console.log("noise parse error", e.data);
+      }
+    },
+    false
+  );
+
+  source.addEventListener(
+    "spectrum",
+    function (e) {
+      try {
+        onSpectrumChannel(JSON.parse(e.data));
+      } catch (err) {
+        console.log("spectrum parse error", e.data);
+      }
+    },
+    false
+  );
+
+  source.addEventListener(
+    "spectrumDone",
+    function (e) {
+      try {
+        onSpectrumDone(JSON.parse(e.data));
+      } catch (err) {
+        console.log("spectrumDone parse error", e.data);
+      }
+    },
+    false
+  );
+
   source.addEventListener(
     "lap",
     function (e) {
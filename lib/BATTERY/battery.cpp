@@ -25,7 +25,7 @@ static uint16_t averageSum = 0;
 
 uint8_t BatteryMonitor::getBatteryVoltage() {
     // 0-3.3V maps to 0-4095, battery voltage ranges from 4.2V to 3.0V, but the voltage is divided, so 2.1V - 1.5V
-    volatile uint16_t raw = analogRead(vbatPin);
+    volatile uint16_t raw = (rawReader != nullptr) ? rawReader() : analogRead(vbatPin);
     averageSum = averageSum - measurements[measurementIndex];  // substract oldest val
     measurements[measurementIndex] = raw;                      // replace old with new val
     averageSum += raw;                                         // update averageSum
@@ -35,6 +35,10 @@ uint8_t BatteryMonitor::getBatteryVoltage() {
     return scaled;
 }
 
+void BatteryMonitor::setRawReader(uint16_t (*reader)(void)) {
+    rawReader = reader;
+}
+
 void BatteryMonitor::checkBatteryState(uint32_t currentTimeMs, uint8_t alarmThreshold) {
     switch (state) {
         case ALARM_OFF:
@@ -18,6 +18,8 @@ class BatteryMonitor {
     void init(uint8_t pin, uint8_t batScale, uint8_t batAdd, Buzzer *buzzer, Led *l);
     uint8_t getBatteryVoltage();
     void checkBatteryState(uint32_t currentTimeMs, uint8_t alarmThreshold);
+    // ADC1被连续采样占用时，改由该函数提供原始电压读数
+    void setRawReader(uint16_t (*reader)(void));
 
    private:
     alarm_state_e state = ALARM_OFF;
@@ -29,5 +31,6 @@ class BatteryMonitor {
     uint8_t add = 0;
     Buzzer *buz;
     Led *led;
+    uint16_t (*rawReader)(void) = nullptr;
 };
 
@@ -1,18 +1,18 @@
 #include "buzzer.h"
 
 void Buzzer::init(uint8_t pin, bool inverted) {
-    pinMode(pin, OUTPUT);
-    initialState = inverted ? HIGH : LOW;
+    halPinMode(pin, HAL_PIN_OUTPUT);
+    initialState = inverted ? HAL_HIGH : HAL_LOW;
     buzzerPin = pin;
     buzzerState = BUZZER_IDLE;
-    digitalWrite(buzzerPin, initialState);
+    halDigitalWrite(buzzerPin, initialState);
 }
 
 void Buzzer::beep(uint32_t timeMs) {
     beepTimeMs = timeMs;
     buzzerState = BUZZER_BEEPING;
-    startTimeMs = millis();
-    digitalWrite(buzzerPin, !initialState);
+    startTimeMs = halMillis();
+    halDigitalWrite(buzzerPin, !initialState);
 }
 
 void Buzzer::handleBuzzer(uint32_t currentTimeMs) {
@@ -24,7 +24,7 @@ void Buzzer::handleBuzzer(uint32_t currentTimeMs) {
                 break;  // updated from different core
             }
             if ((currentTimeMs - startTimeMs) > beepTimeMs) {
-                digitalWrite(buzzerPin, initialState);
+                halDigitalWrite(buzzerPin, initialState);
                 buzzerState = BUZZER_IDLE;
             }
             break;
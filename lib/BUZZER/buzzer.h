@@ -1,7 +1,9 @@
-#include <Arduino.h>
-
 #pragma once
 
+#include <stdint.h>
+
+#include "hal.h"
+
 typedef enum {
     BUZZER_IDLE,
     BUZZER_BEEPING
@@ -16,7 +18,7 @@ class Buzzer {
    private:
     buzzer_state_e buzzerState = BUZZER_IDLE;
     uint8_t buzzerPin;
-    uint8_t initialState = LOW;
+    uint8_t initialState = HAL_LOW;
     uint32_t beepTimeMs;
     uint32_t startTimeMs;
 };
@@ -0,0 +1,77 @@
+#include "calibration.h"
+
+#include <math.h>
+#include <string.h>
+
+void CalibrationHistogram::reset() {
+    count = 0;
+    memset((void *)bins, 0, sizeof(bins));
+    sum = 0;
+    minRssi = 255;
+    maxRssi = 0;
+}
+
+void CalibrationHistogram::add(uint8_t rssi) {
+    bins[rssi] = bins[rssi] + 1;
+    sum = sum + rssi;
+    if (rssi < minRssi) minRssi = rssi;
+    if (rssi > maxRssi) maxRssi = rssi;
+    count = count + 1;
+}
+
+uint16_t CalibrationHistogram::getMeanQ4() {
+    const uint32_t n = count;
+    if (n == 0) return 0;
+    return (uint16_t)((sum * 16 + n / 2) / n);
+}
+
+uint8_t CalibrationHistogram::getPercentile(uint16_t permille) {
+    const uint32_t n = count;
+    if (n == 0) return 0;
+    if (permille > 1000) permille = 1000;
+    // 第rank个样本（从1开始）所在的格
+    uint32_t rank = (uint32_t)(((uint64_t)n * permille + 999) / 1000);
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (uint16_t i = 0; i < CALIBRATION_BINS; i++) {
+        seen += bins[i];
+        if (seen >= rank) return i;
+    }
+    return getMax();
+}
+
+static float clampf(float v, float minV, float maxV) {
+    if (v < minV) return minV;
+    if (v > maxV) return maxV;
+    return v;
+}
+
+void calibrationRecommend(CalibrationHistogram *hist, uint16_t gateDiameterMm, uint8_t dropPercent,
+                          calibration_result_t *result) {
+    const float drop = dropPercent / 100.0f;
+    const float diameterM = gateDiameterMm / 1000.0f;
+
+    // 门越小，要求信号越强才算在门内
+    const float diameterCorrection = 1.0f + (1.0f - diameterM / 1.5f) * 0.3f;
+    const float enterRatio = clampf(clampf(1 - drop * 0.7f, 0.55f, 0.8f) * diameterCorrection, 0.65f, 0.9f);
+    const float exitRatio = clampf(clampf(1 - drop * 1.3f, 0.2f, 0.7f) * diameterCorrection, 0.3f, 0.8f);
+    const uint8_t minDelta = (uint8_t)clampf(roundf(25 * (1.5f / diameterM)), 10, 35);
+
+    result->noise = hist->getPercentile(CALIBRATION_NOISE_PERMILLE);
+    result->median = hist->getPercentile(500);
+    result->spread = result->noise - result->median;
+    result->minDelta = minDelta;
+    // 底噪抖动大时拉开与底噪的距离，避免底噪偶尔越过进入阈值
+    const uint16_t spreadDelta = (uint16_t)result->spread * 2;
+    result->delta = spreadDelta > minDelta ? (spreadDelta > 255 ? 255 : spreadDelta) : minDelta;
+
+    int32_t enter = lroundf(result->noise + result->delta * enterRatio);
+    int32_t exit = lroundf(result->noise + result->delta * exitRatio);
+    if (enter > 255) enter = 255;
+    if (exit > 255) exit = 255;
+    if (enter <= exit) {
+        enter = exit + 10 > 255 ? 255 : exit + 10;
+    }
+    result->enter = enter;
+    result->exit = exit;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#define CALIBRATION_BINS 256            // 每个8位RSSI值一格
+#define CALIBRATION_MS_PER_TARGET 200   // 配置的“采样次数”每次对应200 ms（原网页端的采样间隔）
+#define CALIBRATION_NOISE_PERMILLE 999  // 以99.9%分位数作为底噪上沿，个别尖峰不影响
+#define CALIBRATION_DEFAULT_DROP 30     // 默认RSSI降低量（百分比），与网页高级设置一致
+
+/**
+ * 校准期间的RSSI直方图。计时核逐样本add()，其他任务可随时读取统计值：
+ * 计数只增不减，读到的是某个瞬间前后的近似快照，最多差几个样本。
+ */
+class CalibrationHistogram {
+   public:
+    void reset();
+    void add(uint8_t rssi);
+
+    uint32_t getCount() { return count; }
+    uint8_t getMin() { return count ? minRssi : 0; }
+    uint8_t getMax() { return count ? maxRssi : 0; }
+    uint32_t getBin(uint8_t rssi) { return bins[rssi]; }
+    // 平均值 * 16
+    uint16_t getMeanQ4();
+    // 千分位数：permille为0 - 1000
+    uint8_t getPercentile(uint16_t permille);
+
+   private:
+    volatile uint32_t bins[CALIBRATION_BINS];
+    volatile uint32_t count = 0;
+    volatile uint64_t sum = 0;
+    volatile uint8_t minRssi = 255;
+    volatile uint8_t maxRssi = 0;
+};
+
+typedef struct {
+    uint8_t noise;     // 底噪上沿（99.9%分位数）
+    uint8_t median;
+    uint8_t spread;    // 底噪上沿与中位数之差
+    uint8_t minDelta;  // 按门尺寸要求的最小RSSI变化量
+    uint8_t delta;     // 实际使用的变化量
+    uint8_t enter;
+    uint8_t exit;
+} calibration_result_t;
+
+/**
+ * 由直方图计算推荐的进入/退出阈值。
+ * 变化量取门尺寸要求的minDelta和底噪宽度的2倍中较大者，进入/退出阈值为底噪上沿加上变化量的一定比例，
+ * 比例由降低量百分比和门直径决定（与原网页端算法一致），门越小比例越高。
+ */
+void calibrationRecommend(CalibrationHistogram *hist, uint16_t gateDiameterMm, uint8_t dropPercent,
+                          calibration_result_t *result);
@@ -1,8 +1,9 @@
 #include "config.h"
 
-#include <EEPROM.h>
+#include <string.h>
 
 #include "debug.h"
+#include "hal.h"
 
 void Config::init(void) {
     if (sizeof(laptimer_config_t) > EEPROM_RESERVED_SIZE) {
@@ -10,25 +11,25 @@ void Config::init(void) {
         return;
     }
 
-    EEPROM.begin(EEPROM_RESERVED_SIZE);  // Size of EEPROM
-    load();                              // Override default settings from EEPROM
+    halStorageBegin(EEPROM_RESERVED_SIZE);  // Size of EEPROM
+    load();                                 // Override default settings from EEPROM
 
-    checkTimeMs = millis();
+    checkTimeMs = halMillis();
 
     DEBUG("EEPROM Init Successful\n");
 }
 
 void Config::load(void) {
     modified = false;
-    EEPROM.get(0, conf);
+    halStorageRead(0, &conf, sizeof(conf));
 
     uint32_t version = 0xFFFFFFFF;
     if ((conf.version & CONFIG_MAGIC_MASK) == CONFIG_MAGIC) {
         version = conf.version & ~CONFIG_MAGIC_MASK;
     }
 
+    // 旧版本逐级迁移到当前版本，新增字段取默认值
     if (version == 1) {
-        conf.version = CONFIG_VERSION | CONFIG_MAGIC;
         if (conf.droneSize != 2 && conf.droneSize != 5) {
             conf.droneSize = 5;
         }
@@ -36,11 +37,46 @@ void Config::load(void) {
             conf.calibSamples = 20;
         }
         strlcpy(conf.pilotId, "", sizeof(conf.pilotId));
-        modified = true;
-        write();
-        return;
+        version = 4;
     }
     if (version == 2) {
+        version = 4;
+    }
+    // 版本4没有detector字段，保持原来的峰值检测
+    if (version == 4) {
+        conf.detector = LAPTIMER_DETECTOR_PEAK;
+        version = 5;
+    }
+    // 版本5没有底噪跟踪字段，默认关闭
+    if (version == 5) {
+        setFloorTrackDefaults();
+        version = 6;
+    }
+    // 版本6没有扫描列表，保持单频
+    if (version == 6) {
+        conf.scanCount = 0;
+        memset(conf.scanFreqs, 0, sizeof(conf.scanFreqs));
+        version = 7;
+    }
+    // 版本7没有分段计时，只当起终点门
+    if (version == 7) {
+        conf.sectorIndex = 0;
+        conf.sectorCount = 0;
+        version = 8;
+    }
+    // 版本8没有UDP圈速广播，保持关闭
+    if (version == 8) {
+        conf.lapCast = 0;
+        version = 9;
+    }
+    // 版本9没有ESP-NOW，保持UDP
+    if (version == 9) {
+        conf.raceLink = 0;
+        version = 10;
+    }
+    // 版本10没有有线串口协议，保持串口调试输出
+    if (version == 10) {
+        conf.serialLink = 0;
         conf.version = CONFIG_VERSION | CONFIG_MAGIC;
         modified = true;
         write();
@@ -58,17 +94,18 @@ void Config::write(void) {
 
     DEBUG("Writing to EEPROM\n");
 
-    EEPROM.put(0, conf);
-    EEPROM.commit();
+    halStorageWrite(0, &conf, sizeof(conf));
+    halStorageCommit();
 
     DEBUG("Writing to EEPROM done\n");
 
     modified = false;
 }
 
+#if defined(ARDUINO)
 void Config::toJson(AsyncResponseStream& destination) {
     // Use https://arduinojson.org/v6/assistant to estimate memory
-    DynamicJsonDocument config(320);
+    DynamicJsonDocument config(640);
     config["freq"] = conf.frequency;
     config["minLap"] = conf.minLap;
     config["alarm"] = conf.alarm;
@@ -79,6 +116,20 @@ void Config::toJson(AsyncResponseStream& destination) {
     config["droneSize"] = conf.droneSize;
     config["gateDiameterMm"] = getGateDiameterMm();
     config["calibSamples"] = conf.calibSamples;
+    config["detector"] = getDetector();
+    config["floorTrack"] = conf.floorTrack;
+    config["enterOffset"] = conf.enterOffset;
+    config["exitOffset"] = conf.exitOffset;
+    config["trackMax"] = conf.trackMax;
+    JsonArray scanFreqs = config["scanFreqs"].to<JsonArray>();
+    for (uint8_t i = 0; i < conf.scanCount && i < CONFIG_MAX_SCAN_CHANNELS; i++) {
+        scanFreqs.add(conf.scanFreqs[i]);
+    }
+    config["sector"] = conf.sectorIndex;
+    config["sectors"] = conf.sectorCount;
+    config["lapCast"] = conf.lapCast;
+    config["raceLink"] = conf.raceLink;
+    config["serialLink"] = conf.serialLink;
     config["name"] = conf.pilotName;
     config["pilotId"] = conf.pilotId;
     config["ssid"] = conf.ssid;
@@ -86,9 +137,10 @@ void Config::toJson(AsyncResponseStream& destination) {
     config["apiAddress"] = conf.apiAddress;
     serializeJson(config, destination);
 }
+#endif
 
 void Config::toJsonString(char* buf) {
-    DynamicJsonDocument config(512);
+    DynamicJsonDocument config(640);
     config["freq"] = conf.frequency;
     config["minLap"] = conf.minLap;
     config["alarm"] = conf.alarm;
@@ -99,12 +151,26 @@ void Config::toJsonString(char* buf) {
     config["droneSize"] = conf.droneSize;
     config["gateDiameterMm"] = getGateDiameterMm();
     config["calibSamples"] = conf.calibSamples;
+    config["detector"] = getDetector();
+    config["floorTrack"] = conf.floorTrack;
+    config["enterOffset"] = conf.enterOffset;
+    config["exitOffset"] = conf.exitOffset;
+    config["trackMax"] = conf.trackMax;
+    JsonArray scanFreqs = config["scanFreqs"].to<JsonArray>();
+    for (uint8_t i = 0; i < conf.scanCount && i < CONFIG_MAX_SCAN_CHANNELS; i++) {
+        scanFreqs.add(conf.scanFreqs[i]);
+    }
+    config["sector"] = conf.sectorIndex;
+    config["sectors"] = conf.sectorCount;
+    config["lapCast"] = conf.lapCast;
+    config["raceLink"] = conf.raceLink;
+    config["serialLink"] = conf.serialLink;
     config["name"] = conf.pilotName;
     config["pilotId"] = conf.pilotId;
     config["ssid"] = conf.ssid;
     config["pwd"] = conf.password;
     config["apiAddress"] = conf.apiAddress;
-    serializeJson(config, buf, 512);
+    serializeJson(config, buf, 640);
 }
 
 void Config::fromJson(JsonObject source) {
@@ -153,6 +219,40 @@ void Config::fromJson(JsonObject source) {
             modified = true;
         }
     }
+    if (source.containsKey("detector")) {
+        uint8_t det = source["detector"];
+        if (det > LAPTIMER_DETECTOR_HYSTERESIS) det = LAPTIMER_DETECTOR_PEAK;
+        if (det != conf.detector) {
+            conf.detector = det;
+            modified = true;
+        }
+    }
+    if (source.containsKey("floorTrack")) {
+        setFloorTrack(source["floorTrack"], source["enterOffset"] | conf.enterOffset,
+                      source["exitOffset"] | conf.exitOffset, source["trackMax"] | conf.trackMax);
+    }
+    if (source.containsKey("scanFreqs")) {
+        JsonArray scanFreqs = source["scanFreqs"].as<JsonArray>();
+        uint16_t freqs[CONFIG_MAX_SCAN_CHANNELS];
+        uint8_t count = 0;
+        for (JsonVariant f : scanFreqs) {
+            if (count >= CONFIG_MAX_SCAN_CHANNELS) break;
+            freqs[count++] = f.as<uint16_t>();
+        }
+        setScanFrequencies(freqs, count);
+    }
+    if (source.containsKey("sectors")) {
+        setSector(source["sector"] | conf.sectorIndex, source["sectors"]);
+    }
+    if (source.containsKey("lapCast")) {
+        setLapCastMode(source["lapCast"]);
+    }
+    if (source.containsKey("raceLink")) {
+        setRaceLink(source["raceLink"]);
+    }
+    if (source.containsKey("serialLink")) {
+        setSerialLink(source["serialLink"]);
+    }
     if (source["name"] != conf.pilotName) {
         strlcpy(conf.pilotName, source["name"] | "", sizeof(conf.pilotName));
         modified = true;
@@ -210,6 +310,52 @@ uint16_t Config::getCalibrationSamples() {
     return conf.calibSamples;
 }
 
+uint8_t Config::getDetector() {
+    return conf.detector <= LAPTIMER_DETECTOR_HYSTERESIS ? (laptimer_detector_e)conf.detector : LAPTIMER_DETECTOR_PEAK;
+}
+
+bool Config::getFloorTrack() {
+    return conf.floorTrack == 1;
+}
+
+uint8_t Config::getEnterOffset() {
+    return conf.enterOffset;
+}
+
+uint8_t Config::getExitOffset() {
+    return conf.exitOffset;
+}
+
+uint8_t Config::getTrackMax() {
+    return conf.trackMax;
+}
+
+uint8_t Config::getScanFrequencies(uint16_t* freqs) {
+    const uint8_t count = conf.scanCount > CONFIG_MAX_SCAN_CHANNELS ? CONFIG_MAX_SCAN_CHANNELS : conf.scanCount;
+    memcpy(freqs, conf.scanFreqs, count * sizeof(uint16_t));
+    return count;
+}
+
+uint8_t Config::getSectorIndex() {
+    return conf.sectorCount >= 2 ? conf.sectorIndex : 0;
+}
+
+uint8_t Config::getSectorCount() {
+    return conf.sectorCount >= 2 ? conf.sectorCount : 0;
+}
+
+uint8_t Config::getLapCastMode() {
+    return conf.lapCast;
+}
+
+uint8_t Config::getRaceLink() {
+    return conf.raceLink;
+}
+
+bool Config::getSerialLink() {
+    return conf.serialLink == 1;
+}
+
 char* Config::getSsid() {
     return conf.ssid;
 }
@@ -230,6 +376,116 @@ char* Config::getApiAddress() {
     return conf.apiAddress;
 }
 
+void Config::setFrequency(uint16_t frequency) {
+    if (frequency == conf.frequency) return;
+    conf.frequency = frequency;
+    modified = true;
+}
+
+void Config::setEnterRssi(uint8_t rssi) {
+    if (rssi == conf.enterRssi) return;
+    conf.enterRssi = rssi;
+    modified = true;
+}
+
+void Config::setExitRssi(uint8_t rssi) {
+    if (rssi == conf.exitRssi) return;
+    conf.exitRssi = rssi;
+    modified = true;
+}
+
+// 存储单位为100 ms
+void Config::setMinLapMs(uint32_t ms) {
+    uint32_t minLap = ms / 100;
+    if (minLap > 255) minLap = 255;
+    if (minLap == conf.minLap) return;
+    conf.minLap = minLap;
+    modified = true;
+}
+
+void Config::setDetector(uint8_t detector) {
+    if (detector > LAPTIMER_DETECTOR_HYSTERESIS) detector = LAPTIMER_DETECTOR_PEAK;
+    if (detector == conf.detector) return;
+    conf.detector = detector;
+    modified = true;
+}
+
+void Config::setFloorTrack(bool enabled, uint8_t enterOffset, uint8_t exitOffset, uint8_t trackMax) {
+    // 退出偏移不能高于进入偏移，否则滞回反向
+    if (exitOffset > enterOffset) exitOffset = enterOffset;
+    if (enabled == getFloorTrack() && enterOffset == conf.enterOffset && exitOffset == conf.exitOffset &&
+        trackMax == conf.trackMax) {
+        return;
+    }
+    conf.floorTrack = enabled ? 1 : 0;
+    conf.enterOffset = enterOffset;
+    conf.exitOffset = exitOffset;
+    conf.trackMax = trackMax;
+    modified = true;
+}
+
+// 超出5300 - 5950 MHz（含LowRace频段）的频率丢弃；少于2个频率等于关闭扫描
+void Config::setScanFrequencies(const uint16_t* freqs, uint8_t count) {
+    uint16_t valid[CONFIG_MAX_SCAN_CHANNELS];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count && n < CONFIG_MAX_SCAN_CHANNELS; i++) {
+        if (freqs[i] >= 5300 && freqs[i] <= 5950) valid[n++] = freqs[i];
+    }
+    if (n < 2) n = 0;
+    if (n == conf.scanCount && memcmp(valid, conf.scanFreqs, n * sizeof(uint16_t)) == 0) return;
+    memset(conf.scanFreqs, 0, sizeof(conf.scanFreqs));
+    memcpy(conf.scanFreqs, valid, n * sizeof(uint16_t));
+    conf.scanCount = n;
+    modified = true;
+}
+
+// 门数不足2个等于关闭分段；门序号超出范围时退回起终点门
+void Config::setSector(uint8_t index, uint8_t count) {
+    if (count < 2) count = 0;
+    if (count > CONFIG_MAX_SECTORS) count = CONFIG_MAX_SECTORS;
+    if (index >= count) index = 0;
+    if (index == conf.sectorIndex && count == conf.sectorCount) return;
+    conf.sectorIndex = index;
+    conf.sectorCount = count;
+    modified = true;
+}
+
+// 超出范围的取值视为关闭（与lapcast_mode_e的LAPCAST_MULTICAST一致）
+void Config::setLapCastMode(uint8_t mode) {
+    if (mode > 2) mode = 0;
+    if (mode == conf.lapCast) return;
+    conf.lapCast = mode;
+    modified = true;
+}
+
+void Config::setRaceLink(uint8_t link) {
+    if (link > 1) link = 0;
+    if (link == conf.raceLink) return;
+    conf.raceLink = link;
+    modified = true;
+}
+
+void Config::setSerialLink(bool enabled) {
+    const uint8_t link = enabled ? 1 : 0;
+    if (link == conf.serialLink) return;
+    conf.serialLink = link;
+    modified = true;
+}
+
+void Config::setFloorTrackDefaults() {
+    conf.floorTrack = 0;
+    conf.enterOffset = 50;
+    conf.exitOffset = 30;
+    conf.trackMax = 40;
+}
+
+void Config::setDroneSize(uint8_t size) {
+    if (size != 2 && size != 5) size = 5;
+    if (size == conf.droneSize) return;
+    conf.droneSize = size;
+    modified = true;
+}
+
 void Config::setDefaults(void) {
     DEBUG("Setting EEPROM defaults\n");
     // Reset everything to 0/false and then just set anything that zero is not appropriate
@@ -244,6 +500,7 @@ void Config::setDefaults(void) {
     conf.exitRssi = 100;
     conf.droneSize = 5;
     conf.calibSamples = 20;
+    setFloorTrackDefaults();
     // strlcpy(conf.ssid, "FCJLY", sizeof(conf.ssid));
     // strlcpy(conf.password, "fcj8949008ly", sizeof(conf.password));
 
@@ -1,5 +1,9 @@
+#pragma once
+
 #include <ArduinoJson.h>
+#if defined(ARDUINO)
 #include <AsyncJson.h>
+#endif
 #include <stdint.h>
 
 /*
@@ -79,10 +83,18 @@
 #define EEPROM_RESERVED_SIZE 256
 #define CONFIG_MAGIC_MASK (0b11U << 30)
 #define CONFIG_MAGIC (0b01U << 30)
-#define CONFIG_VERSION 4U
+#define CONFIG_VERSION 11U
+#define CONFIG_MAX_SCAN_CHANNELS 8  // 单个RX5808轮流扫描的最多频率数
+#define CONFIG_MAX_SECTORS 8        // 分段计时最多的门数（含起终点门）
 
 #define EEPROM_CHECK_TIME_MS 1000
 
+// 穿越检测算法
+typedef enum {
+    LAPTIMER_DETECTOR_PEAK = 0,        // 峰值后下降minDelta即判定（原算法）
+    LAPTIMER_DETECTOR_HYSTERESIS = 1   // 高于enterRssi开窗、低于exitRssi关窗，窗内取峰值
+} laptimer_detector_e;
+
 typedef struct {
     uint32_t version;
     uint16_t frequency;
@@ -99,6 +111,23 @@ typedef struct {
     char ssid[33];
     char password[33];
     char apiAddress[100];
+    uint8_t detector;  // 穿越检测算法，见laptimer_detector_e（版本5新增）
+    // 底噪跟踪（版本6新增）：开启后阈值 = 底噪 + 偏移，
+    // 限制在[enterRssi, enterRssi + trackMax]和[exitRssi, exitRssi + trackMax]内
+    uint8_t floorTrack;
+    uint8_t enterOffset;
+    uint8_t exitOffset;
+    uint8_t trackMax;
+    // 多频扫描（版本7新增）：scanCount >= 2时轮流监听scanFreqs，重启后生效
+    uint8_t scanCount;
+    uint16_t scanFreqs[CONFIG_MAX_SCAN_CHANNELS];
+    // 分段计时（版本8新增）：本节点是赛道上第sectorIndex个门（0为起终点），全程共sectorCount个门，
+    // sectorCount < 2表示不参与分段
+    uint8_t sectorIndex;
+    uint8_t sectorCount;
+    uint8_t lapCast;  // UDP圈速广播（版本9新增），见lapcast_mode_e：0关闭、1广播、2组播
+    uint8_t raceLink;  // 多节点汇总的传输（版本10新增）：0为UDP，1为ESP-NOW，重启后生效
+    uint8_t serialLink;  // 有线串口二进制协议（版本11新增）：1为启用，串口切到SERIAL_LINK_BAUD并关闭调试输出，重启后生效
 } laptimer_config_t;
 
 class Config {
@@ -106,7 +135,9 @@ class Config {
     void init();
     void load();
     void write();
+#if defined(ARDUINO)
     void toJson(AsyncResponseStream& destination);
+#endif
     void toJsonString(char* buf);
     void fromJson(JsonObject source);
     void handleEeprom(uint32_t currentTimeMs);
@@ -120,15 +151,39 @@ class Config {
     uint8_t getDroneSize();
     uint16_t getGateDiameterMm();
     uint16_t getCalibrationSamples();
+    uint8_t getDetector();
+    bool getFloorTrack();
+    uint8_t getEnterOffset();
+    uint8_t getExitOffset();
+    uint8_t getTrackMax();
+    uint8_t getScanFrequencies(uint16_t* freqs);  // 返回频率数，freqs至少CONFIG_MAX_SCAN_CHANNELS个
+    uint8_t getSectorIndex();
+    uint8_t getSectorCount();
+    uint8_t getLapCastMode();
+    uint8_t getRaceLink();
+    bool getSerialLink();
     char* getSsid();
     char* getPassword();
     char* getPilotName();
     char* getPilotId();
     char* getApiAddress();
+    void setFrequency(uint16_t frequency);
+    void setEnterRssi(uint8_t rssi);
+    void setExitRssi(uint8_t rssi);
+    void setMinLapMs(uint32_t ms);
+    void setDroneSize(uint8_t size);
+    void setDetector(uint8_t detector);
+    void setFloorTrack(bool enabled, uint8_t enterOffset, uint8_t exitOffset, uint8_t trackMax);
+    void setScanFrequencies(const uint16_t* freqs, uint8_t count);
+    void setSector(uint8_t index, uint8_t count);
+    void setLapCastMode(uint8_t mode);
+    void setRaceLink(uint8_t link);
+    void setSerialLink(bool enabled);
 
    private:
     laptimer_config_t conf;
     bool modified;
     volatile uint32_t checkTimeMs = 0;
     void setDefaults();
+    void setFloorTrackDefaults();
 };
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32（IEEE 802.3，反射多项式0xEDB88320），与zlib/Python binascii.crc32结果一致
+uint32_t crc32(const uint8_t *data, size_t len);
+// 分段计算：crc初值传0，后续传上一次的返回值
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
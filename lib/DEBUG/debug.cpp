@@ -0,0 +1,5 @@
+#include "debug.h"
+
+#if defined(ARDUINO)
+volatile bool debugMuted = false;
+#endif
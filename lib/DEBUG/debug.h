@@ -1,6 +1,12 @@
 #pragma once
 
+#if defined(ARDUINO)
 #include <Arduino.h>
+#else
+#include <stdio.h>
+
+#include "hal.h"
+#endif
 
 // 固件版本号定义
 #define FIRMWARE_VERSION "1.0.9"
@@ -8,11 +14,22 @@
 #define FILESYSTEM_VERSION "1.0.7"
 
 #define SERIAL_BAUD 115200
+#if defined(ARDUINO)
+// 有线串口协议启用后串口上只能有二进制帧，置位后DEBUG输出全部丢弃（见serial_link.h）
+extern volatile bool debugMuted;
 #define DEBUG_OUT Serial
+#define DEBUG_PRINTF(...) do { if (!debugMuted) DEBUG_OUT.printf(__VA_ARGS__); } while(0)
+#define DEBUG_MILLIS() millis()
+#elif defined(NATIVE_DEBUG)
+// 主机上调试输出写到stderr，stdout留给仿真结果；默认关闭，避免影响性能测量
+#define DEBUG_OUT stderr
+#define DEBUG_PRINTF(...) fprintf(DEBUG_OUT, __VA_ARGS__)
+#define DEBUG_MILLIS() halMillis()
+#endif
 
 // 格式化时间戳 (毫秒 -> HH:MM:SS.mmm)
 #define TIMESTAMP() do { \
-  unsigned long ms = millis(); \
+  unsigned long ms = DEBUG_MILLIS(); \
   unsigned long s = ms / 1000; \
   unsigned long m = s / 60; \
   unsigned long h = m / 60; \
@@ -20,16 +37,20 @@
   s %= 60; \
   m %= 60; \
   h %= 24; \
-  DEBUG_OUT.printf("[%02lu:%02lu:%02lu.%03lu] ", h, m, s, ms); \
+  DEBUG_PRINTF("[%02lu:%02lu:%02lu.%03lu] ", h, m, s, ms); \
 } while(0)
 
-#ifdef DEBUG_OUT
+#if defined(DEBUG_OUT) && defined(ARDUINO)
 #define DEBUG_INIT DEBUG_OUT.begin(SERIAL_BAUD);
+#else
+#define DEBUG_INIT
+#endif
+
+#ifdef DEBUG_OUT
 #define DEBUG(...) do { \
   TIMESTAMP(); \
-  DEBUG_OUT.printf(__VA_ARGS__); \
+  DEBUG_PRINTF(__VA_ARGS__); \
 } while(0)
 #else
-#define DEBUG_INIT
 #define DEBUG(...)
 #endif
\ No newline at end of file
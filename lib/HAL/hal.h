@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 硬件抽象层：计时核（LapTimer/RX5808/Config/Kalman）只通过这里访问时钟、GPIO、ADC和持久化存储，
+ * 从而可以在Linux主机上编译运行（[env:native]）。
+ * ESP32上是对Arduino/ESP-IDF接口的直接转发（hal_esp32.cpp），主机实现见hal_native.cpp。
+ */
+
+#define HAL_LOW 0
+#define HAL_HIGH 1
+
+typedef enum {
+    HAL_PIN_INPUT,
+    HAL_PIN_OUTPUT,
+    HAL_PIN_INPUT_PULLUP
+} hal_pin_mode_e;
+
+// 时钟
+uint32_t halMillis();
+uint64_t halMicros();  // 64位单调微秒时间，ESP32上为esp_timer
+void halDelayMs(uint32_t ms);
+void halDelayUs(uint32_t us);
+
+// GPIO
+void halPinMode(uint8_t pin, hal_pin_mode_e mode);
+void halDigitalWrite(uint8_t pin, uint8_t level);
+uint8_t halDigitalRead(uint8_t pin);
+
+/**
+ * 直接读写GPIO寄存器，用于位时序很短的软件串行总线（RX5808）。
+ * 跳过digitalWrite()的引脚检查和函数调用，内联后只有一两条存储指令；引脚须已由halPinMode()配置。
+ */
+#if defined(ARDUINO)
+#include <hal/gpio_ll.h>
+inline void halDigitalWriteFast(uint8_t pin, uint8_t level) {
+    gpio_ll_set_level(&GPIO, (gpio_num_t)pin, level);
+}
+inline uint8_t halDigitalReadFast(uint8_t pin) {
+    return gpio_ll_get_level(&GPIO, (gpio_num_t)pin) ? HAL_HIGH : HAL_LOW;
+}
+#else
+inline void halDigitalWriteFast(uint8_t pin, uint8_t level) {
+    halDigitalWrite(pin, level);
+}
+inline uint8_t halDigitalReadFast(uint8_t pin) {
+    return halDigitalRead(pin);
+}
+#endif
+
+// ADC，12位原始值
+uint16_t halAnalogRead(uint8_t pin);
+
+// 持久化存储（ESP32上为EEPROM模拟区），写入后需commit才落盘
+bool halStorageBegin(size_t size);
+bool halStorageRead(size_t offset, void *buf, size_t len);
+bool halStorageWrite(size_t offset, const void *buf, size_t len);
+bool halStorageCommit();
+
+// 跨核临界区，只用于很短的拷贝
+#if defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+typedef portMUX_TYPE hal_lock_t;
+#define HAL_LOCK_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+#define halLock(lock) portENTER_CRITICAL(lock)
+#define halUnlock(lock) portEXIT_CRITICAL(lock)
+#else
+#include <atomic>
+typedef struct {
+    std::atomic_flag flag;
+} hal_lock_t;
+#define HAL_LOCK_INITIALIZER {ATOMIC_FLAG_INIT}
+inline void halLock(hal_lock_t *lock) {
+    while (lock->flag.test_and_set(std::memory_order_acquire)) {
+    }
+}
+inline void halUnlock(hal_lock_t *lock) {
+    lock->flag.clear(std::memory_order_release);
+}
+#endif
+
+#if !defined(ARDUINO)
+/**
+ * 主机端的仿真控制接口，只在native环境中存在。
+ * 时钟是虚拟的，只有调用halNativeSetTimeUs/halNativeAdvanceUs（或halDelay*）才会前进，
+ * 因此仿真结果与运行速度无关、可重复。
+ */
+void halNativeSetTimeUs(uint64_t timeUs);
+void halNativeAdvanceUs(uint64_t us);
+// 设置ADC读数来源，默认返回0
+void halNativeSetAnalogReader(uint16_t (*reader)(uint8_t pin, void *ctx), void *ctx);
+// 存储内容保存到文件；不设置时只在内存中
+void halNativeSetStorageFile(const char *path);
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+// 旧版glibc没有strlcpy，由hal_native.cpp提供
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+#endif
@@ -0,0 +1,67 @@
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <esp_timer.h>
+
+#include "hal.h"
+
+uint32_t halMillis() {
+    return millis();
+}
+
+uint64_t halMicros() {
+    return esp_timer_get_time();
+}
+
+void halDelayMs(uint32_t ms) {
+    delay(ms);
+}
+
+void halDelayUs(uint32_t us) {
+    delayMicroseconds(us);
+}
+
+void halPinMode(uint8_t pin, hal_pin_mode_e mode) {
+    switch (mode) {
+        case HAL_PIN_OUTPUT:
+            pinMode(pin, OUTPUT);
+            break;
+        case HAL_PIN_INPUT_PULLUP:
+            pinMode(pin, INPUT_PULLUP);
+            break;
+        default:
+            pinMode(pin, INPUT);
+            break;
+    }
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t level) {
+    digitalWrite(pin, level ? HIGH : LOW);
+}
+
+uint8_t halDigitalRead(uint8_t pin) {
+    return digitalRead(pin) ? HAL_HIGH : HAL_LOW;
+}
+
+uint16_t halAnalogRead(uint8_t pin) {
+    return analogRead(pin);
+}
+
+bool halStorageBegin(size_t size) {
+    return EEPROM.begin(size);
+}
+
+bool halStorageRead(size_t offset, void *buf, size_t len) {
+    return EEPROM.readBytes(offset, buf, len) == len;
+}
+
+bool halStorageWrite(size_t offset, const void *buf, size_t len) {
+    return EEPROM.writeBytes(offset, buf, len) == len;
+}
+
+bool halStorageCommit() {
+    return EEPROM.commit();
+}
+
+#endif
@@ -0,0 +1,125 @@
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+
+#define HAL_NATIVE_PINS 64
+
+static uint64_t nowUs = 0;
+static uint8_t pinLevel[HAL_NATIVE_PINS];
+static uint8_t pinModes[HAL_NATIVE_PINS];
+static uint16_t (*analogReader)(uint8_t pin, void *ctx) = nullptr;
+static void *analogReaderCtx = nullptr;
+static uint8_t *storage = nullptr;
+static size_t storageSize = 0;
+static const char *storagePath = nullptr;
+
+void halNativeSetTimeUs(uint64_t timeUs) {
+    nowUs = timeUs;
+}
+
+void halNativeAdvanceUs(uint64_t us) {
+    nowUs += us;
+}
+
+void halNativeSetAnalogReader(uint16_t (*reader)(uint8_t pin, void *ctx), void *ctx) {
+    analogReader = reader;
+    analogReaderCtx = ctx;
+}
+
+void halNativeSetStorageFile(const char *path) {
+    storagePath = path;
+}
+
+uint32_t halMillis() {
+    return (uint32_t)(nowUs / 1000);
+}
+
+uint64_t halMicros() {
+    return nowUs;
+}
+
+void halDelayMs(uint32_t ms) {
+    nowUs += (uint64_t)ms * 1000;
+}
+
+void halDelayUs(uint32_t us) {
+    nowUs += us;
+}
+
+void halPinMode(uint8_t pin, hal_pin_mode_e mode) {
+    if (pin >= HAL_NATIVE_PINS) return;
+    pinModes[pin] = mode;
+    // 上拉输入在没有外部驱动时读到高电平
+    if (mode == HAL_PIN_INPUT_PULLUP) pinLevel[pin] = HAL_HIGH;
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t level) {
+    if (pin >= HAL_NATIVE_PINS) return;
+    pinLevel[pin] = level ? HAL_HIGH : HAL_LOW;
+}
+
+uint8_t halDigitalRead(uint8_t pin) {
+    if (pin >= HAL_NATIVE_PINS) return HAL_LOW;
+    return pinLevel[pin];
+}
+
+uint16_t halAnalogRead(uint8_t pin) {
+    return analogReader ? analogReader(pin, analogReaderCtx) : 0;
+}
+
+// 与EEPROM模拟区一致：未写过的字节为0xFF
+bool halStorageBegin(size_t size) {
+    uint8_t *buf = (uint8_t *)realloc(storage, size);
+    if (buf == nullptr) return false;
+    storage = buf;
+    storageSize = size;
+    memset(storage, 0xFF, size);
+    if (storagePath != nullptr) {
+        FILE *f = fopen(storagePath, "rb");
+        if (f != nullptr) {
+            fread(storage, 1, size, f);
+            fclose(f);
+        }
+    }
+    return true;
+}
+
+bool halStorageRead(size_t offset, void *buf, size_t len) {
+    if (storage == nullptr || offset + len > storageSize) return false;
+    memcpy(buf, storage + offset, len);
+    return true;
+}
+
+bool halStorageWrite(size_t offset, const void *buf, size_t len) {
+    if (storage == nullptr || offset + len > storageSize) return false;
+    memcpy(storage + offset, buf, len);
+    return true;
+}
+
+bool halStorageCommit() {
+    if (storage == nullptr) return false;
+    if (storagePath == nullptr) return true;
+    FILE *f = fopen(storagePath, "wb");
+    if (f == nullptr) return false;
+    const bool ok = fwrite(storage, 1, storageSize, f) == storageSize;
+    fclose(f);
+    return ok;
+}
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    const size_t len = strlen(src);
+    if (size > 0) {
+        const size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+#include "journal.h"
+
+#include <string.h>
+
+#include "crc.h"
+
+void Journal::encode(journal_record_t *record) {
+    record->magic = JOURNAL_MAGIC;
+    record->crc = crc32((const uint8_t *)record, offsetof(journal_record_t, crc));
+}
+
+bool Journal::isValid(const journal_record_t *record) {
+    if (record->magic != JOURNAL_MAGIC) return false;
+    if (record->type < JOURNAL_SESSION_START || record->type > JOURNAL_SESSION_RECOVERED) return false;
+    return record->crc == crc32((const uint8_t *)record, offsetof(journal_record_t, crc));
+}
+
+void Journal::applyRecord(const journal_record_t *record) {
+    switch (record->type) {
+        case JOURNAL_SESSION_START:
+            lastSession.session = record->session;
+            lastSession.laps = 0;
+            lastSession.startTime = record->value;
+            lastSession.open = true;
+            break;
+        case JOURNAL_LAP:
+            if (record->session == lastSession.session) lastSession.laps++;
+            break;
+        case JOURNAL_SESSION_STOP:
+        case JOURNAL_SESSION_RECOVERED:
+            if (record->session == lastSession.session) lastSession.open = false;
+            break;
+        default:
+            break;
+    }
+}
+
+bool Journal::begin(JournalStorage *storage) {
+    store = storage;
+    sequence = 0;
+    truncatedBytes = 0;
+    recovered = false;
+    bootLapCount = 0;
+    memset(&lastSession, 0, sizeof(lastSession));
+    if (!store->open()) return false;
+
+    // 顺序扫描，遇到第一条不完整或校验失败的记录即停止
+    const uint32_t total = store->size();
+    uint32_t offset = 0;
+    journal_record_t record;
+    while (offset + sizeof(record) <= total) {
+        if (!store->read(offset, (uint8_t *)&record, sizeof(record))) break;
+        if (!isValid(&record)) break;
+        applyRecord(&record);
+        if (record.type == JOURNAL_SESSION_START) {
+            bootLapCount = 0;
+        } else if (record.type == JOURNAL_LAP && record.session == lastSession.session &&
+                   bootLapCount < JOURNAL_BOOT_MAX_LAPS) {
+            bootLapTimesUs[bootLapCount++] = record.value;
+        }
+        sequence = record.sequence + 1;
+        offset += sizeof(record);
+    }
+    store->endRead();
+
+    // 掉电写了一半的记录（及其后可能残留的垃圾）直接截掉
+    if (offset < total) {
+        truncatedBytes = total - offset;
+        if (!store->truncate(offset)) return false;
+    }
+
+    // 上一个会话没有正常结束，补写结束记录，圈数以已落盘的为准
+    bootSession = lastSession;
+    if (lastSession.open) {
+        recovered = true;
+        if (!append(JOURNAL_SESSION_RECOVERED, lastSession.laps, 0)) return false;
+    }
+    return true;
+}
+
+bool Journal::append(journal_record_e type, uint32_t lapNumber, uint32_t value) {
+    if (store == nullptr) return false;
+
+    journal_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.session = lastSession.session;
+    record.lapNumber = lapNumber;
+    record.value = value;
+    record.sequence = sequence;
+    encode(&record);
+
+    const uint32_t startUs = clockUs ? clockUs() : 0;
+    const bool ok = store->append((const uint8_t *)&record, sizeof(record));
+    if (clockUs) {
+        const uint32_t elapsedUs = clockUs() - startUs;
+        if (elapsedUs > maxWriteUs) maxWriteUs = elapsedUs;
+    }
+    if (!ok) {
+        writeErrors++;
+        return false;
+    }
+    sequence++;
+    applyRecord(&record);
+    return true;
+}
+
+bool Journal::sessionStart(uint32_t wallTime) {
+    if (store == nullptr) return false;
+    // 只在会话边界轮换，保证一个会话的记录都在同一个文件里
+    if (store->size() >= JOURNAL_MAX_BYTES) {
+        if (store->reset()) sequence = 0;
+    }
+    // 新会话号写进记录前先确定，applyRecord()再据此开启会话
+    if (lastSession.open) {
+        append(JOURNAL_SESSION_STOP, lastSession.laps, wallTime);
+    }
+    lastSession.session++;
+    return append(JOURNAL_SESSION_START, JOURNAL_VERSION, wallTime);
+}
+
+bool Journal::appendLap(uint32_t lapNumber, uint32_t lapTimeUs) {
+    if (!lastSession.open) return false;
+    return append(JOURNAL_LAP, lapNumber, lapTimeUs);
+}
+
+bool Journal::sessionStop(uint32_t wallTime) {
+    if (!lastSession.open) return false;
+    return append(JOURNAL_SESSION_STOP, lastSession.laps, wallTime);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOURNAL_MAGIC 0x4C  // 'L'
+#define JOURNAL_VERSION 1
+#define JOURNAL_MAX_BYTES 32768  // 超过后在下一次会话开始时轮换
+#define JOURNAL_BOOT_MAX_LAPS 64  // begin()时在内存里保留的最后一个会话的圈速
+
+typedef enum {
+    JOURNAL_SESSION_START = 1,
+    JOURNAL_LAP = 2,
+    JOURNAL_SESSION_STOP = 3,
+    JOURNAL_SESSION_RECOVERED = 4  // 启动时替未正常结束的会话补写的结束记录
+} journal_record_e;
+
+/**
+ * 定长日志记录（20字节，小端）。crc覆盖前16字节，
+ * 掉电导致的半条记录或错位数据在恢复时都会因magic/crc不符被截掉。
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t type;        // journal_record_e
+    uint16_t session;    // 会话号，每次start加1
+    uint32_t lapNumber;  // 本会话内的圈序号（START记录为版本号）
+    uint32_t value;      // LAP：圈速（微秒）；START/STOP：墙钟时间（秒，未同步时为0）
+    uint32_t sequence;   // 文件内记录序号，用于检查漏写
+    uint32_t crc;
+} journal_record_t;
+
+static_assert(sizeof(journal_record_t) == 20, "journal record must be 20 bytes");
+
+/**
+ * 日志存储后端。append()返回时数据必须已落盘，
+ * 这样一条记录要么完整存在，要么在恢复时被当作残缺尾部截掉。
+ */
+class JournalStorage {
+   public:
+    virtual ~JournalStorage() {}
+    virtual bool open() = 0;
+    virtual uint32_t size() = 0;
+    virtual bool read(uint32_t offset, uint8_t *buf, uint32_t len) = 0;
+    // 一轮顺序read()结束，后端可以释放读句柄
+    virtual void endRead() {}
+    virtual bool append(const uint8_t *buf, uint32_t len) = 0;
+    // 只保留前length字节
+    virtual bool truncate(uint32_t length) = 0;
+    // 清空日志（轮换），旧内容是否保留由后端决定
+    virtual bool reset() = 0;
+};
+
+typedef struct {
+    uint16_t session;
+    uint32_t laps;       // 已记录的圈数
+    uint32_t startTime;  // 墙钟时间（秒）
+    bool open;           // 最后一条会话记录不是STOP/RECOVERED
+} journal_session_t;
+
+/**
+ * 只追加的圈速日志。写入在非计时任务中调用，每条事件一次定长写入，
+ * 不做读改写，因此单次写入的闪存耗时有上限。
+ * begin()扫描整个文件：截掉第一条损坏记录及其之后的内容，
+ * 若最后一个会话没有结束记录，补写一条RECOVERED。
+ */
+class Journal {
+   public:
+    bool begin(JournalStorage *storage);
+    bool sessionStart(uint32_t wallTime);
+    bool appendLap(uint32_t lapNumber, uint32_t lapTimeUs);
+    bool sessionStop(uint32_t wallTime);
+
+    // 启动恢复的结果
+    bool wasRecovered() { return recovered; }
+    uint32_t getTruncatedBytes() { return truncatedBytes; }
+    journal_session_t *getLastSession() { return &lastSession; }
+    // begin()时日志里最后一个会话（open为true即掉电时未结束、已补写RECOVERED）及其前JOURNAL_BOOT_MAX_LAPS圈，
+    // 之后不再改变，可在其他任务读取
+    const journal_session_t *getBootSession() { return &bootSession; }
+    uint32_t getBootLapCount() { return bootLapCount; }
+    uint32_t getBootLapTimeUs(uint32_t index) { return index < bootLapCount ? bootLapTimesUs[index] : 0; }
+    uint32_t getRecordCount() { return sequence; }
+    uint32_t getWriteErrors() { return writeErrors; }
+    uint32_t getMaxWriteUs() { return maxWriteUs; }
+
+    // 记录编解码，公开以便主机工具直接解析日志文件
+    static void encode(journal_record_t *record);
+    static bool isValid(const journal_record_t *record);
+
+    // 写入耗时统计用的时钟，默认为空（不统计）
+    void setClock(uint32_t (*clock)(void)) { clockUs = clock; }
+
+   private:
+    bool append(journal_record_e type, uint32_t lapNumber, uint32_t value);
+    void applyRecord(const journal_record_t *record);
+
+    JournalStorage *store = nullptr;
+    uint32_t (*clockUs)(void) = nullptr;
+    uint32_t sequence = 0;
+    uint32_t truncatedBytes = 0;
+    uint32_t writeErrors = 0;
+    uint32_t maxWriteUs = 0;
+    bool recovered = false;
+    journal_session_t lastSession = {0, 0, 0, false};
+    journal_session_t bootSession = {0, 0, 0, false};
+    uint32_t bootLapTimesUs[JOURNAL_BOOT_MAX_LAPS];
+    uint32_t bootLapCount = 0;
+};
+
+/**
+ * LittleFS后端：文件保持以追加方式打开，每次append后flush()，
+ * LittleFS在sync时原子提交，掉电最多丢失正在写的那一条。
+ * 启动扫描期间另开一个只读句柄顺序读取，endRead()时关闭；
+ * truncate通过拷贝到临时文件再rename实现，只在启动恢复时用到；
+ * reset把当前文件改名为.old保留上一份。
+ */
+class LittleFsJournalStorage : public JournalStorage {
+   public:
+    LittleFsJournalStorage(const char *path);
+    bool open() override;
+    uint32_t size() override;
+    bool read(uint32_t offset, uint8_t *buf, uint32_t len) override;
+    void endRead() override;
+    bool append(const uint8_t *buf, uint32_t len) override;
+    bool truncate(uint32_t length) override;
+    bool reset() override;
+
+   private:
+    const char *filePath;
+    uint32_t fileSize = 0;
+    bool reopen();
+};
@@ -0,0 +1,113 @@
+#if defined(ARDUINO)
+
+#include <LittleFS.h>
+
+#include "debug.h"
+#include "journal.h"
+
+#define JOURNAL_COPY_CHUNK 256
+
+// 设备上只有一份日志，文件句柄放在这里，头文件不必引入FS
+static File journalFile;
+static File journalReadFile;
+
+LittleFsJournalStorage::LittleFsJournalStorage(const char *path) : filePath(path) {
+}
+
+bool LittleFsJournalStorage::reopen() {
+    if (journalFile) journalFile.close();
+    journalFile = LittleFS.open(filePath, FILE_APPEND);
+    if (!journalFile) {
+        DEBUG("Journal: cannot open %s\n", filePath);
+        return false;
+    }
+    fileSize = journalFile.size();
+    return true;
+}
+
+bool LittleFsJournalStorage::open() {
+    // Webserver稍后也会调用begin()，已挂载时这里直接返回true
+    if (!LittleFS.begin()) {
+        DEBUG("Journal: LittleFS mount failed\n");
+        return false;
+    }
+    return reopen();
+}
+
+uint32_t LittleFsJournalStorage::size() {
+    return fileSize;
+}
+
+// 启动扫描逐条读取，读句柄保持打开到endRead()，不再每条记录打开一次文件
+bool LittleFsJournalStorage::read(uint32_t offset, uint8_t *buf, uint32_t len) {
+    if (!journalReadFile) {
+        journalReadFile = LittleFS.open(filePath, FILE_READ);
+        if (!journalReadFile) return false;
+    }
+    if (journalReadFile.position() != offset && !journalReadFile.seek(offset)) return false;
+    return journalReadFile.read(buf, len) == len;
+}
+
+void LittleFsJournalStorage::endRead() {
+    if (journalReadFile) journalReadFile.close();
+}
+
+bool LittleFsJournalStorage::append(const uint8_t *buf, uint32_t len) {
+    if (!journalFile) return false;
+    if (journalFile.write(buf, len) != len) return false;
+    journalFile.flush();
+    fileSize += len;
+    return true;
+}
+
+bool LittleFsJournalStorage::truncate(uint32_t length) {
+    char tmpPath[48];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", filePath);
+
+    endRead();
+    journalFile.close();
+    File src = LittleFS.open(filePath, FILE_READ);
+    File dst = LittleFS.open(tmpPath, FILE_WRITE);
+    if (!src || !dst) {
+        src.close();
+        dst.close();
+        reopen();
+        return false;
+    }
+    uint8_t buf[JOURNAL_COPY_CHUNK];
+    uint32_t remaining = length;
+    while (remaining > 0) {
+        size_t n = src.read(buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+        if (n == 0 || dst.write(buf, n) != n) break;
+        remaining -= n;
+    }
+    src.close();
+    dst.close();
+    if (remaining > 0) {
+        LittleFS.remove(tmpPath);
+        reopen();
+        return false;
+    }
+    // LittleFS的rename直接覆盖目标且是原子的，掉电只会看到旧文件或新文件
+    if (!LittleFS.rename(tmpPath, filePath)) {
+        LittleFS.remove(tmpPath);
+        reopen();
+        return false;
+    }
+    DEBUG("Journal: truncated to %u bytes\n", length);
+    return reopen();
+}
+
+bool LittleFsJournalStorage::reset() {
+    char oldPath[48];
+    snprintf(oldPath, sizeof(oldPath), "%s.old", filePath);
+
+    endRead();
+    journalFile.close();
+    LittleFS.remove(oldPath);
+    LittleFS.rename(filePath, oldPath);
+    DEBUG("Journal: rotated to %s\n", oldPath);
+    return reopen();
+}
+
+#endif
@@ -8,6 +8,8 @@ KalmanFilter::KalmanFilter() {
     A = 1;
     B = 0;
     C = 1;
+    cov = NAN;
+    x = NAN;
 }
 
 float KalmanFilter::filter(uint16_t z, uint16_t u = 0) {
@@ -41,3 +43,58 @@ void KalmanFilter::setMeasurementNoise(float noise) {
 void KalmanFilter::setProcessNoise(float noise) {
     R = noise;
 }
+
+#define Q16_ONE 65536
+
+KalmanFilterQ16::KalmanFilterQ16() {
+    R = Q16_ONE;
+    Q = Q16_ONE;
+    reset();
+}
+
+void KalmanFilterQ16::reset() {
+    initialized = false;
+    converged = false;
+    cov = 0;
+    K = 0;
+    x = 0;
+}
+
+int32_t KalmanFilterQ16::filterQ16(uint16_t z) {
+    const int32_t zq = (int32_t)z << 16;
+    if (!initialized) {
+        initialized = true;
+        x = zq;
+        cov = Q;
+        return x;
+    }
+
+    if (!converged) {
+        // predCov = cov + R, K = predCov / (predCov + Q), cov = predCov - K * predCov
+        const int32_t predCov = cov + R;
+        K = (int32_t)((((int64_t)predCov << 30) + ((predCov + Q) >> 1)) / (predCov + Q));
+        const int32_t newCov = predCov - (int32_t)(((int64_t)K * predCov + (1 << 29)) >> 30);
+        converged = (newCov == cov);
+        cov = newCov;
+    }
+
+    // correction, 四舍五入避免截断误差在低增益时累积成偏差
+    x += (int32_t)(((int64_t)K * (zq - x) + (1 << 29)) >> 30);
+    return x;
+}
+
+float KalmanFilterQ16::filter(uint16_t z, uint16_t u) {
+    (void)u;  // 与KalmanFilter::filter保持同一签名，定点版无控制输入
+    return filterQ16(z) / (float)Q16_ONE;
+}
+
+void KalmanFilterQ16::setMeasurementNoise(float noise) {
+    Q = (int32_t)(noise * Q16_ONE + 0.5f);
+    if (Q < 1) Q = 1;
+    reset();
+}
+
+void KalmanFilterQ16::setProcessNoise(float noise) {
+    R = (int32_t)(noise * Q16_ONE + 0.5f);
+    reset();
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdint.h>
 
 class KalmanFilter {
@@ -17,3 +19,42 @@ class KalmanFilter {
     float cov;  // NaN
     float x;    // NaN -- estimated signal without noise
 };
+
+/**
+ * 定点版卡尔曼滤波器，用于没有硬件FPU的芯片（ESP32-C3）。
+ * 状态和协方差均为Q16.16，增益为Q2.30，乘法用32x32->64位，只在协方差收敛前做整数除法；
+ * A=C=1且噪声参数固定时增益只与样本序号有关，协方差完全不再变化后增益即被冻结。
+ *
+ * 与KalmanFilter的误差上界（输入为12.4定点RSSI，即rssi*16）：
+ *   |filterQ16()/65536 - KalmanFilter::filter()| <= 1 输入单位（= 1/16 RSSI），
+ *   换算回8位RSSI后两者最多相差1，且只发生在四舍五入边界上。
+ * 误差主要来自过程噪声量化到Q16（0.004 -> 262/65536，稳态增益偏差约0.03%，
+ * 满量程阶跃时表现为不到1输入单位的滞后差）以及每步的舍入。过程噪声更小时量化误差按比例变大，
+ * 上界只对不小于0.004的过程噪声成立。
+ * tools/bench/kalman_bench.cpp 会在合成及录制的数据上核对该上界，test/test_kalman 在合成数据上断言该上界。
+ */
+class KalmanFilterQ16 {
+   public:
+    KalmanFilterQ16();
+    int32_t filterQ16(uint16_t z);
+    float filter(uint16_t z, uint16_t u);
+    void setMeasurementNoise(float noise);
+    void setProcessNoise(float noise);
+    void reset();
+
+   private:
+    int32_t R;    // Q16.16 process noise
+    int32_t Q;    // Q16.16 measurement noise
+    int32_t cov;  // Q16.16
+    int32_t K;    // Q2.30 Kalman gain
+    int32_t x;    // Q16.16 estimated signal without noise
+    bool initialized = false;
+    bool converged = false;
+};
+
+// 按板子在编译期选择滤波器实现，见platformio.ini中的KALMAN_FIXED_POINT
+#ifdef KALMAN_FIXED_POINT
+typedef KalmanFilterQ16 RssiKalmanFilter;
+#else
+typedef KalmanFilter RssiKalmanFilter;
+#endif
@@ -0,0 +1,167 @@
+#include "lapstore.h"
+
+#include <stdlib.h>
+
+static inline uint32_t zigzagEncode(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+void LapStore::freeChain(lap_chunk_t *chunk) {
+    while (chunk != nullptr) {
+        lap_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+LapStore::~LapStore() {
+    clear();
+    freeChain(freeList);
+    freeChain(spares.exchange(nullptr, std::memory_order_acquire));
+}
+
+// 写者调用，只从已分配的块中取，不malloc
+lap_chunk_t *LapStore::takeChunk() {
+    if (freeList == nullptr) {
+        freeList = spares.exchange(nullptr, std::memory_order_acquire);
+        if (freeList == nullptr) return nullptr;
+    }
+    lap_chunk_t *chunk = freeList;
+    freeList = chunk->next;
+    freeChunks.fetch_sub(1, std::memory_order_relaxed);
+    chunk->next = nullptr;
+    return chunk;
+}
+
+void LapStore::reserve(uint16_t chunks) {
+    while (chunksAllocated.load(std::memory_order_relaxed) < chunks &&
+           chunksAllocated.load(std::memory_order_relaxed) < LAPSTORE_MAX_CHUNKS) {
+        lap_chunk_t *chunk = (lap_chunk_t *)malloc(sizeof(lap_chunk_t));
+        if (chunk == nullptr) return;
+        chunksAllocated.fetch_add(1, std::memory_order_relaxed);
+        chunk->next = freeList;
+        freeList = chunk;
+        freeChunks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint16_t LapStore::refill(uint16_t minFree) {
+    uint16_t added = 0;
+    while (freeChunks.load(std::memory_order_relaxed) < minFree &&
+           chunksAllocated.load(std::memory_order_relaxed) < LAPSTORE_MAX_CHUNKS) {
+        lap_chunk_t *chunk = (lap_chunk_t *)malloc(sizeof(lap_chunk_t));
+        if (chunk == nullptr) break;
+        chunksAllocated.fetch_add(1, std::memory_order_relaxed);
+        chunk->next = spares.load(std::memory_order_relaxed);
+        while (!spares.compare_exchange_weak(chunk->next, chunk, std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+        }
+        freeChunks.fetch_add(1, std::memory_order_relaxed);
+        added++;
+    }
+    return added;
+}
+
+bool LapStore::append(uint32_t lapTimeUs) {
+    // 先编码到临时缓冲，确认有空间后再写入，失败时存储保持不变
+    uint32_t v = (count.load(std::memory_order_relaxed) == 0) ? lapTimeUs : zigzagEncode((int32_t)(lapTimeUs - last));
+    uint8_t buf[5];
+    uint8_t len = 0;
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        buf[len++] = v ? (b | 0x80) : b;
+    } while (v);
+
+    const uint32_t n = count.load(std::memory_order_relaxed);
+    if (tail == nullptr || tailUsed + len > LAPSTORE_CHUNK_BYTES) {
+        // 一个值最多5字节，不足时只需再要一块；剩余的零头字节也照常使用
+        lap_chunk_t *chunk = takeChunk();
+        if (chunk == nullptr) {
+            drops++;
+            return false;
+        }
+        if (tail == nullptr) {
+            head = tail = chunk;
+            tailUsed = 0;
+        } else {
+            tail->next = chunk;
+        }
+    }
+
+    for (uint8_t i = 0; i < len; i++) {
+        if (tailUsed == LAPSTORE_CHUNK_BYTES) {
+            tail = tail->next;
+            tailUsed = 0;
+        }
+        tail->data[tailUsed++] = buf[i];
+    }
+    last = lapTimeUs;
+    // 数据和块链接写完后再发布长度，读者只会读到已写好的字节
+    encodedBytes.store(encodedBytes.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    count.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+void LapStore::clear() {
+    // 先让正在遍历的读者作废，再把块还回空闲链表复用
+    generation.fetch_add(1, std::memory_order_acq_rel);
+    encodedBytes.store(0, std::memory_order_release);
+    count.store(0, std::memory_order_release);
+    // 整条链挂回空闲链表，内存不还给堆
+    if (head != nullptr) {
+        uint16_t chunks = 1;
+        lap_chunk_t *end = head;
+        while (end->next != nullptr) {
+            end = end->next;
+            chunks++;
+        }
+        end->next = freeList;
+        freeList = head;
+        freeChunks.fetch_add(chunks, std::memory_order_relaxed);
+    }
+    head = tail = nullptr;
+    tailUsed = 0;
+    last = 0;
+    drops = 0;
+}
+
+LapStore::Iterator LapStore::iterate() const {
+    Iterator it;
+    // 先取长度（acquire），之后读到的head和块内容都不早于这次发布
+    it.remaining = encodedBytes.load(std::memory_order_acquire);
+    it.chunk = it.remaining ? head : nullptr;
+    return it;
+}
+
+bool LapStore::Iterator::readByte(uint8_t *byte) {
+    if (remaining == 0 || chunk == nullptr) return false;
+    if (offset == LAPSTORE_CHUNK_BYTES) {
+        chunk = chunk->next;
+        offset = 0;
+        if (chunk == nullptr) return false;
+    }
+    *byte = chunk->data[offset++];
+    remaining--;
+    return true;
+}
+
+bool LapStore::Iterator::next(uint32_t *lapTimeUs) {
+    uint32_t v = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+        if (shift > 28 || !readByte(&b)) return false;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    previous = (index == 0) ? v : previous + (uint32_t)zigzagDecode(v);
+    index++;
+    *lapTimeUs = previous;
+    return true;
+}
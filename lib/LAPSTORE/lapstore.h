@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define LAPSTORE_CHUNK_BYTES 60      // 每块数据区字节数，加上next指针共64字节
+#define LAPSTORE_PREALLOC_CHUNKS 16  // 初始化时预分配的块数（约250圈）
+#define LAPSTORE_MAX_CHUNKS 512      // 最多32KB，防止异常情况下耗尽堆
+#define LAPSTORE_REFILL_CHUNKS 4     // refill()把空闲块补到这个数（约60圈的余量）
+
+typedef struct lap_chunk {
+    struct lap_chunk *next;
+    uint8_t data[LAPSTORE_CHUNK_BYTES];
+} lap_chunk_t;
+
+/**
+ * 单次会话的圈速存储，不限圈数。
+ * 第一圈存原值，之后存与上一圈之差（zigzag + varint），圈速相近时每圈只占2-3字节。
+ * 数据写在固定大小的块链上，追加O(1)；clear()后块留在空闲链表里复用。
+ *
+ * 只允许一个任务（写者）调用append()/clear()，append()从不malloc：
+ * 空闲块不够时由其他任务调用refill()分配，经无锁的备用链表交给写者。
+ * 其他任务读取时不加锁：编码字节数在数据写完后以release发布，Iterator只读到iterate()时的长度；
+ * clear()会复用块，读者遍历前取getGeneration()，遍历后isGeneration()为false则结果作废。
+ */
+class LapStore {
+   public:
+    class Iterator {
+       public:
+        // 取出下一圈，没有更多时返回false
+        bool next(uint32_t *lapTimeUs);
+        uint32_t getIndex() { return index; }
+
+       private:
+        friend class LapStore;
+        const lap_chunk_t *chunk = nullptr;
+        uint8_t offset = 0;
+        uint32_t remaining = 0;  // 剩余编码字节数
+        uint32_t previous = 0;
+        uint32_t index = 0;
+        bool readByte(uint8_t *byte);
+    };
+
+    ~LapStore();
+    // 预先分配块，只在写者开始使用之前调用
+    void reserve(uint16_t chunks);
+    // 非写者任务调用：空闲块少于minFree时补足，返回新分配的块数
+    uint16_t refill(uint16_t minFree = LAPSTORE_REFILL_CHUNKS);
+    bool append(uint32_t lapTimeUs);
+    void clear();
+
+    uint32_t getCount() const { return count.load(std::memory_order_acquire); }
+    uint32_t getLast() const { return last; }
+    uint32_t getEncodedBytes() const { return encodedBytes.load(std::memory_order_acquire); }
+    uint16_t getChunkCount() const { return chunksAllocated.load(std::memory_order_relaxed); }
+    uint32_t getDrops() const { return drops; }
+    uint32_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+    // 遍历结束后调用：期间没有clear()则读到的数据有效
+    bool isGeneration(uint32_t g) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return generation.load(std::memory_order_relaxed) == g;
+    }
+    Iterator iterate() const;
+
+   private:
+    // 以下只由写者访问
+    lap_chunk_t *head = nullptr;
+    lap_chunk_t *tail = nullptr;
+    lap_chunk_t *freeList = nullptr;
+    uint8_t tailUsed = 0;
+    volatile uint32_t last = 0;
+    volatile uint32_t drops = 0;  // 空闲块用完而未能记录的圈数
+
+    // refill()压入、写者整条取走，没有ABA问题
+    std::atomic<lap_chunk_t *> spares{nullptr};
+    std::atomic<uint16_t> freeChunks{0};  // freeList和spares中的块数
+    std::atomic<uint16_t> chunksAllocated{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> encodedBytes{0};
+    std::atomic<uint32_t> generation{0};
+
+    lap_chunk_t *takeChunk();
+    static void freeChain(lap_chunk_t *chunk);
+};
@@ -1,19 +1,34 @@
 #include "laptimer.h"
 
+#include <math.h>
+#include <string.h>
+
 #include "debug.h"
 
-const uint16_t rssi_filter_q = 2000; //  0.01 - 655.36
-const uint16_t rssi_filter_r = 40;   // 0.0001 - 65.536
+const uint16_t rssi_filter_q = LAPTIMER_FILTER_Q; //  0.01 - 655.36
+const uint16_t rssi_filter_r = LAPTIMER_FILTER_R; // 0.0001 - 65.536
 
-void LapTimer::init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l)
+void LapTimer::init(Config *config, RX5808 *rx5808, RssiSource *rssiSource, Buzzer *buzzer, Led *l)
 {
     conf = config;
     rx = rx5808;
+    source = rssiSource;
     buz = buzzer;
     led = l;
 
+    decimator.init(RSSI_DECIMATOR_MODE, RSSI_READS, RSSI_DECIMATION, RSSI_CIC_ORDER);
+    laps.reserve(LAPSTORE_PREALLOC_CHUNKS);
     filter.setMeasurementNoise(rssi_filter_q * 0.01f);
     filter.setProcessNoise(rssi_filter_r * 0.0001f);
+    // 稳态卡尔曼增益K：预测协方差p满足p^2 - R*p - R*Q = 0，K = p / (p + Q)，
+    // 此时滤波器是系数为K的一阶低通，群延迟(1-K)/K个样本
+    const float q = rssi_filter_q * 0.01f;
+    const float r = rssi_filter_r * 0.0001f;
+    const float p = (r + sqrtf(r * r + 4 * r * q)) / 2;
+    const float k = p / (p + q);
+    filterLagSamples = (1 - k) / k * LAPTIMER_LAG_COMP_PCT / 100;
+    noiseFloor.init();
+    updateThresholds();
 
     stop();
     memset(rssi, 0, sizeof(rssi));
@@ -24,65 +39,227 @@ void LapTimer::init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l)
 void LapTimer::start()
 {
     DEBUG("LapTimer started\n");
-    rssiPeakTimeMs = millis();
     state = RUNNING;
+    detector = (laptimer_detector_e)conf->getDetector();
     lapAvailable = false;
-    lapCount = 0;
     rssiCount = 0;
-    memset(lapTimes, 0, sizeof(lapTimes));
-    startTimeMs = 0;
+    laps.clear();
+    lastLapTimeUs = 0;
+    // 第0圈从start时刻起算，与START事件的时间戳一致
+    startTimeUs = halMicros();
     lapPeakReset();
     buz->beep(500);
     led->on(500);
+
+    laptimer_event_t event = {};
+    event.type = LAPTIMER_EVENT_START;
+    event.timeUs = startTimeUs;
+    eventQueue.push(event);
 }
 
 void LapTimer::stop()
 {
     DEBUG("LapTimer stopped\n");
+    const bool wasRunning = (state != STOPPED);
     state = STOPPED;
     lapAvailable = false;
-    startTimeMs = 0;
+    startTimeUs = 0;
     lapPeakReset();
     buz->beep(500);
     led->on(500);
-    
-    // 先触发stop事件回调，再清空数据
-    if (stopEventHandler != nullptr) {
-        stopEventHandler();
+
+    // stop事件交给网络任务处理，圈速数据保留到下一次start()再清空，
+    // 以便stop回调在另一个核上读取本次的成绩
+    if (wasRunning) {
+        laptimer_event_t event = {};
+        event.type = LAPTIMER_EVENT_STOP;
+        event.lapNumber = laps.getCount();
+        event.timeUs = halMicros();
+        eventQueue.push(event);
     }
-    
-    // 清空圈速数据
-    lapCount = 0;
-    rssiCount = 0;
-    memset(lapTimes, 0, sizeof(lapTimes));
+}
+
+bool LapTimer::postCommand(laptimer_cmd_e cmd)
+{
+    return commandQueue.push(cmd);
+}
+
+bool LapTimer::postIoCommand(laptimer_cmd_e cmd)
+{
+    return ioCommandQueue.push(cmd);
+}
+
+// 在计时核上执行排队的命令，共享状态只在本核修改
+void LapTimer::handleCommands()
+{
+    laptimer_cmd_e cmd;
+    while (commandQueue.pop(&cmd) || ioCommandQueue.pop(&cmd))
+    {
+        switch (cmd)
+        {
+        case LAPTIMER_CMD_START:
+            start();
+            break;
+        case LAPTIMER_CMD_STOP:
+            stop();
+            break;
+        case LAPTIMER_CMD_CALIB_NOISE_START:
+            startCalibrationNoise();
+            break;
+        case LAPTIMER_CMD_CALIB_NOISE_STOP:
+            stopCalibrationNoise();
+            break;
+        case LAPTIMER_CMD_CALIB_CROSSING_START:
+            startCalibrationCrossing();
+            break;
+        case LAPTIMER_CMD_CALIB_CROSSING_STOP:
+            stopCalibrationCrossing();
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// 在网络/IO任务中调用，取出计时核产生的事件并执行回调
+void LapTimer::dispatchEvents()
+{
+    laptimer_event_t event;
+    while (eventQueue.pop(&event))
+    {
+        switch (event.type)
+        {
+        case LAPTIMER_EVENT_LAP:
+            if (lapEventHandler != nullptr)
+            {
+                lapEventHandler(event.lapTimeUs);
+            }
+            break;
+        case LAPTIMER_EVENT_STOP:
+            if (stopEventHandler != nullptr)
+            {
+                stopEventHandler();
+            }
+            break;
+        default:
+            break;
+        }
+        for (uint8_t i = 0; i < eventSinkCount; i++)
+        {
+            eventSinks[i](&event, eventSinkCtx[i]);
+        }
+    }
+}
+
+void LapTimer::setTraceRecorder(TraceRecorder *recorder)
+{
+    trace = recorder;
+}
+
+void LapTimer::setRssiStream(RssiStream *rssiStream)
+{
+    stream = rssiStream;
+}
+
+// 只应在启动阶段、dispatchEvents()运行之前调用
+bool LapTimer::addEventSink(laptimer_event_sink_fn sink, void *ctx)
+{
+    if (eventSinkCount >= LAPTIMER_MAX_EVENT_SINKS)
+    {
+        return false;
+    }
+    eventSinks[eventSinkCount] = sink;
+    eventSinkCtx[eventSinkCount] = ctx;
+    eventSinkCount++;
+    return true;
+}
+
+SpscQueue<laptimer_cmd_e, LAPTIMER_CMD_QUEUE_SIZE> *LapTimer::getCommandQueue()
+{
+    return &commandQueue;
+}
+
+SpscQueue<laptimer_event_t, LAPTIMER_EVENT_QUEUE_SIZE> *LapTimer::getEventQueue()
+{
+    return &eventQueue;
 }
 
 /**
  * @brief 处理计时系统的核心更新逻辑
- * @param currentTimeMs 当前系统时间（毫秒）
  *
- * 该函数是计时系统的主循环处理函数，负责：
- * 1. 持续读取和滤波RSSI信号
+ * 从采样源取出已就绪的一块RSSI原始样本，经过采样抽取后逐个交给processSample()处理。
+ * 每个样本带有采样时刻，计时精度不再取决于loop()的循环速度。
+ */
+void LapTimer::handleLapTimerUpdate()
+{
+    handleCommands();
+
+    if (source->readBlock(&block) == 0)
+        return;
+
+    // 调谐期间RSSI不稳定，整块按无信号处理
+    const bool stable = rx->isRssiStable();
+    // 抽取输出的时间戳扣除滤波器群延迟，对齐到窗口中心
+    const uint32_t delayUs = (decimator.getGroupDelayHalfSamples() * block.periodUs) / 2;
+    for (uint16_t i = 0; i < block.count; i++)
+    {
+        uint16_t rawQ4;
+        if (!decimator.push(block.raw[i], &rawQ4))
+            continue;
+        const uint64_t sampleTimeUs = block.startUs + (uint64_t)i * block.periodUs - delayUs;
+        processSample(stable ? RX5808::scaleRssiQ4(rawQ4) : 0, sampleTimeUs);
+    }
+}
+
+/**
+ * @brief 处理单个RSSI样本
+ * @param rssiQ4 RSSI值，12.4定点数（rssi * 16）
+ * @param currentTimeUs 样本采集时刻（微秒，esp_timer时间基准）
+ *
+ * 1. 对RSSI信号进行卡尔曼滤波以减少噪声
  * 2. 处理噪声校准和穿越校准逻辑
  * 3. 根据当前状态（STOPPED/WAITING/RUNNING）执行不同的计时处理
  * 4. 管理RSSI历史记录
  */
-void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs)
+void LapTimer::processSample(uint16_t rssiQ4, uint64_t currentTimeUs)
 {
-    // 始终读取RSSI值，通过卡尔曼滤波器进行滤波处理以减少噪声
-    rssi[rssiCount] = round(filter.filter(rx->readRssi(), 0));
+    // 通过卡尔曼滤波器进行滤波处理以减少噪声
+    // 测量值和过程噪声同比例缩放时卡尔曼增益不变，直接对定点值滤波即可
+#ifdef KALMAN_FIXED_POINT
+    int32_t filteredQ4 = (filter.filterQ16(rssiQ4) + (1 << 15)) >> 16;
+#else
+    int32_t filteredQ4 = round(filter.filter(rssiQ4, 0));
+#endif
+    if (filteredQ4 < 0) filteredQ4 = 0;
+    if (filteredQ4 > (255 << 4)) filteredQ4 = 255 << 4;
+    rssi[rssiCount] = (filteredQ4 + 8) >> 4;
+    // 保留4位小数和时间戳，用于峰值时刻插值
+    rssiFine[rssiCount] = filteredQ4;
+    rssiTimeUs[rssiCount] = (uint32_t)currentTimeUs;
+    if (trace != nullptr)
+    {
+        trace->push(currentTimeUs, rssiQ4, filteredQ4);
+    }
+    if (stream != nullptr)
+    {
+        stream->push(currentTimeUs, filteredQ4);
+    }
     // DEBUG("RSSI: %u\n", rssi[rssiCount]);
 
-    // 噪声校准模式：记录环境噪声的最大RSSI值
+    // 没有穿越进行中（低于进入阈值、未开窗、未捕获峰值）的样本用于估计底噪
+    if (rssi[rssiCount] < enterRssi && !crossingOpen && rssiPeak == 0)
+    {
+        noiseFloor.push(filteredQ4);
+    }
+    updateThresholds();
+
+    // 噪声校准模式：每个样本计入直方图，达到目标时长后自动停止
     if (isCalibratingNoise)
     {
-        // 增加校准样本计数（上限为65535）
-        if (calibrationNoiseSamples < 65535)
-            calibrationNoiseSamples++;
-        // 更新最大噪声RSSI值
-        if (rssi[rssiCount] > calibrationMaxNoise)
+        calibrationNoise.add(rssi[rssiCount]);
+        if (calibrationNoise.getCount() >= calibrationNoiseTarget)
         {
-            calibrationMaxNoise = rssi[rssiCount];
+            stopCalibrationNoise();
         }
     }
 
@@ -105,31 +282,60 @@ void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs)
     case STOPPED: // 停止状态：不执行任何计时相关操作
         break;
     case WAITING: // 等待状态：检测第一个穿越（开圈）
-        
+        if (detector == LAPTIMER_DETECTOR_HYSTERESIS)
+        {
+            if (crossingWindowClosed(currentTimeUs))
+            {
+                lapPeakRefine();
+                state = RUNNING;
+                startLap();
+            }
+            break;
+        }
+
         // 捕获RSSI峰值以检测穿越
-        lapPeakCapture(currentTimeMs);
+        lapPeakCapture(currentTimeUs);
         // 如果检测到有效峰值，开始计时
         if (lapPeakCaptured())
         {
+            lapPeakRefine();
             state = RUNNING;
             startLap();
         }
         // DEBUG("LapTimer WAITING\n");
         break;
     case RUNNING: // 运行状态：持续计时并检测后续穿越
-        
+        if (detector == LAPTIMER_DETECTOR_HYSTERESIS)
+        {
+            // 整个窗口都参与选峰，峰值落在最小圈时内的整次穿越丢弃
+            if (crossingWindowClosed(currentTimeUs))
+            {
+                if (minLapElapsed(rssiPeakTimeUs))
+                {
+                    lapPeakRefine();
+                    finishLap();
+                    startLap();
+                }
+                else
+                {
+                    lapPeakReset();
+                }
+            }
+            break;
+        }
 
         // 无论是否超过最小圈时，都持续捕获RSSI值
 
         // 仅当超过最小圈时后才更新峰值信息（避免过快连续触发）
-        if ((currentTimeMs - startTimeMs) > conf->getMinLapMs())
+        if (minLapElapsed(currentTimeUs))
         {
-            lapPeakCapture(currentTimeMs);
+            lapPeakCapture(currentTimeUs);
         }
 
         // 检测到有效峰值时，完成当前圈并开始新圈
         if (lapPeakCaptured())
         {
+            lapPeakRefine();
             finishLap();
             startLap();
         }
@@ -143,16 +349,17 @@ void LapTimer::handleLapTimerUpdate(uint32_t currentTimeMs)
     rssiCount = (rssiCount + 1) % LAPTIMER_RSSI_HISTORY;
 }
 
-void LapTimer::lapPeakCapture(uint32_t currentTimeMs)
+void LapTimer::lapPeakCapture(uint64_t currentTimeUs)
 {
     // 恢复严格的enterRssi阈值检查，避免误触发
-    if (rssi[rssiCount] >= conf->getEnterRssi())
+    if (rssi[rssiCount] >= enterRssi)
     {
         // Check if RSSI is greater than the previous detected peak
         if (rssi[rssiCount] > rssiPeak)
         {
             rssiPeak = rssi[rssiCount];
-            rssiPeakTimeMs = currentTimeMs;
+            rssiPeakTimeUs = currentTimeUs;
+            rssiPeakIndex = rssiCount;
         }
     }
 }
@@ -166,7 +373,7 @@ bool LapTimer::lapPeakCaptured()
     bool rssiConditions;
 
     // 全有圈严格的参数要求
-    minDelta = (gateDiameterMm == 1000) ? 10 : 6;
+    minDelta = (gateDiameterMm == 1000) ? LAPTIMER_MIN_DELTA_SMALL_GATE : LAPTIMER_MIN_DELTA_LARGE_GATE;
     // 严格检查RSSI下降和变化量
     rssiConditions = (rssi[rssiCount] < rssiPeak);
     bool deltaCondition = (rssiPeak - rssi[rssiCount]) >= minDelta;
@@ -178,16 +385,151 @@ bool LapTimer::lapPeakCaptured()
     return rssiConditions && deltaCondition;
 }
 
+/**
+ * @brief 修正峰值时刻：先在滤波后的历史上插值，再扣除卡尔曼滤波的滞后
+ *
+ * 滤波后的峰值比信号真实峰值晚，不扣除时快速穿越的圈速时刻系统性偏晚约10 ms。
+ */
+void LapTimer::lapPeakRefine()
+{
+    lapPeakInterpolate();
+    const uint32_t samplePeriodUs = block.periodUs * decimator.getRatio();
+    rssiPeakTimeUs -= (uint64_t)(filterLagSamples * samplePeriodUs + 0.5f);
+}
+
+/**
+ * @brief 用峰值附近的样本细化峰值时刻
+ *
+ * 8位RSSI在峰顶常出现平台，先在平台内按4位小数的滤波值找到真正的最大样本，
+ * 再对它和左右相邻样本做抛物线插值，把峰值时刻细化到采样间隔以内。
+ * 峰值样本已被历史缓冲区覆盖或峰顶不呈凸形时保留原始峰值时刻。
+ */
+void LapTimer::lapPeakInterpolate()
+{
+    const uint8_t N = LAPTIMER_RSSI_HISTORY;
+    // 穿越窗口比历史缓冲区长时，峰值样本可能已被覆盖
+    if (rssiTimeUs[rssiPeakIndex] != (uint32_t)rssiPeakTimeUs)
+        return;
+    // 峰值样本距当前样本的距离，至少保留左侧一个样本
+    uint8_t age = (rssiCount + N - rssiPeakIndex) % N;
+    if (age == 0 || age >= N - 1)
+        return;
+
+    // 在平台内找小数部分最大的样本
+    uint8_t best = rssiPeakIndex;
+    for (uint8_t i = 1; i <= age; i++)
+    {
+        uint8_t idx = (rssiPeakIndex + i) % N;
+        if (rssi[idx] != rssiPeak)
+            break;
+        if (rssiFine[idx] > rssiFine[best])
+            best = idx;
+    }
+    uint8_t left = (best + N - 1) % N;
+    uint8_t right = (best + 1) % N;
+    if (best == rssiCount || (rssiCount + N - left) % N >= N - 1)
+        return;
+
+    const float yl = rssiFine[left];
+    const float y0 = rssiFine[best];
+    const float yr = rssiFine[right];
+    const float denom = yl - 2 * y0 + yr;
+    const int32_t stepUs = (int32_t)(rssiTimeUs[right] - rssiTimeUs[left]) / 2;
+    const int32_t bestOffsetUs = (int32_t)(rssiTimeUs[best] - rssiTimeUs[rssiPeakIndex]);
+    float delta = 0;
+    if (denom < 0)
+    {
+        delta = 0.5f * (yl - yr) / denom;
+        if (delta > 0.5f) delta = 0.5f;
+        if (delta < -0.5f) delta = -0.5f;
+    }
+    rssiPeakTimeUs += bestOffsetUs + (int32_t)lroundf(delta * stepUs);
+}
+
+/**
+ * @brief 滞回穿越检测，每个样本调用一次
+ * @return 穿越窗口在本样本关闭时返回true，峰值保存在rssiPeak*中
+ *
+ * RSSI达到enterRssi时开窗，降到exitRssi以下时关窗，窗内按滤波后的小数值选最大的样本作为峰值。
+ * 窗内的多径凹陷只要不低于exitRssi就不会提前判定，慢速穿越也只在关窗时判定一次。
+ * exitRssi不低于enterRssi时按enterRssi处理（无滞回）。
+ */
+bool LapTimer::crossingWindowClosed(uint64_t currentTimeUs)
+{
+    const uint8_t enter = enterRssi;
+    const uint8_t exit = exitRssi < enter ? exitRssi : enter;
+    const uint8_t r = rssi[rssiCount];
+
+    if (!crossingOpen)
+    {
+        if (r < enter)
+            return false;
+        lapPeakReset();
+        crossingOpen = true;
+    }
+    if (rssiFine[rssiCount] > rssiPeakFine)
+    {
+        rssiPeakFine = rssiFine[rssiCount];
+        rssiPeak = r;
+        rssiPeakTimeUs = currentTimeUs;
+        rssiPeakIndex = rssiCount;
+    }
+    if (r < exit)
+    {
+        crossingOpen = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 计算生效的进入/退出阈值
+ *
+ * 关闭底噪跟随或底噪尚未估计出来时直接使用配置值；开启时为底噪 + 偏移，
+ * 并限制在[配置值, 配置值 + trackMax]内：底噪再低也不会比手动校准的阈值更灵敏，
+ * 底噪异常升高（例如有人在门边开机）时最多抬高trackMax。
+ */
+void LapTimer::updateThresholds()
+{
+    uint16_t enter = conf->getEnterRssi();
+    uint16_t exit = conf->getExitRssi();
+    if (conf->getFloorTrack() && noiseFloor.isValid())
+    {
+        const uint16_t floor = noiseFloor.getFloor();
+        const uint16_t enterMax = enter + conf->getTrackMax();
+        const uint16_t exitMax = exit + conf->getTrackMax();
+        const uint16_t trackedEnter = floor + conf->getEnterOffset();
+        const uint16_t trackedExit = floor + conf->getExitOffset();
+        if (trackedEnter > enter)
+            enter = trackedEnter < enterMax ? trackedEnter : enterMax;
+        if (trackedExit > exit)
+            exit = trackedExit < exitMax ? trackedExit : exitMax;
+    }
+    enterRssi = enter > 255 ? 255 : enter;
+    exitRssi = exit > 255 ? 255 : exit;
+}
+
 void LapTimer::lapPeakReset()
 {
     rssiPeak = 0;
-    rssiPeakTimeMs = 0;
+    rssiPeakTimeUs = 0;
+    rssiPeakIndex = 0;
+    rssiPeakFine = 0;
+    crossingOpen = false;
+}
+
+// 第0圈（开圈）不受最小圈时限制：起飞后可能很快就穿过计时门
+bool LapTimer::minLapElapsed(uint64_t timeUs)
+{
+    if (laps.getCount() == 0)
+        return true;
+    return timeUs > startTimeUs && (timeUs - startTimeUs) > (uint64_t)conf->getMinLapMs() * 1000;
 }
 
 void LapTimer::startLap()
 {
     DEBUG("Lap started\n");
-    startTimeMs = rssiPeakTimeMs;
+    startTimeUs = rssiPeakTimeUs;
     lapPeakReset();
     buz->beep(200);
     led->on(200);
@@ -195,16 +537,23 @@ void LapTimer::startLap()
 
 void LapTimer::finishLap()
 {
-    lapTimes[lapCount] = rssiPeakTimeMs - startTimeMs;
-    DEBUG("Lap finished, lap time = %u\n", lapTimes[lapCount]);
-    lapCount = (lapCount + 1) % LAPTIMER_LAP_HISTORY;
+    // 采样块带回的样本可能略早于start()时刻，开圈时间钳到0而不是回绕
+    const uint32_t lapTimeUs = rssiPeakTimeUs > startTimeUs ? (uint32_t)(rssiPeakTimeUs - startTimeUs) : 0;
+    DEBUG("Lap finished, lap time = %u us\n", lapTimeUs);
+    laptimer_event_t event = {};
+    event.type = LAPTIMER_EVENT_LAP;
+    event.lapNumber = laps.getCount();
+    event.lapTimeUs = lapTimeUs;
+    event.timeUs = rssiPeakTimeUs;
+    event.peakRssi = rssiPeak;
+    // 只用已分配的块，不在计时核上malloc；空闲块由parallelTask经refillLaps()补充，
+    // 跟不上时只丢存储，事件照常发出
+    laps.append(lapTimeUs);
+    lastLapTimeUs = lapTimeUs;
     lapAvailable = true;
 
-    // 立即触发lap事件回调，不再等待定期检查
-    if (lapEventHandler != nullptr)
-    {
-        lapEventHandler(lapTimes[lapCount > 0 ? lapCount - 1 : LAPTIMER_LAP_HISTORY - 1]);
-    }
+    // 事件放入队列后立即返回，网络发送不会阻塞计时核
+    eventQueue.push(event);
 }
 
 uint8_t LapTimer::getRssi()
@@ -212,19 +561,40 @@ uint8_t LapTimer::getRssi()
     return rssi[rssiCount];
 }
 
+uint8_t LapTimer::getNoiseFloor()
+{
+    return noiseFloor.getFloor();
+}
+
+bool LapTimer::isNoiseFloorValid()
+{
+    return noiseFloor.isValid();
+}
+
+uint32_t LapTimer::getNoiseFloorUpdates()
+{
+    return noiseFloor.getUpdates();
+}
+
+uint8_t LapTimer::getEnterRssi()
+{
+    return enterRssi;
+}
+
+uint8_t LapTimer::getExitRssi()
+{
+    return exitRssi;
+}
+
 uint32_t LapTimer::getLapTime()
 {
-    uint32_t lapTime = 0;
+    return (getLapTimeUs() + 500) / 1000;
+}
+
+uint32_t LapTimer::getLapTimeUs()
+{
     lapAvailable = false;
-    if (lapCount == 0)
-    {
-        lapTime = lapTimes[LAPTIMER_LAP_HISTORY - 1];
-    }
-    else
-    {
-        lapTime = lapTimes[lapCount - 1];
-    }
-    return lapTime;
+    return lastLapTimeUs;
 }
 
 bool LapTimer::isLapAvailable()
@@ -234,17 +604,24 @@ bool LapTimer::isLapAvailable()
 
 void LapTimer::startCalibrationNoise()
 {
+    calibrationNoise.reset();
+    // 按采样源实际的检测器采样率换算，不假定SAMPLER_RATE_HZ
+    uint32_t rateHz = source->getSampleRateHz() / decimator.getRatio();
+    if (rateHz == 0) rateHz = SAMPLER_RATE_HZ;
+    calibrationNoiseTarget = (uint32_t)((uint64_t)conf->getCalibrationSamples() * CALIBRATION_MS_PER_TARGET * rateHz / 1000);
     isCalibratingNoise = true;
-    calibrationMaxNoise = 0;
-    calibrationNoiseSamples = 0;
     buz->beep(200);
 }
 
 uint8_t LapTimer::stopCalibrationNoise()
 {
-    isCalibratingNoise = false;
-    buz->beep(200);
-    return calibrationMaxNoise;
+    // 自动停止后网页再发停止命令时不再重复蜂鸣
+    if (isCalibratingNoise)
+    {
+        isCalibratingNoise = false;
+        buz->beep(200);
+    }
+    return calibrationNoise.getMax();
 }
 
 void LapTimer::startCalibrationCrossing()
@@ -264,7 +641,7 @@ uint8_t LapTimer::stopCalibrationCrossing()
 
 uint8_t LapTimer::getCalibrationMaxNoise()
 {
-    return calibrationMaxNoise;
+    return calibrationNoise.getMax();
 }
 
 uint8_t LapTimer::getCalibrationMaxPeak()
@@ -272,9 +649,29 @@ uint8_t LapTimer::getCalibrationMaxPeak()
     return calibrationMaxPeak;
 }
 
-uint16_t LapTimer::getCalibrationNoiseSamples()
+uint32_t LapTimer::getCalibrationNoiseSamples()
 {
-    return calibrationNoiseSamples;
+    return calibrationNoise.getCount();
+}
+
+uint32_t LapTimer::getCalibrationNoiseTarget()
+{
+    return calibrationNoiseTarget;
+}
+
+bool LapTimer::isCalibrationNoiseRunning()
+{
+    return isCalibratingNoise;
+}
+
+bool LapTimer::isRunning()
+{
+    return state != STOPPED;
+}
+
+CalibrationHistogram *LapTimer::getCalibrationHistogram()
+{
+    return &calibrationNoise;
 }
 
 uint16_t LapTimer::getCalibrationCrossingSamples()
@@ -282,7 +679,7 @@ uint16_t LapTimer::getCalibrationCrossingSamples()
     return calibrationCrossingSamples;
 }
 
-void LapTimer::setLapEventHandler(void (*handler)(uint32_t lapTime))
+void LapTimer::setLapEventHandler(void (*handler)(uint32_t lapTimeUs))
 {
     lapEventHandler = handler;
 }
@@ -292,12 +689,36 @@ void LapTimer::setStopEventHandler(void (*handler)(void))
     stopEventHandler = handler;
 }
 
-uint32_t* LapTimer::getLapTimes()
+uint32_t LapTimer::getLapCount()
+{
+    return laps.getCount();
+}
+
+const LapStore *LapTimer::getLaps()
 {
-    return lapTimes;
+    return &laps;
+}
+
+uint32_t LapTimer::copyLapTimesUs(uint32_t *dst, uint32_t maxLaps)
+{
+    // 不加锁：遍历期间start()清空了存储则重来，新会话的圈数很少
+    for (;;)
+    {
+        const uint32_t generation = laps.getGeneration();
+        uint32_t n = 0;
+        LapStore::Iterator it = laps.iterate();
+        while (n < maxLaps && it.next(&dst[n]))
+        {
+            n++;
+        }
+        if (laps.isGeneration(generation))
+        {
+            return n;
+        }
+    }
 }
 
-uint8_t LapTimer::getLapCount()
+void LapTimer::refillLaps()
 {
-    return lapCount;
+    laps.refill();
 }
\ No newline at end of file
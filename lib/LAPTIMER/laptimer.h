@@ -1,8 +1,19 @@
+#pragma once
+
 #include "RX5808.h"
 #include "buzzer.h"
+#include "calibration.h"
 #include "config.h"
+#include "decimator.h"
+#include "hal.h"
 #include "kalman.h"
+#include "rssi_stream.h"
+#include "lapstore.h"
 #include "led.h"
+#include "noise_floor.h"
+#include "sampler.h"
+#include "spsc_queue.h"
+#include "trace.h"
 
 typedef enum {
     STOPPED,
@@ -10,17 +21,78 @@ typedef enum {
     RUNNING
 } laptimer_state_e;
 
-#define LAPTIMER_LAP_HISTORY 50
-#define LAPTIMER_RSSI_HISTORY 100
+typedef enum {
+    LAPTIMER_CMD_START,
+    LAPTIMER_CMD_STOP,
+    LAPTIMER_CMD_CALIB_NOISE_START,
+    LAPTIMER_CMD_CALIB_NOISE_STOP,
+    LAPTIMER_CMD_CALIB_CROSSING_START,
+    LAPTIMER_CMD_CALIB_CROSSING_STOP
+} laptimer_cmd_e;
+
+typedef enum {
+    LAPTIMER_EVENT_START,
+    LAPTIMER_EVENT_LAP,
+    LAPTIMER_EVENT_STOP
+} laptimer_event_e;
+
+typedef struct {
+    laptimer_event_e type;
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t timeUs;  // 事件发生时刻（峰值时刻或停止时刻）
+    uint8_t channel;  // 多频扫描时的频率序号，单频为0
+    uint8_t peakRssi;  // 圈事件的峰值RSSI，其他事件为0
+} laptimer_event_t;
+
+#define LAPTIMER_CMD_QUEUE_SIZE 16
+#define LAPTIMER_EVENT_QUEUE_SIZE 32
+#define LAPTIMER_MAX_EVENT_SINKS 8  // dispatchEvents()最多转发给几个订阅者，固件目前最多用4个
+
+// 事件订阅回调，在dispatchEvents()所在任务中执行
+typedef void (*laptimer_event_sink_fn)(const laptimer_event_t *event, void *ctx);
+
+#define LAPTIMER_RSSI_HISTORY 250  // 5 kHz下约50 ms，覆盖峰值插值所需的样本
+
+// 检测器参数，可通过build_flags覆盖，便于用native环境的基准测试对比
+#ifndef LAPTIMER_FILTER_Q
+#define LAPTIMER_FILTER_Q 2000  // 卡尔曼测量噪声 * 100（0.01 - 655.36）
+#endif
+#ifndef LAPTIMER_FILTER_R
+#define LAPTIMER_FILTER_R 40    // 卡尔曼过程噪声 * 10000（0.0001 - 65.536）
+#endif
+// 峰值时刻扣除卡尔曼稳态滞后的比例（%）。滞后对宽而平的峰等于(1-K)/K个样本，
+// 窄峰（快速穿越）实际滞后更小，80%在native bench的15 - 30 m/s下偏差最小
+#ifndef LAPTIMER_LAG_COMP_PCT
+#define LAPTIMER_LAG_COMP_PCT 80
+#endif
+#ifndef LAPTIMER_MIN_DELTA_SMALL_GATE
+#define LAPTIMER_MIN_DELTA_SMALL_GATE 10  // 1米门：峰值后需下降的RSSI
+#endif
+#ifndef LAPTIMER_MIN_DELTA_LARGE_GATE
+#define LAPTIMER_MIN_DELTA_LARGE_GATE 6   // 2米门
+#endif
 
 class LapTimer {
    public:
-    void init(Config *config, RX5808 *rx5808, Buzzer *buzzer, Led *l);
+    void init(Config *config, RX5808 *rx5808, RssiSource *rssiSource, Buzzer *buzzer, Led *l);
     void start();
     void stop();
-    void handleLapTimerUpdate(uint32_t currentTimeMs);
+    void handleLapTimerUpdate();
+    bool isRunning();  // 已开始计时（等待第一次穿越或计圈中）
+
+    // 跨核接口：网络任务投递命令，计时核在handleLapTimerUpdate()中执行；
+    // 计时核产生的事件由dispatchEvents()在网络/IO任务中取出并回调。
+    // 两个方向都是单生产者单消费者，postCommand()只能由AsyncTCP任务调用，
+    // postIoCommand()只能由网络/IO任务（parallelTask，如有线串口的命令）调用，两个队列分开。
+    bool postCommand(laptimer_cmd_e cmd);
+    bool postIoCommand(laptimer_cmd_e cmd);
+    void dispatchEvents();
+    SpscQueue<laptimer_cmd_e, LAPTIMER_CMD_QUEUE_SIZE> *getCommandQueue();
+    SpscQueue<laptimer_event_t, LAPTIMER_EVENT_QUEUE_SIZE> *getEventQueue();
     uint8_t getRssi();
-    uint32_t getLapTime();
+    uint32_t getLapTime();    // 毫秒
+    uint32_t getLapTimeUs();  // 微秒
     bool isLapAvailable();
 
     void startCalibrationNoise();
@@ -29,51 +101,103 @@ class LapTimer {
     uint8_t stopCalibrationCrossing();
     uint8_t getCalibrationMaxNoise();
     uint8_t getCalibrationMaxPeak();
-    uint16_t getCalibrationNoiseSamples();
+    uint32_t getCalibrationNoiseSamples();
     uint16_t getCalibrationCrossingSamples();
+    // 噪声校准以全速率采集，达到配置的时长后由计时核自动停止
+    uint32_t getCalibrationNoiseTarget();
+    bool isCalibrationNoiseRunning();
+    CalibrationHistogram *getCalibrationHistogram();
+
+    // 在线底噪与当前生效的阈值（开启底噪跟随时随底噪变化），任意任务可读
+    uint8_t getNoiseFloor();
+    bool isNoiseFloorValid();
+    uint32_t getNoiseFloorUpdates();
+    uint8_t getEnterRssi();
+    uint8_t getExitRssi();
 
-    // 新增：设置lap事件回调函数
-    void setLapEventHandler(void (*handler)(uint32_t lapTime));
+    // 新增：设置lap事件回调函数，圈速单位为微秒
+    void setLapEventHandler(void (*handler)(uint32_t lapTimeUs));
     // 新增：设置stop事件回调函数
     void setStopEventHandler(void (*handler)(void));
-    // 新增：获取圈速数据
-    uint32_t* getLapTimes();
-    uint8_t getLapCount();
+    // 订阅全部计时事件（开始/圈速/停止），用于日志、网络广播等
+    bool addEventSink(laptimer_event_sink_fn sink, void *ctx);
+    uint8_t getEventSinkCount() { return eventSinkCount; }
+    // 录制器在计时核上逐样本接收滤波前后的RSSI
+    void setTraceRecorder(TraceRecorder *recorder);
+    // 实时流在计时核上逐样本聚合滤波后的RSSI
+    void setRssiStream(RssiStream *rssiStream);
+    // 新增：获取圈速数据（微秒），第0圈为开圈（从start()时刻到第一次穿越，不受最小圈时限制）
+    uint32_t getLapCount();
+    // 在计时核上或计时停止后按顺序遍历，不拷贝
+    const LapStore *getLaps();
+    // 计时核以外的任务调用：不加锁解码最多maxLaps圈到dst，返回实际圈数
+    uint32_t copyLapTimesUs(uint32_t *dst, uint32_t maxLaps);
+    // 计时核以外的任务定期调用，为圈速存储补充空闲块
+    void refillLaps();
 
    private:
     laptimer_state_e state = STOPPED;
     RX5808 *rx;
+    RssiSource *source;
+    rssi_block_t block;
+    Decimator decimator;
     Config *conf;
     Buzzer *buz;
     Led *led;
-    KalmanFilter filter;
-    uint32_t startTimeMs;
-    uint8_t lapCount;
+    RssiKalmanFilter filter;
+    float filterLagSamples = 0;  // 峰值时刻补偿量（检测器样本数），init()时由Q/R算出
+    uint64_t startTimeUs;
     uint8_t rssiCount;
-    uint32_t lapTimes[LAPTIMER_LAP_HISTORY];
+    LapStore laps;
+    uint32_t lastLapTimeUs = 0;
     uint8_t rssi[LAPTIMER_RSSI_HISTORY];
+    uint16_t rssiFine[LAPTIMER_RSSI_HISTORY];    // 滤波后RSSI，12.4定点
+    uint32_t rssiTimeUs[LAPTIMER_RSSI_HISTORY];  // 采样时刻低32位
 
     uint8_t rssiPeak;
-    uint32_t rssiPeakTimeMs;
+    uint8_t rssiPeakIndex;
+    uint64_t rssiPeakTimeUs;
+    uint16_t rssiPeakFine;  // 滞回检测：窗内最大的滤波值（12.4定点）
+    bool crossingOpen = false;
+    laptimer_detector_e detector = LAPTIMER_DETECTOR_PEAK;  // start()时从配置读取
+    NoiseFloorTracker noiseFloor;
+    volatile uint8_t enterRssi = 0;  // 生效的阈值，每个样本由updateThresholds()刷新
+    volatile uint8_t exitRssi = 0;
 
     bool lapAvailable = false;
 
+    SpscQueue<laptimer_cmd_e, LAPTIMER_CMD_QUEUE_SIZE> commandQueue;
+    SpscQueue<laptimer_cmd_e, LAPTIMER_CMD_QUEUE_SIZE> ioCommandQueue;
+    SpscQueue<laptimer_event_t, LAPTIMER_EVENT_QUEUE_SIZE> eventQueue;
+    void handleCommands();
+
     // Calibration
-    bool isCalibratingNoise = false;
+    volatile bool isCalibratingNoise = false;
     bool isCalibratingCrossing = false;
-    uint8_t calibrationMaxNoise = 0;
+    CalibrationHistogram calibrationNoise;
+    uint32_t calibrationNoiseTarget = 0;
     uint8_t calibrationMaxPeak = 0;
-    uint16_t calibrationNoiseSamples = 0;
     uint16_t calibrationCrossingSamples = 0;
 
     // 新增：lap事件回调函数指针
-    void (*lapEventHandler)(uint32_t lapTime);
+    void (*lapEventHandler)(uint32_t lapTimeUs);
     // 新增：stop事件回调函数指针
     void (*stopEventHandler)(void);
+    laptimer_event_sink_fn eventSinks[LAPTIMER_MAX_EVENT_SINKS];
+    void *eventSinkCtx[LAPTIMER_MAX_EVENT_SINKS];
+    uint8_t eventSinkCount = 0;
+    TraceRecorder *trace = nullptr;
+    RssiStream *stream = nullptr;
 
-    void lapPeakCapture(uint32_t currentTimeMs);
+    void processSample(uint16_t rssiQ4, uint64_t currentTimeUs);
+    void lapPeakCapture(uint64_t currentTimeUs);
     bool lapPeakCaptured();
+    void lapPeakRefine();
+    void lapPeakInterpolate();
     void lapPeakReset();
+    bool crossingWindowClosed(uint64_t currentTimeUs);
+    bool minLapElapsed(uint64_t timeUs);
+    void updateThresholds();
 
     void startLap();
     void finishLap();
@@ -1,7 +1,9 @@
-#include <Arduino.h>
-
 #pragma once
 
+#include <stdint.h>
+
+#include "hal.h"
+
 typedef enum {
     LED_IDLE,
     LED_BLINKING,
@@ -19,8 +21,8 @@ class Led {
    private:
     led_state_e ledState = LED_IDLE;
     uint8_t ledPin;
-    uint8_t initialState = LOW;
-    uint8_t currentState = LOW;
+    uint8_t initialState = HAL_LOW;
+    uint8_t currentState = HAL_LOW;
     uint32_t onTimeMs;
     uint32_t offTimeMs;
     uint32_t checkTimeMs;
@@ -0,0 +1,114 @@
+#include "noise_floor.h"
+
+void P2Quantile::init(float quantile) {
+    p = quantile;
+    reset();
+}
+
+void P2Quantile::reset() {
+    count = 0;
+    for (int i = 0; i < 5; i++) {
+        n[i] = i;
+    }
+    np[0] = 0;
+    np[1] = 2 * p;
+    np[2] = 4 * p;
+    np[3] = 2 + 2 * p;
+    np[4] = 4;
+    dn[0] = 0;
+    dn[1] = p / 2;
+    dn[2] = p;
+    dn[3] = (1 + p) / 2;
+    dn[4] = 1;
+}
+
+float P2Quantile::parabolic(int i, float d) {
+    return q[i] + d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+float P2Quantile::linear(int i, float d) {
+    const int j = i + (int)d;
+    return q[i] + d * (q[j] - q[i]) / (n[j] - n[i]);
+}
+
+void P2Quantile::add(float x) {
+    // 前5个样本直接插入排序作为初始标记点
+    if (count < 5) {
+        int i = count++;
+        while (i > 0 && q[i - 1] > x) {
+            q[i] = q[i - 1];
+            i--;
+        }
+        q[i] = x;
+        return;
+    }
+    count++;
+
+    int k;
+    if (x < q[0]) {
+        q[0] = x;
+        k = 0;
+    } else if (x >= q[4]) {
+        q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= q[k + 1]) k++;
+    }
+    for (int i = k + 1; i < 5; i++) {
+        n[i] += 1;
+    }
+    for (int i = 0; i < 5; i++) {
+        np[i] += dn[i];
+    }
+
+    // 中间3个标记点偏离期望位置超过1时移动一格
+    for (int i = 1; i < 4; i++) {
+        const float d = np[i] - n[i];
+        if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+            const float s = d > 0 ? 1.0f : -1.0f;
+            float qi = parabolic(i, s);
+            if (!(q[i - 1] < qi && qi < q[i + 1])) qi = linear(i, s);
+            q[i] = qi;
+            n[i] += s;
+        }
+    }
+}
+
+float P2Quantile::get() {
+    if (count == 0) return 0;
+    if (count < 5) {
+        // 样本不足时取已排序样本中最接近的一个
+        return q[(int)(p * (count - 1) + 0.5f)];
+    }
+    return q[2];
+}
+
+void NoiseFloorTracker::init() {
+    estimator.init(NOISE_FLOOR_QUANTILE);
+    phase = 0;
+    valid = false;
+    floorQ4 = 0;
+    updates = 0;
+}
+
+bool NoiseFloorTracker::push(uint16_t filteredQ4) {
+    if (++phase < NOISE_FLOOR_DECIMATION) return false;
+    phase = 0;
+
+    estimator.add(filteredQ4);
+    if (estimator.getCount() < NOISE_FLOOR_BLOCK) return false;
+
+    const int32_t estimate = (int32_t)(estimator.get() + 0.5f);
+    estimator.reset();
+    if (!valid) {
+        floorQ4 = estimate;
+        valid = true;
+    } else {
+        floorQ4 = floorQ4 + ((estimate - (int32_t)floorQ4) >> NOISE_FLOOR_SMOOTH_SHIFT);
+    }
+    updates = updates + 1;
+    return true;
+}
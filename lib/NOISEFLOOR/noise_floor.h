@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#define NOISE_FLOOR_QUANTILE 0.5f     // 估计的分位数：中位数作为底噪
+#define NOISE_FLOOR_DECIMATION 50     // 每50个检测器样本取一个（5 kHz下100 Hz）
+#define NOISE_FLOOR_BLOCK 1000        // 每1000个取样（约10 s）得到一个新估计
+#define NOISE_FLOOR_SMOOTH_SHIFT 2    // 新估计以1/4的权重并入底噪，约40 s跟上变化
+
+/**
+ * P²分位数估计（Jain & Chlamtac 1985）：5个标记点，O(1)内存和时间，不保存样本。
+ */
+class P2Quantile {
+   public:
+    void init(float quantile);
+    void reset();
+    void add(float x);
+    float get();
+    uint32_t getCount() { return count; }
+
+   private:
+    float p = 0.5f;
+    float q[5];   // 标记点高度
+    float n[5];   // 标记点实际位置
+    float np[5];  // 标记点期望位置
+    float dn[5];  // 期望位置增量
+    uint32_t count = 0;
+
+    float parabolic(int i, float d);
+    float linear(int i, float d);
+};
+
+/**
+ * 在线底噪估计。只在没有穿越时（RSSI低于退出阈值、检测窗口未打开）由计时核喂入滤波后的RSSI，
+ * 按NOISE_FLOOR_DECIMATION抽取后进入P²估计器；每NOISE_FLOOR_BLOCK个取样重新开始一轮，
+ * 结果指数平滑到底噪上，因此能跟上电池电压下降、其他图传开机等缓慢漂移，
+ * 又不会被单次穿越拉高。
+ */
+class NoiseFloorTracker {
+   public:
+    void init();
+    // 计时核调用，底噪更新时返回true
+    bool push(uint16_t filteredQ4);
+
+    bool isValid() { return valid; }
+    uint16_t getFloorQ4() { return floorQ4; }
+    uint8_t getFloor() { return (floorQ4 + 8) >> 4; }
+    uint32_t getUpdates() { return updates; }
+
+   private:
+    P2Quantile estimator;
+    uint16_t phase = 0;
+    volatile bool valid = false;
+    volatile uint16_t floorQ4 = 0;
+    volatile uint32_t updates = 0;
+};
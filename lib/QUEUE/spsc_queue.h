@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * 有界无锁单生产者/单消费者队列，用于跨核传递命令和事件。
+ *
+ * 只有一个任务调用push()，只有一个任务调用pop()。索引单调递增，
+ * 生产者只写head、消费者只写tail，用acquire/release读写即可，
+ * 不需要原子读改写指令（ESP32-C3的RV32IMC没有A扩展）。
+ * 队列满时push()直接丢弃并计数，生产者永远不会阻塞。
+ */
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+   public:
+    // 仅生产者调用
+    bool push(const T &item) {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t t = tail.load(std::memory_order_acquire);
+        if (h - t >= N) {
+            drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        const uint32_t used = h + 1 - t;
+        if (used > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(used, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // 仅消费者调用
+    bool pop(T *item) {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        const uint32_t h = head.load(std::memory_order_acquire);
+        if (t == h) return false;
+        *item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 以下统计值可在任意任务读取，只是近似快照
+    uint32_t depth() {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    uint32_t capacity() { return N; }
+    uint32_t getHighWater() { return highWater.load(std::memory_order_relaxed); }
+    uint32_t getDrops() { return drops.load(std::memory_order_relaxed); }
+    uint32_t getPushed() { return head.load(std::memory_order_relaxed); }
+
+   private:
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> highWater{0};
+    std::atomic<uint32_t> drops{0};
+};
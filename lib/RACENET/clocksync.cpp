@@ -0,0 +1,126 @@
+#include "clocksync.h"
+
+#include <math.h>
+
+void ClockSync::reset() {
+    windowCount = 0;
+    windowNext = 0;
+    fitCount = 0;
+    fitNext = 0;
+    lastFitLocalUs = 0;
+    lastSampleUs = 0;
+    refUs = 0;
+    offsetUs = 0;
+    slopePpm = 0;
+    halfDelayUs = 0;
+    slopeErrPpm = 0;
+    minDelayUs = 0;
+    spanUs = 0;
+    samples = 0;
+    rejected = 0;
+}
+
+bool ClockSync::addSample(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    const int64_t delay = ((int64_t)t4 - (int64_t)t1) - ((int64_t)t3 - (int64_t)t2);
+    if (t4 < t1 || delay < 0 || delay > RACENET_SYNC_MAX_RTT_US) {
+        rejected++;
+        return false;
+    }
+    sample_t *s = &window[windowNext];
+    s->localUs = t1 + (t4 - t1) / 2;
+    s->offsetUs = (((int64_t)t2 - (int64_t)t1) + ((int64_t)t3 - (int64_t)t4)) / 2;
+    s->delayUs = (uint32_t)delay;
+    windowNext = (windowNext + 1) % RACENET_SYNC_WINDOW;
+    if (windowCount < RACENET_SYNC_WINDOW) windowCount++;
+    samples++;
+    lastSampleUs = t4;
+
+    // 窗口中往返最短的一次（相同时取较新的），比上次用过的新才加入拟合，每个窗口最多贡献几个点
+    const sample_t *best = &window[0];
+    for (uint8_t i = 1; i < windowCount; i++) {
+        if (window[i].delayUs < best->delayUs ||
+            (window[i].delayUs == best->delayUs && window[i].localUs > best->localUs))
+            best = &window[i];
+    }
+    if (fitCount == 0 || best->localUs > lastFitLocalUs) {
+        fit[fitNext] = *best;
+        fitNext = (fitNext + 1) % RACENET_SYNC_FIT;
+        if (fitCount < RACENET_SYNC_FIT) fitCount++;
+        lastFitLocalUs = best->localUs;
+        refit();
+    }
+    return true;
+}
+
+// 加权直线拟合，权重为往返时间平方的倒数：排队少的测量误差上界小，权重也大。
+// x为秒、y为微秒（都相对最新的点），斜率即ppm；结果以加权重心为参考点，外推误差最小
+void ClockSync::refit() {
+    const sample_t *newest = &fit[(fitNext + RACENET_SYNC_FIT - 1) % RACENET_SYNC_FIT];
+    uint64_t oldestUs = newest->localUs;
+    uint32_t delayUs = newest->delayUs;
+    double sw = 0, sx = 0, sy = 0, sd = 0;
+    for (uint8_t i = 0; i < fitCount; i++) {
+        const double d = fit[i].delayUs > 10 ? fit[i].delayUs : 10;
+        const double w = 1.0 / (d * d);
+        sw += w;
+        sx += w * (double)((int64_t)fit[i].localUs - (int64_t)newest->localUs) / 1e6;
+        sy += w * (double)(fit[i].offsetUs - newest->offsetUs);
+        sd += w * fit[i].delayUs / 2.0;
+        if (fit[i].localUs < oldestUs) oldestUs = fit[i].localUs;
+        if (fit[i].delayUs < delayUs) delayUs = fit[i].delayUs;
+    }
+    const double mx = sx / sw;
+    const double my = sy / sw;
+    double sxx = 0, sxy = 0;
+    for (uint8_t i = 0; i < fitCount; i++) {
+        const double d = fit[i].delayUs > 10 ? fit[i].delayUs : 10;
+        const double w = 1.0 / (d * d) / sw;
+        const double x = (double)((int64_t)fit[i].localUs - (int64_t)newest->localUs) / 1e6 - mx;
+        const double y = (double)(fit[i].offsetUs - newest->offsetUs) - my;
+        sxx += w * x * x;
+        sxy += w * x * y;
+    }
+    spanUs = newest->localUs - oldestUs;
+    double slope = 0;
+    if (fitCount >= 3 && spanUs >= (uint64_t)RACENET_SYNC_MIN_SPAN_MS * 1000 && sxx > 0) {
+        slope = sxy / sxx;
+        if (slope > RACENET_SYNC_MAX_DRIFT_PPM) slope = RACENET_SYNC_MAX_DRIFT_PPM;
+        if (slope < -RACENET_SYNC_MAX_DRIFT_PPM) slope = -RACENET_SYNC_MAX_DRIFT_PPM;
+    }
+    double ss = 0;
+    for (uint8_t i = 0; i < fitCount; i++) {
+        const double d = fit[i].delayUs > 10 ? fit[i].delayUs : 10;
+        const double w = 1.0 / (d * d) / sw;
+        const double x = (double)((int64_t)fit[i].localUs - (int64_t)newest->localUs) / 1e6 - mx;
+        const double r = (double)(fit[i].offsetUs - newest->offsetUs) - my - slope * x;
+        ss += w * r * r;
+    }
+    refUs = newest->localUs + (int64_t)llround(mx * 1e6);
+    offsetUs = newest->offsetUs + (int64_t)llround(my);
+    slopePpm = slope;
+    // 每个测量的误差不超过delay / 2，加权平均的误差也不超过delay / 2的加权平均
+    halfDelayUs = sd / sw;
+    slopeErrPpm = sxx > 0 && fitCount > 2 ? sqrt(ss / sxx / (fitCount - 2)) : 0;
+    minDelayUs = delayUs;
+}
+
+bool ClockSync::isSynced(uint64_t localUs) {
+    return samples >= RACENET_SYNC_MIN_SAMPLES && fitCount > 0 &&
+           localUs - lastSampleUs < (uint64_t)RACENET_SYNC_TIMEOUT_MS * 1000;
+}
+
+uint64_t ClockSync::toMaster(uint64_t localUs, uint32_t *uncertaintyUs) {
+    const int64_t dt = (int64_t)localUs - (int64_t)refUs;
+    const uint64_t masterUs = localUs + offsetUs + (int64_t)llround(slopePpm * (double)dt / 1e6);
+    if (uncertaintyUs != nullptr) {
+        // 往返不对称的上界 + 从拟合重心外推的漂移误差；漂移未知时拟合点本身也按最大漂移分散
+        double u = halfDelayUs;
+        if (spanUs >= (uint64_t)RACENET_SYNC_MIN_SPAN_MS * 1000) {
+            u += fabs((double)dt) * (3 * slopeErrPpm + RACENET_SYNC_DRIFT_BOUND_PPM) / 1e6;
+        } else {
+            u += (fabs((double)dt) + spanUs / 2.0) * RACENET_SYNC_UNKNOWN_DRIFT_PPM / 1e6;
+        }
+        *uncertaintyUs = u < 4e9 ? (uint32_t)ceil(u) : 4000000000UL;
+    }
+    return masterUs;
+}
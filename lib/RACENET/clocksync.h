@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * 主从时钟同步的估计器（NTP/PTP式往返测量），不涉及收发，主机上可以直接验证。
+ *
+ * 每次往返得到 t1本地发送、t2主时钟收到、t3主时钟回复、t4本地收到：
+ *   偏差 offset = ((t2 - t1) + (t3 - t4)) / 2   （主时钟 - 本地时钟）
+ *   往返 delay  = (t4 - t1) - (t3 - t2)
+ * 单次测量的误差不超过 delay / 2（去程和回程不对称的极限情况）。WiFi上偶尔有几毫秒的排队，
+ * 所以只取最近RACENET_SYNC_WINDOW次中往返最短的一次（NTP的时钟过滤），
+ * 再对这些点做加权最小二乘直线拟合，斜率即两边晶振的相对漂移（ppm）。
+ */
+#define RACENET_SYNC_WINDOW 8         // 时钟过滤窗口（原始测量数）
+#define RACENET_SYNC_FIT 16           // 参与拟合的过滤后测量数
+#define RACENET_SYNC_MIN_SAMPLES 4    // 至少这么多次原始测量才认为已同步
+#define RACENET_SYNC_MAX_RTT_US 100000  // 往返超过100 ms的测量直接丢弃
+#define RACENET_SYNC_MIN_SPAN_MS 10000   // 拟合点跨度不足时斜率噪声太大，不估计漂移
+#define RACENET_SYNC_MAX_DRIFT_PPM 200     // 晶振不会差这么多，超过说明测量有误
+#define RACENET_SYNC_DRIFT_BOUND_PPM 5     // 估计出漂移后，外推误差按斜率标准误差的3倍再加这么多计
+#define RACENET_SYNC_UNKNOWN_DRIFT_PPM 50  // 漂移未知时按常见晶振误差上限外推
+#define RACENET_SYNC_TIMEOUT_MS 10000      // 这么久没有新测量视为失去同步
+
+class ClockSync {
+   public:
+    void reset();
+    // 加入一次往返测量，返回false表示被丢弃
+    bool addSample(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+    bool isSynced(uint64_t localUs);
+    // 本地时刻换算到主时钟；uncertaintyUs为误差上界的估计，随距上次测量的时间增长
+    uint64_t toMaster(uint64_t localUs, uint32_t *uncertaintyUs);
+
+    int64_t getOffsetUs() { return offsetUs; }
+    // 本地时钟比主站快多少ppm，即偏差随时间变化的斜率取反
+    float getDriftPpm() { return (float)-slopePpm; }
+    uint32_t getMinDelayUs() { return minDelayUs; }
+    uint32_t getSamples() { return samples; }
+    uint32_t getRejected() { return rejected; }
+
+   private:
+    typedef struct {
+        uint64_t localUs;  // 测量中点（本地时钟）
+        int64_t offsetUs;
+        uint32_t delayUs;
+    } sample_t;
+
+    sample_t window[RACENET_SYNC_WINDOW];
+    uint8_t windowCount = 0;
+    uint8_t windowNext = 0;
+    sample_t fit[RACENET_SYNC_FIT];
+    uint8_t fitCount = 0;
+    uint8_t fitNext = 0;
+    uint64_t lastFitLocalUs = 0;
+    uint64_t lastSampleUs = 0;
+
+    // 拟合结果：主时钟 = local + offsetUs + slopePpm * (local - refUs) / 1e6，refUs为拟合点的加权重心
+    uint64_t refUs = 0;
+    int64_t offsetUs = 0;
+    double slopePpm = 0;
+    double halfDelayUs = 0;  // 拟合点delay / 2的加权平均，即偏差的误差上界
+    double slopeErrPpm = 0;  // 斜率的标准误差
+    uint32_t minDelayUs = 0;
+    uint64_t spanUs = 0;
+    uint32_t samples = 0;
+    uint32_t rejected = 0;
+
+    void refit();
+};
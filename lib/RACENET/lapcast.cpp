@@ -0,0 +1,143 @@
+#include "lapcast.h"
+
+#include <string.h>
+
+#include "crc.h"
+
+#define LAPCAST_CRC_BYTES 4
+
+uint16_t lapcastSeal(uint8_t *buf, uint16_t len) {
+    const uint32_t crc = crc32(buf, len);
+    memcpy(buf + len, &crc, LAPCAST_CRC_BYTES);
+    return len + LAPCAST_CRC_BYTES;
+}
+
+uint8_t lapcastCheck(const uint8_t *buf, uint16_t len) {
+    if (len < 4 + LAPCAST_CRC_BYTES) return 0;
+    uint16_t magic;
+    memcpy(&magic, buf, sizeof(magic));
+    if (magic != LAPCAST_MAGIC || buf[2] != LAPCAST_VERSION) return 0;
+    uint16_t size;
+    switch (buf[3]) {
+        case LAPCAST_LAP:
+        case LAPCAST_HEARTBEAT:
+            size = sizeof(lapcast_lap_t);
+            break;
+        case LAPCAST_NACK:
+            size = sizeof(lapcast_nack_t);
+            break;
+        default:
+            return 0;
+    }
+    if (len != size + LAPCAST_CRC_BYTES) return 0;
+    uint32_t crc;
+    memcpy(&crc, buf + size, LAPCAST_CRC_BYTES);
+    if (crc != crc32(buf, size)) return 0;
+    return buf[3];
+}
+
+uint32_t lapcastNodeId(const uint8_t *mac) {
+    return (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+}
+
+uint32_t lapcastGroupIp() {
+    const uint8_t group[4] = {LAPCAST_GROUP_A, LAPCAST_GROUP_B, LAPCAST_GROUP_C, LAPCAST_GROUP_D};
+    uint32_t ip;
+    memcpy(&ip, group, sizeof(ip));
+    return ip;
+}
+
+void LapCaster::begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId) {
+    transport = raceTransport;
+    node = lapcastNodeId(mac);
+    boot = bootId;
+    memset(history, 0, sizeof(history));
+    seq = 0;
+    heartbeatUs = 0;
+}
+
+void LapCaster::fillTime(lapcast_lap_t *packet, uint64_t localUs, uint64_t nowUs) {
+    uint64_t sharedUs;
+    uint32_t uncertaintyUs;
+    if (clockSource != nullptr && clockSource->toShared(localUs, nowUs, &sharedUs, &uncertaintyUs)) {
+        packet->timeUs = sharedUs;
+        packet->flags |= LAPCAST_FLAG_SHARED;
+    } else {
+        packet->timeUs = localUs;
+        packet->flags &= ~LAPCAST_FLAG_SHARED;
+    }
+}
+
+bool LapCaster::send(lapcast_lap_t *packet) {
+    if (transport == nullptr || mode == LAPCAST_OFF) return false;
+    uint8_t buf[LAPCAST_MAX_PACKET];
+    memcpy(buf, packet, sizeof(*packet));
+    const uint16_t len = lapcastSeal(buf, sizeof(*packet));
+    if (mode == LAPCAST_BROADCAST) return transport->broadcast(LAPCAST_PORT, buf, len);
+    if (mode == LAPCAST_MULTICAST) {
+        const racenet_addr_t group = {lapcastGroupIp(), LAPCAST_PORT};
+        return transport->send(&group, buf, len);
+    }
+    return unicast.ip != 0 && transport->send(&unicast, buf, len);
+}
+
+void LapCaster::publish(uint16_t frequency, uint32_t lapNumber, uint32_t lapTimeUs, uint64_t eventUs,
+                        uint8_t peakRssi, uint64_t nowUs) {
+    seq++;
+    entry_t *e = &history[seq % LAPCAST_HISTORY];
+    memset(e, 0, sizeof(*e));
+    lapcast_lap_t *p = &e->packet;
+    p->magic = LAPCAST_MAGIC;
+    p->version = LAPCAST_VERSION;
+    p->type = LAPCAST_LAP;
+    p->node = node;
+    p->boot = boot;
+    p->seq = seq;
+    p->lapMs = (lapTimeUs + 500) / 1000;
+    p->lapNumber = (uint16_t)lapNumber;
+    p->frequency = frequency;
+    p->peakRssi = peakRssi;
+    e->eventUs = eventUs;
+    fillTime(p, eventUs, nowUs);
+    p->sendDelayUs = (uint32_t)(nowUs - eventUs);
+    if (send(p)) sent++;
+}
+
+bool LapCaster::handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs) {
+    (void)from;
+    if (lapcastCheck(buf, len) != LAPCAST_NACK) return false;
+    lapcast_nack_t nack;
+    memcpy(&nack, buf, sizeof(nack));
+    if (nack.node != node || nack.boot != boot) return true;
+    nacks++;
+    const uint32_t oldest = seq > LAPCAST_HISTORY ? seq - LAPCAST_HISTORY + 1 : 1;
+    const uint8_t count = nack.count > LAPCAST_NACK_MAX ? LAPCAST_NACK_MAX : nack.count;
+    for (uint32_t s = nack.firstSeq; s < nack.firstSeq + count; s++) {
+        if (s < oldest || s > seq) continue;
+        entry_t *e = &history[s % LAPCAST_HISTORY];
+        if (e->resentUs != 0 && nowUs - e->resentUs < (uint64_t)LAPCAST_RESEND_GUARD_MS * 1000) continue;
+        e->resentUs = nowUs;
+        // 重发时按最新的同步结果重新换算，sendDelayUs也相应变大，接收方据此看出是补发
+        lapcast_lap_t *p = &e->packet;
+        p->flags |= LAPCAST_FLAG_RESENT;
+        fillTime(p, e->eventUs, nowUs);
+        p->sendDelayUs = (uint32_t)(nowUs - e->eventUs);
+        if (send(p)) resent++;
+    }
+    return true;
+}
+
+void LapCaster::service(uint64_t nowUs) {
+    if (mode == LAPCAST_OFF || nowUs - heartbeatUs < (uint64_t)LAPCAST_HEARTBEAT_MS * 1000) return;
+    heartbeatUs = nowUs;
+    lapcast_lap_t p;
+    memset(&p, 0, sizeof(p));
+    p.magic = LAPCAST_MAGIC;
+    p.version = LAPCAST_VERSION;
+    p.type = LAPCAST_HEARTBEAT;
+    p.node = node;
+    p.boot = boot;
+    p.seq = seq;
+    fillTime(&p, nowUs, nowUs);
+    send(&p);
+}
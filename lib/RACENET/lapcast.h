@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "racenet.h"
+
+/**
+ * 给比赛控制软件用的UDP圈速广播：每完成一圈立即向组播组（或本网段广播）发一个定长二进制包，
+ * 接收方不必订阅，也不必对每个节点保持/events的SSE连接。
+ *
+ * 每个包带节点ID、boot和序号，接收方按(节点, boot)检查序号，发现缺号就向发送方单播NACK，
+ * 节点从最近LAPCAST_HISTORY个圈包中重发（仍发往组播组/广播，其他接收方同时补齐）；
+ * 每LAPCAST_HEARTBEAT_MS一次的心跳带上最新序号，最后一个包丢了也能发现。
+ * WiFi的组播和广播帧没有链路层确认和重传，丢包率明显高于单播，所以需要这套补发。
+ *
+ * 与RaceNet共用设备上的UDP套接字：包从RACENET_PORT发出，NACK发回这个端口，magic不同，按magic分流。
+ * 字段为小端字节序，末尾是前面所有字节的CRC-32。
+ */
+#define LAPCAST_PORT 7371
+#define LAPCAST_MAGIC 0x4351  // "QC"
+#define LAPCAST_VERSION 1
+#define LAPCAST_HISTORY 16
+#define LAPCAST_HEARTBEAT_MS 1000
+#define LAPCAST_RESEND_GUARD_MS 20  // 多个接收方同时NACK同一个包时只重发一次
+#define LAPCAST_NACK_MAX 16         // 一个NACK最多请求的连续序号数
+#define LAPCAST_NACK_RETRY_MS 40    // 接收方：NACK之后这么久还没补到就再发一次
+#define LAPCAST_NACK_TRIES 8        // 接收方：超过这么多次仍没补到记为丢失
+
+// 组播组239.255.73.71（组织内部范围），网络字节序与racenet_addr_t.ip相同
+#define LAPCAST_GROUP_A 239
+#define LAPCAST_GROUP_B 255
+#define LAPCAST_GROUP_C 73
+#define LAPCAST_GROUP_D 71
+
+typedef enum {
+    LAPCAST_OFF,
+    LAPCAST_BROADCAST,
+    LAPCAST_MULTICAST,
+    LAPCAST_UNICAST  // 只用于主机工具，发往setUnicast()给出的地址
+} lapcast_mode_e;
+
+typedef enum {
+    LAPCAST_LAP = 1,
+    LAPCAST_HEARTBEAT = 2,
+    LAPCAST_NACK = 3
+} lapcast_type_e;
+
+#define LAPCAST_FLAG_RESENT 0x01  // 应NACK重发的包
+#define LAPCAST_FLAG_SHARED 0x02  // timeUs已换算到RaceNet时钟主站，否则为节点自己的时钟
+
+// 圈包和心跳共用一个布局，心跳只填seq（最新序号，0表示还没有圈）、timeUs（发送时刻）和flags
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint32_t node;  // 节点ID，取MAC后4字节
+    uint32_t boot;  // 每次启动随机生成，变化表示序号重新开始
+    uint32_t seq;   // 从1开始
+    uint64_t timeUs;       // 过门时刻
+    uint32_t sendDelayUs;  // 本次发送时刻 - 过门时刻（节点时钟），即节点内部的延迟
+    uint32_t lapMs;
+    uint16_t lapNumber;
+    uint16_t frequency;
+    uint8_t peakRssi;
+    uint8_t flags;
+} lapcast_lap_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint32_t node;
+    uint32_t boot;
+    uint32_t firstSeq;
+    uint8_t count;  // 从firstSeq起连续count个序号，不超过LAPCAST_NACK_MAX
+} lapcast_nack_t;
+
+#define LAPCAST_MAX_PACKET (sizeof(lapcast_lap_t) + 4)
+
+// 校验长度、magic、版本和CRC，返回包类型，无效时返回0
+uint8_t lapcastCheck(const uint8_t *buf, uint16_t len);
+// 在len字节后追加CRC，返回总长度
+uint16_t lapcastSeal(uint8_t *buf, uint16_t len);
+uint32_t lapcastNodeId(const uint8_t *mac);
+uint32_t lapcastGroupIp();
+
+/**
+ * 发送端：publish()、handlePacket()和service()须在同一任务中调用（设备上为parallelTask）。
+ */
+class LapCaster {
+   public:
+    void begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId);
+    // 网络就绪前transport可以为空，圈包照常进入历史，之后可被NACK补回
+    void setTransport(RaceTransport *raceTransport) { transport = raceTransport; }
+    // 已同步到RaceNet时钟主站时，timeUs用主站时钟，不同节点的过门时刻可以直接比较
+    void setClockSource(RaceNode *node) { clockSource = node; }
+    void setMode(uint8_t castMode) { mode = castMode <= LAPCAST_UNICAST ? castMode : (uint8_t)LAPCAST_OFF; }
+    void setUnicast(const racenet_addr_t *to) { unicast = *to; }
+    uint8_t getMode() { return mode; }
+
+    void publish(uint16_t frequency, uint32_t lapNumber, uint32_t lapTimeUs, uint64_t eventUs, uint8_t peakRssi,
+                 uint64_t nowUs);
+    // 处理发给本节点的NACK，其他包返回false
+    bool handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs);
+    void service(uint64_t nowUs);
+
+    uint32_t getLastSeq() { return seq; }
+    uint32_t getSent() { return sent; }
+    uint32_t getResent() { return resent; }
+    uint32_t getNacks() { return nacks; }
+
+   private:
+    typedef struct {
+        lapcast_lap_t packet;
+        uint64_t eventUs;   // 节点时钟，每次发送时重新换算
+        uint64_t resentUs;  // 最近一次重发的时刻
+    } entry_t;
+
+    RaceTransport *transport = nullptr;
+    RaceNode *clockSource = nullptr;
+    uint8_t mode = LAPCAST_OFF;
+    racenet_addr_t unicast = {0, 0};
+    uint32_t node = 0;
+    uint32_t boot = 0;
+    entry_t history[LAPCAST_HISTORY];
+    uint32_t seq = 0;
+    uint64_t heartbeatUs = 0;
+    uint32_t sent = 0;
+    uint32_t resent = 0;
+    uint32_t nacks = 0;
+
+    void fillTime(lapcast_lap_t *packet, uint64_t localUs, uint64_t nowUs);
+    bool send(lapcast_lap_t *packet);
+};
@@ -0,0 +1,569 @@
+#include "racenet.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "crc.h"
+
+#define RACENET_CRC_BYTES 4
+
+static const racenet_addr_t localAddr = {0, 0};
+
+void racenetInitHeader(racenet_header_t *header, uint8_t type, const uint8_t *mac, uint32_t boot) {
+    header->magic = RACENET_MAGIC;
+    header->version = RACENET_VERSION;
+    header->type = type;
+    memcpy(header->mac, mac, sizeof(header->mac));
+    header->boot = boot;
+}
+
+uint16_t racenetSeal(uint8_t *buf, uint16_t len) {
+    const uint32_t crc = crc32(buf, len);
+    memcpy(buf + len, &crc, RACENET_CRC_BYTES);
+    return len + RACENET_CRC_BYTES;
+}
+
+static uint16_t payloadSize(uint8_t type) {
+    switch (type) {
+        case RACENET_DISCOVER:
+            return sizeof(racenet_header_t);
+        case RACENET_HELLO:
+            return sizeof(racenet_hello_t);
+        case RACENET_SUBSCRIBE:
+            return sizeof(racenet_subscribe_t);
+        case RACENET_EVENT:
+            return sizeof(racenet_event_t);
+        case RACENET_SYNC:
+        case RACENET_SYNC_REPLY:
+            return sizeof(racenet_sync_t);
+        default:
+            return 0;
+    }
+}
+
+uint8_t racenetCheck(const uint8_t *buf, uint16_t len) {
+    if (len < sizeof(racenet_header_t) + RACENET_CRC_BYTES) return 0;
+    racenet_header_t header;
+    memcpy(&header, buf, sizeof(header));
+    if (header.magic != RACENET_MAGIC || header.version != RACENET_VERSION) return 0;
+    const uint16_t size = payloadSize(header.type);
+    if (size == 0 || len != size + RACENET_CRC_BYTES) return 0;
+    uint32_t crc;
+    memcpy(&crc, buf + size, RACENET_CRC_BYTES);
+    if (crc != crc32(buf, size)) return 0;
+    return header.type;
+}
+
+void racenetFormatIp(uint32_t ip, char *buf, size_t size) {
+    const uint8_t *b = (const uint8_t *)&ip;
+    snprintf(buf, size, "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+}
+
+void racenetFormatMac(const uint8_t *mac, char *buf, size_t size) {
+    snprintf(buf, size, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+void racenetAddrFromMac(const uint8_t *mac, racenet_addr_t *addr) {
+    memcpy(&addr->ip, mac, 4);
+    addr->port = (uint16_t)(mac[4] << 8 | mac[5]);
+}
+
+void racenetAddrToMac(const racenet_addr_t *addr, uint8_t *mac) {
+    memcpy(mac, &addr->ip, 4);
+    mac[4] = addr->port >> 8;
+    mac[5] = addr->port & 0xFF;
+}
+
+static bool sameAddr(const racenet_addr_t *a, const racenet_addr_t *b) {
+    return a->ip == b->ip && a->port == b->port;
+}
+
+// 定长字段，发送方已清零填充，末字节强制结束
+static void copyField(char *dst, const char *src, size_t size) {
+    memcpy(dst, src, size - 1);
+    dst[size - 1] = '\0';
+}
+
+// ---------------------------------------------------------------- 节点
+
+void RaceNode::begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId) {
+    transport = raceTransport;
+    memcpy(nodeMac, mac, sizeof(nodeMac));
+    boot = bootId;
+    memset(&info, 0, sizeof(info));
+    memset(subscribers, 0, sizeof(subscribers));
+    seq = 0;
+    clock.reset();
+    selfMaster = false;
+    masterSlot = -1;
+}
+
+uint8_t RaceNode::getSubscriberCount() {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs != 0) n++;
+    }
+    return n;
+}
+
+bool RaceNode::toShared(uint64_t localUs, uint64_t nowUs, uint64_t *sharedUs, uint32_t *uncertaintyUs) {
+    if (selfMaster) {
+        *sharedUs = localUs;
+        *uncertaintyUs = 0;
+        return true;
+    }
+    if (!isSynced(nowUs)) return false;
+    *sharedUs = clock.toMaster(localUs, uncertaintyUs);
+    return true;
+}
+
+void RaceNode::sendEvent(racenet_event_t *event, const racenet_addr_t *to, uint64_t nowUs) {
+    uint8_t buf[RACENET_MAX_PACKET];
+    event->sendUs = nowUs;
+    // 重发时按最新的同步结果重新换算，主站换了也能跟上
+    uint64_t sharedUs;
+    uint32_t uncertaintyUs;
+    if (toShared(event->eventUs, nowUs, &sharedUs, &uncertaintyUs)) {
+        memcpy(event->masterMac, selfMaster ? nodeMac : masterMac, sizeof(event->masterMac));
+        event->sharedUs = sharedUs;
+        event->uncertaintyUs = uncertaintyUs;
+    } else {
+        memset(event->masterMac, 0, sizeof(event->masterMac));
+        event->sharedUs = 0;
+        event->uncertaintyUs = RACENET_UNSYNCED;
+    }
+    memcpy(buf, event, sizeof(*event));
+    const uint16_t len = racenetSeal(buf, sizeof(*event));
+    if (to->ip == 0) {
+        if (local != nullptr) local->handlePacket(&localAddr, buf, len, nowUs);
+    } else if (transport != nullptr) {
+        transport->send(to, buf, len);
+    }
+}
+
+void RaceNode::pushEvent(uint8_t event, uint8_t channel, uint16_t frequency, uint32_t lapNumber, uint32_t lapTimeUs,
+                         uint64_t eventUs, uint64_t nowUs) {
+    seq++;
+    racenet_event_t *e = &history[seq % RACENET_HISTORY];
+    memset(e, 0, sizeof(*e));
+    racenetInitHeader(&e->header, RACENET_EVENT, nodeMac, boot);
+    e->seq = seq;
+    e->event = event;
+    e->channel = channel;
+    e->frequency = frequency;
+    e->lapNumber = lapNumber;
+    e->lapTimeUs = lapTimeUs;
+    e->eventUs = eventUs;
+    e->sector = info.sector;
+    e->sectorCount = info.sectorCount;
+
+    sendEvent(e, &localAddr, nowUs);
+    for (uint8_t i = 0; i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs == 0) continue;
+        sendEvent(e, &subscribers[i].addr, nowUs);
+        sent++;
+    }
+}
+
+void RaceNode::sendHello(const racenet_addr_t *to, uint64_t nowUs) {
+    racenet_hello_t hello;
+    memset(&hello, 0, sizeof(hello));
+    racenetInitHeader(&hello.header, RACENET_HELLO, nodeMac, boot);
+    hello.nowUs = nowUs;
+    hello.lastSeq = seq;
+    hello.oldestSeq = oldestSeq();
+    hello.frequency = info.frequency;
+    hello.running = info.running;
+    hello.sector = info.sector;
+    hello.sectorCount = info.sectorCount;
+    copyField(hello.host, info.host, sizeof(hello.host));
+    copyField(hello.product, info.product, sizeof(hello.product));
+    copyField(hello.pilot, info.pilot, sizeof(hello.pilot));
+    uint64_t sharedUs;
+    uint32_t uncertaintyUs;
+    if (toShared(nowUs, nowUs, &sharedUs, &uncertaintyUs)) {
+        memcpy(hello.masterMac, selfMaster ? nodeMac : masterMac, sizeof(hello.masterMac));
+        hello.uncertaintyUs = uncertaintyUs;
+    } else {
+        hello.uncertaintyUs = RACENET_UNSYNCED;
+    }
+
+    uint8_t buf[RACENET_MAX_PACKET];
+    memcpy(buf, &hello, sizeof(hello));
+    const uint16_t len = racenetSeal(buf, sizeof(hello));
+    if (to->ip == 0) {
+        if (local != nullptr) local->handlePacket(&localAddr, buf, len, nowUs);
+    } else if (transport != nullptr) {
+        transport->send(to, buf, len);
+    }
+}
+
+// 重发ackSeq之后仍在历史中的事件，刚发出不久的跳过（多半还在路上）
+void RaceNode::resendAfter(const racenet_addr_t *to, uint32_t ackSeq, uint64_t nowUs) {
+    const uint32_t first = ackSeq + 1 > oldestSeq() ? ackSeq + 1 : oldestSeq();
+    for (uint32_t s = first; s <= seq; s++) {
+        racenet_event_t *e = &history[s % RACENET_HISTORY];
+        if (nowUs - e->sendUs < (uint64_t)RACENET_RESEND_GUARD_MS * 1000) continue;
+        sendEvent(e, to, nowUs);
+        resent++;
+    }
+}
+
+bool RaceNode::handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs) {
+    const uint8_t type = racenetCheck(buf, len);
+    if (type == RACENET_DISCOVER) {
+        sendHello(from, nowUs);
+        return true;
+    }
+    if (type == RACENET_SYNC_REPLY) {
+        racenet_sync_t reply;
+        memcpy(&reply, buf, sizeof(reply));
+        handleSyncReply(from, &reply, nowUs);
+        return true;
+    }
+    if (type != RACENET_SUBSCRIBE) return false;
+
+    racenet_subscribe_t sub;
+    memcpy(&sub, buf, sizeof(sub));
+    subscriber_t *slot = nullptr;
+    for (uint8_t i = 0; i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs != 0 && sameAddr(&subscribers[i].addr, from)) {
+            slot = &subscribers[i];
+            break;
+        }
+    }
+    for (uint8_t i = 0; slot == nullptr && i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs == 0) slot = &subscribers[i];
+    }
+    if (slot == nullptr) return true;  // 订阅者已满，对方租期到后会继续尝试
+    const bool renewed = slot->expiresUs != 0;
+    if (!renewed) slot->sinceUs = nowUs;
+    slot->addr = *from;
+    memcpy(slot->mac, sub.header.mac, sizeof(slot->mac));
+    slot->expiresUs = nowUs + (uint64_t)RACENET_LEASE_MS * 1000;
+    if (!renewed) sendHello(from, nowUs);
+    resendAfter(from, sub.nodeBoot == boot ? sub.ackSeq : 0, nowUs);
+    return true;
+}
+
+// 本机在汇总时以自己为主站，否则跟随最早订阅的汇总方；主站变化时重新开始测量
+void RaceNode::selectMaster(uint64_t nowUs) {
+    const bool self = local != nullptr && local->isActive();
+    int8_t slot = -1;
+    for (uint8_t i = 0; !self && i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs == 0) continue;
+        if (slot < 0 || subscribers[i].sinceUs < subscribers[slot].sinceUs) slot = i;
+    }
+    if (self != selfMaster || slot != masterSlot ||
+        (slot >= 0 && memcmp(subscribers[slot].mac, masterMac, sizeof(masterMac)) != 0)) {
+        selfMaster = self;
+        masterSlot = slot;
+        if (slot >= 0) memcpy(masterMac, subscribers[slot].mac, sizeof(masterMac));
+        clock.reset();
+        syncSentUs = 0;
+        syncOriginUs = 0;
+    }
+    if (masterSlot < 0 || transport == nullptr) return;
+
+    const uint32_t intervalMs = clock.getSamples() < RACENET_SYNC_WINDOW ? RACENET_SYNC_FAST_MS : RACENET_SYNC_INTERVAL_MS;
+    if (syncSentUs != 0 && nowUs - syncSentUs < (uint64_t)intervalMs * 1000) return;
+    racenet_sync_t request;
+    memset(&request, 0, sizeof(request));
+    racenetInitHeader(&request.header, RACENET_SYNC, nodeMac, boot);
+    request.originUs = nowUs;
+    uint8_t buf[RACENET_MAX_PACKET];
+    memcpy(buf, &request, sizeof(request));
+    transport->send(&subscribers[masterSlot].addr, buf, racenetSeal(buf, sizeof(request)));
+    syncSentUs = nowUs;
+    syncOriginUs = nowUs;  // 上一个请求没回复就作废，迟到的回复不再采用
+}
+
+void RaceNode::handleSyncReply(const racenet_addr_t *from, const racenet_sync_t *reply, uint64_t nowUs) {
+    if (masterSlot < 0 || syncOriginUs == 0 || reply->originUs != syncOriginUs) return;
+    if (!sameAddr(from, &subscribers[masterSlot].addr) ||
+        memcmp(reply->header.mac, masterMac, sizeof(masterMac)) != 0)
+        return;
+    syncOriginUs = 0;
+    clock.addSample(reply->originUs, reply->receiveUs, reply->transmitUs, nowUs);
+}
+
+void RaceNode::service(uint64_t nowUs) {
+    for (uint8_t i = 0; i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs != 0 && nowUs > subscribers[i].expiresUs) {
+            subscribers[i].expiresUs = 0;
+        }
+    }
+    selectMaster(nowUs);
+    if (nowUs - heartbeatUs < (uint64_t)RACENET_HEARTBEAT_MS * 1000 && heartbeatUs != 0) return;
+    heartbeatUs = nowUs;
+    sendHello(&localAddr, nowUs);
+    for (uint8_t i = 0; i < RACENET_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].expiresUs != 0) sendHello(&subscribers[i].addr, nowUs);
+    }
+}
+
+// ---------------------------------------------------------------- 汇总方
+
+void RaceAggregator::begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId) {
+    transport = raceTransport;
+    memcpy(selfMac, mac, sizeof(selfMac));
+    boot = bootId;
+    peerCount = 0;
+    lapCount = 0;
+}
+
+racenet_peer_t *RaceAggregator::findPeer(const uint8_t *mac) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (memcmp(peers[i].mac, mac, sizeof(peers[i].mac)) == 0) return &peers[i];
+    }
+    return nullptr;
+}
+
+void RaceAggregator::setLapSink(racenet_lap_sink_fn sink, void *ctx) {
+    lapSink = sink;
+    lapSinkCtx = ctx;
+}
+
+bool RaceAggregator::hasGaps() {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (peers[i].ackSeq < peers[i].lastSeq) return true;
+    }
+    return false;
+}
+
+bool RaceAggregator::isOnline(uint8_t index, uint64_t nowUs) {
+    if (index >= peerCount) return false;
+    return nowUs - peers[index].lastSeenUs < (uint64_t)RACENET_PEER_TIMEOUT_MS * 1000;
+}
+
+void RaceAggregator::sendDiscover(const racenet_addr_t *to) {
+    if (transport == nullptr) return;
+    uint8_t buf[RACENET_MAX_PACKET];
+    racenet_header_t header;
+    racenetInitHeader(&header, RACENET_DISCOVER, selfMac, boot);
+    memcpy(buf, &header, sizeof(header));
+    const uint16_t len = racenetSeal(buf, sizeof(header));
+    if (to == nullptr) {
+        transport->broadcast(RACENET_PORT, buf, len);
+    } else {
+        transport->send(to, buf, len);
+    }
+}
+
+void RaceAggregator::addPeer(const racenet_addr_t *addr, uint64_t nowUs) {
+    (void)nowUs;
+    for (uint8_t i = 0; i < knownCount; i++) {
+        if (sameAddr(&known[i], addr)) return;
+    }
+    if (knownCount < RACENET_MAX_PEERS) known[knownCount++] = *addr;
+    sendDiscover(addr);
+}
+
+// 任何节点都可以拿汇总方的时钟做参照，不要求已订阅
+void RaceAggregator::replySync(const racenet_addr_t *from, const racenet_sync_t *request, uint64_t nowUs) {
+    if (transport == nullptr || from->ip == 0) return;
+    racenet_sync_t reply = *request;
+    racenetInitHeader(&reply.header, RACENET_SYNC_REPLY, selfMac, boot);
+    reply.receiveUs = nowUs;
+    reply.transmitUs = clock != nullptr ? clock() : nowUs;
+    uint8_t buf[RACENET_MAX_PACKET];
+    memcpy(buf, &reply, sizeof(reply));
+    transport->send(from, buf, racenetSeal(buf, sizeof(reply)));
+    syncReplies++;
+}
+
+bool RaceAggregator::hasPeerAt(const racenet_addr_t *addr) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (sameAddr(&peers[i].addr, addr)) return true;
+    }
+    return false;
+}
+
+void RaceAggregator::subscribe(racenet_peer_t *peer, uint64_t nowUs) {
+    peer->subscribedUs = nowUs;
+    if (peer->addr.ip == 0 || transport == nullptr) return;  // 本机节点直接投递，不需要订阅
+    racenet_subscribe_t sub;
+    racenetInitHeader(&sub.header, RACENET_SUBSCRIBE, selfMac, boot);
+    sub.nodeBoot = peer->boot;
+    sub.ackSeq = peer->ackSeq;
+    uint8_t buf[RACENET_MAX_PACKET];
+    memcpy(buf, &sub, sizeof(sub));
+    transport->send(&peer->addr, buf, racenetSeal(buf, sizeof(sub)));
+}
+
+// ackSeq之前未收到的序号已不在节点历史中，计为丢失
+void RaceAggregator::skipTo(racenet_peer_t *peer, uint32_t ackSeq) {
+    while (peer->ackSeq < ackSeq) {
+        if (!(peer->pendingMask & 1)) peer->lost++;
+        peer->pendingMask >>= 1;
+        peer->ackSeq++;
+    }
+    while (peer->pendingMask & 1) {
+        peer->pendingMask >>= 1;
+        peer->ackSeq++;
+    }
+}
+
+// 序号去重：ackSeq之后32个序号内用位图记录，返回false表示重复
+bool RaceAggregator::acceptSeq(racenet_peer_t *peer, uint32_t eventSeq) {
+    if (eventSeq <= peer->ackSeq) return false;
+    if (eventSeq - peer->ackSeq > 32) skipTo(peer, eventSeq - 32);
+    const uint32_t bit = 1UL << (eventSeq - peer->ackSeq - 1);
+    if (peer->pendingMask & bit) return false;
+    peer->pendingMask |= bit;
+    skipTo(peer, peer->ackSeq);
+    return true;
+}
+
+void RaceAggregator::handleHello(const racenet_addr_t *from, const racenet_hello_t *hello, uint64_t nowUs) {
+    // 本机节点只经setLocalAggregator()投递，广播回环收到的自己的包忽略
+    if (from->ip != 0 && memcmp(hello->header.mac, selfMac, sizeof(selfMac)) == 0) return;
+    racenet_peer_t *peer = findPeer(hello->header.mac);
+    const bool found = peer != nullptr;
+    if (!found) {
+        if (peerCount >= RACENET_MAX_PEERS) return;
+        peer = &peers[peerCount];
+        memset(peer, 0, sizeof(*peer));
+        memcpy(peer->mac, hello->header.mac, sizeof(peer->mac));
+        peer->uncertaintyUs = RACENET_UNSYNCED;
+        peerCount = peerCount + 1;
+    }
+    // 新节点或节点重启：从历史中最早的序号开始收，之前的不算丢失
+    if (!found || peer->boot != hello->header.boot) {
+        peer->boot = hello->header.boot;
+        peer->ackSeq = hello->oldestSeq > 0 ? hello->oldestSeq - 1 : 0;
+        peer->pendingMask = 0;
+    }
+    peer->addr = *from;
+    copyField(peer->host, hello->host, sizeof(peer->host));
+    copyField(peer->product, hello->product, sizeof(peer->product));
+    copyField(peer->pilot, hello->pilot, sizeof(peer->pilot));
+    peer->frequency = hello->frequency;
+    peer->running = hello->running;
+    peer->sector = hello->sector;
+    peer->sectorCount = hello->sectorCount;
+    peer->lastSeq = hello->lastSeq;
+    peer->lastSeenUs = nowUs;
+    peer->uncertaintyUs = memcmp(hello->masterMac, selfMac, sizeof(selfMac)) == 0 ? hello->uncertaintyUs : RACENET_UNSYNCED;
+    if (hello->oldestSeq > 0) skipTo(peer, hello->oldestSeq - 1);
+    // 新节点或有缺失时立即订阅，不等续订周期
+    if (active && (peer->subscribedUs == 0 || peer->ackSeq < peer->lastSeq)) {
+        if (nowUs - peer->subscribedUs >= (uint64_t)RACENET_RESEND_GUARD_MS * 1000) subscribe(peer, nowUs);
+    }
+}
+
+void RaceAggregator::insertLap(const racenet_lap_t *lap) {
+    if (lapCount == RACENET_MAX_LAPS) {
+        if (lap->timeUs < laps[0].timeUs) {
+            lapsDropped++;
+            return;
+        }
+        memmove(&laps[0], &laps[1], sizeof(laps[0]) * (RACENET_MAX_LAPS - 1));
+        lapCount = lapCount - 1;
+        lapsDropped++;
+    }
+    uint16_t pos = lapCount;
+    while (pos > 0 && laps[pos - 1].timeUs > lap->timeUs) pos--;
+    if (pos < lapCount) {
+        memmove(&laps[pos + 1], &laps[pos], sizeof(laps[0]) * (lapCount - pos));
+        orderFixes++;
+    }
+    laps[pos] = *lap;
+    lapCount = lapCount + 1;
+}
+
+void RaceAggregator::handleEvent(const racenet_addr_t *from, const racenet_event_t *event, uint64_t nowUs) {
+    if (from->ip != 0 && memcmp(event->header.mac, selfMac, sizeof(selfMac)) == 0) return;
+    racenet_peer_t *peer = findPeer(event->header.mac);
+    // 还没收到HELLO的节点先不收事件，订阅后节点会重发
+    if (peer == nullptr) return;
+    if (peer->boot != event->header.boot) return;
+    peer->addr = *from;
+    peer->lastSeenUs = nowUs;
+    if (!acceptSeq(peer, event->seq)) {
+        peer->duplicates++;
+        return;
+    }
+    peer->events++;
+    if (event->event == RACENET_EVENT_START) peer->running = true;
+    if (event->event == RACENET_EVENT_STOP) peer->running = false;
+    if (event->event != RACENET_EVENT_LAP) return;
+
+    racenet_lap_t lap;
+    lap.peer = peer - peers;
+    lap.channel = event->channel;
+    lap.frequency = event->frequency;
+    lap.lapNumber = event->lapNumber;
+    lap.lapTimeUs = event->lapTimeUs;
+    lap.sector = event->sector;
+    lap.sectorCount = event->sectorCount;
+    if (event->uncertaintyUs != RACENET_UNSYNCED && memcmp(event->masterMac, selfMac, sizeof(selfMac)) == 0) {
+        lap.timeUs = event->sharedUs;
+        lap.uncertaintyUs = event->uncertaintyUs;
+    } else {
+        lap.timeUs = nowUs - (event->sendUs - event->eventUs);
+        lap.uncertaintyUs = RACENET_UNSYNCED;
+    }
+    insertLap(&lap);
+    if (lapSink != nullptr) lapSink(&lap, lapSinkCtx);
+}
+
+bool RaceAggregator::handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs) {
+    const uint8_t type = racenetCheck(buf, len);
+    if (type == RACENET_HELLO) {
+        racenet_hello_t hello;
+        memcpy(&hello, buf, sizeof(hello));
+        handleHello(from, &hello, nowUs);
+        return true;
+    }
+    if (type == RACENET_EVENT) {
+        racenet_event_t event;
+        memcpy(&event, buf, sizeof(event));
+        handleEvent(from, &event, nowUs);
+        return true;
+    }
+    if (type == RACENET_SYNC) {
+        racenet_sync_t request;
+        memcpy(&request, buf, sizeof(request));
+        replySync(from, &request, nowUs);
+        return true;
+    }
+    return false;
+}
+
+void RaceAggregator::service(uint64_t nowUs) {
+    if (clearRequested) {
+        clearRequested = false;
+        clearLaps();
+    }
+    if (activeRequested) {
+        activeRequested = false;
+        activeUntilUs = nowUs + (uint64_t)RACENET_ACTIVE_MS * 1000;
+    }
+    active = alwaysActive || nowUs < activeUntilUs;
+    if (!active) {
+        discoverSent = false;
+        return;
+    }
+    if (!discoverSent || nowUs - discoverUs >= (uint64_t)RACENET_DISCOVER_MS * 1000) {
+        discoverUs = nowUs;
+        discoverSent = true;
+        sendDiscover(nullptr);
+    }
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (nowUs - peers[i].subscribedUs >= (uint64_t)RACENET_RENEW_MS * 1000) subscribe(&peers[i], nowUs);
+    }
+    // 已知地址但还没回复的节点（可能尚未启动）随续订周期重试
+    if (nowUs - knownRetryUs >= (uint64_t)RACENET_RENEW_MS * 1000) {
+        knownRetryUs = nowUs;
+        for (uint8_t i = 0; i < knownCount; i++) {
+            if (!hasPeerAt(&known[i])) sendDiscover(&known[i]);
+        }
+    }
+}
+
+void RaceAggregator::clearLaps() {
+    lapCount = 0;
+    lapsDropped = 0;
+    orderFixes = 0;
+}
@@ -0,0 +1,463 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clocksync.h"
+#include "spsc_queue.h"
+
+/**
+ * 节点间的UDP计圈协议，用于把多个节点的圈速汇总到一处（某个节点或主机程序）。
+ *
+ * 汇总方发现节点后发SUBSCRIBE订阅，节点此后把每个计时事件立即以EVENT发给所有订阅者，
+ * 并每RACENET_HEARTBEAT_MS发一次HELLO作为心跳。订阅有租期，汇总方每RACENET_RENEW_MS续订一次，
+ * 续订中带上已连续收到的最大序号，节点据此重发历史中更新的事件：丢包在一个续订周期内补齐，
+ * 不需要逐包确认，汇总方重启后也能补回最近RACENET_HISTORY个事件。
+ *
+ * 发现：汇总方定期向本网段广播DISCOVER，节点回复HELLO；设备上另外通过mDNS查询_qylap._udp。
+ * 时钟：汇总方同时是时钟主站。节点向最早订阅它的汇总方发SYNC测量往返，用ClockSync跟踪偏差和漂移，
+ * 事件中带上换算到主站时钟的时刻和误差上界，汇总方据此直接比较不同节点的过门时刻。
+ * 分段：HELLO和EVENT带上节点在赛道上的门序号，汇总方把同一频率各门的过门交给SectorCoordinator排成分段。
+ * 所有字段为小端字节序（ESP32与x86/ARM主机相同），每个包末尾是前面所有字节的CRC-32。
+ */
+#ifndef RACENET_PORT
+#define RACENET_PORT 7370
+#endif
+#define RACENET_MAGIC 0x4C51  // "QL"
+#define RACENET_VERSION 3
+#define RACENET_MAX_PACKET 128
+#define RACENET_HOST_LEN 16
+#define RACENET_NAME_LEN 21  // 与配置中的飞手名长度一致
+#define RACENET_HISTORY 32   // 节点保留的最近事件数，用于重发
+#define RACENET_MAX_SUBSCRIBERS 4
+#define RACENET_LEASE_MS 5000
+#define RACENET_RENEW_MS 1000
+#define RACENET_HEARTBEAT_MS 1000
+#define RACENET_RESEND_GUARD_MS 200  // 刚发出的事件不因续订重发，避免与在途的包重复
+#define RACENET_DISCOVER_MS 5000
+#define RACENET_PEER_TIMEOUT_MS 5000  // 超过该时间没有HELLO视为离线
+#define RACENET_ACTIVE_MS 120000      // 设备上最后一次请求/nodes或/race后继续汇总的时间
+#define RACENET_SYNC_FAST_MS 100      // 刚开始或换了主站时的SYNC间隔，尽快填满过滤窗口
+#define RACENET_SYNC_INTERVAL_MS 1000
+#define RACENET_UNSYNCED 0xFFFFFFFFUL  // uncertaintyUs取该值表示sharedUs无效
+#ifndef RACENET_MAX_PEERS
+#define RACENET_MAX_PEERS 16
+#endif
+#ifndef RACENET_MAX_LAPS
+#define RACENET_MAX_LAPS 256
+#endif
+
+typedef enum {
+    RACENET_DISCOVER = 1,
+    RACENET_HELLO = 2,
+    RACENET_SUBSCRIBE = 3,
+    RACENET_EVENT = 4,
+    RACENET_SYNC = 5,
+    RACENET_SYNC_REPLY = 6
+} racenet_type_e;
+
+// 与laptimer_event_e取值相同
+typedef enum {
+    RACENET_EVENT_START,
+    RACENET_EVENT_LAP,
+    RACENET_EVENT_STOP
+} racenet_event_e;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint8_t mac[6];  // 发送方ID
+    uint32_t boot;   // 发送方每次启动随机生成，变化表示事件序号重新开始
+} racenet_header_t;
+
+typedef struct __attribute__((packed)) {
+    racenet_header_t header;
+    uint64_t nowUs;      // 发送时刻（节点时钟）
+    uint32_t lastSeq;    // 最新事件序号，0表示还没有事件
+    uint32_t oldestSeq;  // 历史中最早可重发的序号
+    uint16_t frequency;
+    uint8_t running;
+    char host[RACENET_HOST_LEN];
+    char product[RACENET_HOST_LEN];
+    char pilot[RACENET_NAME_LEN];
+    uint8_t masterMac[6];    // 节点当前跟随的时钟主站
+    uint32_t uncertaintyUs;  // 此刻的同步误差上界，RACENET_UNSYNCED表示未同步
+    uint8_t sector;          // 本节点是第几个门，0为起终点
+    uint8_t sectorCount;     // 全程的门数，小于2表示不参与分段
+} racenet_hello_t;
+
+typedef struct __attribute__((packed)) {
+    racenet_header_t header;
+    uint32_t nodeBoot;  // 汇总方所知的节点boot，与节点当前的不同时ackSeq视为0
+    uint32_t ackSeq;    // 已连续收到的最大序号
+} racenet_subscribe_t;
+
+typedef struct __attribute__((packed)) {
+    racenet_header_t header;
+    uint32_t seq;  // 从1开始
+    uint8_t event;
+    uint8_t channel;  // 多频扫描时的频率序号
+    uint16_t frequency;
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t eventUs;  // 事件时刻（节点时钟）
+    uint64_t sendUs;   // 本次发送时刻（节点时钟），重发时更新
+    uint8_t masterMac[6];    // sharedUs所用的时钟主站
+    uint64_t sharedUs;       // 事件时刻（主站时钟），发送时按当前的同步结果换算
+    uint32_t uncertaintyUs;  // sharedUs的误差上界，RACENET_UNSYNCED表示未同步
+    uint8_t sector;          // 事件发生时节点的门序号，与HELLO相同
+    uint8_t sectorCount;
+} racenet_event_t;
+
+// 请求时只填originUs，主站原样带回并填上收到和回复的时刻
+typedef struct __attribute__((packed)) {
+    racenet_header_t header;
+    uint64_t originUs;    // t1，节点发出请求的时刻（节点时钟）
+    uint64_t receiveUs;   // t2，主站收到请求的时刻
+    uint64_t transmitUs;  // t3，主站回复的时刻
+} racenet_sync_t;
+
+typedef struct {
+    uint32_t ip;  // 网络字节序，与lwIP/BSD socket相同；0表示本机
+    uint16_t port;
+} racenet_addr_t;
+
+void racenetInitHeader(racenet_header_t *header, uint8_t type, const uint8_t *mac, uint32_t boot);
+// 在len字节后追加CRC，返回总长度；buf至少要有len + 4字节
+uint16_t racenetSeal(uint8_t *buf, uint16_t len);
+// 校验长度、magic、版本和CRC，返回包类型，无效时返回0
+uint8_t racenetCheck(const uint8_t *buf, uint16_t len);
+void racenetFormatIp(uint32_t ip, char *buf, size_t size);
+void racenetFormatMac(const uint8_t *mac, char *buf, size_t size);
+// ESP-NOW和回环传输按MAC寻址：MAC前4字节按原顺序放进ip，后2字节放进port，协议层把地址原样带回即可回复。
+// 真实MAC的前4字节不会全为0，不会与表示本机的ip==0冲突
+void racenetAddrFromMac(const uint8_t *mac, racenet_addr_t *addr);
+void racenetAddrToMac(const racenet_addr_t *addr, uint8_t *mac);
+
+/**
+ * 收发接口：设备上为WiFiUDP或ESP-NOW，主机上为BSD socket或进程内回环。
+ */
+class RaceTransport {
+   public:
+    virtual ~RaceTransport() {}
+    virtual bool begin(uint16_t port) = 0;
+    virtual bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) = 0;
+    // 发往本网段的广播地址
+    virtual bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) = 0;
+    // 非阻塞，没有数据时返回0
+    virtual uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) = 0;
+};
+
+class WiFiUdpRaceTransport : public RaceTransport {
+   public:
+    bool begin(uint16_t port) override;
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override;
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override;
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override;
+};
+
+class PosixUdpRaceTransport : public RaceTransport {
+   public:
+    ~PosixUdpRaceTransport();
+    bool begin(uint16_t port) override;
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override;
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override;
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override;
+
+   private:
+    int fd = -1;
+};
+
+#if defined(ARDUINO)
+/**
+ * ESP-NOW传输：没有路由器时各节点各开一个QYLPT_xxxx软AP，手机只能连其中一个。
+ * ESP-NOW不需要关联，节点直接把事件和心跳推给手机所连的节点（汇总方），协议与UDP完全相同。
+ * 各节点须在同一个WiFi信道上：软AP默认都在信道1，连同一个路由器时即路由器的信道。
+ * 收包回调在WiFi任务中执行，经SPSC队列交给parallelTask；单播前须登记对端，
+ * 登记满RACENET_ESPNOW_PEERS个时顶替最早登记的（ESP-NOW不加密时最多20个）。
+ */
+#define RACENET_ESPNOW_QUEUE 16
+#define RACENET_ESPNOW_PEERS 16
+
+class EspNowRaceTransport : public RaceTransport {
+   public:
+    bool begin(uint16_t port) override;  // ESP-NOW没有端口，port不用
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override;
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override;
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override;
+    uint32_t getDropped();  // 接收队列满丢弃的帧
+    uint32_t getSendFailures() { return sendFailures; }
+
+   private:
+    uint8_t peers[RACENET_ESPNOW_PEERS][6];
+    uint8_t peerCount = 0;
+    uint8_t nextPeer = 0;
+    uint32_t sendFailures = 0;
+    bool addPeer(const uint8_t *mac);
+};
+#endif
+
+/**
+ * 进程内的回环传输，按MAC寻址，用来在主机上跑ESP-NOW场景下的协议和重发逻辑：
+ * 所有端点挂在同一个RaceLoopbackBus上，send()直接放进对方的接收队列，可按比例随机丢帧。
+ * 只能在单个线程中使用。
+ */
+#define RACENET_LOOPBACK_ENDPOINTS 20
+#define RACENET_LOOPBACK_QUEUE 64
+
+class LoopbackRaceTransport;
+
+class RaceLoopbackBus {
+   public:
+    void setLoss(uint8_t percent, uint32_t seed);
+    uint32_t getDelivered() { return delivered; }
+    uint32_t getDropped() { return dropped; }
+
+   private:
+    friend class LoopbackRaceTransport;
+    LoopbackRaceTransport *endpoints[RACENET_LOOPBACK_ENDPOINTS];
+    uint8_t endpointCount = 0;
+    uint8_t lossPercent = 0;
+    uint32_t rng = 1;
+    uint32_t delivered = 0;
+    uint32_t dropped = 0;
+    bool attach(LoopbackRaceTransport *endpoint);
+    bool deliver(LoopbackRaceTransport *to, const racenet_addr_t *from, const uint8_t *buf, uint16_t len);
+};
+
+class LoopbackRaceTransport : public RaceTransport {
+   public:
+    LoopbackRaceTransport(RaceLoopbackBus *loopbackBus, const uint8_t *mac);
+    bool begin(uint16_t port) override;  // 挂到总线上，port不用
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override;
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override;
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override;
+    const racenet_addr_t *getAddr() { return &addr; }
+    uint32_t getDropped() { return queue.getDrops(); }
+
+   private:
+    friend class RaceLoopbackBus;
+    typedef struct {
+        racenet_addr_t from;
+        uint16_t len;
+        uint8_t data[RACENET_MAX_PACKET];
+    } frame_t;
+
+    RaceLoopbackBus *bus;
+    racenet_addr_t addr;
+    SpscQueue<frame_t, RACENET_LOOPBACK_QUEUE> queue;
+};
+
+class RaceAggregator;
+
+typedef struct {
+    char host[RACENET_HOST_LEN];
+    char product[RACENET_HOST_LEN];
+    char pilot[RACENET_NAME_LEN];
+    uint16_t frequency;
+    bool running;
+    uint8_t sector;
+    uint8_t sectorCount;
+} racenet_node_info_t;
+
+/**
+ * 节点端：记录计时事件并推送给订阅者。pushEvent()、handlePacket()和service()须在同一任务中调用。
+ */
+class RaceNode {
+   public:
+    void begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId);
+    // 网络就绪前transport可以为空，事件照常进入历史
+    void setTransport(RaceTransport *raceTransport) { transport = raceTransport; }
+    // 本机同时是汇总方时，事件和心跳直接交给它，不经过网络
+    void setLocalAggregator(RaceAggregator *aggregator) { local = aggregator; }
+    racenet_node_info_t *getInfo() { return &info; }
+
+    void pushEvent(uint8_t event, uint8_t channel, uint16_t frequency, uint32_t lapNumber, uint32_t lapTimeUs,
+                   uint64_t eventUs, uint64_t nowUs);
+    // 处理DISCOVER和SUBSCRIBE，其他包返回false
+    bool handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs);
+    void service(uint64_t nowUs);
+
+    uint8_t getSubscriberCount();
+    uint32_t getLastSeq() { return seq; }
+    uint32_t getSent() { return sent; }
+    uint32_t getResent() { return resent; }
+
+    // 本机汇总时自己就是主站；否则跟随最早订阅的汇总方
+    bool isSelfMaster() { return selfMaster; }
+    bool hasMaster() { return masterSlot >= 0; }
+    bool isSynced(uint64_t nowUs) { return selfMaster || (masterSlot >= 0 && clock.isSynced(nowUs)); }
+    ClockSync *getClock() { return &clock; }
+    // 本地时刻换算到主站时钟，未同步时返回false
+    bool toShared(uint64_t localUs, uint64_t nowUs, uint64_t *sharedUs, uint32_t *uncertaintyUs);
+
+   private:
+    typedef struct {
+        racenet_addr_t addr;
+        uint8_t mac[6];
+        uint64_t sinceUs;  // 首次订阅的时刻，最早的一个作为时钟主站
+        uint64_t expiresUs;
+    } subscriber_t;
+
+    RaceTransport *transport = nullptr;
+    RaceAggregator *local = nullptr;
+    uint8_t nodeMac[6];
+    uint32_t boot = 0;
+    racenet_node_info_t info;
+    subscriber_t subscribers[RACENET_MAX_SUBSCRIBERS];
+    racenet_event_t history[RACENET_HISTORY];
+    uint32_t seq = 0;
+    uint64_t heartbeatUs = 0;
+    uint32_t sent = 0;
+    uint32_t resent = 0;
+    ClockSync clock;
+    bool selfMaster = false;
+    int8_t masterSlot = -1;
+    uint8_t masterMac[6];
+    uint64_t syncSentUs = 0;
+    uint64_t syncOriginUs = 0;  // 在途SYNC请求的t1，回复须原样带回
+
+    uint32_t oldestSeq() { return seq > RACENET_HISTORY ? seq - RACENET_HISTORY + 1 : 1; }
+    void sendEvent(racenet_event_t *event, const racenet_addr_t *to, uint64_t nowUs);
+    void sendHello(const racenet_addr_t *to, uint64_t nowUs);
+    void resendAfter(const racenet_addr_t *to, uint32_t ackSeq, uint64_t nowUs);
+    void selectMaster(uint64_t nowUs);
+    void handleSyncReply(const racenet_addr_t *from, const racenet_sync_t *reply, uint64_t nowUs);
+};
+
+typedef struct {
+    uint8_t mac[6];
+    racenet_addr_t addr;
+    uint32_t boot;
+    char host[RACENET_HOST_LEN];
+    char product[RACENET_HOST_LEN];
+    char pilot[RACENET_NAME_LEN];
+    uint16_t frequency;
+    bool running;
+    uint64_t lastSeenUs;
+    uint64_t subscribedUs;  // 最近一次发送SUBSCRIBE的时刻
+    uint32_t ackSeq;        // 已连续收到的最大序号
+    uint32_t pendingMask;   // ackSeq之后已收到的序号，第0位为ackSeq + 1
+    uint32_t lastSeq;       // 节点心跳报告的最新序号
+    uint32_t events;
+    uint32_t duplicates;
+    uint32_t lost;
+    uint32_t uncertaintyUs;  // 心跳报告的相对本汇总方的同步误差上界，RACENET_UNSYNCED表示未同步到本机
+    uint8_t sector;
+    uint8_t sectorCount;
+} racenet_peer_t;
+
+typedef struct {
+    uint8_t peer;
+    uint8_t channel;
+    uint16_t frequency;
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t timeUs;         // 换算到汇总方时钟的过门时刻
+    uint32_t uncertaintyUs;  // 节点报告的同步误差上界，RACENET_UNSYNCED表示按发送延迟估算
+    uint8_t sector;          // 过门的门序号和全程门数，sectorCount < 2表示不参与分段
+    uint8_t sectorCount;
+} racenet_lap_t;
+
+// 每收到一圈回调一次，在handlePacket()所在任务中执行
+typedef void (*racenet_lap_sink_fn)(const racenet_lap_t *lap, void *ctx);
+
+/**
+ * 汇总方：发现节点、维持订阅，把各节点的圈速按过门时刻合并。
+ *
+ * 已与本汇总方同步的节点，过门时刻直接取事件中的主站时刻；其他节点（刚启动、跟随别的汇总方）
+ * 按 接收时刻 - (发送时刻 - 事件时刻) 换算到汇总方时钟，误差为单程网络延迟（局域网内通常几毫秒）。
+ * 设备上的HTTP处理函数读取节点表和圈速时不加锁，插入过程中读到的可能是前后两个状态之一，下一次请求即恢复一致。
+ */
+class RaceAggregator {
+   public:
+    void begin(RaceTransport *raceTransport, const uint8_t *mac, uint32_t bootId);
+    void setTransport(RaceTransport *raceTransport) { transport = raceTransport; }
+    // 回复SYNC时读取发送时刻t3，不设置时用收到请求的时刻代替
+    void setClock(uint64_t (*clockUs)()) { clock = clockUs; }
+    // 设为常驻汇总方（主机程序）；设备上只在页面请求后的RACENET_ACTIVE_MS内汇总
+    void setAlwaysActive(bool always) { alwaysActive = always; }
+    // 可在其他任务中调用，下一次service()时生效
+    void requestActive() { activeRequested = true; }
+    bool isActive() { return active; }
+
+    // 已知地址的节点（mDNS结果或命令行），先单播DISCOVER，收到HELLO后订阅
+    void addPeer(const racenet_addr_t *addr, uint64_t nowUs);
+    // 处理HELLO、EVENT，并以本机时钟回复SYNC，其他包返回false
+    bool handlePacket(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs);
+    void service(uint64_t nowUs);
+    void clearLaps();
+    // 其他任务中清空圈速用这个，下一次service()时执行
+    void requestClear() { clearRequested = true; }
+    void setLapSink(racenet_lap_sink_fn sink, void *ctx);
+
+    uint8_t getPeerCount() { return peerCount; }
+    const racenet_peer_t *getPeer(uint8_t index) { return index < peerCount ? &peers[index] : nullptr; }
+    bool isOnline(uint8_t index, uint64_t nowUs);
+    // 有节点的事件还没收齐（等重发中）
+    bool hasGaps();
+    // 按过门时刻升序，超过RACENET_MAX_LAPS时丢弃最早的
+    uint16_t getLapCount() { return lapCount; }
+    const racenet_lap_t *getLap(uint16_t index) { return index < lapCount ? &laps[index] : nullptr; }
+    uint32_t getLapsDropped() { return lapsDropped; }
+    uint32_t getOrderFixes() { return orderFixes; }
+    uint32_t getSyncReplies() { return syncReplies; }
+
+   private:
+    RaceTransport *transport = nullptr;
+    uint64_t (*clock)() = nullptr;
+    uint8_t selfMac[6];
+    uint32_t boot = 0;
+    bool alwaysActive = false;
+    volatile bool activeRequested = false;
+    volatile bool clearRequested = false;
+    bool active = false;
+    uint64_t activeUntilUs = 0;
+    uint64_t discoverUs = 0;
+    bool discoverSent = false;
+
+    racenet_addr_t known[RACENET_MAX_PEERS];  // addPeer()给出的地址
+    uint8_t knownCount = 0;
+    uint64_t knownRetryUs = 0;
+    racenet_peer_t peers[RACENET_MAX_PEERS];
+    volatile uint8_t peerCount = 0;
+    racenet_lap_t laps[RACENET_MAX_LAPS];
+    volatile uint16_t lapCount = 0;
+    uint32_t lapsDropped = 0;
+    uint32_t orderFixes = 0;  // 晚到（重发或网络延迟）而插入到中间的圈数
+    uint32_t syncReplies = 0;
+    racenet_lap_sink_fn lapSink = nullptr;
+    void *lapSinkCtx = nullptr;
+
+    racenet_peer_t *findPeer(const uint8_t *mac);
+    bool hasPeerAt(const racenet_addr_t *addr);
+    void handleHello(const racenet_addr_t *from, const racenet_hello_t *hello, uint64_t nowUs);
+    void handleEvent(const racenet_addr_t *from, const racenet_event_t *event, uint64_t nowUs);
+    bool acceptSeq(racenet_peer_t *peer, uint32_t eventSeq);
+    void skipTo(racenet_peer_t *peer, uint32_t ackSeq);
+    void insertLap(const racenet_lap_t *lap);
+    void subscribe(racenet_peer_t *peer, uint64_t nowUs);
+    void sendDiscover(const racenet_addr_t *to);
+    void replySync(const racenet_addr_t *from, const racenet_sync_t *request, uint64_t nowUs);
+};
+
+#if defined(ARDUINO)
+/**
+ * 设备上的mDNS发现：后台任务定期查询_qylap._udp。MDNS.queryService()会阻塞数秒，
+ * 不能放在parallelTask中（查询本身约3秒）；查到的地址经SPSC队列交给parallelTask调用addPeer()。
+ */
+#define RACENET_MDNS_INTERVAL_MS 30000
+
+class MdnsPeerFinder {
+   public:
+    bool begin();
+    void setEnabled(bool enable) { enabled = enable; }
+    bool poll(racenet_addr_t *addr) { return found.pop(addr); }
+
+   private:
+    static void task(void *arg);
+    volatile bool enabled = false;
+    SpscQueue<racenet_addr_t, 16> found;
+};
+#endif
@@ -0,0 +1,154 @@
+#if defined(ARDUINO)
+
+#include <ESPmDNS.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+#include "debug.h"
+#include "racenet.h"
+
+// 设备上只有一个计圈UDP端口，套接字放在这里，头文件不必引入WiFiUdp
+static WiFiUDP raceUdp;
+
+bool WiFiUdpRaceTransport::begin(uint16_t port) {
+    if (!raceUdp.begin(port)) {
+        DEBUG("RaceNet: cannot bind UDP port %u\n", port);
+        return false;
+    }
+    return true;
+}
+
+bool WiFiUdpRaceTransport::send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) {
+    if (!raceUdp.beginPacket(IPAddress(to->ip), to->port)) return false;
+    raceUdp.write(buf, len);
+    return raceUdp.endPacket() == 1;
+}
+
+// 软AP模式下没有STA地址，广播到软AP的网段
+bool WiFiUdpRaceTransport::broadcast(uint16_t port, const uint8_t *buf, uint16_t len) {
+    IPAddress target = WiFi.getMode() == WIFI_AP ? WiFi.softAPBroadcastIP() : WiFi.broadcastIP();
+    if (!raceUdp.beginPacket(target, port)) return false;
+    raceUdp.write(buf, len);
+    return raceUdp.endPacket() == 1;
+}
+
+uint16_t WiFiUdpRaceTransport::receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) {
+    const int n = raceUdp.parsePacket();
+    if (n <= 0) return 0;
+    if (n > size) {
+        raceUdp.flush();
+        return 0;
+    }
+    from->ip = (uint32_t)raceUdp.remoteIP();
+    from->port = raceUdp.remotePort();
+    return raceUdp.read(buf, size);
+}
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t len;
+    uint8_t data[RACENET_MAX_PACKET];
+} espnow_frame_t;
+
+// ESP-NOW的收包回调只能是普通函数，队列也放在这里：WiFi任务push，parallelTask在receive()中pop
+static SpscQueue<espnow_frame_t, RACENET_ESPNOW_QUEUE> espNowFrames;
+static const uint8_t espNowBroadcastMac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static void espNowReceive(const uint8_t *mac, const uint8_t *data, int len) {
+    if (len <= 0 || len > RACENET_MAX_PACKET) return;
+    espnow_frame_t frame;
+    memcpy(frame.mac, mac, sizeof(frame.mac));
+    frame.len = (uint8_t)len;
+    memcpy(frame.data, data, len);
+    espNowFrames.push(frame);
+}
+
+bool EspNowRaceTransport::begin(uint16_t port) {
+    (void)port;
+    if (esp_now_init() != ESP_OK) {
+        DEBUG("RaceNet: ESP-NOW init failed\n");
+        return false;
+    }
+    esp_now_register_recv_cb(espNowReceive);
+    uint8_t channel;
+    wifi_second_chan_t second;
+    esp_wifi_get_channel(&channel, &second);
+    DEBUG("RaceNet: ESP-NOW on channel %u\n", channel);
+    return true;
+}
+
+bool EspNowRaceTransport::addPeer(const uint8_t *mac) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (memcmp(peers[i], mac, 6) == 0) return true;
+    }
+    uint8_t slot = peerCount;
+    if (peerCount >= RACENET_ESPNOW_PEERS) {
+        slot = nextPeer;
+        nextPeer = (nextPeer + 1) % RACENET_ESPNOW_PEERS;
+        esp_now_del_peer(peers[slot]);
+    }
+    esp_now_peer_info_t peer;
+    memset(&peer, 0, sizeof(peer));
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = 0;  // 跟随当前信道
+    peer.ifidx = WiFi.getMode() == WIFI_AP ? WIFI_IF_AP : WIFI_IF_STA;
+    peer.encrypt = false;
+    if (esp_now_add_peer(&peer) != ESP_OK) return false;
+    memcpy(peers[slot], mac, 6);
+    if (slot == peerCount) peerCount++;
+    return true;
+}
+
+bool EspNowRaceTransport::send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) {
+    uint8_t mac[6];
+    racenetAddrToMac(to, mac);
+    if (len > ESP_NOW_MAX_DATA_LEN || !addPeer(mac) || esp_now_send(mac, buf, len) != ESP_OK) {
+        sendFailures++;
+        return false;
+    }
+    return true;
+}
+
+bool EspNowRaceTransport::broadcast(uint16_t port, const uint8_t *buf, uint16_t len) {
+    (void)port;
+    if (len > ESP_NOW_MAX_DATA_LEN || !addPeer(espNowBroadcastMac) ||
+        esp_now_send(espNowBroadcastMac, buf, len) != ESP_OK) {
+        sendFailures++;
+        return false;
+    }
+    return true;
+}
+
+uint16_t EspNowRaceTransport::receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) {
+    espnow_frame_t frame;
+    if (!espNowFrames.pop(&frame) || frame.len > size) return 0;
+    racenetAddrFromMac(frame.mac, from);
+    memcpy(buf, frame.data, frame.len);
+    return frame.len;
+}
+
+uint32_t EspNowRaceTransport::getDropped() {
+    return espNowFrames.getDrops();
+}
+
+bool MdnsPeerFinder::begin() {
+    return xTaskCreatePinnedToCore(task, "mdnsFinder", 3072, this, 0, NULL, 0) == pdPASS;
+}
+
+void MdnsPeerFinder::task(void *arg) {
+    MdnsPeerFinder *self = (MdnsPeerFinder *)arg;
+    for (;;) {
+        if (self->enabled && WiFi.getMode() != WIFI_OFF) {
+            const int n = MDNS.queryService("qylap", "udp");
+            for (int i = 0; i < n; i++) {
+                racenet_addr_t addr = {(uint32_t)MDNS.IP(i), MDNS.port(i)};
+                self->found.push(addr);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(RACENET_MDNS_INTERVAL_MS));
+    }
+}
+
+#endif
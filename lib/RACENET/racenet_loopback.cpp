@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "racenet.h"
+
+void RaceLoopbackBus::setLoss(uint8_t percent, uint32_t seed) {
+    lossPercent = percent > 100 ? 100 : percent;
+    rng = seed ? seed : 1;
+}
+
+bool RaceLoopbackBus::attach(LoopbackRaceTransport *endpoint) {
+    for (uint8_t i = 0; i < endpointCount; i++) {
+        if (endpoints[i] == endpoint) return true;
+    }
+    if (endpointCount >= RACENET_LOOPBACK_ENDPOINTS) return false;
+    endpoints[endpointCount++] = endpoint;
+    return true;
+}
+
+// 与ESP-NOW一样，丢掉的帧发送方不知道，send()仍返回true
+bool RaceLoopbackBus::deliver(LoopbackRaceTransport *to, const racenet_addr_t *from, const uint8_t *buf,
+                              uint16_t len) {
+    rng = rng * 1103515245 + 12345;
+    if ((rng >> 16) % 100 < lossPercent) {
+        dropped++;
+        return true;
+    }
+    LoopbackRaceTransport::frame_t frame;
+    frame.from = *from;
+    frame.len = len;
+    memcpy(frame.data, buf, len);
+    if (!to->queue.push(frame)) return false;
+    delivered++;
+    return true;
+}
+
+LoopbackRaceTransport::LoopbackRaceTransport(RaceLoopbackBus *loopbackBus, const uint8_t *mac) : bus(loopbackBus) {
+    racenetAddrFromMac(mac, &addr);
+}
+
+bool LoopbackRaceTransport::begin(uint16_t port) {
+    (void)port;
+    return bus->attach(this);
+}
+
+bool LoopbackRaceTransport::send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) {
+    if (len > RACENET_MAX_PACKET) return false;
+    for (uint8_t i = 0; i < bus->endpointCount; i++) {
+        LoopbackRaceTransport *endpoint = bus->endpoints[i];
+        if (endpoint->addr.ip == to->ip && endpoint->addr.port == to->port) {
+            return bus->deliver(endpoint, &addr, buf, len);
+        }
+    }
+    return true;  // 没有这个对端，和空中一样石沉大海
+}
+
+bool LoopbackRaceTransport::broadcast(uint16_t port, const uint8_t *buf, uint16_t len) {
+    (void)port;
+    if (len > RACENET_MAX_PACKET) return false;
+    for (uint8_t i = 0; i < bus->endpointCount; i++) {
+        if (bus->endpoints[i] != this) bus->deliver(bus->endpoints[i], &addr, buf, len);
+    }
+    return true;
+}
+
+uint16_t LoopbackRaceTransport::receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) {
+    frame_t frame;
+    if (!queue.pop(&frame)) return 0;
+    if (frame.len > size) return 0;
+    *from = frame.from;
+    memcpy(buf, frame.data, frame.len);
+    return frame.len;
+}
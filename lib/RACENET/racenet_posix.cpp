@@ -0,0 +1,59 @@
+#if !defined(ARDUINO)
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "racenet.h"
+
+PosixUdpRaceTransport::~PosixUdpRaceTransport() {
+    if (fd >= 0) close(fd);
+}
+
+bool PosixUdpRaceTransport::begin(uint16_t port) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool PosixUdpRaceTransport::send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = to->ip;
+    addr.sin_port = htons(to->port);
+    return sendto(fd, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr)) == len;
+}
+
+bool PosixUdpRaceTransport::broadcast(uint16_t port, const uint8_t *buf, uint16_t len) {
+    const racenet_addr_t to = {htonl(INADDR_BROADCAST), port};
+    return send(&to, buf, len);
+}
+
+uint16_t PosixUdpRaceTransport::receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) {
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    const ssize_t n = recvfrom(fd, buf, size, 0, (struct sockaddr *)&addr, &addrLen);
+    if (n <= 0) return 0;
+    from->ip = addr.sin_addr.s_addr;
+    from->port = ntohs(addr.sin_port);
+    return (uint16_t)n;
+}
+
+#endif
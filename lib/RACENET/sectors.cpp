@@ -0,0 +1,213 @@
+#include "sectors.h"
+
+#include <string.h>
+
+const char *SectorCoordinator::statusToString(uint8_t status) {
+    switch (status) {
+        case RACENET_SECTOR_OK:
+            return "ok";
+        case RACENET_SECTOR_MISSING:
+            return "missing";
+        case RACENET_SECTOR_REPEAT:
+            return "repeat";
+        case RACENET_SECTOR_LATE:
+            return "late";
+        default:
+            return "unknown";
+    }
+}
+
+static uint32_t addUncertainty(uint32_t a, uint32_t b) {
+    if (a == RACENET_UNSYNCED || b == RACENET_UNSYNCED) return RACENET_UNSYNCED;
+    return a + b;
+}
+
+void SectorCoordinator::setResultSink(racenet_sector_sink_fn resultSink, void *ctx) {
+    sink = resultSink;
+    sinkCtx = ctx;
+}
+
+void SectorCoordinator::clear() {
+    pendingCount = 0;
+    memset(pilots, 0, sizeof(pilots));
+    resultCount = 0;
+    memset(counts, 0, sizeof(counts));
+    rejected = 0;
+}
+
+const racenet_sector_t *SectorCoordinator::getResult(uint32_t resultSeq) {
+    const uint32_t last = seq;
+    if (resultSeq == 0 || resultSeq > last || last - resultSeq >= resultCount) return nullptr;
+    return &results[resultSeq % RACENET_SECTOR_RESULTS];
+}
+
+void SectorCoordinator::addLap(const racenet_lap_t *lap) {
+    if (lap->sectorCount < 2) return;
+    addCrossing(lap->frequency, lap->sector, lap->sectorCount, lap->timeUs, lap->uncertaintyUs, lap->peer);
+}
+
+// 按过门时刻插入待处理区；满了先处理最早的一个腾出位置
+void SectorCoordinator::addCrossing(uint16_t frequency, uint8_t gate, uint8_t gateCount, uint64_t timeUs,
+                                    uint32_t uncertaintyUs, uint8_t peer) {
+    if (frequency == 0 || gateCount < 2 || gateCount > RACENET_MAX_SECTORS || gate >= gateCount) {
+        rejected++;
+        return;
+    }
+    if (pendingCount == RACENET_SECTOR_PENDING) {
+        process(&pending[0]);
+        memmove(&pending[0], &pending[1], sizeof(pending[0]) * (RACENET_SECTOR_PENDING - 1));
+        pendingCount--;
+    }
+    uint8_t pos = pendingCount;
+    while (pos > 0 && pending[pos - 1].timeUs > timeUs) pos--;
+    if (pos < pendingCount) memmove(&pending[pos + 1], &pending[pos], sizeof(pending[0]) * (pendingCount - pos));
+    crossing_t *c = &pending[pos];
+    c->timeUs = timeUs;
+    c->uncertaintyUs = uncertaintyUs;
+    c->frequency = frequency;
+    c->gate = gate;
+    c->gateCount = gateCount;
+    c->peer = peer;
+    pendingCount++;
+}
+
+void SectorCoordinator::service(uint64_t nowUs, bool waiting) {
+    if (clearRequested) {
+        clearRequested = false;
+        clear();
+    }
+    const uint64_t holdUs = (uint64_t)(waiting ? RACENET_SECTOR_GAP_HOLD_MS : RACENET_SECTOR_HOLD_MS) * 1000;
+    uint8_t done = 0;
+    while (done < pendingCount && pending[done].timeUs + holdUs <= nowUs) {
+        process(&pending[done]);
+        done++;
+    }
+    if (done == 0) return;
+    memmove(&pending[0], &pending[done], sizeof(pending[0]) * (pendingCount - done));
+    pendingCount -= done;
+}
+
+void SectorCoordinator::resetPilot(pilot_t *p, uint16_t frequency, uint8_t gateCount) {
+    memset(p, 0, sizeof(*p));
+    p->frequency = frequency;
+    p->gateCount = gateCount;
+    p->lastGate = -1;
+}
+
+// 找不到时占用空闲位置，都占满了就顶替最久没有过门的频率
+SectorCoordinator::pilot_t *SectorCoordinator::findPilot(uint16_t frequency) {
+    pilot_t *slot = nullptr;
+    for (uint8_t i = 0; i < RACENET_SECTOR_PILOTS; i++) {
+        if (pilots[i].frequency == frequency) return &pilots[i];
+        if (slot != nullptr && slot->frequency == 0) continue;
+        if (slot == nullptr || pilots[i].frequency == 0 || pilots[i].lastUs < slot->lastUs) slot = &pilots[i];
+    }
+    return slot;
+}
+
+void SectorCoordinator::emit(const pilot_t *p, const crossing_t *c, uint8_t sector, uint8_t status, uint32_t timeUs,
+                             uint32_t uncertaintyUs) {
+    const uint32_t next = seq + 1;
+    racenet_sector_t *r = &results[next % RACENET_SECTOR_RESULTS];
+    r->seq = next;
+    r->frequency = c->frequency;
+    r->sector = sector;
+    r->sectorCount = c->gateCount;
+    r->gate = c->gate;
+    r->status = status;
+    r->peer = c->peer;
+    r->lap = p->lap;
+    r->timeUs = timeUs;
+    r->crossingUs = c->timeUs;
+    r->uncertaintyUs = uncertaintyUs;
+    if (resultCount < RACENET_SECTOR_RESULTS) resultCount++;
+    counts[status]++;
+    seq = next;
+    if (sink != nullptr) sink(r, sinkCtx);
+}
+
+// 从门from往后distance段上一次的用时之和，没有记录的段按有记录的最长一段的两倍计（宁可少判漏圈）；
+// 一段都没有时返回0
+uint32_t SectorCoordinator::expectedUs(const pilot_t *p, uint8_t from, uint8_t distance) {
+    uint32_t longest = 0;
+    for (uint8_t i = 0; i < p->gateCount; i++) {
+        if (p->sectorUs[i] > longest) longest = p->sectorUs[i];
+    }
+    if (longest == 0) return 0;
+    uint32_t sum = 0;
+    for (uint8_t i = 1; i <= distance; i++) {
+        const uint32_t us = p->sectorUs[(from + i + p->gateCount - 1) % p->gateCount];
+        sum += us != 0 ? us : longest * 2;
+    }
+    return sum;
+}
+
+void SectorCoordinator::process(const crossing_t *c) {
+    pilot_t *p = findPilot(c->frequency);
+    if (p->frequency != c->frequency || p->gateCount != c->gateCount) resetPilot(p, c->frequency, c->gateCount);
+    if (p->lastGate >= 0 && c->timeUs < p->lastUs) {
+        emit(p, c, 0, RACENET_SECTOR_LATE, (uint32_t)(p->lastUs - c->timeUs),
+             addUncertainty(c->uncertaintyUs, p->lastUncUs));
+        return;
+    }
+    if (p->lastGate >= 0 && c->timeUs - p->lastUs > (uint64_t)RACENET_SECTOR_TIMEOUT_MS * 1000) {
+        resetPilot(p, c->frequency, c->gateCount);
+    }
+    // 第一次过门：门0开始第一圈，其他门从中途开始，到门0前的段照常输出但不计整圈
+    if (p->lastGate < 0) {
+        if (c->gate == 0) {
+            p->lap = 1;
+            p->lapStartUs = c->timeUs;
+            p->lapStartUncUs = c->uncertaintyUs;
+            p->lapValid = true;
+        }
+        p->lastGate = c->gate;
+        p->lastUs = c->timeUs;
+        p->lastUncUs = c->uncertaintyUs;
+        return;
+    }
+
+    const uint8_t n = p->gateCount;
+    uint8_t distance = (uint8_t)((c->gate + n - p->lastGate) % n);
+    const uint8_t sector = c->gate == 0 ? n : c->gate;
+    const uint32_t sinceUs = (uint32_t)(c->timeUs - p->lastUs);
+    const uint32_t uncertaintyUs = addUncertainty(c->uncertaintyUs, p->lastUncUs);
+    // 同一个门：间隔很短（两个节点设了同一个门）或不到四分之一圈（圈速再不稳定也跑不了这么快）是重复；
+    // 更久说明其他门整圈都漏了
+    const uint32_t lapUs = expectedUs(p, c->gate, n);
+    if (distance == 0) {
+        if (sinceUs < (uint32_t)RACENET_SECTOR_REPEAT_MS * 1000 || sinceUs < lapUs / 4) {
+            emit(p, c, 0, RACENET_SECTOR_REPEAT, sinceUs, uncertaintyUs);
+            return;
+        }
+        distance = n;
+    }
+    // 门的顺序对得上但用时比这几段上一次的用时多出半圈以上：中间还漏了整整一圈（门少时常见）
+    const uint32_t spanUs = expectedUs(p, p->lastGate, distance);
+    if (lapUs != 0 && sinceUs > spanUs + lapUs / 2) distance += n;
+    if (distance == 1) {
+        p->sectorUs[sector - 1] = sinceUs;
+        emit(p, c, sector, RACENET_SECTOR_OK, sinceUs, uncertaintyUs);
+    } else {
+        emit(p, c, sector, RACENET_SECTOR_MISSING, sinceUs, uncertaintyUs);
+        p->lapValid = false;
+        // 跳过的门里有门0：错过了一次圈界，圈数照加，新的一圈起点未知
+        if ((c->gate != 0 && (c->gate < p->lastGate || distance >= n)) || distance > n) {
+            p->lap++;
+            p->lapStartUs = 0;
+        }
+    }
+    if (c->gate == 0) {
+        if (p->lapStartUs != 0) {
+            emit(p, c, 0, p->lapValid ? RACENET_SECTOR_OK : RACENET_SECTOR_MISSING,
+                 (uint32_t)(c->timeUs - p->lapStartUs), addUncertainty(c->uncertaintyUs, p->lapStartUncUs));
+        }
+        p->lap++;
+        p->lapStartUs = c->timeUs;
+        p->lapStartUncUs = c->uncertaintyUs;
+        p->lapValid = true;
+    }
+    p->lastGate = c->gate;
+    p->lastUs = c->timeUs;
+    p->lastUncUs = c->uncertaintyUs;
+}
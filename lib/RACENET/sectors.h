@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "racenet.h"
+
+/**
+ * 分段计时：同一飞手频率的几个节点放在赛道上不同的门，配置中的分段序号表示各自是第几个门（0为起终点）。
+ * 协调器把各节点的过门按时刻排成 门0 → 门1 → … → 门N-1 → 门0，第k段为门k-1到门k，
+ * 第N段为门N-1回到门0，整圈为各段之和。
+ *
+ * 不同节点的事件经网络到达的先后不一定是过门的先后：过门先按时刻插入待处理区，
+ * 保留RACENET_SECTOR_HOLD_MS（有节点的事件在等重发时放宽到RACENET_SECTOR_GAP_HOLD_MS）再依次处理，
+ * 每跑完一段立即输出一条结果，回到门0时再输出整圈，不必等到圈末。
+ *   - 跳过了门（漏检或节点离线）：该段输出MISSING，从这个门重新开始，本圈作废；
+ *     门的顺序对得上但用时比各段上一次的用时多出半圈以上，视为中间漏了整整一圈（每段至少正常跑过一次才可靠）；
+ *   - 同一个门连续两次且间隔很短（两个节点设了同一个门、误检）：输出REPEAT，忽略；
+ *   - 过门时刻早于已处理的过门（保留期过后才到）：输出LATE，忽略。
+ * 时刻为汇总方时钟，各节点须已同步到汇总方；未同步的过门照常排序，误差上界记为RACENET_UNSYNCED。
+ */
+#define RACENET_MAX_SECTORS 8        // 与CONFIG_MAX_SECTORS一致
+#define RACENET_SECTOR_PILOTS 8      // 同时跟踪的频率数
+#define RACENET_SECTOR_PENDING 32    // 待处理区大小，满了就提前处理最早的
+#define RACENET_SECTOR_RESULTS 64    // 保留的最近结果数，供/sectors轮询
+#define RACENET_SECTOR_HOLD_MS 300   // 覆盖检测延迟和局域网延迟
+#define RACENET_SECTOR_GAP_HOLD_MS 2000  // 覆盖两个续订周期的重发
+#define RACENET_SECTOR_TIMEOUT_MS 60000  // 超过这么久没有过门视为重新开始，不算漏段
+#define RACENET_SECTOR_REPEAT_MS 1000    // 同一个门两次过门间隔小于此值一定是重复（同一节点有最小圈时保护）
+
+typedef enum {
+    RACENET_SECTOR_OK,
+    RACENET_SECTOR_MISSING,
+    RACENET_SECTOR_REPEAT,
+    RACENET_SECTOR_LATE
+} racenet_sector_status_e;
+
+typedef struct {
+    uint32_t seq;  // 结果序号，从1开始递增，清空后也不归零
+    uint16_t frequency;
+    uint8_t sector;       // 1..sectorCount；0表示整圈
+    uint8_t sectorCount;
+    uint8_t gate;         // 本次过门的门序号
+    uint8_t status;       // racenet_sector_status_e；整圈为MISSING表示圈内有段缺失，用时不可信
+    uint8_t peer;         // 汇总方节点表中的序号
+    uint32_t lap;         // 该频率第几圈，从1开始，第一次过门0之前为0
+    uint32_t timeUs;      // 段（整圈）用时；MISSING为跨过的几段的总用时，REPEAT/LATE为距上次过门
+    uint64_t crossingUs;  // 本次过门时刻（汇总方时钟）
+    uint32_t uncertaintyUs;  // 用时的误差上界（两端之和），RACENET_UNSYNCED表示有一端未同步
+} racenet_sector_t;
+
+typedef void (*racenet_sector_sink_fn)(const racenet_sector_t *result, void *ctx);
+
+class SectorCoordinator {
+   public:
+    // 来自RaceAggregator的圈事件，sectorCount < 2的节点不参与分段
+    void addLap(const racenet_lap_t *lap);
+    void addCrossing(uint16_t frequency, uint8_t gate, uint8_t gateCount, uint64_t timeUs, uint32_t uncertaintyUs,
+                     uint8_t peer);
+    // waiting为true（汇总方有节点的事件还没收齐）时延长保留期
+    void service(uint64_t nowUs, bool waiting);
+    // 每条结果产生时回调，在service()所在任务中执行
+    void setResultSink(racenet_sector_sink_fn sink, void *ctx);
+    void clear();
+    // 其他任务中清空用这个，下一次service()时执行
+    void requestClear() { clearRequested = true; }
+
+    uint32_t getLastSeq() { return seq; }
+    // 已被覆盖或还没产生时返回nullptr
+    const racenet_sector_t *getResult(uint32_t resultSeq);
+    uint32_t getCount(uint8_t status) { return status <= RACENET_SECTOR_LATE ? counts[status] : 0; }
+    uint32_t getRejected() { return rejected; }
+    static const char *statusToString(uint8_t status);
+
+   private:
+    typedef struct {
+        uint64_t timeUs;
+        uint32_t uncertaintyUs;
+        uint16_t frequency;
+        uint8_t gate;
+        uint8_t gateCount;
+        uint8_t peer;
+    } crossing_t;
+
+    typedef struct {
+        uint16_t frequency;  // 0表示空闲
+        uint8_t gateCount;
+        int8_t lastGate;  // -1表示还没有过门
+        uint64_t lastUs;
+        uint32_t lastUncUs;
+        uint64_t lapStartUs;  // 本圈在门0的起点，0表示未知
+        uint32_t lapStartUncUs;
+        uint32_t lap;
+        uint32_t sectorUs[RACENET_MAX_SECTORS];  // 各段最近一次OK的用时，用来识别整圈漏检
+        bool lapValid;
+    } pilot_t;
+
+    crossing_t pending[RACENET_SECTOR_PENDING];
+    uint8_t pendingCount = 0;
+    pilot_t pilots[RACENET_SECTOR_PILOTS];
+    racenet_sector_t results[RACENET_SECTOR_RESULTS];
+    volatile uint32_t seq = 0;
+    uint32_t resultCount = 0;
+    uint32_t counts[RACENET_SECTOR_LATE + 1] = {};
+    uint32_t rejected = 0;  // 门序号超出范围的过门
+    volatile bool clearRequested = false;
+    racenet_sector_sink_fn sink = nullptr;
+    void *sinkCtx = nullptr;
+
+    pilot_t *findPilot(uint16_t frequency);
+    void resetPilot(pilot_t *p, uint16_t frequency, uint8_t gateCount);
+    uint32_t expectedUs(const pilot_t *p, uint8_t from, uint8_t distance);
+    void process(const crossing_t *c);
+    void emit(const pilot_t *p, const crossing_t *c, uint8_t sector, uint8_t status, uint32_t timeUs,
+              uint32_t uncertaintyUs);
+};
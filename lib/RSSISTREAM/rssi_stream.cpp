@@ -0,0 +1,105 @@
+#include "rssi_stream.h"
+
+#include <string.h>
+
+void RssiStream::setEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_release);
+}
+
+void RssiStream::setResolution(uint32_t us, uint32_t samplePeriodUs) {
+    if (samplePeriodUs == 0) samplePeriodUs = 1;
+    uint32_t samples = (us + samplePeriodUs / 2) / samplePeriodUs;
+    if (samples < 1) samples = 1;
+    if (samples > 0xFFFF) samples = 0xFFFF;
+    periodUs = samplePeriodUs;
+    bucketSamples.store(samples, std::memory_order_release);
+}
+
+void RssiStream::push(uint64_t timeUs, uint16_t filteredQ4) {
+    if (!enabled.load(std::memory_order_acquire)) {
+        count = 0;
+        return;
+    }
+    if (count == 0) {
+        // 只在桶边界采用新的分辨率
+        activeSamples = bucketSamples.load(std::memory_order_acquire);
+        bucketStartUs = timeUs;
+        minQ4 = maxQ4 = filteredQ4;
+    } else {
+        if (filteredQ4 < minQ4) minQ4 = filteredQ4;
+        if (filteredQ4 > maxQ4) maxQ4 = filteredQ4;
+    }
+    if (++count < activeSamples) return;
+    count = 0;
+
+    rssi_bucket_t bucket;
+    bucket.startUs = bucketStartUs;
+    bucket.samples = activeSamples;
+    if (activeSamples == 1) {
+        // 单样本与getRssi()一样四舍五入
+        bucket.minRssi = bucket.maxRssi = (minQ4 + 8) >> 4;
+    } else {
+        bucket.minRssi = minQ4 >> 4;
+        bucket.maxRssi = (maxQ4 + 15) >> 4 > 255 ? 255 : (maxQ4 + 15) >> 4;
+    }
+    queue.push(bucket);
+}
+
+size_t RssiStream::buildFrame(uint8_t *frame, uint32_t nowMs, uint8_t enterRssi, uint8_t exitRssi) {
+    // 取出桶直到帧满或时间不连续
+    bool flush = false;
+    rssi_bucket_t bucket;
+    while (pendingCount < RSSI_STREAM_FRAME_BUCKETS) {
+        if (hasCarry) {
+            bucket = carry;
+            hasCarry = false;
+        } else if (!queue.pop(&bucket)) {
+            break;
+        }
+        if (pendingCount == 0) {
+            frameStartMs = nowMs;
+        } else {
+            const int64_t bucketUs = (int64_t)pending[0].samples * periodUs;
+            const uint64_t expected = pending[0].startUs + (uint64_t)pendingCount * bucketUs;
+            const int64_t error = (int64_t)(bucket.startUs - expected);
+            if (bucket.samples != pending[0].samples || error > bucketUs / 2 || error < -bucketUs / 2) {
+                carry = bucket;
+                hasCarry = true;
+                flush = true;
+                break;
+            }
+        }
+        pending[pendingCount++] = bucket;
+    }
+    if (pendingCount == 0) return 0;
+    if (!flush && pendingCount < RSSI_STREAM_FRAME_BUCKETS && (nowMs - frameStartMs) < RSSI_STREAM_FRAME_MS) return 0;
+
+    // 每个桶只有一个样本时min==max，只发一个值
+    const bool samples = pending[0].samples == 1;
+    rssi_frame_header_t header;
+    header.magic = RSSI_STREAM_MAGIC;
+    header.type = samples ? RSSI_FRAME_SAMPLES : RSSI_FRAME_ENVELOPE;
+    header.count = pendingCount;
+    header.sequence = sequence++;
+    header.baseUs = pending[0].startUs;
+    header.bucketUs = pending[0].samples * periodUs;
+    header.enterRssi = enterRssi;
+    header.exitRssi = exitRssi;
+    const uint32_t drops = queue.getDrops();
+    const uint32_t newDrops = drops - lastDrops;
+    header.dropped = newDrops > 0xFFFF ? 0xFFFF : newDrops;
+    lastDrops = drops;
+    memcpy(frame, &header, sizeof(header));
+
+    uint8_t *p = frame + sizeof(header);
+    for (uint16_t i = 0; i < pendingCount; i++) {
+        if (samples) {
+            *p++ = pending[i].maxRssi;
+        } else {
+            *p++ = pending[i].minRssi;
+            *p++ = pending[i].maxRssi;
+        }
+    }
+    pendingCount = 0;
+    return p - frame;
+}
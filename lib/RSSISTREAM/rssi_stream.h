@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "spsc_queue.h"
+
+#define RSSI_STREAM_QUEUE_SIZE 1024   // 计时核到网络任务的桶队列（5 kHz下约200 ms）
+#define RSSI_STREAM_FRAME_BUCKETS 250  // 每帧最多桶数
+#define RSSI_STREAM_FRAME_MS 50        // 不满一帧时最长等待时间
+#define RSSI_STREAM_MAGIC 0x52         // 'R'
+
+typedef enum {
+    RSSI_FRAME_SAMPLES = 1,  // 每桶一个样本，payload为count个uint8
+    RSSI_FRAME_ENVELOPE = 2  // 每桶min/max，payload为count对uint8
+} rssi_frame_type_e;
+
+/*
+ * WebSocket二进制帧（小端）：
+ *
+ *   0  u8   magic 'R'
+ *   1  u8   type（rssi_frame_type_e）
+ *   2  u16  count    桶数
+ *   4  u32  sequence 帧序号，连续递增
+ *   8  u64  baseUs   第一个桶的开始时刻（esp_timer，微秒）
+ *  16  u32  bucketUs 每个桶的时长，第i个桶开始于 baseUs + i * bucketUs
+ *  20  u8   enterRssi
+ *  21  u8   exitRssi
+ *  22  u16  dropped  本帧之前因队列满丢弃的桶数
+ *  24  payload
+ *
+ * 包络模式下min向下取整、max向上取整，窄峰不会被平均掉。
+ * 桶之间时间不连续（采样源重新对齐或丢桶）或分辨率改变时提前结束本帧，下一帧重新给baseUs。
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t type;
+    uint16_t count;
+    uint32_t sequence;
+    uint64_t baseUs;
+    uint32_t bucketUs;
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint16_t dropped;
+} rssi_frame_header_t;
+
+static_assert(sizeof(rssi_frame_header_t) == 24, "rssi frame header must be 24 bytes");
+
+#define RSSI_STREAM_FRAME_MAX_BYTES (sizeof(rssi_frame_header_t) + RSSI_STREAM_FRAME_BUCKETS * 2)
+
+typedef struct {
+    uint64_t startUs;
+    uint16_t samples;  // 本桶聚合的样本数
+    uint8_t minRssi;
+    uint8_t maxRssi;
+} rssi_bucket_t;
+
+/**
+ * RSSI实时流。计时核逐样本调用push()，按客户端选的分辨率聚合成min/max桶放入无锁队列；
+ * 网络任务调用buildFrame()取桶打包成二进制帧。没有客户端时setEnabled(false)，push()立即返回。
+ */
+class RssiStream {
+   public:
+    // 网络任务调用
+    void setEnabled(bool enable);
+    // 分辨率对所有客户端生效，以最后一次设置为准；samplePeriodUs为检测器采样周期
+    void setResolution(uint32_t bucketUs, uint32_t samplePeriodUs);
+    uint32_t getBucketUs() { return bucketSamples.load(std::memory_order_relaxed) * periodUs; }
+    // 有一帧可发时写入frame并返回字节数，否则返回0
+    size_t buildFrame(uint8_t *frame, uint32_t nowMs, uint8_t enterRssi, uint8_t exitRssi);
+    uint32_t getDroppedBuckets() { return queue.getDrops(); }
+
+    // 计时核调用，filteredQ4为12.4定点
+    void push(uint64_t timeUs, uint16_t filteredQ4);
+
+   private:
+    SpscQueue<rssi_bucket_t, RSSI_STREAM_QUEUE_SIZE> queue;
+    std::atomic<bool> enabled{false};
+    std::atomic<uint16_t> bucketSamples{1};
+    uint32_t periodUs = 200;
+
+    // 计时核上的聚合状态
+    uint16_t count = 0;
+    uint16_t minQ4 = 0;
+    uint16_t maxQ4 = 0;
+    uint64_t bucketStartUs = 0;
+    uint16_t activeSamples = 1;
+
+    // 网络任务上的打包状态
+    rssi_bucket_t pending[RSSI_STREAM_FRAME_BUCKETS];
+    uint16_t pendingCount = 0;
+    bool hasCarry = false;
+    rssi_bucket_t carry;
+    uint32_t frameStartMs = 0;
+    uint32_t sequence = 0;
+    uint32_t lastDrops = 0;
+};
@@ -1,259 +1,405 @@
 #include "RX5808.h"
 
-#include <Arduino.h>
-
 #include "debug.h"
+#include "hal.h"
 
 RX5808::RX5808(uint8_t _rssiInputPin, uint8_t _rx5808DataPin, uint8_t _rx5808SelPin, uint8_t _rx5808ClkPin) {
     rssiInputPin = _rssiInputPin;
     rx5808DataPin = _rx5808DataPin;
     rx5808SelPin = _rx5808SelPin;
     rx5808ClkPin = _rx5808ClkPin;
-    lastSetFreqTimeMs = millis();
+    lastSetFreqTimeMs = halMillis();
 }
 
 void RX5808::init() {
-    pinMode(rssiInputPin, INPUT);
-    pinMode(rx5808DataPin, OUTPUT);
-    pinMode(rx5808SelPin, OUTPUT);
-    pinMode(rx5808ClkPin, OUTPUT);
-    digitalWrite(rx5808SelPin, HIGH);
-    digitalWrite(rx5808ClkPin, LOW);
-    digitalWrite(rx5808DataPin, LOW);
+    halPinMode(rssiInputPin, HAL_PIN_INPUT);
+    halPinMode(rx5808DataPin, HAL_PIN_OUTPUT);
+    halPinMode(rx5808SelPin, HAL_PIN_OUTPUT);
+    halPinMode(rx5808ClkPin, HAL_PIN_OUTPUT);
+    halDigitalWrite(rx5808SelPin, HAL_HIGH);
+    halDigitalWrite(rx5808ClkPin, HAL_LOW);
+    halDigitalWrite(rx5808DataPin, HAL_LOW);
+    setBus(RX5808_DEFAULT_BUS);
     resetRxModule();
     setFrequency(POWER_DOWN_FREQ_MHZ);
 }
 
-void RX5808::handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyNewFreq) {
-    if ((currentFrequency != potentiallyNewFreq) && ((currentTimeMs - lastSetFreqTimeMs) > RX5808_MIN_BUSTIME)) {
-        lastSetFreqTimeMs = currentTimeMs;
-        setFrequency(potentiallyNewFreq);
+void RX5808::setBus(rx5808_bus_e mode) {
+    bus = mode;
+    bitUs = mode == RX5808_BUS_FAST ? RX5808_FAST_BIT_US : RX5808_SLOW_BIT_US;
+    enableUs = mode == RX5808_BUS_FAST ? RX5808_FAST_BIT_US : RX5808_SLOW_ENABLE_US;
+    verifyFailStreak = 0;
+    DEBUG("RX5808 bus: %s\n", mode == RX5808_BUS_FAST ? "fast" : "slow");
+}
+
+const char *RX5808::stateToString(rx5808_state_e s) {
+    switch (s) {
+        case RX5808_STATE_IDLE:
+            return "idle";
+        case RX5808_STATE_WAKING:
+            return "waking";
+        case RX5808_STATE_WRITING:
+            return "writing";
+        case RX5808_STATE_SETTLING:
+            return "settling";
+        case RX5808_STATE_VERIFYING:
+            return "verifying";
+        case RX5808_STATE_RETRYING:
+            return "retrying";
+        case RX5808_STATE_FAILED:
+            return "failed";
+        default:
+            return "unknown";
     }
+}
 
-    if (recentSetFreqFlag && (currentTimeMs - lastSetFreqTimeMs) > RX5808_MIN_TUNETIME) {
-        lastSetFreqTimeMs = currentTimeMs;
-        DEBUG("RX5808 Tune done\n");
-        if (verifyFrequency()) {
-            recentSetFreqFlag = false;  // only clear flag if frequency was verified correctly
-        } else {
-            DEBUG("RX5808 frequency verification failed, retrying...\n");
-            // Re-verify after a short delay
+void RX5808::setState(rx5808_state_e newState, uint32_t currentTimeMs) {
+    state = newState;
+    stateStartMs = currentTimeMs;
+}
+
+// 在parallelTask中循环调用，每次只推进一小段，不阻塞蜂鸣器、LED和网页
+void RX5808::handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyNewFreq) {
+    const uint64_t startUs = halMicros();
+
+    // 寄存器命令进行中：推进总线，命令完成后再处理状态转换
+    if (!txActive || serviceCommand(RX5808_STEPS_PER_CALL)) {
+        switch (state) {
+            case RX5808_STATE_WAKING:
+                if (wakeStep == 0) {
+                    // 复位已写完，写上电设置
+                    beginCommand(0xA, 0b11010000110111110011, false);
+                    wakeStep = 1;
+                } else if (wakeStep == 1) {
+                    stateStartMs = currentTimeMs;  // Give module time to reset
+                    wakeStep = 2;
+                } else if ((currentTimeMs - stateStartMs) >= RX5808_WAKE_MS) {
+                    rxPoweredDown = false;
+                    beginFrequencyWrite();
+                    setState(RX5808_STATE_WRITING, currentTimeMs);
+                }
+                break;
+            case RX5808_STATE_WRITING:
+                setState(currentFrequency == POWER_DOWN_FREQ_MHZ ? RX5808_STATE_IDLE : RX5808_STATE_SETTLING, currentTimeMs);
+                break;
+            case RX5808_STATE_SETTLING:
+                if ((currentTimeMs - stateStartMs) > RX5808_MIN_TUNETIME) {
+                    DEBUG("RX5808 Tune done\n");
+                    // Verify read HEX value in RX5808 module Frequency Register 0x01
+                    beginCommand(0x1, 0, true);
+                    setState(RX5808_STATE_VERIFYING, currentTimeMs);
+                }
+                break;
+            case RX5808_STATE_VERIFYING:
+                handleVerifyResult(currentTimeMs);
+                break;
+            case RX5808_STATE_RETRYING:
+                if ((currentTimeMs - stateStartMs) > RX5808_RETRY_MS) {
+                    beginFrequencyWrite();
+                    setState(RX5808_STATE_WRITING, currentTimeMs);
+                }
+                break;
+            default:
+                break;
+        }
+
+        // 只在没有命令进行中的状态接受新频率，写入/校验中途到来的新频率在下一轮处理
+        const bool canChange = !txActive && state != RX5808_STATE_WAKING && state != RX5808_STATE_WRITING &&
+                               state != RX5808_STATE_VERIFYING;
+        if (canChange && (currentFrequency != potentiallyNewFreq) &&
+            ((currentTimeMs - lastSetFreqTimeMs) > RX5808_MIN_BUSTIME)) {
             lastSetFreqTimeMs = currentTimeMs;
+            beginFrequencyChange(potentiallyNewFreq, currentTimeMs);
         }
     }
+
+    const uint32_t elapsedUs = (uint32_t)(halMicros() - startUs);
+    if (elapsedUs > maxServiceUs) maxServiceUs = elapsedUs;
 }
 
-bool RX5808::verifyFrequency() {
-    // Start of Read Reg code :
-    // Verify read HEX value in RX5808 module Frequency Register 0x01
-    uint16_t vtxRegisterHex = 0;
-    //  Modified copy of packet code in setRxModuleToFreq(), to read Register 0x01
-    //  20 bytes of register data are read, but the
-    //  MSB 4 bits are zeros
-    //  Data Packet is: register address (4-bits) = 0x1, read/write bit = 1 for read, data D0-D15 stored in vtxHexVerify, data15-19=0x0
-
-    rx5808SerialEnableHigh();
-    rx5808SerialEnableLow();
-
-    rx5808SerialSendBit1();  // Register 0x1
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-
-    rx5808SerialSendBit0();  // Read register r/w
-
-    // receive data D0-D15, and ignore D16-D19
-    pinMode(rx5808DataPin, INPUT_PULLUP);
-    for (uint8_t i = 0; i < 20; i++) {
-        delayMicroseconds(10);
-        // only use D0-D15, ignore D16-D19
-        if (i < 16) {
-            if (digitalRead(rx5808DataPin)) {
-                bitWrite(vtxRegisterHex, i, 1);
-            } else {
-                bitWrite(vtxRegisterHex, i, 0);
-            }
-        }
-        if (i >= 16) {
-            digitalRead(rx5808DataPin);
-        }
-        digitalWrite(rx5808ClkPin, HIGH);
-        delayMicroseconds(10);
-        digitalWrite(rx5808ClkPin, LOW);
-        delayMicroseconds(10);
+void RX5808::beginFrequencyChange(uint16_t vtxFreq, uint32_t currentTimeMs) {
+    DEBUG("Setting frequency to %u MHz\n", vtxFreq);
+    currentFrequency = vtxFreq;
+    verifyAttempts = 0;
+
+    if (vtxFreq == POWER_DOWN_FREQ_MHZ)  // frequency value to power down rx module
+    {
+        beginCommand(0xA, 0b11111111111111111111, false);
+        rxPoweredDown = true;
+        recentSetFreqFlag = false;
+        setState(RX5808_STATE_WRITING, currentTimeMs);
+        return;
     }
+    recentSetFreqFlag = true;  // indicate need to wait RX5808_MIN_TUNETIME before reading RSSI
+    if (rxPoweredDown) {
+        // Reset rx5808 module to wake up from power down
+        beginCommand(0xF, 0, false);
+        wakeStep = 0;
+        setState(RX5808_STATE_WAKING, currentTimeMs);
+        return;
+    }
+    beginFrequencyWrite();
+    setState(RX5808_STATE_WRITING, currentTimeMs);
+}
 
-    pinMode(rx5808DataPin, OUTPUT);  // return status of Data pin after INPUT_PULLUP above
-    rx5808SerialEnableHigh();        // Finished clocking data in
-    delay(2);
+// register address = 0x1, write, data0-15=vtxHex data15-19=0x0
+void RX5808::beginFrequencyWrite() {
+    beginCommand(0x1, freqMhzToRegVal(currentFrequency), false);
+}
 
-    digitalWrite(rx5808ClkPin, LOW);
-    digitalWrite(rx5808DataPin, LOW);
+void RX5808::handleVerifyResult(uint32_t currentTimeMs) {
+    // 20 bits of register data are read, but the MSB 4 bits are zeros
+    const uint16_t vtxRegisterHex = txData & 0xFFFF;
+    verifyAttempts++;
+    if (vtxRegisterHex == freqMhzToRegVal(currentFrequency)) {
+        DEBUG("RX5808 frequency verified properly in %u attempt(s)\n", verifyAttempts);
+        recentSetFreqFlag = false;  // only clear flag if frequency was verified correctly
+        verifyFailStreak = 0;
+        setState(RX5808_STATE_IDLE, currentTimeMs);
+        return;
+    }
 
-    if (vtxRegisterHex != freqMhzToRegVal(currentFrequency)) {
-        DEBUG("RX5808 frequency not matching, register = %u, currentFreq = %u\n", vtxRegisterHex, currentFrequency);
-        return false;
+    DEBUG("RX5808 frequency not matching, register = %u, currentFreq = %u\n", vtxRegisterHex, currentFrequency);
+    verifyFailures = verifyFailures + 1;
+    // 快速总线反复校验失败时多半是接线余量不够，换回慢速时序重写频率
+    if (bus == RX5808_BUS_FAST && ++verifyFailStreak >= RX5808_VERIFY_FALLBACK) {
+        DEBUG("RX5808 fast bus unreliable, falling back to slow bus\n");
+        setBus(RX5808_BUS_SLOW);
+        verifyAttempts = 0;
+        beginFrequencyWrite();
+        setState(RX5808_STATE_WRITING, currentTimeMs);
+        return;
     }
-    DEBUG("RX5808 frequency verified properly\n");
-    return true;
+    if (verifyAttempts >= RX5808_MAX_VERIFY_ATTEMPTS) {
+        // 不再重试，放开RSSI让计时继续，/status中可以看到FAILED
+        DEBUG("RX5808 frequency verification failed %u times, giving up\n", verifyAttempts);
+        recentSetFreqFlag = false;
+        setState(RX5808_STATE_FAILED, currentTimeMs);
+        return;
+    }
+    DEBUG("RX5808 frequency verification failed, retrying...\n");
+    setState(RX5808_STATE_RETRYING, currentTimeMs);
 }
 
 // Set frequency on RX5808 module to given value
 void RX5808::setFrequency(uint16_t vtxFreq) {
-    DEBUG("Setting frequency to %u MHz\n", vtxFreq);
-
     // Don't set frequency if it's the same as current
     if (currentFrequency == vtxFreq) {
         DEBUG("Already on frequency %u MHz, skipping\n", vtxFreq);
         return;
     }
+    // 与handleFrequencyChange()相同的流程，逐条命令跑完
+    beginFrequencyChange(vtxFreq, halMillis());
+    runCommand();
+    if (state == RX5808_STATE_WAKING) {
+        setupRxModule();
+        halDelayMs(RX5808_WAKE_MS);  // Give module time to reset
+        rxPoweredDown = false;
+        beginFrequencyWrite();
+        runCommand();
+    }
+    // 校验留给handleFrequencyChange()
+    setState(vtxFreq == POWER_DOWN_FREQ_MHZ ? RX5808_STATE_IDLE : RX5808_STATE_SETTLING, halMillis());
+    DEBUG("Frequency set in %u us, recentSetFreqFlag = %u\n", lastCommandUs, recentSetFreqFlag);
+}
 
-    currentFrequency = vtxFreq;
-
-    if (vtxFreq == POWER_DOWN_FREQ_MHZ)  // frequency value to power down rx module
-    {
-        powerDownRxModule();
-        rxPoweredDown = true;
-        recentSetFreqFlag = false;
-        return;
+/**
+ * 扫描模式的调谐：只写频率寄存器，不回读校验、不等待，RSSI立即视为可用，
+ * 由扫描器丢弃RX5808_MIN_TUNETIME内的样本。模块处于掉电状态时走setFrequency()的完整流程。
+ */
+void RX5808::tune(uint16_t vtxFreq) {
+    if (rxPoweredDown || vtxFreq == POWER_DOWN_FREQ_MHZ) {
+        setFrequency(vtxFreq);
+    } else {
+        currentFrequency = vtxFreq;
+        writeRegister(0x1, freqMhzToRegVal(vtxFreq));
     }
-    if (rxPoweredDown) {
-        resetRxModule();
-        rxPoweredDown = false;
-        // Give module time to reset
-        delay(10);
+    recentSetFreqFlag = false;
+    state = RX5808_STATE_IDLE;
+}
+
+void RX5808::recordCommandTime(uint64_t startUs) {
+    const uint32_t elapsedUs = (uint32_t)(halMicros() - startUs);
+    lastCommandUs = elapsedUs;
+    if (elapsedUs > maxCommandUs) maxCommandUs = elapsedUs;
+}
+
+/**
+ * 准备一条寄存器命令：4位地址、1位读写标志（写为1），写命令再跟20位数据，均为低位在前；
+ * 读命令在发出地址和读标志后把DATA改为输入，读回20位。
+ */
+void RX5808::beginCommand(uint8_t address, uint32_t data, bool read) {
+    if (read) {
+        txPacket = address & 0xF;
+        txWriteBits = 5;
+        txReadBits = 20;
+    } else {
+        txPacket = (address & 0xF) | (1UL << 4) | ((data & 0xFFFFF) << 5);
+        txWriteBits = 25;
+        txReadBits = 0;
     }
+    txData = 0;
+    txStep = 0;
+    // SEL高、SEL低、每个写位3步、（读：切换输入1步、每个读位2步）、SEL高、收尾
+    txSteps = 2 + 3 * txWriteBits + (txReadBits ? 1 + 2 * txReadBits : 0) + 2;
+    txStartUs = halMicros();
+    txNextUs = txStartUs;
+    txActive = true;
+}
 
-    // Get the hex value to send to the rx module
-    uint16_t vtxHex = freqMhzToRegVal(vtxFreq);
-    DEBUG("Sending register value %u to RX5808\n", vtxHex);
-
-    // Channel data from the lookup table, 20 bytes of register data are sent, but the
-    // MSB 4 bits are zeros register address = 0x1, write, data0-15=vtxHex data15-19=0x0
-    rx5808SerialEnableHigh();
-    delayMicroseconds(200); // Ensure stable state
-    rx5808SerialEnableLow();
-    delayMicroseconds(200); // Ensure stable state
-
-    // Register 0x1 (frequency register)
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit0();
-
-    rx5808SerialSendBit1();  // Write to register
-
-    // Send D0-D15, note: loop runs backwards
-    for (uint8_t i = 16; i > 0; i--) {
-        if (vtxHex & 0x1) {
-            rx5808SerialSendBit1();
+// 执行命令的第step步，返回这一步之后需要保持的时间
+uint32_t RX5808::busStep(uint16_t step) {
+    const uint16_t writeSteps = 3 * txWriteBits;
+    const uint16_t readSteps = txReadBits ? 1 + 2 * txReadBits : 0;
+    const uint32_t readUs = bus == RX5808_BUS_FAST ? bitUs : RX5808_SLOW_READ_US;
+
+    if (step == 0) {
+        busWrite(rx5808SelPin, HAL_HIGH);
+        return enableUs;
+    }
+    if (step == 1) {
+        busWrite(rx5808SelPin, HAL_LOW);
+        return enableUs;
+    }
+    step -= 2;
+    if (step < writeSteps) {
+        switch (step % 3) {
+            case 0:
+                busWrite(rx5808DataPin, (txPacket >> (step / 3)) & 0x1 ? HAL_HIGH : HAL_LOW);
+                break;
+            case 1:
+                busWrite(rx5808ClkPin, HAL_HIGH);
+                break;
+            default:
+                busWrite(rx5808ClkPin, HAL_LOW);
+                break;
+        }
+        return bitUs;
+    }
+    step -= writeSteps;
+    if (step < readSteps) {
+        if (step == 0) {
+            halPinMode(rx5808DataPin, HAL_PIN_INPUT_PULLUP);
+            return readUs;
+        }
+        step -= 1;
+        // 时钟低电平时采样，再给一个时钟
+        if (step % 2 == 0) {
+            if (busRead(rx5808DataPin)) {
+                txData |= 1UL << (step / 2);
+            }
+            busWrite(rx5808ClkPin, HAL_HIGH);
         } else {
-            rx5808SerialSendBit0();
+            busWrite(rx5808ClkPin, HAL_LOW);
         }
-        vtxHex >>= 1;
+        return readUs;
     }
-
-    // Send remaining D16-D19 (all zeros)
-    for (uint8_t i = 4; i > 0; i--) {
-        rx5808SerialSendBit0();
+    step -= readSteps;
+    if (step == 0) {
+        if (txReadBits) {
+            halPinMode(rx5808DataPin, HAL_PIN_OUTPUT);  // return status of Data pin after INPUT_PULLUP above
+        }
+        busWrite(rx5808SelPin, HAL_HIGH);  // Finished clocking data in
+        return enableUs + (bus == RX5808_BUS_SLOW ? RX5808_SLOW_TAIL_US : 0);
     }
+    busWrite(rx5808ClkPin, HAL_LOW);
+    busWrite(rx5808DataPin, HAL_LOW);
+    return 0;
+}
 
-    rx5808SerialEnableHigh();  // Finished clocking data in
-    delay(2);
+/**
+ * 推进进行中的命令，完成时返回true。
+ * 保持时间不超过RX5808_INLINE_HOLD_US的直接忙等，更长的或已执行maxSteps步时返回，下次调用继续。
+ */
+bool RX5808::serviceCommand(uint32_t maxSteps) {
+    uint32_t steps = 0;
+    while (txActive) {
+        const uint64_t nowUs = halMicros();
+        if (nowUs < txNextUs) {
+            const uint64_t waitUs = txNextUs - nowUs;
+            if (waitUs > RX5808_INLINE_HOLD_US || steps >= maxSteps) return false;
+            halDelayUs(waitUs);
+        }
+        const uint32_t holdUs = busStep(txStep++);
+        steps++;
+        txNextUs = halMicros() + holdUs;
+        if (txStep >= txSteps) {
+            txActive = false;
+            recordCommandTime(txStartUs);
+        }
+    }
+    return true;
+}
 
-    digitalWrite(rx5808ClkPin, LOW);
-    digitalWrite(rx5808DataPin, LOW);
+// 阻塞执行完当前命令
+void RX5808::runCommand() {
+    while (!serviceCommand(UINT32_MAX)) {
+        const uint64_t nowUs = halMicros();
+        if (txNextUs > nowUs) halDelayUs(txNextUs - nowUs);
+    }
+}
 
-    recentSetFreqFlag = true;  // indicate need to wait RX5808_MIN_TUNETIME before reading RSSI
-    DEBUG("Frequency set, recentSetFreqFlag = %u\n", recentSetFreqFlag);
+void RX5808::writeRegister(uint8_t address, uint32_t data) {
+    beginCommand(address, data, false);
+    runCommand();
 }
 
 // Read the RSSI value
 uint8_t RX5808::readRssi() {
-    volatile uint16_t rssi = 0;
+    return scaleRssi(readRssiRaw());
+}
 
+// Read the raw 12-bit RSSI value, 0 while the module is still tuning
+uint16_t RX5808::readRssiRaw() {
     if (recentSetFreqFlag) return 0;  // RSSI is unstable, return 0 to indicate no signal
 
     // reads 5V value as 0-4095, RX5808 is 3.3V powered so RSSI pin will never output the full range
-    rssi = analogRead(rssiInputPin);
-    // clamp upper range to fit scaling
-    if (rssi > 2047) rssi = 2047;
-    // rescale to fit into a byte and remove some jitter TODO: experiment with exp or log
-    return rssi >> 3;
+    return halAnalogRead(rssiInputPin);
 }
 
-void RX5808::rx5808SerialSendBit1() {
-    digitalWrite(rx5808DataPin, HIGH);
-    delayMicroseconds(300);
-    digitalWrite(rx5808ClkPin, HIGH);
-    delayMicroseconds(300);
-    digitalWrite(rx5808ClkPin, LOW);
-    delayMicroseconds(300);
+bool RX5808::isRssiStable() {
+    return !recentSetFreqFlag;
 }
 
-void RX5808::rx5808SerialSendBit0() {
-    digitalWrite(rx5808DataPin, LOW);
-    delayMicroseconds(300);
-    digitalWrite(rx5808ClkPin, HIGH);
-    delayMicroseconds(300);
-    digitalWrite(rx5808ClkPin, LOW);
-    delayMicroseconds(300);
+uint8_t RX5808::getRssiPin() {
+    return rssiInputPin;
 }
 
-void RX5808::rx5808SerialEnableLow() {
-    digitalWrite(rx5808SelPin, LOW);
-    delayMicroseconds(200);
+uint8_t RX5808::scaleRssi(uint16_t raw) {
+    // clamp upper range to fit scaling
+    if (raw > 2047) raw = 2047;
+    // rescale to fit into a byte and remove some jitter TODO: experiment with exp or log
+    return raw >> 3;
 }
 
-void RX5808::rx5808SerialEnableHigh() {
-    digitalWrite(rx5808SelPin, HIGH);
-    delayMicroseconds(200);
+// Same scaling for 12.4 fixed-point decimator output, keeps 4 fractional bits
+uint16_t RX5808::scaleRssiQ4(uint16_t rawQ4) {
+    if (rawQ4 > (2047 << 4)) rawQ4 = 2047 << 4;
+    return rawQ4 >> 3;
 }
 
-// Reset rx5808 module to wake up from power down
-void RX5808::resetRxModule() {
-    rx5808SerialEnableHigh();
-    rx5808SerialEnableLow();
-
-    rx5808SerialSendBit1();  // Register 0xF
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit1();
-
-    rx5808SerialSendBit1();  // Write to register
-
-    for (uint8_t i = 20; i > 0; i--)
-        rx5808SerialSendBit0();
+// 慢速总线保留digitalWrite，时序与改动前完全相同
+inline void RX5808::busWrite(uint8_t pin, uint8_t level) {
+    if (bus == RX5808_BUS_FAST) {
+        halDigitalWriteFast(pin, level);
+    } else {
+        halDigitalWrite(pin, level);
+    }
+}
 
-    rx5808SerialEnableHigh();  // Finished clocking data in
+inline uint8_t RX5808::busRead(uint8_t pin) {
+    return bus == RX5808_BUS_FAST ? halDigitalReadFast(pin) : halDigitalRead(pin);
+}
 
+// Reset rx5808 module to wake up from power down
+void RX5808::resetRxModule() {
+    writeRegister(0xF, 0);  // Register 0xF
     setupRxModule();
 }
 
 // Set power options on the rx5808 module
 void RX5808::setRxModulePower(uint32_t options) {
-    rx5808SerialEnableHigh();
-    rx5808SerialEnableLow();
-
-    rx5808SerialSendBit0();  // Register 0xA
-    rx5808SerialSendBit1();
-    rx5808SerialSendBit0();
-    rx5808SerialSendBit1();
-
-    rx5808SerialSendBit1();  // Write to register
-
-    for (uint8_t i = 20; i > 0; i--) {
-        if (options & 0x1) {  // Is bit high or low?
-            rx5808SerialSendBit1();
-        } else {
-            rx5808SerialSendBit0();
-        }
-        options >>= 1;  // Shift bits along to check the next one
-    }
-
-    rx5808SerialEnableHigh();  // Finished clocking data in
-
-    digitalWrite(rx5808DataPin, LOW);
+    writeRegister(0xA, options);  // Register 0xA
 }
 
 // Power down rx5808 module
@@ -265,21 +411,3 @@ void RX5808::powerDownRxModule() {
 void RX5808::setupRxModule() {
     setRxModulePower(0b11010000110111110011);
 }
-
-// Calculate rx5808 register hex value for given frequency in MHz
-uint16_t RX5808::freqMhzToRegVal(uint16_t freqInMhz) {
-    // Improved frequency calculation for better accuracy
-    // Formula: TF = (F - 479) / 2
-    // N = TF / 32
-    // A = TF % 32
-    // Register value = (N << 7) | A
-    uint16_t tf = (freqInMhz - 479) / 2;
-    uint16_t N = tf / 32;
-    uint16_t A = tf % 32;
-    uint16_t regVal = (N << 7) | A;
-    
-    // Debug output for frequency calculation
-    DEBUG("Freq: %u MHz -> TF: %u, N: %u, A: %u, Reg: %u\n", freqInMhz, tf, N, A, regVal);
-    
-    return regVal;
-}
\ No newline at end of file
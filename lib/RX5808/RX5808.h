@@ -1,17 +1,108 @@
+#pragma once
+
 #include <stdint.h>
 
 #define RX5808_MIN_TUNETIME 35    // after set freq need to wait this long before read RSSI
 #define RX5808_MIN_BUSTIME 30     // after set freq need to wait this long before setting again
 #define POWER_DOWN_FREQ_MHZ 1111  // signal to power down the module
-#define RSSI_READS 5              // number of analog RSSI reads per tick
+
+/**
+ * RTC6715三线串行总线（DATA/SEL/CLK，低位在前，每条命令25位）的两种时序：
+ *   RX5808_BUS_FAST：直接写GPIO寄存器，每个时钟相位RX5808_FAST_BIT_US，一条命令约0.1 ms
+ *   RX5808_BUS_SLOW：原来的digitalWrite加300 us延时，一条命令约23 ms，用于接线过长或电平不稳的板子
+ * 快速总线连续RX5808_VERIFY_FALLBACK次回读校验失败后自动退回慢速总线。
+ */
+typedef enum {
+    RX5808_BUS_FAST,
+    RX5808_BUS_SLOW
+} rx5808_bus_e;
+
+#ifndef RX5808_DEFAULT_BUS
+#define RX5808_DEFAULT_BUS RX5808_BUS_FAST
+#endif
+#ifndef RX5808_FAST_BIT_US
+#define RX5808_FAST_BIT_US 1      // RTC6715的串行时钟远高于此，1 us已留足余量
+#endif
+#define RX5808_SLOW_BIT_US 300
+#define RX5808_SLOW_ENABLE_US 200
+#define RX5808_SLOW_READ_US 10
+#define RX5808_SLOW_TAIL_US 2000  // 慢速总线每条命令结束后的等待
+#define RX5808_VERIFY_FALLBACK 3
+
+/**
+ * 频率切换状态机，由handleFrequencyChange()在parallelTask中推进，每次调用都不阻塞：
+ * 一条寄存器命令被拆成若干总线步骤（SEL/DATA/CLK的一次翻转加保持时间），
+ * 不超过RX5808_INLINE_HOLD_US的保持直接忙等，更长的留到下一次调用，每次最多执行RX5808_STEPS_PER_CALL步。
+ *   IDLE → (掉电时WAKING：复位、上电设置、等待RX5808_WAKE_MS) → WRITING → SETTLING（RX5808_MIN_TUNETIME）
+ *        → VERIFYING → IDLE
+ * 回读不一致时进入RETRYING，等待RX5808_RETRY_MS后重写频率；同一次切换最多校验RX5808_MAX_VERIFY_ATTEMPTS次，
+ * 仍失败则进入FAILED并放开RSSI（不再无限重试），直到下一次切换频率。
+ */
+typedef enum {
+    RX5808_STATE_IDLE,
+    RX5808_STATE_WAKING,
+    RX5808_STATE_WRITING,
+    RX5808_STATE_SETTLING,
+    RX5808_STATE_VERIFYING,
+    RX5808_STATE_RETRYING,
+    RX5808_STATE_FAILED
+} rx5808_state_e;
+
+#define RX5808_INLINE_HOLD_US 5
+#define RX5808_STEPS_PER_CALL 32
+#define RX5808_WAKE_MS 10
+#define RX5808_RETRY_MS 20
+#define RX5808_MAX_VERIFY_ATTEMPTS 5
+
+// 过采样抽取前端，可通过build_flags覆盖
+#ifndef RSSI_READS
+#define RSSI_READS 5              // number of analog RSSI reads per tick (boxcar window N)
+#endif
+#ifndef RSSI_DECIMATION
+#define RSSI_DECIMATION RSSI_READS  // raw reads per output sample (decimation ratio R)
+#endif
+#ifndef RSSI_DECIMATOR_MODE
+#define RSSI_DECIMATOR_MODE DECIMATOR_BOXCAR  // DECIMATOR_BOXCAR or DECIMATOR_CIC
+#endif
+#ifndef RSSI_CIC_ORDER
+#define RSSI_CIC_ORDER 2          // CIC stages when RSSI_DECIMATOR_MODE is DECIMATOR_CIC
+#endif
 
 class RX5808 {
    public:
     RX5808(uint8_t _rssiInputPin, uint8_t _rx5808DataPin, uint8_t _rx5808SelPin, uint8_t _rx5808ClkPin);
     void init();
+    // 阻塞式设置频率，只在启动阶段或计时核上使用；运行中切换频率用handleFrequencyChange()
     void setFrequency(uint16_t frequency);
+    // 扫描用的调谐：只写频率寄存器，不回读校验，稳定时间由调用者安排
+    void tune(uint16_t frequency);
+    void setBus(rx5808_bus_e mode);
+    rx5808_bus_e getBus() { return bus; }
+    // 最近一条/最长一条寄存器命令的耗时（微秒）
+    uint32_t getLastCommandUs() { return lastCommandUs; }
+    uint32_t getMaxCommandUs() { return maxCommandUs; }
+    uint32_t getVerifyFailures() { return verifyFailures; }
+    rx5808_state_e getState() { return state; }
+    static const char *stateToString(rx5808_state_e s);
+    // handleFrequencyChange()单次调用的最长耗时（微秒）
+    uint32_t getMaxServiceUs() { return maxServiceUs; }
+    uint16_t getFrequency() { return currentFrequency; }
     uint8_t readRssi();
+    uint16_t readRssiRaw();
+    bool isRssiStable();
+    uint8_t getRssiPin();
+    static uint8_t scaleRssi(uint16_t raw);
+    static uint16_t scaleRssiQ4(uint16_t rawQ4);
     void handleFrequencyChange(uint32_t currentTimeMs, uint16_t potentiallyNewFreq);
+    // 有寄存器命令进行到一半（只在parallelTask中变化）
+    bool isCommandActive() { return txActive; }
+
+    // Calculate rx5808 register hex value for given frequency in MHz
+    // Formula: TF = (F - 479) / 2, N = TF / 32, A = TF % 32, register value = (N << 7) | A
+    // constexpr，频段表可在编译期换算和检查
+    static constexpr uint16_t freqMhzToRegVal(uint16_t freqInMhz) {
+        return (uint16_t)(((((freqInMhz - 479) / 2) / 32) << 7) | (((freqInMhz - 479) / 2) % 32));
+    }
 
    private:
     uint8_t rx5808DataPin = 0;  // DATA (CH1) output line to RX5808 module
@@ -22,19 +113,50 @@ class RX5808 {
     uint16_t currentFrequency = 0;
 
     bool rxPoweredDown = false;
-    bool recentSetFreqFlag = false;
+    volatile bool recentSetFreqFlag = false;  // 计时核读取
     uint32_t lastSetFreqTimeMs = 0;
 
-    void rx5808SerialSendBit1();
-    void rx5808SerialSendBit0();
-    void rx5808SerialEnableLow();
-    void rx5808SerialEnableHigh();
+    volatile rx5808_state_e state = RX5808_STATE_IDLE;
+    uint32_t stateStartMs = 0;
+    uint8_t wakeStep = 0;
+    uint8_t verifyAttempts = 0;
+    volatile uint32_t maxServiceUs = 0;
+
+    // 进行中的寄存器命令
+    bool txActive = false;
+    uint32_t txPacket = 0;
+    uint8_t txWriteBits = 0;
+    uint8_t txReadBits = 0;
+    uint16_t txStep = 0;
+    uint16_t txSteps = 0;
+    uint32_t txData = 0;
+    uint64_t txStartUs = 0;
+    uint64_t txNextUs = 0;
+
+    rx5808_bus_e bus = RX5808_DEFAULT_BUS;
+    uint32_t bitUs = 0;     // 时钟每个相位的保持时间
+    uint32_t enableUs = 0;  // SEL变化后的保持时间
+    volatile uint32_t lastCommandUs = 0;
+    volatile uint32_t maxCommandUs = 0;
+    volatile uint32_t verifyFailures = 0;
+    uint8_t verifyFailStreak = 0;
+
+    void busWrite(uint8_t pin, uint8_t level);
+    uint8_t busRead(uint8_t pin);
+    void beginCommand(uint8_t address, uint32_t data, bool read);
+    uint32_t busStep(uint16_t step);
+    bool serviceCommand(uint32_t maxSteps);
+    void runCommand();
+    void writeRegister(uint8_t address, uint32_t data);
+    void recordCommandTime(uint64_t startUs);
+
+    void beginFrequencyChange(uint16_t frequency, uint32_t currentTimeMs);
+    void beginFrequencyWrite();
+    void handleVerifyResult(uint32_t currentTimeMs);
+    void setState(rx5808_state_e newState, uint32_t currentTimeMs);
 
     void setRxModulePower(uint32_t options);
     void resetRxModule();
     void setupRxModule();
     void powerDownRxModule();
-    bool verifyFrequency();
-
-    static uint16_t freqMhzToRegVal(uint16_t freqInMhz);
 };
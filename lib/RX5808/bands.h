@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "RX5808.h"
+
+#define RX5808_BAND_COUNT 6
+#define RX5808_BAND_CHANNELS 8
+#define RX5808_FREQ_MIN_MHZ 5300
+#define RX5808_FREQ_MAX_MHZ 5950
+
+/**
+ * 5.8 GHz频段/频道表，顺序与网页的freqLookup和频段下拉框一致：A、B、E、F、R（RaceBand）、L（LowRace）。
+ * 编译期常量，频谱扫描按频段字母取频率，不占RAM。
+ */
+static constexpr char RX5808_BAND_NAMES[] = "ABEFRL";
+static constexpr uint16_t RX5808_BANDS[RX5808_BAND_COUNT][RX5808_BAND_CHANNELS] = {
+    {5865, 5845, 5825, 5805, 5785, 5765, 5745, 5725},  // A
+    {5733, 5752, 5771, 5790, 5809, 5828, 5847, 5866},  // B
+    {5705, 5685, 5665, 5645, 5885, 5905, 5925, 5945},  // E
+    {5740, 5760, 5780, 5800, 5820, 5840, 5860, 5880},  // F
+    {5658, 5695, 5732, 5769, 5806, 5843, 5880, 5917},  // R
+    {5362, 5399, 5436, 5473, 5510, 5547, 5584, 5621},  // L
+};
+
+// 编译期检查：表内频率都在RX5808可调范围内，寄存器换算与常用的RX5808频率寄存器表（5800 MHz = 0x2984）一致
+static constexpr bool rx5808BandsInRange(uint8_t i) {
+    return i >= RX5808_BAND_COUNT * RX5808_BAND_CHANNELS ||
+           (RX5808_BANDS[i / RX5808_BAND_CHANNELS][i % RX5808_BAND_CHANNELS] >= RX5808_FREQ_MIN_MHZ &&
+            RX5808_BANDS[i / RX5808_BAND_CHANNELS][i % RX5808_BAND_CHANNELS] <= RX5808_FREQ_MAX_MHZ &&
+            rx5808BandsInRange(i + 1));
+}
+static_assert(sizeof(RX5808_BAND_NAMES) == RX5808_BAND_COUNT + 1, "one letter per band");
+static_assert(rx5808BandsInRange(0), "band table frequency out of range");
+static_assert(RX5808::freqMhzToRegVal(5800) == 0x2984, "RTC6715 register value for 5800 MHz");
@@ -0,0 +1,78 @@
+#include "decimator.h"
+
+#include <string.h>
+
+void Decimator::init(decimator_mode_e mode, uint8_t window, uint8_t ratio, uint8_t order) {
+    filterMode = mode;
+    decimation = ratio < 1 ? 1 : ratio;
+    if (window < 1) window = 1;
+    if (window > DECIMATOR_MAX_WINDOW) window = DECIMATOR_MAX_WINDOW;
+    windowSize = window;
+    if (order < 1) order = 1;
+    if (order > DECIMATOR_MAX_ORDER) order = DECIMATOR_MAX_ORDER;
+    cicOrder = order;
+
+    gain = 1;
+    if (filterMode == DECIMATOR_CIC) {
+        for (uint8_t i = 0; i < cicOrder; i++) gain *= decimation;
+    } else {
+        gain = windowSize;
+    }
+    reset();
+}
+
+void Decimator::reset() {
+    phase = 0;
+    historyIndex = 0;
+    historyCount = 0;
+    sum = 0;
+    memset(history, 0, sizeof(history));
+    memset(integrators, 0, sizeof(integrators));
+    memset(combs, 0, sizeof(combs));
+}
+
+bool Decimator::push(uint16_t raw, uint16_t *out) {
+    uint32_t acc;
+
+    if (filterMode == DECIMATOR_CIC) {
+        integrators[0] += raw;
+        for (uint8_t i = 1; i < cicOrder; i++) {
+            integrators[i] += integrators[i - 1];
+        }
+        if (++phase < decimation) return false;
+        phase = 0;
+
+        acc = integrators[cicOrder - 1];
+        for (uint8_t i = 0; i < cicOrder; i++) {
+            const uint32_t prev = combs[i];
+            combs[i] = acc;
+            acc -= prev;
+        }
+    } else {
+        sum -= history[historyIndex];
+        history[historyIndex] = raw;
+        sum += raw;
+        historyIndex = (historyIndex + 1) % windowSize;
+        if (historyCount < windowSize) historyCount++;
+        if (++phase < decimation) return false;
+        phase = 0;
+
+        // 刚开始窗口未填满时按已有样本数平均
+        if (historyCount < windowSize) {
+            *out = (uint16_t)((sum << 4) / historyCount);
+            return true;
+        }
+        acc = sum;
+    }
+
+    *out = (uint16_t)(((uint64_t)acc << 4) / gain);
+    return true;
+}
+
+uint16_t Decimator::getGroupDelayHalfSamples() {
+    // boxcar: (N-1)/2，CIC: M*(R-1)/2
+    if (filterMode == DECIMATOR_CIC) {
+        return cicOrder * (decimation - 1);
+    }
+    return windowSize - 1;
+}
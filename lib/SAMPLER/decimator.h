@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#define DECIMATOR_MAX_WINDOW 32  // 滑动平均最大窗口
+#define DECIMATOR_MAX_ORDER 4    // CIC最大阶数
+
+typedef enum {
+    DECIMATOR_BOXCAR,  // 最近N个样本求平均，每R个输入输出一次
+    DECIMATOR_CIC      // M阶CIC（积分-梳状），窗口等于R，gain = R^M
+} decimator_mode_e;
+
+/**
+ * 过采样抽取器：把多个12位ADC原始值合成一个样本。
+ * 输出为12.4定点数（原始值 * 16），平均后多出来的有效位不会被截掉。
+ */
+class Decimator {
+   public:
+    void init(decimator_mode_e mode, uint8_t window, uint8_t ratio, uint8_t order = 1);
+    void reset();
+    // 输入一个原始值，每ratio个输入返回true并通过out给出一个输出
+    bool push(uint16_t raw, uint16_t *out);
+    uint8_t getRatio() { return decimation; }
+    // 输出相对最后一个输入的群延迟（以输入样本为单位，x2避免小数）
+    uint16_t getGroupDelayHalfSamples();
+
+   private:
+    decimator_mode_e filterMode = DECIMATOR_BOXCAR;
+    uint8_t windowSize = 1;
+    uint8_t decimation = 1;
+    uint8_t cicOrder = 1;
+    uint8_t phase = 0;
+    uint32_t gain = 1;
+
+    // boxcar
+    uint16_t history[DECIMATOR_MAX_WINDOW];
+    uint8_t historyIndex = 0;
+    uint8_t historyCount = 0;
+    uint32_t sum = 0;
+
+    // CIC，依靠无符号整数回绕保证结果正确
+    uint32_t integrators[DECIMATOR_MAX_ORDER];
+    uint32_t combs[DECIMATOR_MAX_ORDER];
+};
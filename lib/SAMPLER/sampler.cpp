@@ -0,0 +1,25 @@
+#include "sampler.h"
+
+SimulatedRssiSource::SimulatedRssiSource(generator_fn fn, void *context) {
+    generator = fn;
+    ctx = context;
+}
+
+bool SimulatedRssiSource::begin(uint32_t rateHz) {
+    if (rateHz == 0 || generator == nullptr) return false;
+    sampleRateHz = rateHz;
+    periodUs = 1000000UL / rateHz;
+    timeUs = 0;
+    return true;
+}
+
+uint16_t SimulatedRssiSource::readBlock(rssi_block_t *block) {
+    block->startUs = timeUs;
+    block->periodUs = periodUs;
+    block->count = SAMPLER_BLOCK_SIZE;
+    for (uint16_t i = 0; i < SAMPLER_BLOCK_SIZE; i++) {
+        block->raw[i] = generator(timeUs, ctx);
+        timeUs += periodUs;
+    }
+    return block->count;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLER_RATE_HZ 5000     // 检测器看到的固定采样率（2-10 kHz）
+#define SAMPLER_BLOCK_SIZE 64    // 每次交给检测器的最大样本数
+#define SAMPLER_POOL_SAMPLES 2048  // DMA环形缓冲区容量（样本数）
+
+class RX5808;
+
+/**
+ * 一块连续等间隔的RSSI原始采样（12位ADC值）。
+ * 第i个样本的时间戳为 startUs + i * periodUs，时间基准为esp_timer（微秒）。
+ */
+typedef struct {
+    uint64_t startUs;
+    uint32_t periodUs;
+    uint16_t count;
+    uint16_t raw[SAMPLER_BLOCK_SIZE];
+} rssi_block_t;
+
+/**
+ * RSSI采样源接口。检测器只通过readBlock()按块取数，不关心数据来自
+ * 连续ADC/DMA、轮询analogRead还是主机上的仿真信号。
+ */
+class RssiSource {
+   public:
+    virtual ~RssiSource() {}
+    virtual bool begin(uint32_t sampleRateHz) = 0;
+    virtual void end() {}
+    // 取出已就绪的样本，返回样本数（0表示暂无数据），不阻塞
+    virtual uint16_t readBlock(rssi_block_t *block) = 0;
+    uint32_t getSampleRateHz() { return sampleRateHz; }
+    uint32_t getOverruns() { return overruns; }
+
+   protected:
+    uint32_t sampleRateHz = 0;
+    uint32_t overruns = 0;
+};
+
+/**
+ * 连续ADC + DMA采样源。ADC按固定硬件速率转换，驱动将结果写入环形缓冲区，
+ * 当请求速率低于芯片最低DMA速率时，按整数倍过采样后平均为一个样本。
+ * 仅支持ADC1通道；ADC2通道（如ESP32-S3的GPIO13）begin()返回false。
+ * 连续模式下ADC1不能再用analogRead()，auxPin（电池电压）若也在ADC1上则一起交替转换。
+ */
+class AdcDmaRssiSource : public RssiSource {
+   public:
+    AdcDmaRssiSource(uint8_t pin, uint8_t auxPin);
+    bool begin(uint32_t sampleRateHz) override;
+    void end() override;
+    uint16_t readBlock(rssi_block_t *block) override;
+    bool hasAux();
+    uint16_t getAuxRaw();
+
+   private:
+    uint8_t rssiPin;
+    uint8_t auxInputPin;
+    uint8_t channel = 0;
+    uint8_t auxChannel = 0xFF;
+    uint8_t patternNum = 1;
+    volatile uint16_t auxRaw = 0;
+    bool running = false;
+    uint16_t oversample = 1;  // 每个输出样本对应的硬件转换次数
+    uint32_t accSum = 0;
+    uint16_t accCount = 0;
+    uint64_t nextSampleUs = 0;  // 下一个输出样本的时间戳
+};
+
+/**
+ * 轮询采样源：每次readBlock()连续做readsPerTick次analogRead，时间戳取读取时刻。
+ * 作为DMA不可用时的后备，与原先每次loop()读取一次的节奏相同。
+ */
+class PolledRssiSource : public RssiSource {
+   public:
+    PolledRssiSource(RX5808 *rx5808, uint8_t readsPerTick);
+    bool begin(uint32_t sampleRateHz) override;
+    uint16_t readBlock(rssi_block_t *block) override;
+
+   private:
+    RX5808 *rx;
+    uint8_t reads;
+};
+
+/**
+ * 仿真采样源：按虚拟时间以固定速率调用generator生成样本，
+ * 每次readBlock()推进一整块，用于在Linux主机上驱动检测器。
+ */
+class SimulatedRssiSource : public RssiSource {
+   public:
+    typedef uint16_t (*generator_fn)(uint64_t timeUs, void *ctx);
+
+    SimulatedRssiSource(generator_fn fn, void *context);
+    bool begin(uint32_t sampleRateHz) override;
+    uint16_t readBlock(rssi_block_t *block) override;
+    uint64_t getTimeUs() { return timeUs; }
+
+   private:
+    generator_fn generator;
+    void *ctx;
+    uint64_t timeUs = 0;
+    uint32_t periodUs = 0;
+};
@@ -0,0 +1,215 @@
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp_timer.h>
+#include <soc/adc_periph.h>
+
+#include "RX5808.h"
+#include "debug.h"
+#include "sampler.h"
+
+// 不同芯片DMA输出格式不同，参考 IDF v4.4 examples/peripherals/adc/dma_read
+#if CONFIG_IDF_TARGET_ESP32
+#define SAMPLER_ADC_RESULT_BYTES 2
+#define SAMPLER_ADC_CONV_LIMIT_EN true
+#define SAMPLER_ADC_CONV_MODE ADC_CONV_SINGLE_UNIT_1
+#define SAMPLER_ADC_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define SAMPLER_ADC_TYPE1 1
+#elif CONFIG_IDF_TARGET_ESP32S2
+#define SAMPLER_ADC_RESULT_BYTES 2
+#define SAMPLER_ADC_CONV_LIMIT_EN true
+#define SAMPLER_ADC_CONV_MODE ADC_CONV_SINGLE_UNIT_1
+#define SAMPLER_ADC_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define SAMPLER_ADC_RESULT_BYTES 4
+#define SAMPLER_ADC_CONV_LIMIT_EN false
+#define SAMPLER_ADC_CONV_MODE ADC_CONV_ALTER_UNIT
+#define SAMPLER_ADC_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#else
+#define SAMPLER_ADC_RESULT_BYTES 4
+#define SAMPLER_ADC_CONV_LIMIT_EN false
+#define SAMPLER_ADC_CONV_MODE ADC_CONV_SINGLE_UNIT_1
+#define SAMPLER_ADC_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#endif
+
+#ifndef SOC_ADC_SAMPLE_FREQ_THRES_LOW
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW 20000
+#endif
+
+#define SAMPLER_DMA_FRAME_BYTES 256
+
+static uint8_t *dmaBuf = nullptr;
+static uint32_t dmaBufBytes = 0;
+
+// 查找GPIO对应的ADC1通道，不在ADC1上返回-1
+static int8_t adc1ChannelForPin(uint8_t pin) {
+    for (uint8_t ch = 0; ch < SOC_ADC_CHANNEL_NUM(0); ch++) {
+        if (adc_channel_io_map[0][ch] == pin) return ch;
+    }
+    return -1;
+}
+
+AdcDmaRssiSource::AdcDmaRssiSource(uint8_t pin, uint8_t auxPin) {
+    rssiPin = pin;
+    auxInputPin = auxPin;
+}
+
+bool AdcDmaRssiSource::begin(uint32_t rateHz) {
+    int8_t ch = adc1ChannelForPin(rssiPin);
+    if (ch < 0 || rateHz == 0) {
+        DEBUG("ADC DMA: pin %u is not an ADC1 channel\n", rssiPin);
+        return false;
+    }
+    channel = ch;
+    sampleRateHz = rateHz;
+
+    // 连续模式占用整个ADC1，同在ADC1上的电池电压改为交替转换，供getAuxRaw()读取
+    int8_t aux = adc1ChannelForPin(auxInputPin);
+    auxChannel = (aux >= 0 && aux != ch) ? aux : 0xFF;
+    patternNum = (auxChannel != 0xFF) ? 2 : 1;
+
+    // 芯片有最低DMA速率限制，低于该速率时整数倍过采样再平均
+    oversample = 1;
+    while (sampleRateHz * oversample < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+        oversample++;
+    }
+
+    // 每次最多读出一块输出样本对应的转换结果
+    dmaBufBytes = (SAMPLER_BLOCK_SIZE - 1) * oversample * patternNum * SAMPLER_ADC_RESULT_BYTES;
+    dmaBuf = (uint8_t *)malloc(dmaBufBytes);
+    if (dmaBuf == nullptr) return false;
+
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = SAMPLER_POOL_SAMPLES * oversample * patternNum * SAMPLER_ADC_RESULT_BYTES;
+    initConfig.conv_num_each_intr = SAMPLER_DMA_FRAME_BYTES;
+    initConfig.adc1_chan_mask = BIT(channel) | (patternNum > 1 ? BIT(auxChannel) : 0);
+    initConfig.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&initConfig) != ESP_OK) {
+        DEBUG("ADC DMA: initialize failed\n");
+        free(dmaBuf);
+        dmaBuf = nullptr;
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern[2] = {};
+    for (uint8_t i = 0; i < patternNum; i++) {
+        pattern[i].atten = ADC_ATTEN_DB_11;  // 与analogRead()默认量程一致
+        pattern[i].channel = (i == 0) ? channel : auxChannel;
+        pattern[i].unit = 0;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_digi_configuration_t digConfig = {};
+    digConfig.conv_limit_en = SAMPLER_ADC_CONV_LIMIT_EN;
+    digConfig.conv_limit_num = 250;
+    digConfig.pattern_num = patternNum;
+    digConfig.adc_pattern = pattern;
+    digConfig.sample_freq_hz = sampleRateHz * oversample * patternNum;
+    digConfig.conv_mode = SAMPLER_ADC_CONV_MODE;
+    digConfig.format = SAMPLER_ADC_FORMAT;
+    if (adc_digi_controller_configure(&digConfig) != ESP_OK || adc_digi_start() != ESP_OK) {
+        DEBUG("ADC DMA: configure/start failed\n");
+        adc_digi_deinitialize();
+        free(dmaBuf);
+        dmaBuf = nullptr;
+        return false;
+    }
+
+    accSum = 0;
+    accCount = 0;
+    nextSampleUs = esp_timer_get_time();
+    running = true;
+    DEBUG("ADC DMA: GPIO%u ADC1_CH%u, %u Hz x%u oversample, aux channel %u\n", rssiPin, channel, sampleRateHz, oversample, auxChannel);
+    return true;
+}
+
+void AdcDmaRssiSource::end() {
+    if (!running) return;
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    free(dmaBuf);
+    dmaBuf = nullptr;
+    running = false;
+}
+
+uint16_t AdcDmaRssiSource::getAuxRaw() {
+    return auxRaw;
+}
+
+bool AdcDmaRssiSource::hasAux() {
+    return running && auxChannel != 0xFF;
+}
+
+uint16_t AdcDmaRssiSource::readBlock(rssi_block_t *block) {
+    block->count = 0;
+    if (!running) return 0;
+
+    uint32_t bytesRead = 0;
+    esp_err_t err = adc_digi_read_bytes(dmaBuf, dmaBufBytes, &bytesRead, 0);
+    if (err == ESP_ERR_INVALID_STATE) {
+        // 环形缓冲区溢出，丢失了样本，时间戳需要重新对齐
+        overruns++;
+    } else if (err != ESP_OK) {
+        return 0;
+    }
+
+    const uint32_t periodUs = 1000000UL / sampleRateHz;
+    const uint64_t nowUs = esp_timer_get_time();
+    const uint32_t conversions = bytesRead / SAMPLER_ADC_RESULT_BYTES;
+    const uint32_t pending = (accCount + conversions / patternNum) / oversample;
+
+    // 最新样本不可能晚于当前时刻，也不可能早于整个缓冲池的时长，超出即重新对齐
+    const uint64_t lastUs = nextSampleUs + (uint64_t)pending * periodUs;
+    const uint64_t maxLagUs = (uint64_t)SAMPLER_POOL_SAMPLES * periodUs;
+    if (err == ESP_ERR_INVALID_STATE || lastUs > nowUs || nowUs - lastUs > maxLagUs) {
+        nextSampleUs = nowUs - (uint64_t)pending * periodUs;
+    }
+
+    block->startUs = nextSampleUs;
+    block->periodUs = periodUs;
+    for (uint32_t i = 0; i < conversions; i++) {
+        adc_digi_output_data_t *p = (adc_digi_output_data_t *)&dmaBuf[i * SAMPLER_ADC_RESULT_BYTES];
+#if SAMPLER_ADC_TYPE1
+        const uint8_t ch = p->type1.channel;
+        const uint16_t data = p->type1.data;
+#else
+        const uint8_t ch = p->type2.channel;
+        const uint16_t data = p->type2.data;
+#endif
+        if (ch != channel) {
+            if (ch == auxChannel) auxRaw = data;
+            continue;
+        }
+        accSum += data;
+        if (++accCount >= oversample) {
+            block->raw[block->count++] = accSum / oversample;
+            accSum = 0;
+            accCount = 0;
+            nextSampleUs += periodUs;
+        }
+    }
+    return block->count;
+}
+
+PolledRssiSource::PolledRssiSource(RX5808 *rx5808, uint8_t readsPerTick) {
+    rx = rx5808;
+    reads = readsPerTick < 1 ? 1 : (readsPerTick > SAMPLER_BLOCK_SIZE ? SAMPLER_BLOCK_SIZE : readsPerTick);
+}
+
+bool PolledRssiSource::begin(uint32_t rateHz) {
+    sampleRateHz = rateHz;
+    return true;
+}
+
+uint16_t PolledRssiSource::readBlock(rssi_block_t *block) {
+    block->startUs = esp_timer_get_time();
+    block->periodUs = 0;
+    block->count = reads;
+    for (uint8_t i = 0; i < reads; i++) {
+        block->raw[i] = rx->readRssiRaw();
+    }
+    return block->count;
+}
+
+#endif
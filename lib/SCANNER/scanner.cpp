@@ -0,0 +1,276 @@
+#include "scanner.h"
+
+#include <string.h>
+
+#include "debug.h"
+#include "hal.h"
+
+void ScanChannel::init(uint8_t index, uint16_t frequency, Config *config) {
+    channel = index;
+    freq = frequency;
+    conf = config;
+    filter.setMeasurementNoise(SCANNER_FILTER_MEASUREMENT);
+    filter.setProcessNoise(SCANNER_FILTER_PROCESS);
+    laps.reserve(2);
+    stop();
+}
+
+void ScanChannel::start(uint64_t timeUs) {
+    laps.clear();
+    startTimeUs = timeUs;
+    crossingOpen = false;
+    peakNeedsNext = false;
+    running = true;
+}
+
+void ScanChannel::stop() {
+    running = false;
+    crossingOpen = false;
+    peakNeedsNext = false;
+}
+
+/**
+ * 峰值访问与前后两次访问做抛物线插值，假设前后间隔相同（都等于重访周期）。
+ * 顶点偏移限制在±半个周期内，峰值在窗口边缘或三点共线时退化为峰值访问的时刻。
+ */
+uint64_t ScanChannel::interpolatePeak() {
+    const int32_t p = peakPrevQ4;
+    const int32_t c = peakQ4;
+    const int32_t n = peakNextQ4;
+    const int32_t denom = p - 2 * c + n;
+    if (denom >= 0 || peakSpanUs == 0) return peakTimeUs;
+    int32_t offsetUs = (int32_t)((int64_t)(p - n) * peakSpanUs / (2 * denom));
+    const int32_t limit = peakSpanUs / 2;
+    if (offsetUs > limit) offsetUs = limit;
+    if (offsetUs < -limit) offsetUs = -limit;
+    return peakTimeUs + offsetUs;
+}
+
+bool ScanChannel::processVisit(uint16_t rssiQ4, uint64_t timeUs, laptimer_event_t *event) {
+#ifdef KALMAN_FIXED_POINT
+    int32_t filteredQ4 = (filter.filterQ16(rssiQ4) + (1 << 15)) >> 16;
+#else
+    int32_t filteredQ4 = (int32_t)(filter.filter(rssiQ4, 0) + 0.5f);
+#endif
+    if (filteredQ4 < 0) filteredQ4 = 0;
+    if (filteredQ4 > (255 << 4)) filteredQ4 = 255 << 4;
+    const uint8_t r = (filteredQ4 + 8) >> 4;
+    rssi = r;
+    visits = visits + 1;
+
+    bool lap = false;
+    if (running) {
+        if (peakNeedsNext) {
+            peakNextQ4 = filteredQ4;
+            peakNeedsNext = false;
+        }
+        const uint8_t enter = conf->getEnterRssi();
+        const uint8_t exit = conf->getExitRssi() < enter ? conf->getExitRssi() : enter;
+        if (!crossingOpen && r >= enter) {
+            crossingOpen = true;
+            peakQ4 = 0;
+        }
+        if (crossingOpen) {
+            if ((uint16_t)filteredQ4 > peakQ4) {
+                peakQ4 = filteredQ4;
+                peakPrevQ4 = prevQ4;
+                peakNextQ4 = filteredQ4;
+                peakTimeUs = timeUs;
+                peakSpanUs = (uint32_t)(timeUs - prevTimeUs);
+                peakNeedsNext = true;
+            }
+            if (r < exit) {
+                crossingOpen = false;
+                const uint64_t crossingUs = interpolatePeak();
+                // 峰值落在最小圈时内的整次穿越丢弃，与LapTimer的滞回检测一致
+                if (crossingUs > startTimeUs && (crossingUs - startTimeUs) > (uint64_t)conf->getMinLapMs() * 1000) {
+                    const uint32_t lapTimeUs = (uint32_t)(crossingUs - startTimeUs);
+                    memset(event, 0, sizeof(*event));
+                    event->type = LAPTIMER_EVENT_LAP;
+                    event->lapNumber = laps.getCount();
+                    event->lapTimeUs = lapTimeUs;
+                    event->timeUs = crossingUs;
+                    event->channel = channel;
+                    event->peakRssi = (uint8_t)((peakQ4 + 8) >> 4);
+                    laps.append(lapTimeUs);
+                    startTimeUs = crossingUs;
+                    lap = true;
+                }
+            }
+        }
+    }
+    prevQ4 = filteredQ4;
+    prevTimeUs = timeUs;
+    return lap;
+}
+
+uint8_t FrequencyScanner::maxChannels(uint32_t settleUs, uint32_t dwellUs, uint32_t maxRevisitUs) {
+    const uint32_t perChannelUs = SCANNER_TUNE_BUDGET_US + settleUs + dwellUs;
+    const uint32_t n = maxRevisitUs / perChannelUs;
+    return n > SCANNER_MAX_CHANNELS ? SCANNER_MAX_CHANNELS : n;
+}
+
+bool FrequencyScanner::begin(Config *config, RX5808 *rx5808, RssiSource *rssiSource, Buzzer *buzzer, Led *l) {
+    conf = config;
+    rx = rx5808;
+    source = rssiSource;
+    buz = buzzer;
+    led = l;
+
+    uint16_t freqs[CONFIG_MAX_SCAN_CHANNELS];
+    uint8_t count = conf->getScanFrequencies(freqs);
+    const uint8_t limit = maxChannels(SCANNER_SETTLE_US, SCANNER_DWELL_US, SCANNER_MAX_REVISIT_US);
+    if (count > limit) {
+        DEBUG("Scanner: %u frequencies exceed revisit budget, scanning first %u\n", count, limit);
+        count = limit;
+    }
+    if (count < 2) {
+        active = false;
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        channels[i].init(i, freqs[i], conf);
+    }
+    channelCount = count;
+    // 模块在init()后处于掉电状态，第一次tune()会走完整的setFrequency()将其唤醒
+    current = 0;
+    tuneTo(0);
+    maxTuneUs = 0;  // 不计唤醒所用的时间
+    cycleStartUs = halMicros();
+    active = true;
+    DEBUG("Scanner: %u frequencies, settle %u us, dwell %u us\n", count, (uint32_t)SCANNER_SETTLE_US, (uint32_t)SCANNER_DWELL_US);
+    return true;
+}
+
+bool FrequencyScanner::postCommand(laptimer_cmd_e cmd) {
+    return commandQueue.push(cmd);
+}
+
+bool FrequencyScanner::postIoCommand(laptimer_cmd_e cmd) {
+    return ioCommandQueue.push(cmd);
+}
+
+// 扫描模式只支持开始/停止，校准需要单频连续采样
+void FrequencyScanner::handleCommands() {
+    laptimer_cmd_e cmd;
+    while (commandQueue.pop(&cmd) || ioCommandQueue.pop(&cmd)) {
+        switch (cmd) {
+            case LAPTIMER_CMD_START:
+                start();
+                break;
+            case LAPTIMER_CMD_STOP:
+                stop();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void FrequencyScanner::start() {
+    DEBUG("Scanner started\n");
+    const uint64_t nowUs = halMicros();
+    for (uint8_t i = 0; i < channelCount; i++) {
+        channels[i].start(nowUs);
+    }
+    running = true;
+    buz->beep(500);
+    led->on(500);
+
+    laptimer_event_t event = {};
+    event.type = LAPTIMER_EVENT_START;
+    event.timeUs = nowUs;
+    eventQueue.push(event);
+}
+
+void FrequencyScanner::stop() {
+    DEBUG("Scanner stopped\n");
+    const bool wasRunning = running;
+    for (uint8_t i = 0; i < channelCount; i++) {
+        channels[i].stop();
+    }
+    running = false;
+    buz->beep(500);
+    led->on(500);
+
+    if (wasRunning) {
+        laptimer_event_t event = {};
+        event.type = LAPTIMER_EVENT_STOP;
+        event.timeUs = halMicros();
+        eventQueue.push(event);
+    }
+}
+
+void FrequencyScanner::tuneTo(uint8_t index) {
+    const uint64_t t0 = halMicros();
+    rx->tune(channels[index].getFrequency());
+    const uint64_t t1 = halMicros();
+    if (t1 - t0 > maxTuneUs) maxTuneUs = t1 - t0;
+    // 调谐完成前采到的样本时间戳都早于dwellStartUs，自然被丢弃
+    dwellStartUs = t1 + SCANNER_SETTLE_US;
+    dwellSum = 0;
+    dwellCount = 0;
+}
+
+void FrequencyScanner::finishDwell() {
+    if (dwellCount > 0) {
+        const uint16_t rawQ4 = (uint16_t)(((dwellSum << 4) + dwellCount / 2) / dwellCount);
+        laptimer_event_t event;
+        if (channels[current].processVisit(RX5808::scaleRssiQ4(rawQ4), dwellStartUs + SCANNER_DWELL_US / 2, &event)) {
+            eventQueue.push(event);
+            buz->beep(200);
+            led->on(200);
+        }
+    }
+    current = (current + 1) % channelCount;
+    if (current == 0) {
+        const uint64_t nowUs = halMicros();
+        revisitUs = (uint32_t)(nowUs - cycleStartUs);
+        cycleStartUs = nowUs;
+        cycles = cycles + 1;
+    }
+    tuneTo(current);
+}
+
+/**
+ * 计时核主循环调用：取一块原始样本，稳定期内的丢弃，驻留期内的累加，
+ * 驻留结束时把平均值交给当前频率的检测器并调谐到下一个频率。
+ */
+void FrequencyScanner::handleScanUpdate() {
+    handleCommands();
+
+    if (source->readBlock(&block) == 0) return;
+
+    for (uint16_t i = 0; i < block.count; i++) {
+        const uint64_t sampleTimeUs = block.startUs + (uint64_t)i * block.periodUs;
+        if (sampleTimeUs < dwellStartUs) continue;
+        dwellSum += block.raw[i];
+        dwellCount++;
+        if (sampleTimeUs - dwellStartUs >= SCANNER_DWELL_US) {
+            finishDwell();
+        }
+    }
+}
+
+// 在网络/IO任务中调用
+void FrequencyScanner::dispatchEvents() {
+    laptimer_event_t event;
+    while (eventQueue.pop(&event)) {
+        for (uint8_t i = 0; i < eventSinkCount; i++) {
+            eventSinks[i](&event, eventSinkCtx[i]);
+        }
+    }
+}
+
+// 只应在启动阶段、dispatchEvents()运行之前调用
+void FrequencyScanner::refillLaps() {
+    for (uint8_t i = 0; i < channelCount; i++) channels[i].refillLaps();
+}
+
+bool FrequencyScanner::addEventSink(laptimer_event_sink_fn sink, void *ctx) {
+    if (eventSinkCount >= LAPTIMER_MAX_EVENT_SINKS) return false;
+    eventSinks[eventSinkCount] = sink;
+    eventSinkCtx[eventSinkCount] = ctx;
+    eventSinkCount++;
+    return true;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "RX5808.h"
+#include "buzzer.h"
+#include "config.h"
+#include "kalman.h"
+#include "lapstore.h"
+#include "laptimer.h"
+#include "led.h"
+#include "sampler.h"
+#include "spsc_queue.h"
+
+/**
+ * 单个RX5808分时扫描多个频率。
+ *
+ * 每个频率依次经过：调谐（tune()，约0.1 ms）→ 稳定（丢弃SCANNER_SETTLE_US内的样本）
+ * → 驻留（SCANNER_DWELL_US内的原始样本取平均，得到该频率的一次“访问”）。
+ * 同一频率两次访问的间隔（重访周期）为
+ *   T = N × (调谐 + SCANNER_SETTLE_US + SCANNER_DWELL_US)
+ * 每个频率有独立的卡尔曼滤波、滞回检测和圈速存储，访问序列上的峰值用前后两次访问做抛物线插值。
+ *
+ * 计时误差预算（稳定35 ms、驻留5 ms，即每频率约40 ms）。p99为native scan仿真2米门、3个种子各30圈中最差频率的值，
+ * 10 - 30 m/s之间变化不大：
+ *   频率数   重访周期   无插值最大误差(T/2)   p99（无多径）   p99（2处多径凹陷）
+ *     2        82 ms          ±41 ms              约14 ms          50 - 75 ms
+ *     3       123 ms          ±61 ms              约22 ms          70 - 115 ms
+ *     4       164 ms          ±82 ms              约29 ms          45 - 115 ms
+ * 2 - 4个频率在10 - 80 m/s、1米和2米门下仿真均无漏圈。
+ * 穿越时信号高于进入阈值的时间必须覆盖至少2次访问，否则会漏圈：2米门30 m/s时约150 ms，
+ * 因此重访周期上限为SCANNER_MAX_REVISIT_US（默认200 ms，默认稳定时间下即4个频率），超出的频率不扫描。
+ * 单频模式（连续采样）在同一仿真（native bench）中无多径时p99在30 m/s约2 - 3 ms、15 m/s约6 - 14 ms，
+ * 有多径凹陷时15 m/s可达100 ms以上（扫描在多径下并不比单频差）；无多径时扫描的误差在15 m/s约为单频的2倍，
+ * 30 m/s约为5 - 10倍（不随速度提高而减小），需要精确计时时每个飞手仍应使用独立的节点。
+ * RX5808实际稳定时间短于RX5808_MIN_TUNETIME时，可通过build_flags减小SCANNER_SETTLE_US换取更多频率。
+ */
+#ifndef SCANNER_SETTLE_US
+#define SCANNER_SETTLE_US (RX5808_MIN_TUNETIME * 1000UL)
+#endif
+#ifndef SCANNER_DWELL_US
+#define SCANNER_DWELL_US 5000  // 25 kHz原始采样下约125个样本取平均
+#endif
+#ifndef SCANNER_MAX_REVISIT_US
+#define SCANNER_MAX_REVISIT_US 200000
+#endif
+#define SCANNER_MAX_CHANNELS CONFIG_MAX_SCAN_CHANNELS
+#define SCANNER_TUNE_BUDGET_US 500  // 估算重访周期时每次调谐的预留时间
+// 驻留平均后噪声已很小，滤波只做轻度平滑：访问间隔长，平滑过重会使峰值滞后（4个频率时约+15 ms）
+#define SCANNER_FILTER_MEASUREMENT 16.0f
+#define SCANNER_FILTER_PROCESS 1024.0f
+#define SCANNER_CMD_QUEUE_SIZE 8
+#define SCANNER_EVENT_QUEUE_SIZE 32
+
+/**
+ * 单个频率的检测状态，只在计时核上修改。
+ * 检测方式与LapTimer的滞回检测相同：高于enterRssi开窗，低于exitRssi关窗，窗内取最大值。
+ */
+class ScanChannel {
+   public:
+    void init(uint8_t index, uint16_t frequency, Config *config);
+    void start(uint64_t timeUs);
+    void stop();
+    // 处理一次访问，产生圈速时填写event并返回true
+    bool processVisit(uint16_t rssiQ4, uint64_t timeUs, laptimer_event_t *event);
+
+    uint16_t getFrequency() { return freq; }
+    uint8_t getRssi() { return rssi; }
+    uint32_t getVisits() { return visits; }
+    uint32_t getLapCount() { return laps.getCount(); }
+    uint32_t getLastLapUs() { return laps.getLast(); }
+    const LapStore *getLaps() { return &laps; }
+    void refillLaps() { laps.refill(); }
+
+   private:
+    uint8_t channel = 0;
+    uint16_t freq = 0;
+    Config *conf = nullptr;
+    RssiKalmanFilter filter;
+    LapStore laps;
+    bool running = false;
+    uint64_t startTimeUs = 0;
+    volatile uint8_t rssi = 0;
+    volatile uint32_t visits = 0;
+
+    bool crossingOpen = false;
+    bool peakNeedsNext = false;  // 峰值后的一次访问尚未到来
+    uint16_t prevQ4 = 0;         // 上一次访问的滤波值
+    uint64_t prevTimeUs = 0;
+    uint16_t peakQ4 = 0;
+    uint16_t peakPrevQ4 = 0;
+    uint16_t peakNextQ4 = 0;
+    uint64_t peakTimeUs = 0;
+    uint32_t peakSpanUs = 0;  // 峰值与前一次访问的间隔
+
+    uint64_t interpolatePeak();
+};
+
+/**
+ * 扫描调度器，取代LapTimer在计时核上运行（loop()中调用handleScanUpdate()）。
+ * 命令和事件与LapTimer一样经SPSC队列跨核传递，事件的channel字段为频率序号。
+ */
+class FrequencyScanner {
+   public:
+    // 读取配置的扫描列表，少于2个频率时返回false（保持单频模式）
+    bool begin(Config *config, RX5808 *rx5808, RssiSource *rssiSource, Buzzer *buzzer, Led *l);
+    bool isActive() { return active; }
+    void handleScanUpdate();
+
+    bool postCommand(laptimer_cmd_e cmd);
+    bool postIoCommand(laptimer_cmd_e cmd);  // 同LapTimer::postIoCommand()
+    void dispatchEvents();
+    bool addEventSink(laptimer_event_sink_fn sink, void *ctx);
+    uint8_t getEventSinkCount() { return eventSinkCount; }
+    // 计时核以外的任务定期调用，为各频率的圈速存储补充空闲块
+    void refillLaps();
+
+    uint8_t getChannelCount() { return channelCount; }
+    ScanChannel *getChannel(uint8_t index) { return index < channelCount ? &channels[index] : nullptr; }
+    bool isRunning() { return running; }
+    uint32_t getRevisitUs() { return revisitUs; }  // 实测的重访周期（最近一轮）
+    uint32_t getMaxTuneUs() { return maxTuneUs; }
+    uint32_t getCycles() { return cycles; }
+
+    // 给定稳定、驻留时间和重访周期上限时最多可扫描的频率数
+    static uint8_t maxChannels(uint32_t settleUs, uint32_t dwellUs, uint32_t maxRevisitUs);
+
+   private:
+    Config *conf = nullptr;
+    RX5808 *rx = nullptr;
+    RssiSource *source = nullptr;
+    Buzzer *buz = nullptr;
+    Led *led = nullptr;
+    rssi_block_t block;
+    ScanChannel channels[SCANNER_MAX_CHANNELS];
+    uint8_t channelCount = 0;
+    bool active = false;
+    volatile bool running = false;
+
+    uint8_t current = 0;
+    uint64_t dwellStartUs = 0;  // 稳定结束、开始累加的时刻
+    uint32_t dwellSum = 0;
+    uint16_t dwellCount = 0;
+    uint64_t cycleStartUs = 0;
+    volatile uint32_t revisitUs = 0;
+    volatile uint32_t maxTuneUs = 0;
+    volatile uint32_t cycles = 0;
+
+    SpscQueue<laptimer_cmd_e, SCANNER_CMD_QUEUE_SIZE> commandQueue;
+    SpscQueue<laptimer_cmd_e, SCANNER_CMD_QUEUE_SIZE> ioCommandQueue;
+    SpscQueue<laptimer_event_t, SCANNER_EVENT_QUEUE_SIZE> eventQueue;
+    laptimer_event_sink_fn eventSinks[LAPTIMER_MAX_EVENT_SINKS];
+    void *eventSinkCtx[LAPTIMER_MAX_EVENT_SINKS];
+    uint8_t eventSinkCount = 0;
+
+    void handleCommands();
+    void start();
+    void stop();
+    void tuneTo(uint8_t index);
+    void finishDwell();
+};
@@ -0,0 +1,193 @@
+#include "spectrum.h"
+
+#include <string.h>
+
+#include "bands.h"
+#include "debug.h"
+#include "hal.h"
+
+void SpectrumSweep::init(RX5808 *rx5808, RssiSource *rssiSource) {
+    rx = rx5808;
+    source = rssiSource;
+}
+
+const char *SpectrumSweep::stateToString(spectrum_state_e s) {
+    switch (s) {
+        case SPECTRUM_IDLE:
+            return "idle";
+        case SPECTRUM_REQUESTED:
+            return "requested";
+        case SPECTRUM_SWEEPING:
+            return "sweeping";
+        case SPECTRUM_FINISHED:
+            return "finished";
+        default:
+            return "unknown";
+    }
+}
+
+bool SpectrumSweep::request(const uint16_t *list, uint8_t n) {
+    if (state != SPECTRUM_IDLE || n == 0) return false;
+    if (n > SPECTRUM_MAX_CHANNELS) n = SPECTRUM_MAX_CHANNELS;
+    memcpy(freqs, list, n * sizeof(uint16_t));
+    count = n;
+    completed = 0;
+    elapsedMs = 0;
+    aborted = false;
+    abortRequested = false;
+    state = SPECTRUM_REQUESTED;
+    return true;
+}
+
+void SpectrumSweep::service() {
+    switch (state) {
+        case SPECTRUM_REQUESTED:
+            if (abortRequested) {
+                aborted = true;
+                state = SPECTRUM_IDLE;
+            } else if (!rx->isCommandActive()) {
+                // 频率状态机没有写到一半的命令，交给计时核
+                tuned = false;
+                state = SPECTRUM_SWEEPING;
+            }
+            break;
+        case SPECTRUM_FINISHED:
+            // 计时核已停止操作总线，交回频率状态机，由它恢复比赛频率
+            state = SPECTRUM_IDLE;
+            break;
+        default:
+            break;
+    }
+}
+
+void SpectrumSweep::tuneTo(uint8_t index) {
+    rx->tune(freqs[index]);
+    // 调谐完成前采到的样本时间戳都早于dwellStartUs，自然被丢弃
+    dwellStartUs = halMicros() + SCANNER_SETTLE_US;
+    dwellSum = 0;
+    dwellCount = 0;
+    dwellPeak = 0;
+}
+
+void SpectrumSweep::finish(bool wasAborted) {
+    elapsedMs = (uint32_t)((halMicros() - startUs) / 1000);
+    aborted = wasAborted;
+    DEBUG("Spectrum sweep %s: %u of %u channels in %u ms\n", wasAborted ? "aborted" : "done", completed, count,
+          elapsedMs);
+
+    spectrum_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = wasAborted ? SPECTRUM_EVENT_ABORTED : SPECTRUM_EVENT_DONE;
+    event.index = completed;
+    event.count = count;
+    event.elapsedMs = elapsedMs;
+    eventQueue.push(event);
+    state = SPECTRUM_FINISHED;
+}
+
+void SpectrumSweep::finishChannel() {
+    const uint8_t index = completed;
+    spectrum_channel_t *channel = &channels[index];
+    channel->freq = freqs[index];
+    channel->peak = RX5808::scaleRssi(dwellPeak);
+    channel->mean = dwellCount ? RX5808::scaleRssi((dwellSum + dwellCount / 2) / dwellCount) : 0;
+    channel->samples = dwellCount;
+    completed = index + 1;  // 先写结果再更新计数，其他任务读到的都是完整结果
+
+    spectrum_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = SPECTRUM_EVENT_CHANNEL;
+    event.index = index;
+    event.count = count;
+    event.channel = *channel;
+    eventQueue.push(event);
+
+    if (completed >= count) {
+        finish(false);
+    } else {
+        tuneTo(completed);
+    }
+}
+
+/**
+ * 计时核主循环调用（代替LapTimer）：稳定期内的样本丢弃，驻留期内累加并记录峰值，
+ * 驻留结束后记下该频率的结果并调到下一个频率。
+ */
+void SpectrumSweep::handleSweepUpdate() {
+    if (!tuned) {
+        tuned = true;
+        startUs = halMicros();
+        DEBUG("Spectrum sweep: %u channels from %u MHz\n", count, freqs[0]);
+        tuneTo(0);
+    }
+    if (abortRequested) {
+        finish(true);
+        return;
+    }
+
+    if (source->readBlock(&block) == 0) return;
+
+    for (uint16_t i = 0; i < block.count && state == SPECTRUM_SWEEPING; i++) {
+        const uint64_t sampleTimeUs = block.startUs + (uint64_t)i * block.periodUs;
+        if (sampleTimeUs < dwellStartUs) continue;
+        const uint16_t raw = block.raw[i];
+        dwellSum += raw;
+        dwellCount++;
+        if (raw > dwellPeak) dwellPeak = raw;
+        if (sampleTimeUs - dwellStartUs >= SPECTRUM_DWELL_US) {
+            finishChannel();
+        }
+    }
+}
+
+// 在parallelTask中调用
+void SpectrumSweep::dispatchEvents() {
+    spectrum_event_t event;
+    while (eventQueue.pop(&event)) {
+        for (uint8_t i = 0; i < eventSinkCount; i++) {
+            eventSinks[i](&event, eventSinkCtx[i]);
+        }
+    }
+}
+
+// 只应在启动阶段、dispatchEvents()运行之前调用
+bool SpectrumSweep::addEventSink(spectrum_event_sink_fn sink, void *ctx) {
+    if (eventSinkCount >= SPECTRUM_MAX_EVENT_SINKS) return false;
+    eventSinks[eventSinkCount] = sink;
+    eventSinkCtx[eventSinkCount] = ctx;
+    eventSinkCount++;
+    return true;
+}
+
+static uint8_t insertSorted(uint16_t freq, uint16_t *freqs, uint8_t n, uint8_t maxCount) {
+    uint8_t pos = 0;
+    while (pos < n && freqs[pos] < freq) pos++;
+    if ((pos < n && freqs[pos] == freq) || n >= maxCount) return n;
+    memmove(&freqs[pos + 1], &freqs[pos], (n - pos) * sizeof(uint16_t));
+    freqs[pos] = freq;
+    return n + 1;
+}
+
+uint8_t SpectrumSweep::bandFrequencies(const char *bands, uint16_t *freqs, uint8_t maxCount) {
+    uint8_t n = 0;
+    for (const char *c = bands; *c; c++) {
+        const char *letter = strchr(RX5808_BAND_NAMES, *c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : *c);
+        if (letter == nullptr || *letter == '\0') continue;
+        const uint8_t band = letter - RX5808_BAND_NAMES;
+        for (uint8_t ch = 0; ch < RX5808_BAND_CHANNELS; ch++) {
+            n = insertSorted(RX5808_BANDS[band][ch], freqs, n, maxCount);
+        }
+    }
+    return n;
+}
+
+uint8_t SpectrumSweep::rangeFrequencies(uint16_t from, uint16_t to, uint16_t step, uint16_t *freqs, uint8_t maxCount) {
+    if (from < RX5808_FREQ_MIN_MHZ) from = RX5808_FREQ_MIN_MHZ;
+    if (to > RX5808_FREQ_MAX_MHZ) to = RX5808_FREQ_MAX_MHZ;
+    if (step == 0) step = 1;
+    uint8_t n = 0;
+    for (uint32_t f = from; f <= to && n < maxCount; f += step) {
+        freqs[n++] = f;
+    }
+    return n;
+}
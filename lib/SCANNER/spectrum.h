@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "RX5808.h"
+#include "sampler.h"
+#include "scanner.h"
+#include "spsc_queue.h"
+
+#define SPECTRUM_MAX_CHANNELS 64
+#ifndef SPECTRUM_DWELL_US
+#define SPECTRUM_DWELL_US 10000  // 每个频率稳定后采集10 ms，取峰值和平均值
+#endif
+#define SPECTRUM_EVENT_QUEUE_SIZE 16
+#define SPECTRUM_MAX_EVENT_SINKS 2
+
+typedef enum {
+    SPECTRUM_IDLE,
+    SPECTRUM_REQUESTED,  // 已收到请求，等parallelTask交出接收机
+    SPECTRUM_SWEEPING,   // 计时核在扫描
+    SPECTRUM_FINISHED    // 扫描结束或中止，等parallelTask收回接收机并恢复比赛频率
+} spectrum_state_e;
+
+typedef enum {
+    SPECTRUM_EVENT_CHANNEL,
+    SPECTRUM_EVENT_DONE,
+    SPECTRUM_EVENT_ABORTED
+} spectrum_event_e;
+
+typedef struct {
+    uint16_t freq;
+    uint8_t peak;   // 驻留期内的最大RSSI（0 - 255，与计时RSSI同一刻度）
+    uint8_t mean;
+    uint16_t samples;
+} spectrum_channel_t;
+
+typedef struct {
+    spectrum_event_e type;
+    uint8_t index;  // CHANNEL：频率序号
+    uint8_t count;
+    spectrum_channel_t channel;
+    uint32_t elapsedMs;  // DONE/ABORTED：整次扫描耗时
+} spectrum_event_t;
+
+typedef void (*spectrum_event_sink_fn)(const spectrum_event_t *event, void *ctx);
+
+/**
+ * 赛前频谱扫描：把RX5808依次调到列表中的每个频率，稳定SCANNER_SETTLE_US后采集SPECTRUM_DWELL_US，
+ * 记录峰值和平均RSSI，每完成一个频率推送一个事件。每个频率约45 ms，扫描速度只受调谐稳定时间限制。
+ *
+ * 接收机的交接都在parallelTask（service()）中完成，计时核与频率状态机不会同时操作总线：
+ *   request()（网页） → REQUESTED → service()：总线空闲时 → SWEEPING → 计时核handleSweepUpdate()
+ *   → FINISHED → service() → IDLE，之后handleFrequencyChange()发现频率不一致，重新调回配置的比赛频率并校验。
+ * 扫描期间计时核不运行LapTimer，因此只允许在未计时、未校准时开始，多频扫描模式下不可用。
+ */
+class SpectrumSweep {
+   public:
+    void init(RX5808 *rx5808, RssiSource *rssiSource);
+
+    // AsyncTCP任务调用：空闲时接受新的频率列表
+    bool request(const uint16_t *freqs, uint8_t count);
+    void abort() { abortRequested = true; }
+
+    // parallelTask调用：交接接收机；ownsReceiver()为true时不能调用rx.handleFrequencyChange()
+    void service();
+    bool ownsReceiver() { return state == SPECTRUM_SWEEPING || state == SPECTRUM_FINISHED; }
+    void dispatchEvents();
+    bool addEventSink(spectrum_event_sink_fn sink, void *ctx);
+
+    // 计时核调用
+    bool isSweeping() { return state == SPECTRUM_SWEEPING; }
+    void handleSweepUpdate();
+
+    spectrum_state_e getState() { return state; }
+    static const char *stateToString(spectrum_state_e s);
+    uint8_t getCount() { return count; }
+    uint8_t getCompleted() { return completed; }
+    const spectrum_channel_t *getChannel(uint8_t index) { return index < completed ? &channels[index] : nullptr; }
+    uint32_t getElapsedMs() { return elapsedMs; }
+    bool wasAborted() { return aborted; }
+
+    // 频段字母（如"RF"，见bands.h）对应的频率，去重并按频率排序；返回数量
+    static uint8_t bandFrequencies(const char *bands, uint16_t *freqs, uint8_t maxCount);
+    // from到to每step MHz一个频率；返回数量
+    static uint8_t rangeFrequencies(uint16_t from, uint16_t to, uint16_t step, uint16_t *freqs, uint8_t maxCount);
+
+   private:
+    RX5808 *rx = nullptr;
+    RssiSource *source = nullptr;
+    rssi_block_t block;
+    volatile spectrum_state_e state = SPECTRUM_IDLE;
+    volatile bool abortRequested = false;
+    volatile bool aborted = false;
+
+    uint16_t freqs[SPECTRUM_MAX_CHANNELS];
+    spectrum_channel_t channels[SPECTRUM_MAX_CHANNELS];
+    uint8_t count = 0;
+    volatile uint8_t completed = 0;
+    volatile uint32_t elapsedMs = 0;
+
+    // 以下只在计时核上使用
+    bool tuned = false;
+    uint64_t startUs = 0;
+    uint64_t dwellStartUs = 0;
+    uint32_t dwellSum = 0;
+    uint16_t dwellCount = 0;
+    uint16_t dwellPeak = 0;
+
+    SpscQueue<spectrum_event_t, SPECTRUM_EVENT_QUEUE_SIZE> eventQueue;
+    spectrum_event_sink_fn eventSinks[SPECTRUM_MAX_EVENT_SINKS];
+    void *eventSinkCtx[SPECTRUM_MAX_EVENT_SINKS];
+    uint8_t eventSinkCount = 0;
+
+    void tuneTo(uint8_t index);
+    void finishChannel();
+    void finish(bool wasAborted);
+};
@@ -0,0 +1,265 @@
+#include "serial_link.h"
+
+#include <string.h>
+
+#include "crc.h"
+
+#define SERIAL_LINK_HEADER_BYTES 2
+#define SERIAL_LINK_CRC_BYTES 4
+
+// 逐字节COBS编码，帧头、payload和CRC不必先拼到一个缓冲里
+typedef struct {
+    uint8_t *out;
+    size_t write;
+    size_t codeIndex;
+    uint8_t code;
+} cobs_writer_t;
+
+static void cobsBegin(cobs_writer_t *w, uint8_t *out) {
+    w->out = out;
+    w->codeIndex = 0;
+    w->write = 1;
+    w->code = 1;
+}
+
+static void cobsPut(cobs_writer_t *w, uint8_t b) {
+    if (b == 0) {
+        w->out[w->codeIndex] = w->code;
+        w->code = 1;
+        w->codeIndex = w->write++;
+        return;
+    }
+    w->out[w->write++] = b;
+    if (++w->code == 0xFF) {
+        w->out[w->codeIndex] = w->code;
+        w->code = 1;
+        w->codeIndex = w->write++;
+    }
+}
+
+static size_t cobsEnd(cobs_writer_t *w) {
+    w->out[w->codeIndex] = w->code;
+    return w->write;
+}
+
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+    cobs_writer_t w;
+    cobsBegin(&w, out);
+    for (size_t i = 0; i < len; i++) cobsPut(&w, in[i]);
+    return cobsEnd(&w);
+}
+
+// 写指针总不超过读指针，in和out可以是同一个缓冲
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out, size_t size) {
+    size_t r = 0;
+    size_t w = 0;
+    while (r < len) {
+        const uint8_t code = in[r++];
+        if (code == 0) return 0;
+        for (uint8_t i = 1; i < code; i++) {
+            if (r >= len || w >= size || in[r] == 0) return 0;
+            out[w++] = in[r++];
+        }
+        if (code != 0xFF && r < len) {
+            if (w >= size) return 0;
+            out[w++] = 0;
+        }
+    }
+    return w;
+}
+
+size_t serialLinkEncode(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, uint8_t *out) {
+    const uint8_t header[SERIAL_LINK_HEADER_BYTES] = {type, seq};
+    uint32_t crc = crc32Update(0, header, sizeof(header));
+    crc = crc32Update(crc, payload, len);
+    cobs_writer_t w;
+    cobsBegin(&w, out);
+    cobsPut(&w, type);
+    cobsPut(&w, seq);
+    for (uint16_t i = 0; i < len; i++) cobsPut(&w, payload[i]);
+    for (uint8_t i = 0; i < SERIAL_LINK_CRC_BYTES; i++) cobsPut(&w, (uint8_t)(crc >> (8 * i)));
+    const size_t n = cobsEnd(&w);
+    out[n] = 0;
+    return n + 1;
+}
+
+void SerialFrameDecoder::feed(const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t b = buf[i];
+        if (b == 0) {
+            finishFrame();
+        } else if (used < sizeof(encoded)) {
+            encoded[used++] = b;
+        } else {
+            overflow = true;
+        }
+    }
+}
+
+void SerialFrameDecoder::finishFrame() {
+    const uint16_t n = used;
+    const bool tooLong = overflow;
+    used = 0;
+    overflow = false;
+    if (n == 0 && !tooLong) return;  // 连续的0x00
+    const size_t len = tooLong ? 0 : cobsDecode(encoded, n, encoded, sizeof(encoded));
+    if (len < SERIAL_LINK_HEADER_BYTES + SERIAL_LINK_CRC_BYTES) {
+        bad++;
+        return;
+    }
+    const size_t body = len - SERIAL_LINK_CRC_BYTES;
+    uint32_t crc;
+    memcpy(&crc, encoded + body, sizeof(crc));
+    if (crc != crc32(encoded, body)) {
+        bad++;
+        return;
+    }
+    const uint8_t seq = encoded[1];
+    if (haveSeq && seq != (uint8_t)(lastSeq + 1)) seqGaps++;
+    haveSeq = true;
+    lastSeq = seq;
+    frames++;
+    if (handler != nullptr) {
+        handler(encoded[0], seq, encoded + SERIAL_LINK_HEADER_BYTES, (uint16_t)(body - SERIAL_LINK_HEADER_BYTES), ctx);
+    }
+}
+
+void SerialLink::begin(SerialPort *serialPort, serial_command_fn fn, void *context) {
+    port = serialPort;
+    handler = fn;
+    ctx = context;
+    decoder.setHandler(onFrame, this);
+    memset(history, 0, sizeof(history));
+    eventSeq = 0;
+    streamBucketUs = 0;
+}
+
+void SerialLink::service(uint64_t now) {
+    if (port == nullptr) return;
+    nowUs = now;
+    uint8_t buf[64];
+    size_t total = 0;
+    size_t n;
+    while (total < SERIAL_LINK_READ_BYTES && (n = port->read(buf, sizeof(buf))) > 0) {
+        decoder.feed(buf, n);
+        total += n;
+    }
+}
+
+bool SerialLink::send(uint8_t type, const void *payload, uint16_t len, bool droppable) {
+    if (port == nullptr || len > SERIAL_LINK_MAX_PAYLOAD) return false;
+    const size_t n = serialLinkEncode(type, txSeq, (const uint8_t *)payload, len, txBuf);
+    if (droppable && port->availableForWrite() < n) {
+        txDropped++;
+        return false;
+    }
+    txSeq++;
+    return port->write(txBuf, n) == n;
+}
+
+void SerialLink::ack(uint8_t type, uint8_t seq, uint8_t result) {
+    const serial_ack_t a = {type, seq, result};
+    send(SERIAL_MSG_ACK, &a, sizeof(a), false);
+}
+
+void SerialLink::onFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, void *ctx) {
+    ((SerialLink *)ctx)->handleFrame(type, seq, payload, len);
+}
+
+void SerialLink::handleFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len) {
+    commands++;
+    if (type == SERIAL_CMD_PING) {
+        if (len < sizeof(uint64_t)) return;
+        serial_pong_t pong;
+        memcpy(&pong.hostUs, payload, sizeof(pong.hostUs));
+        pong.deviceUs = nowUs;
+        send(SERIAL_MSG_PONG, &pong, sizeof(pong), false);
+        return;
+    }
+    if (type == SERIAL_CMD_RESEND) {
+        if (len < 5) return;
+        uint32_t first;
+        memcpy(&first, payload, sizeof(first));
+        const uint32_t oldest = eventSeq > SERIAL_LINK_HISTORY ? eventSeq - SERIAL_LINK_HISTORY + 1 : 1;
+        for (uint32_t s = first; s < first + payload[4]; s++) {
+            if (s < oldest || s > eventSeq) continue;
+            serial_event_t *e = &history[s % SERIAL_LINK_HISTORY];
+            e->sendUs = nowUs;
+            e->resent = 1;
+            if (send(SERIAL_MSG_EVENT, e, sizeof(*e), false)) resent++;
+        }
+        return;
+    }
+
+    serial_link_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = type;
+    cmd.seq = seq;
+    uint8_t result = SERIAL_RESULT_OK;
+    switch (type) {
+        case SERIAL_CMD_START:
+        case SERIAL_CMD_STOP:
+        case SERIAL_CMD_STATUS:
+            break;
+        case SERIAL_CMD_SET_FREQ:
+            if (len < sizeof(cmd.frequency)) {
+                result = SERIAL_RESULT_BAD_ARGS;
+                break;
+            }
+            memcpy(&cmd.frequency, payload, sizeof(cmd.frequency));
+            break;
+        case SERIAL_CMD_SET_RSSI:
+            if (len < 2) {
+                result = SERIAL_RESULT_BAD_ARGS;
+                break;
+            }
+            cmd.enterRssi = payload[0];
+            cmd.exitRssi = payload[1];
+            break;
+        case SERIAL_CMD_STREAM:
+            if (len < sizeof(cmd.bucketUs)) {
+                result = SERIAL_RESULT_BAD_ARGS;
+                break;
+            }
+            memcpy(&cmd.bucketUs, payload, sizeof(cmd.bucketUs));
+            break;
+        default:
+            result = SERIAL_RESULT_UNKNOWN;  // 包括设备自己发出的类型
+            break;
+    }
+    if (result == SERIAL_RESULT_OK) result = handler != nullptr ? handler(&cmd, ctx) : (uint8_t)SERIAL_RESULT_UNKNOWN;
+    if (result == SERIAL_RESULT_OK && type == SERIAL_CMD_STREAM) streamBucketUs = cmd.bucketUs;
+    ack(type, seq, result);
+}
+
+void SerialLink::sendEvent(uint8_t event, uint8_t channel, uint16_t frequency, uint32_t lapNumber,
+                           uint32_t lapTimeUs, uint64_t eventUs, uint8_t peakRssi, uint64_t now) {
+    eventSeq++;
+    serial_event_t *e = &history[eventSeq % SERIAL_LINK_HISTORY];
+    e->seq = eventSeq;
+    e->event = event;
+    e->channel = channel;
+    e->frequency = frequency;
+    e->lapNumber = lapNumber;
+    e->lapTimeUs = lapTimeUs;
+    e->eventUs = eventUs;
+    e->sendUs = now;
+    e->peakRssi = peakRssi;
+    e->resent = 0;
+    send(SERIAL_MSG_EVENT, e, sizeof(*e), false);
+}
+
+bool SerialLink::sendRssi(const uint8_t *frame, uint16_t len) {
+    if (!send(SERIAL_MSG_RSSI, frame, len, true)) return false;
+    rssiFrames++;
+    return true;
+}
+
+void SerialLink::sendStatus(serial_status_t *status) {
+    status->version = SERIAL_LINK_VERSION;
+    status->bucketUs = streamBucketUs;
+    status->lastSeq = eventSeq;
+    status->rxBad = decoder.getBad();
+    status->txDropped = txDropped;
+    send(SERIAL_MSG_STATUS, status, sizeof(*status), false);
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 有线串口二进制协议，决赛时给比赛控制电脑用：不经过WiFi，延迟只取决于串口。
+ *
+ * 帧：type(1) seq(1) payload(n) crc32(4)，整体做COBS编码后以一个0x00结尾。
+ * COBS保证帧内没有0x00，接收方从任意位置开始都能在下一个0x00处重新对齐（上电时的ROM输出、插拔时的乱码都会被跳过）；
+ * CRC不对的帧直接丢弃并计数。seq是发送方每帧加一的8位计数，两个方向各自独立。
+ *
+ * 设备发出的计时事件另有32位事件序号，电脑发现缺号时发RESEND，设备从最近SERIAL_LINK_HISTORY个事件中重发；
+ * 其他命令都回ACK，带上命令的type和seq。RSSI帧的payload原样是rssi_stream.h中的WebSocket帧。
+ * 协议启用后串口切到SERIAL_LINK_BAUD，DEBUG文本不再写串口（见debug.h的debugMuted）。
+ * 字段为小端字节序。
+ */
+#define SERIAL_LINK_BAUD 921600
+#define SERIAL_LINK_VERSION 1
+#define SERIAL_LINK_MAX_PAYLOAD 600  // 不小于RSSI_STREAM_FRAME_MAX_BYTES
+#define SERIAL_LINK_MAX_FRAME (2 + SERIAL_LINK_MAX_PAYLOAD + 4)
+#define SERIAL_LINK_MAX_ENCODED (SERIAL_LINK_MAX_FRAME + SERIAL_LINK_MAX_FRAME / 254 + 2)
+#define SERIAL_LINK_HISTORY 16
+#define SERIAL_LINK_READ_BYTES 256  // service()每次最多读的字节数
+
+typedef enum {
+    // 电脑 -> 设备
+    SERIAL_CMD_PING = 0x01,        // u64 hostUs，设备回PONG
+    SERIAL_CMD_START = 0x02,
+    SERIAL_CMD_STOP = 0x03,
+    SERIAL_CMD_SET_FREQ = 0x04,    // u16 MHz
+    SERIAL_CMD_SET_RSSI = 0x05,    // u8 enterRssi, u8 exitRssi
+    SERIAL_CMD_STREAM = 0x06,      // u32 bucketUs，0为关闭RSSI帧
+    SERIAL_CMD_STATUS = 0x07,      // 设备回STATUS
+    SERIAL_CMD_RESEND = 0x08,      // u32 firstSeq, u8 count
+    // 设备 -> 电脑
+    SERIAL_MSG_ACK = 0x80,
+    SERIAL_MSG_PONG = 0x81,
+    SERIAL_MSG_EVENT = 0x82,
+    SERIAL_MSG_RSSI = 0x83,
+    SERIAL_MSG_STATUS = 0x84
+} serial_link_type_e;
+
+typedef enum {
+    SERIAL_RESULT_OK = 0,
+    SERIAL_RESULT_REJECTED = 1,  // 当前状态下不能执行，如命令队列满、频谱扫描中
+    SERIAL_RESULT_BAD_ARGS = 2,
+    SERIAL_RESULT_UNKNOWN = 3
+} serial_link_result_e;
+
+typedef struct __attribute__((packed)) {
+    uint8_t cmdType;
+    uint8_t cmdSeq;
+    uint8_t result;
+} serial_ack_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t hostUs;    // 电脑发出PING的时刻，原样带回
+    uint64_t deviceUs;  // 设备处理PING的时刻（esp_timer）
+} serial_pong_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;      // 事件序号，从1开始
+    uint8_t event;     // laptimer_event_e
+    uint8_t channel;   // 多频扫描时的频率序号
+    uint16_t frequency;
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t eventUs;  // 事件时刻（esp_timer）
+    uint64_t sendUs;   // 本次发送时刻，重发时更新
+    uint8_t peakRssi;
+    uint8_t resent;
+} serial_event_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t running;
+    uint16_t frequency;
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint8_t rssi;
+    uint32_t bucketUs;  // 当前RSSI帧的分辨率，0为关闭
+    uint32_t lastSeq;   // 最新事件序号
+    uint32_t rxBad;     // 设备收到的坏帧数
+    uint32_t txDropped; // 串口忙时丢弃的RSSI帧数
+    uint64_t nowUs;
+} serial_status_t;
+
+// 解析后的命令，按type使用对应字段
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t frequency;
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint32_t bucketUs;
+} serial_link_cmd_t;
+
+// 返回serial_link_result_e；STATUS命令由处理函数调用sendStatus()
+typedef uint8_t (*serial_command_fn)(const serial_link_cmd_t *cmd, void *ctx);
+
+// COBS编码，out至少len + len / 254 + 1字节，返回编码后长度（不含结尾的0x00）
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+// COBS解码（不含结尾的0x00），格式错误返回0
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out, size_t size);
+
+/**
+ * 串口字节流：设备上为HardwareSerial，主机上为termios打开的tty/pty。
+ */
+class SerialPort {
+   public:
+    virtual ~SerialPort() {}
+    // 发送缓冲写不下时阻塞到写完
+    virtual size_t write(const uint8_t *buf, size_t len) = 0;
+    virtual size_t availableForWrite() = 0;
+    // 非阻塞，没有数据时返回0
+    virtual size_t read(uint8_t *buf, size_t size) = 0;
+};
+
+/**
+ * 接收端的帧同步：逐字节喂入，遇到0x00时解码并校验CRC，完整的帧交给回调。
+ * 电脑和设备共用。
+ */
+typedef void (*serial_frame_fn)(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, void *ctx);
+
+class SerialFrameDecoder {
+   public:
+    void setHandler(serial_frame_fn fn, void *context) {
+        handler = fn;
+        ctx = context;
+    }
+    void feed(const uint8_t *buf, size_t len);
+    uint32_t getFrames() { return frames; }
+    uint32_t getBad() { return bad; }  // 解码失败、CRC错误或超长
+    uint32_t getSeqGaps() { return seqGaps; }
+
+   private:
+    serial_frame_fn handler = nullptr;
+    void *ctx = nullptr;
+    uint8_t encoded[SERIAL_LINK_MAX_ENCODED];
+    uint16_t used = 0;
+    bool overflow = false;
+    bool haveSeq = false;
+    uint8_t lastSeq = 0;
+    uint32_t frames = 0;
+    uint32_t bad = 0;
+    uint32_t seqGaps = 0;
+
+    void finishFrame();
+};
+
+// 编码一帧，返回写入out的字节数（含结尾的0x00），out至少SERIAL_LINK_MAX_ENCODED字节
+size_t serialLinkEncode(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, uint8_t *out);
+
+/**
+ * 设备端：所有方法须在同一任务中调用（设备上为parallelTask），串口只有这一个写者。
+ * 计时事件、ACK和PONG总是发出（发送缓冲满时短暂阻塞）；RSSI帧在发送缓冲不够时丢弃并计数，不拖慢计时事件。
+ */
+class SerialLink {
+   public:
+    void begin(SerialPort *serialPort, serial_command_fn fn, void *context);
+    bool isActive() { return port != nullptr; }
+    void service(uint64_t nowUs);
+
+    void sendEvent(uint8_t event, uint8_t channel, uint16_t frequency, uint32_t lapNumber, uint32_t lapTimeUs,
+                   uint64_t eventUs, uint8_t peakRssi, uint64_t nowUs);
+    bool sendRssi(const uint8_t *frame, uint16_t len);
+    void sendStatus(serial_status_t *status);
+
+    // 电脑用STREAM命令打开RSSI帧后为非0，由网页的RSSI流一并产出
+    uint32_t getStreamBucketUs() { return streamBucketUs; }
+    uint32_t getLastSeq() { return eventSeq; }
+    uint32_t getCommands() { return commands; }
+    uint32_t getResent() { return resent; }
+    uint32_t getRssiFrames() { return rssiFrames; }
+    uint32_t getTxDropped() { return txDropped; }
+    uint32_t getRxBad() { return decoder.getBad(); }
+
+   private:
+    SerialPort *port = nullptr;
+    serial_command_fn handler = nullptr;
+    void *ctx = nullptr;
+    SerialFrameDecoder decoder;
+    uint8_t txSeq = 0;
+    uint8_t txBuf[SERIAL_LINK_MAX_ENCODED];
+    serial_event_t history[SERIAL_LINK_HISTORY];
+    uint32_t eventSeq = 0;
+    uint32_t streamBucketUs = 0;
+    uint64_t nowUs = 0;
+    uint32_t commands = 0;
+    uint32_t resent = 0;
+    uint32_t rssiFrames = 0;
+    uint32_t txDropped = 0;
+
+    static void onFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, void *ctx);
+    void handleFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len);
+    bool send(uint8_t type, const void *payload, uint16_t len, bool droppable);
+    void ack(uint8_t type, uint8_t seq, uint8_t result);
+};
+
+#if defined(ARDUINO)
+// 设备上的UART0：begin()时切到指定波特率、加大收发缓冲，并关闭DEBUG文本和IDF日志
+class HardwareSerialPort : public SerialPort {
+   public:
+    void begin(uint32_t baud);
+    size_t write(const uint8_t *buf, size_t len) override;
+    size_t availableForWrite() override;
+    size_t read(uint8_t *buf, size_t size) override;
+};
+#else
+// 主机上的串口或pty：以原始模式打开，非阻塞读
+class PosixSerialPort : public SerialPort {
+   public:
+    ~PosixSerialPort();
+    bool open(const char *path, uint32_t baud);
+    // 接管已打开的描述符（如openpty()得到的一端），同样切到原始模式
+    bool attach(int fd);
+    size_t write(const uint8_t *buf, size_t len) override;
+    size_t availableForWrite() override;
+    size_t read(uint8_t *buf, size_t size) override;
+    int getFd() { return fd; }
+
+   private:
+    int fd = -1;
+};
+#endif
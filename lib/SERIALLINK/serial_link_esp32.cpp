@@ -0,0 +1,39 @@
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <esp_log.h>
+
+#include "debug.h"
+#include "serial_link.h"
+
+#define SERIAL_LINK_RX_BUFFER 1024
+#define SERIAL_LINK_TX_BUFFER 4096  // 921600波特下约44 ms的数据，RSSI帧据此判断是否丢弃
+
+// 串口上只能有一种内容：先关掉DEBUG文本和IDF日志，再切波特率，之后的字节全部是COBS帧
+void HardwareSerialPort::begin(uint32_t baud) {
+    DEBUG("Serial link: switching to %u baud, debug output off\n", baud);
+    Serial.flush();
+    debugMuted = true;
+    esp_log_level_set("*", ESP_LOG_NONE);
+    Serial.setDebugOutput(false);
+    Serial.end();
+    Serial.setRxBufferSize(SERIAL_LINK_RX_BUFFER);
+    Serial.setTxBufferSize(SERIAL_LINK_TX_BUFFER);
+    Serial.begin(baud);
+}
+
+size_t HardwareSerialPort::write(const uint8_t *buf, size_t len) {
+    return Serial.write(buf, len);
+}
+
+size_t HardwareSerialPort::availableForWrite() {
+    return Serial.availableForWrite();
+}
+
+size_t HardwareSerialPort::read(uint8_t *buf, size_t size) {
+    const int n = Serial.available();
+    if (n <= 0) return 0;
+    return Serial.readBytes(buf, (size_t)n < size ? (size_t)n : size);
+}
+
+#endif
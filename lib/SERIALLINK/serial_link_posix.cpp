@@ -0,0 +1,97 @@
+#if !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial_link.h"
+
+#define POSIX_SERIAL_QUEUE 65536  // availableForWrite()假定的内核发送缓冲
+
+static speed_t baudToSpeed(uint32_t baud) {
+    switch (baud) {
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        case 1000000:
+            return B1000000;
+        case 1500000:
+            return B1500000;
+        case 2000000:
+            return B2000000;
+        default:
+            return B0;
+    }
+}
+
+PosixSerialPort::~PosixSerialPort() {
+    if (fd >= 0) close(fd);
+}
+
+bool PosixSerialPort::open(const char *path, uint32_t baud) {
+    const speed_t speed = baudToSpeed(baud);
+    if (speed == B0) return false;
+    const int f = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (f < 0) return false;
+    if (!attach(f)) return false;
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+bool PosixSerialPort::attach(int f) {
+    if (fd >= 0) close(fd);
+    fd = f;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+size_t PosixSerialPort::write(const uint8_t *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t n = ::write(fd, buf + done, len - done);
+        if (n > 0) {
+            done += n;
+        } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        } else {
+            struct pollfd p = {fd, POLLOUT, 0};
+            poll(&p, 1, 10);
+        }
+    }
+    return done;
+}
+
+size_t PosixSerialPort::availableForWrite() {
+    int queued = 0;
+    if (ioctl(fd, TIOCOUTQ, &queued) != 0 || queued < 0) queued = 0;
+    return queued >= POSIX_SERIAL_QUEUE ? 0 : POSIX_SERIAL_QUEUE - queued;
+}
+
+size_t PosixSerialPort::read(uint8_t *buf, size_t size) {
+    const ssize_t n = ::read(fd, buf, size);
+    return n > 0 ? (size_t)n : 0;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool TraceRecorder::requestStart(uint16_t div, uint32_t sampleRateHz, uint8_t enterRssi, uint8_t exitRssi, uint32_t frequency) {
+    if (store == nullptr || getState() != TRACE_IDLE) return false;
+    if (div < 1) div = 1;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader.magic, "QYTR", 4);
+    fileHeader.version = TRACE_FILE_VERSION;
+    fileHeader.headerBytes = sizeof(fileHeader);
+    fileHeader.sampleRateHz = sampleRateHz / div;
+    fileHeader.divider = div;
+    fileHeader.enterRssi = enterRssi;
+    fileHeader.exitRssi = exitRssi;
+    fileHeader.frequency = frequency;
+    divider = div;
+    state.store(TRACE_STARTING, std::memory_order_release);
+    return true;
+}
+
+void TraceRecorder::requestStop() {
+    if (getState() == TRACE_RECORDING) {
+        stopRequested.store(true, std::memory_order_release);
+    }
+}
+
+// 关闭当前缓冲区并交给service()，换到另一个缓冲区
+void TraceRecorder::closeActive() {
+    trace_buffer_t *buf = buffers[active];
+    if (buf->header.count == 0) return;
+    bufferFull[active].store(true, std::memory_order_release);
+    active ^= 1;
+}
+
+// 只在生产者一侧执行，active和未写满的缓冲区不会被两个线程同时改
+bool TraceRecorder::completeStop() {
+    if (!stopRequested.load(std::memory_order_acquire)) return false;
+    // 把未写满的缓冲区也交出去，之后不再写入
+    if (!bufferFull[active].load(std::memory_order_acquire)) closeActive();
+    stopRequested.store(false, std::memory_order_relaxed);
+    state.store(TRACE_STOPPING, std::memory_order_release);
+    return true;
+}
+
+void TraceRecorder::producerIdle() {
+    if (state.load(std::memory_order_acquire) != TRACE_RECORDING) return;
+    completeStop();
+}
+
+void TraceRecorder::push(uint64_t timeUs, uint16_t rawQ4, uint16_t filteredQ4) {
+    if (state.load(std::memory_order_acquire) != TRACE_RECORDING) return;
+    if (completeStop()) return;
+
+    if (++phase < divider) return;
+    phase = 0;
+
+    // 当前缓冲区还在等待写出，说明两个都满了，丢弃样本
+    if (bufferFull[active].load(std::memory_order_acquire)) {
+        pendingDrops++;
+        dropped = dropped + 1;
+        return;
+    }
+
+    trace_buffer_t *buf = buffers[active];
+    if (buf->header.count == 0) {
+        buf->header.magic = TRACE_BLOCK_MAGIC;
+        buf->header.droppedBefore = pendingDrops;
+        buf->header.startUs = timeUs;
+        pendingDrops = 0;
+        lastTimeUs = timeUs;
+    }
+    const uint64_t dt = timeUs - lastTimeUs;
+    trace_sample_t *s = &buf->samples[buf->header.count++];
+    s->dtUs = dt > 0xFFFF ? 0xFFFF : (uint16_t)dt;
+    s->rawQ4 = rawQ4;
+    s->filteredQ4 = filteredQ4;
+    lastTimeUs = timeUs;
+
+    if (buf->header.count == TRACE_BUFFER_SAMPLES) closeActive();
+}
+
+void TraceRecorder::startRecording(uint64_t nowUs) {
+    for (uint8_t i = 0; i < 2; i++) {
+        if (buffers[i] == nullptr) buffers[i] = (trace_buffer_t *)malloc(sizeof(trace_buffer_t));
+    }
+    capacity = (buffers[0] && buffers[1]) ? store->begin() : 0;
+    if (capacity < sizeof(fileHeader) + sizeof(trace_buffer_t)) {
+        finishRecording();
+        return;
+    }
+    fileHeader.startUs = nowUs;
+    store->write((const uint8_t *)&fileHeader, sizeof(fileHeader));
+    bytesWritten = sizeof(fileHeader);
+    samplesWritten = 0;
+    dropped = 0;
+    maxWriteMs = 0;
+    for (uint8_t i = 0; i < 2; i++) {
+        buffers[i]->header.count = 0;
+        bufferFull[i].store(false, std::memory_order_relaxed);
+    }
+    active = 0;
+    phase = 0;
+    pendingDrops = 0;
+    stopRequested.store(false, std::memory_order_relaxed);
+    state.store(TRACE_RECORDING, std::memory_order_release);
+}
+
+void TraceRecorder::finishRecording() {
+    store->end();
+    for (uint8_t i = 0; i < 2; i++) {
+        free(buffers[i]);
+        buffers[i] = nullptr;
+        bufferFull[i].store(false, std::memory_order_relaxed);
+    }
+    state.store(TRACE_IDLE, std::memory_order_release);
+}
+
+bool TraceRecorder::flushBuffer(uint8_t index) {
+    trace_buffer_t *buf = buffers[index];
+    const uint32_t len = sizeof(trace_block_header_t) + buf->header.count * sizeof(trace_sample_t);
+    // 存储写满后自动停止，已写入的数据保持完整
+    if (bytesWritten + len > capacity) return false;
+
+    const uint32_t startMs = clockMs ? clockMs() : 0;
+    const bool ok = store->write((const uint8_t *)buf, len);
+    if (clockMs) {
+        const uint32_t elapsedMs = clockMs() - startMs;
+        if (elapsedMs > maxWriteMs) maxWriteMs = elapsedMs;
+    }
+    if (!ok) return false;
+    bytesWritten = bytesWritten + len;
+    samplesWritten = samplesWritten + buf->header.count;
+    buf->header.count = 0;
+    return true;
+}
+
+void TraceRecorder::service(uint64_t nowUs) {
+    trace_state_e s = getState();
+    if (s == TRACE_IDLE) return;
+    if (s == TRACE_STARTING) {
+        startRecording(nowUs);
+        return;
+    }
+
+    // 两个都满时生产者停在active上不动，active就是先写满的那个，按顺序先写它
+    const uint8_t first = active;
+    for (uint8_t n = 0; n < 2; n++) {
+        const uint8_t i = (first + n) & 1;
+        if (!bufferFull[i].load(std::memory_order_acquire)) continue;
+        if (!flushBuffer(i)) {
+            // 空间不足或写入失败：停止录制，等生产者停下后收尾
+            requestStop();
+            bufferFull[i].store(false, std::memory_order_release);
+            buffers[i]->header.count = 0;
+            continue;
+        }
+        bufferFull[i].store(false, std::memory_order_release);
+    }
+
+    if (getState() == TRACE_STOPPING && !bufferFull[0].load(std::memory_order_acquire) &&
+        !bufferFull[1].load(std::memory_order_acquire)) {
+        finishRecording();
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#define TRACE_BUFFER_SAMPLES 1024  // 每个缓冲区的样本数，5 kHz下约200 ms
+#define TRACE_BLOCK_MAGIC 0x4254   // "TB"
+#define TRACE_FILE_VERSION 1
+#define TRACE_RESERVE_BYTES 65536  // LittleFS上给其他文件保留的空间
+#define TRACE_PSRAM_BYTES (2 * 1024 * 1024)  // PSRAM后端的录制容量
+
+/*
+ * 录制文件格式（小端）：
+ *
+ *   trace_file_header_t                          32字节，文件开头一次
+ *   { trace_block_header_t + count * trace_sample_t } ...
+ *
+ * 每个块对应一个写满（或录制结束时未写满）的缓冲区。块内第一个样本的时刻为
+ * startUs，之后每个样本的时刻为前一个加上dtUs。dtUs饱和于65535，
+ * 此时真实间隔未知（只在采样源长时间停顿时出现）。
+ * droppedBefore是写入跟不上时在本块之前丢掉的样本数，非0表示时间轴上有缺口。
+ * rawQ4是滤波前RSSI，filteredQ4是卡尔曼滤波后RSSI，均为12.4定点（rssi * 16）。
+ * 解析工具见tools/trace/trace_dump.cpp。
+ */
+typedef struct __attribute__((packed)) {
+    char magic[4];          // "QYTR"
+    uint16_t version;       // TRACE_FILE_VERSION
+    uint16_t headerBytes;   // sizeof(trace_file_header_t)
+    uint32_t sampleRateHz;  // 检测器标称采样率除以divider
+    uint16_t divider;       // 每divider个检测器样本记录一个
+    uint8_t enterRssi;      // 录制开始时的进入/退出阈值
+    uint8_t exitRssi;
+    uint32_t frequency;  // 录制时的频率（MHz）
+    uint64_t startUs;    // 录制开始时刻（esp_timer）
+    uint8_t reserved[4];
+} trace_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;  // TRACE_BLOCK_MAGIC
+    uint16_t count;
+    uint32_t droppedBefore;
+    uint64_t startUs;
+} trace_block_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t dtUs;
+    uint16_t rawQ4;
+    uint16_t filteredQ4;
+} trace_sample_t;
+
+static_assert(sizeof(trace_file_header_t) == 32, "trace header must be 32 bytes");
+static_assert(sizeof(trace_block_header_t) == 16, "trace block header must be 16 bytes");
+static_assert(sizeof(trace_sample_t) == 6, "trace sample must be 6 bytes");
+
+/**
+ * 录制存储后端：LittleFS文件，或有PSRAM的板子上放在PSRAM里。
+ * read()用于下载，只在没有录制时调用。
+ */
+class TraceStorage {
+   public:
+    virtual ~TraceStorage() {}
+    // 清空并准备写入，返回可用容量（字节），0表示失败
+    virtual uint32_t begin() = 0;
+    virtual bool write(const uint8_t *buf, uint32_t len) = 0;
+    virtual void end() {}
+    virtual uint32_t size() = 0;
+    virtual uint32_t read(uint32_t offset, uint8_t *buf, uint32_t len) = 0;
+};
+
+typedef enum {
+    TRACE_IDLE,
+    TRACE_STARTING,
+    TRACE_RECORDING,
+    TRACE_STOPPING
+} trace_state_e;
+
+typedef struct {
+    trace_block_header_t header;
+    trace_sample_t samples[TRACE_BUFFER_SAMPLES];
+} trace_buffer_t;
+
+/**
+ * 全速率RSSI录制器，双缓冲。
+ * push()在计时核上逐样本调用，只写内存；写满一个缓冲区后换到另一个，
+ * 两个都满时丢样本并计数。service()在IO任务中把写满的缓冲区写入存储。
+ * requestStart()/requestStop()只置标志，实际打开/关闭存储都在service()里完成。
+ * 停止请求由生产者交出最后一个缓冲区后才算完成；计时核暂时不产生样本时
+ * （多频扫描、频谱扫描期间）由同一任务调用producerIdle()完成。
+ */
+class TraceRecorder {
+   public:
+    void setStorage(TraceStorage *storage) { store = storage; }
+    bool requestStart(uint16_t divider, uint32_t sampleRateHz, uint8_t enterRssi, uint8_t exitRssi, uint32_t frequency);
+    void requestStop();
+
+    // 计时核调用
+    void push(uint64_t timeUs, uint16_t rawQ4, uint16_t filteredQ4);
+    // 计时核本轮没有调用push()时调用
+    void producerIdle();
+    // IO任务调用，nowUs用于文件头的开始时刻
+    void service(uint64_t nowUs);
+
+    trace_state_e getState() { return state.load(std::memory_order_acquire); }
+    bool isRecording() { return getState() != TRACE_IDLE; }
+    uint32_t getSamples() { return samplesWritten; }
+    uint32_t getDropped() { return dropped; }
+    uint32_t getBytes() { return bytesWritten; }
+    uint32_t getCapacity() { return capacity; }
+    uint32_t getMaxWriteMs() { return maxWriteMs; }
+    TraceStorage *getStorage() { return store; }
+
+    // 写入耗时统计用的时钟（毫秒），默认为空（不统计）
+    void setClock(uint32_t (*clock)(void)) { clockMs = clock; }
+
+   private:
+    void startRecording(uint64_t nowUs);
+    void finishRecording();
+    bool flushBuffer(uint8_t index);
+    void closeActive();
+    bool completeStop();
+
+    TraceStorage *store = nullptr;
+    uint32_t (*clockMs)(void) = nullptr;
+    std::atomic<trace_state_e> state{TRACE_IDLE};
+    std::atomic<bool> stopRequested{false};
+    // 两个缓冲区的所有权：false属于生产者，true表示已写满、等待service()写出
+    std::atomic<bool> bufferFull[2] = {{false}, {false}};
+    trace_buffer_t *buffers[2] = {nullptr, nullptr};
+    trace_file_header_t fileHeader;
+
+    // 以下只由生产者（计时核）修改
+    volatile uint8_t active = 0;
+    uint16_t divider = 1;
+    uint16_t phase = 0;
+    uint64_t lastTimeUs = 0;
+    uint32_t pendingDrops = 0;
+    volatile uint32_t dropped = 0;
+
+    // 以下只由service()修改
+    volatile uint32_t samplesWritten = 0;
+    volatile uint32_t bytesWritten = 0;
+    uint32_t capacity = 0;
+    uint32_t maxWriteMs = 0;
+};
+
+/**
+ * LittleFS后端：录制时以写方式打开文件，只在结束时flush一次。
+ * 容量为文件系统剩余空间减去TRACE_RESERVE_BYTES。
+ */
+class LittleFsTraceStorage : public TraceStorage {
+   public:
+    LittleFsTraceStorage(const char *path);
+    uint32_t begin() override;
+    bool write(const uint8_t *buf, uint32_t len) override;
+    void end() override;
+    uint32_t size() override;
+    uint32_t read(uint32_t offset, uint8_t *buf, uint32_t len) override;
+    const char *getPath() { return filePath; }
+
+   private:
+    const char *filePath;
+};
+
+/**
+ * PSRAM后端：第一次录制时在PSRAM中分配maxBytes，之后复用，断电即丢失。
+ * 没有PSRAM的芯片begin()返回0。
+ */
+class PsramTraceStorage : public TraceStorage {
+   public:
+    PsramTraceStorage(uint32_t maxBytes);
+    uint32_t begin() override;
+    bool write(const uint8_t *buf, uint32_t len) override;
+    uint32_t size() override;
+    uint32_t read(uint32_t offset, uint8_t *buf, uint32_t len) override;
+
+   private:
+    uint8_t *data = nullptr;
+    uint32_t capacity;
+    uint32_t used = 0;
+};
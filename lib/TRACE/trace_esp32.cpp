@@ -0,0 +1,96 @@
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "debug.h"
+#include "trace.h"
+
+// 设备上只有一个录制文件，句柄放在这里，头文件不必引入FS
+static File traceFile;
+static File traceReadFile;
+
+LittleFsTraceStorage::LittleFsTraceStorage(const char *path) : filePath(path) {
+}
+
+uint32_t LittleFsTraceStorage::begin() {
+    if (!LittleFS.begin()) {
+        DEBUG("Trace: LittleFS mount failed\n");
+        return 0;
+    }
+    if (traceReadFile) traceReadFile.close();
+    LittleFS.remove(filePath);
+    // 先删掉旧录制再算剩余空间
+    const size_t total = LittleFS.totalBytes();
+    const size_t used = LittleFS.usedBytes();
+    if (total < used + TRACE_RESERVE_BYTES) return 0;
+    traceFile = LittleFS.open(filePath, FILE_WRITE);
+    if (!traceFile) {
+        DEBUG("Trace: cannot open %s\n", filePath);
+        return 0;
+    }
+    return total - used - TRACE_RESERVE_BYTES;
+}
+
+bool LittleFsTraceStorage::write(const uint8_t *buf, uint32_t len) {
+    return traceFile && traceFile.write(buf, len) == len;
+}
+
+void LittleFsTraceStorage::end() {
+    if (traceFile) traceFile.close();
+}
+
+uint32_t LittleFsTraceStorage::size() {
+    if (traceFile) return traceFile.size();
+    File f = LittleFS.open(filePath, FILE_READ);
+    if (!f) return 0;
+    uint32_t n = f.size();
+    f.close();
+    return n;
+}
+
+// 分块下载按顺序读，读句柄一直保持打开，下一次begin()时关闭
+uint32_t LittleFsTraceStorage::read(uint32_t offset, uint8_t *buf, uint32_t len) {
+    if (!traceReadFile) {
+        traceReadFile = LittleFS.open(filePath, FILE_READ);
+        if (!traceReadFile) return 0;
+    }
+    if (traceReadFile.position() != offset && !traceReadFile.seek(offset)) return 0;
+    return traceReadFile.read(buf, len);
+}
+
+PsramTraceStorage::PsramTraceStorage(uint32_t maxBytes) : capacity(maxBytes) {
+}
+
+uint32_t PsramTraceStorage::begin() {
+    if (data == nullptr) {
+        if (!psramFound()) return 0;
+        data = (uint8_t *)ps_malloc(capacity);
+        if (data == nullptr) {
+            DEBUG("Trace: cannot allocate %u bytes of PSRAM\n", capacity);
+            return 0;
+        }
+    }
+    used = 0;
+    return capacity;
+}
+
+bool PsramTraceStorage::write(const uint8_t *buf, uint32_t len) {
+    if (data == nullptr || used + len > capacity) return false;
+    memcpy(data + used, buf, len);
+    used += len;
+    return true;
+}
+
+uint32_t PsramTraceStorage::size() {
+    return used;
+}
+
+uint32_t PsramTraceStorage::read(uint32_t offset, uint8_t *buf, uint32_t len) {
+    if (data == nullptr || offset >= used) return 0;
+    if (len > used - offset) len = used - offset;
+    memcpy(buf, data + offset, len);
+    return len;
+}
+
+#endif
@@ -0,0 +1,272 @@
+#include "uploader.h"
+
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <lwip/sockets.h>
+#include <time.h>
+
+#include "debug.h"
+
+bool Uploader::begin() {
+    if (jobQueue != NULL) return true;
+    jobQueue = xQueueCreate(UPLOAD_QUEUE_SIZE, sizeof(upload_job_t));
+    if (jobQueue == NULL) {
+        DEBUG("Uploader: failed to create job queue\n");
+        return false;
+    }
+    guardMutex = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timerArgs = {deadlineCallback, this, ESP_TIMER_TASK, "uploadDeadline"};
+    if (guardMutex == NULL || esp_timer_create(&timerArgs, &deadlineTimer) != ESP_OK) {
+        DEBUG("Uploader: failed to create deadline timer\n");
+        vQueueDelete(jobQueue);
+        jobQueue = NULL;
+        return false;
+    }
+    // 放在核0，与WiFi/网络同核，不打扰核1上的计时循环
+    if (xTaskCreatePinnedToCore(uploadTask, "uploadTask", UPLOAD_TASK_STACK, this, UPLOAD_TASK_PRIORITY, &taskHandle, 0) != pdPASS) {
+        DEBUG("Uploader: failed to create task\n");
+        vQueueDelete(jobQueue);
+        jobQueue = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool Uploader::submit(const upload_job_t *job) {
+    if (jobQueue == NULL || xQueueSend(jobQueue, job, 0) != pdTRUE) {
+        portENTER_CRITICAL(&statusMux);
+        status.dropped++;
+        portEXIT_CRITICAL(&statusMux);
+        free(job->lapTimesUs);
+        DEBUG("Uploader: queue full, training data dropped\n");
+        return false;
+    }
+    portENTER_CRITICAL(&statusMux);
+    status.queued++;
+    if (status.state != UPLOAD_IN_FLIGHT) status.state = UPLOAD_PENDING;
+    portEXIT_CRITICAL(&statusMux);
+    return true;
+}
+
+void Uploader::getStatus(upload_status_t *out) {
+    portENTER_CRITICAL(&statusMux);
+    *out = status;
+    portEXIT_CRITICAL(&statusMux);
+}
+
+const char *Uploader::stateToString(upload_state_e state) {
+    switch (state) {
+        case UPLOAD_PENDING:
+            return "pending";
+        case UPLOAD_IN_FLIGHT:
+            return "in_flight";
+        case UPLOAD_DONE:
+            return "done";
+        case UPLOAD_FAILED:
+            return "failed";
+        default:
+            return "idle";
+    }
+}
+
+void Uploader::setState(upload_state_e state) {
+    portENTER_CRITICAL(&statusMux);
+    status.state = state;
+    portEXIT_CRITICAL(&statusMux);
+}
+
+// esp_timer任务中执行：关闭收发两个方向，上传任务里阻塞的读写马上失败返回
+void Uploader::deadlineCallback(void *arg) {
+    Uploader *self = (Uploader *)arg;
+    xSemaphoreTake(self->guardMutex, portMAX_DELAY);
+    self->deadlineHit = true;
+    if (self->guardFd >= 0) shutdown(self->guardFd, SHUT_RDWR);
+    xSemaphoreGive(self->guardMutex);
+}
+
+// fd < 0表示连接即将关闭，之后回调不再碰这个编号
+void Uploader::guardSocket(int fd) {
+    xSemaphoreTake(guardMutex, portMAX_DELAY);
+    guardFd = fd;
+    xSemaphoreGive(guardMutex);
+}
+
+void Uploader::uploadTask(void *pvArgs) {
+    Uploader *self = (Uploader *)pvArgs;
+    // 只有这一个上传任务，缓冲用静态变量，不占任务栈
+    static upload_job_t job;
+    for (;;) {
+        if (xQueueReceive(self->jobQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+
+        self->setState(UPLOAD_IN_FLIGHT);
+        uint32_t startMs = millis();
+        int16_t httpCode = 0;
+        self->deadlineHit = false;
+        esp_timer_start_once(self->deadlineTimer, (uint64_t)UPLOAD_TOTAL_TIMEOUT_MS * 1000);
+        bool ok = self->runJob(&job, startMs, &httpCode);
+        esp_timer_stop(self->deadlineTimer);
+        // 已经拿到结果后才到时限的不算超时
+        const bool timedOut = self->deadlineHit && !ok;
+        if (timedOut) httpCode = UPLOAD_ERROR_DEADLINE;
+        uint32_t latencyMs = millis() - startMs;
+        free(job.lapTimesUs);
+        job.lapTimesUs = nullptr;
+
+        portENTER_CRITICAL(&self->statusMux);
+        self->status.completed++;
+        if (!ok) self->status.failed++;
+        if (timedOut) self->status.timeouts++;
+        self->status.lastHttpCode = httpCode;
+        self->status.lastLatencyMs = latencyMs;
+        self->status.lastLapCount = job.lapCount;
+        // 后面还有排队的任务时保持pending，让调用方知道还没结束
+        if (uxQueueMessagesWaiting(self->jobQueue) > 0) {
+            self->status.state = UPLOAD_PENDING;
+        } else {
+            self->status.state = ok ? UPLOAD_DONE : UPLOAD_FAILED;
+        }
+        portEXIT_CRITICAL(&self->statusMux);
+
+        DEBUG("Upload %s in %u ms (HTTP %d)\n", ok ? "succeeded" : "failed", latencyMs, httpCode);
+    }
+}
+
+// WiFiClient::fd()对TLS连接返回-1，套接字在sslclient里
+class GuardedSecureClient : public WiFiClientSecure {
+   public:
+    int socketFd() const { return sslclient->socket; }
+};
+
+// 从"http[s]://host[:port]/..."中取出主机和端口
+static bool parseHost(const char *url, char *host, size_t hostSize, uint16_t *port, bool *secure) {
+    const char *p;
+    if (strncmp(url, "http://", 7) == 0) {
+        p = url + 7;
+        *secure = false;
+        *port = 80;
+    } else if (strncmp(url, "https://", 8) == 0) {
+        p = url + 8;
+        *secure = true;
+        *port = 443;
+    } else {
+        return false;
+    }
+    size_t len = strcspn(p, ":/");
+    if (len == 0 || len >= hostSize) return false;
+    memcpy(host, p, len);
+    host[len] = '\0';
+    if (p[len] == ':') *port = (uint16_t)atoi(p + len + 1);
+    return true;
+}
+
+bool Uploader::runJob(const upload_job_t *job, uint32_t startMs, int16_t *httpCode) {
+    if (WiFi.status() != WL_CONNECTED) {
+        DEBUG("WiFi not connected, cannot upload data\n");
+        return false;
+    }
+
+    // 计算总时间
+    uint64_t totalTimeUs = 0;
+    uint32_t bestLapTimeUs = 0;
+    for (uint32_t i = 0; i < job->lapCount; i++) {
+        totalTimeUs += job->lapTimesUs[i];
+        if (i == 0 || job->lapTimesUs[i] < bestLapTimeUs) {
+            bestLapTimeUs = job->lapTimesUs[i];
+        }
+    }
+    uint32_t totalTime = (totalTimeUs + 500) / 1000;
+    uint32_t bestLapTime = (bestLapTimeUs + 500) / 1000;
+
+    // 时间取stop时刻，而不是排队之后真正上传的时刻
+    struct tm timeInfo;
+    localtime_r(&job->stopTime, &timeInfo);
+    char timeStr[20];
+    snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+             timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
+             timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec);
+
+    // ArduinoJson 7的文档按需增长，构造参数不限制圈数
+    DynamicJsonDocument doc(1024);
+    doc["device_id"] = job->deviceId;
+    doc["pilot_id"] = job->pilotId;
+    doc["title"] = "训练测试";
+    doc["description"] = "计时器终端数据";
+    doc["flight_date"] = timeStr;
+    doc["takeoff_time"] = timeStr;
+    doc["total_time"] = totalTime;
+    doc["total_laps"] = job->lapCount;
+    doc["average_lap_time"] = job->lapCount > 0 ? totalTime / job->lapCount : 0;
+    doc["best_lap_time"] = bestLapTime;
+    doc["record_type"] = "system";
+    doc["pilot_name"] = job->pilotName;
+    doc["updated_at"] = timeStr;
+
+    // 添加圈速数据  去除首圈开圏的无效成绩
+    JsonArray laps = doc.createNestedArray("laps");
+    for (uint32_t i = 1; i < job->lapCount; i++) {
+        JsonObject lap = laps.createNestedObject();
+        lap["lap_time"] = (job->lapTimesUs[i] + 500) / 1000;
+        lap["lap_time_us"] = job->lapTimesUs[i];
+    }
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    DEBUG("Training data: %s\n", jsonString.c_str());
+
+    // 先自己建立连接，拿到套接字交给总时限的回调；HTTPClient发现已连接会直接复用
+    char host[64];
+    uint16_t port;
+    bool secure;
+    if (!parseHost(job->apiAddress, host, sizeof(host), &port, &secure)) {
+        DEBUG("Invalid API address: %s\n", job->apiAddress);
+        return false;
+    }
+    WiFiClient plainClient;
+    GuardedSecureClient secureClient;
+    secureClient.setInsecure();  // 与HTTPClient::begin(url)不带证书时一致，不校验服务器证书
+    WiFiClient *client = secure ? (WiFiClient *)&secureClient : &plainClient;
+    if (!client->connect(host, port, UPLOAD_CONNECT_TIMEOUT_MS)) {
+        DEBUG("Cannot connect to %s:%u\n", host, port);
+        *httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+        return false;
+    }
+    guardSocket(secure ? secureClient.socketFd() : plainClient.fd());
+    // 连接期间已经到时限（回调时还没有套接字）
+    if (deadlineHit || millis() - startMs >= UPLOAD_TOTAL_TIMEOUT_MS) {
+        guardSocket(-1);
+        client->stop();
+        return false;
+    }
+
+    HTTPClient http;
+    http.setReuse(false);
+    http.setConnectTimeout(UPLOAD_CONNECT_TIMEOUT_MS);
+    http.setTimeout(UPLOAD_HTTP_TIMEOUT_MS);
+    http.begin(*client, String(job->apiAddress) + "/training/device_upload");
+    http.addHeader("Content-Type", "application/json");
+
+    int code = http.POST(jsonString);
+    *httpCode = code;
+    bool ok = false;
+    if (code > 0) {
+        String response = http.getString();
+        DEBUG("HTTP Response code: %d\n", code);
+        DEBUG("Response: %s\n", response.c_str());
+
+        // 检查上传是否成功
+        DynamicJsonDocument responseDoc(512);
+        DeserializationError error = deserializeJson(responseDoc, response);
+        ok = !error && responseDoc["success"] == true;
+        if (!ok) {
+            DEBUG("Failed to upload training data: %s\n", response.c_str());
+        }
+    } else {
+        DEBUG("HTTP request failed, error: %s\n", http.errorToString(code).c_str());
+    }
+    guardSocket(-1);
+    http.end();
+    client->stop();
+    return ok;
+}
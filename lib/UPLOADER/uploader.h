@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#define UPLOAD_QUEUE_SIZE 4             // 最多排队的训练记录数
+#define UPLOAD_TASK_STACK 8192          // HTTPClient + JSON序列化需要较大的栈
+#define UPLOAD_TASK_PRIORITY 0          // 与空闲任务同级，只用空闲CPU
+#define UPLOAD_CONNECT_TIMEOUT_MS 3000  // TCP连接超时
+#define UPLOAD_HTTP_TIMEOUT_MS 5000     // 等待响应超时（两次收到数据之间）
+#define UPLOAD_TOTAL_TIMEOUT_MS 15000   // 单个任务从开始到结束的总时限，服务器逐字节慢发也不能超过
+#define UPLOAD_ERROR_DEADLINE -100      // lastHttpCode：超过总时限被中止
+
+typedef enum {
+    UPLOAD_IDLE,
+    UPLOAD_PENDING,
+    UPLOAD_IN_FLIGHT,
+    UPLOAD_DONE,
+    UPLOAD_FAILED
+} upload_state_e;
+
+/**
+ * 一次训练的快照。stop时从计时器和配置里拷出来，之后与计时器再无关系，
+ * 下一次start清空圈速也不影响正在排队的上传。
+ * lapTimesUs由malloc分配，submit()之后归上传器所有并负责释放。
+ */
+typedef struct {
+    char deviceId[24];
+    char pilotId[21];
+    char pilotName[21];
+    char apiAddress[100];
+    time_t stopTime;
+    uint32_t lapCount;
+    uint32_t *lapTimesUs;
+} upload_job_t;
+
+typedef struct {
+    upload_state_e state;
+    uint32_t queued;     // 已入队的任务数
+    uint32_t completed;  // 已结束（成功或失败）的任务数
+    uint32_t failed;
+    uint32_t dropped;  // 队列满而放弃的任务数
+    uint32_t timeouts;  // 超过UPLOAD_TOTAL_TIMEOUT_MS被中止的任务数（也计入failed）
+    int16_t lastHttpCode;
+    uint32_t lastLatencyMs;
+    uint32_t lastLapCount;
+} upload_status_t;
+
+/**
+ * 训练数据上传器。submit()只把快照拷入队列，立即返回；
+ * 低优先级的后台任务串行执行HTTP上传，连接和响应都有超时上限；
+ * 另有一个esp_timer在总时限到达时对连接的套接字执行shutdown()，阻塞中的读写随即返回错误。
+ */
+class Uploader {
+   public:
+    bool begin();
+    // 可在任意任务调用，任务按值拷入队列；返回false表示队列已满（圈速缓冲已释放）
+    bool submit(const upload_job_t *job);
+    void getStatus(upload_status_t *status);
+    static const char *stateToString(upload_state_e state);
+
+   private:
+    static void uploadTask(void *pvArgs);
+    static void deadlineCallback(void *arg);
+    bool runJob(const upload_job_t *job, uint32_t startMs, int16_t *httpCode);
+    void guardSocket(int fd);
+    void setState(upload_state_e state);
+
+    QueueHandle_t jobQueue = NULL;
+    TaskHandle_t taskHandle = NULL;
+    portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
+    upload_status_t status = {UPLOAD_IDLE, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    // 总时限：guardMutex保证回调shutdown()时套接字还没被关闭、编号没被复用
+    esp_timer_handle_t deadlineTimer = NULL;
+    SemaphoreHandle_t guardMutex = NULL;
+    int guardFd = -1;
+    volatile bool deadlineHit = false;
+};
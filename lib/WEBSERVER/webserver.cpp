@@ -7,7 +7,7 @@
 #include <LittleFS.h>
 #include <esp_wifi.h>
 #include <Update.h>
-#include <HTTPClient.h>
+#include <esp_timer.h>
 
 #include "debug.h"
 #include <time.h>
@@ -20,6 +20,7 @@ static DNSServer dnsServer;
 static IPAddress ipAddress;
 static AsyncWebServer server(80);
 static AsyncEventSource events("/events");
+static AsyncWebSocket rssiSocket("/rssi/ws");
 
 static const char *wifi_hostname = "qylpt";
 static const char *wifi_ap_ssid_prefix = "QYLPT";
@@ -60,6 +61,9 @@ void Webserver::init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMoni
     // 设置stop事件回调函数
     timer->setStopEventHandler(stopEventHandler);
 
+    // 训练数据上传在独立的低优先级任务中执行
+    uploader.begin();
+
     wifi_ap_ssid = String(wifi_ap_ssid_prefix) + "_" + WiFi.macAddress().substring(WiFi.macAddress().length() - 6);
     wifi_ap_ssid.replace(":", "");
 
@@ -96,20 +100,385 @@ void Webserver::sendRssiEvent(uint8_t rssi)
     events.send(buf, "rssi");
 }
 
-void Webserver::sendLaptimeEvent(uint32_t lapTime)
+size_t Webserver::noiseToJson(char *buf, size_t size)
+{
+    return snprintf(buf, size, "{\"floor\":%u,\"valid\":%s,\"updates\":%u,\"enter\":%u,\"exit\":%u,\"tracking\":%s}",
+                    timer->getNoiseFloor(), timer->isNoiseFloorValid() ? "true" : "false", timer->getNoiseFloorUpdates(),
+                    timer->getEnterRssi(), timer->getExitRssi(), conf->getFloorTrack() ? "true" : "false");
+}
+
+void Webserver::sendNoiseEvent()
+{
+    if (!servicesStarted)
+        return;
+    char buf[112];
+    noiseToJson(buf, sizeof(buf));
+    events.send(buf, "noise");
+}
+
+/**
+ * 噪声校准的统计和推荐阈值，进度查询和停止共用。
+ * withHistogram时附带min到max之间每个RSSI值的样本数，网页据此画分布，不再自己采样。
+ * 可选参数drop为RSSI降低量百分比（10 - 100）。
+ */
+void Webserver::sendCalibrationNoise(AsyncWebServerRequest *request, bool withHistogram)
+{
+    uint8_t drop = CALIBRATION_DEFAULT_DROP;
+    if (request->hasParam("drop")) {
+        long v = request->getParam("drop")->value().toInt();
+        if (v >= 10 && v <= 100) drop = v;
+    }
+    CalibrationHistogram *hist = timer->getCalibrationHistogram();
+    calibration_result_t rec;
+    calibrationRecommend(hist, conf->getGateDiameterMm(), drop, &rec);
+    const uint32_t samples = hist->getCount();
+    const uint32_t target = timer->getCalibrationNoiseTarget();
+    const uint16_t meanQ4 = hist->getMeanQ4();
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->printf("{\"status\":\"OK\",\"running\":%s,\"samples\":%u,\"target\":%u,\"ok\":%s,",
+                     timer->isCalibrationNoiseRunning() ? "true" : "false", samples, target,
+                     samples >= target ? "true" : "false");
+    response->printf("\"maxNoise\":%u,\"min\":%u,\"mean\":%u.%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,",
+                     hist->getMax(), hist->getMin(), meanQ4 >> 4, ((meanQ4 & 15) * 10 + 8) >> 4,
+                     rec.median, hist->getPercentile(900), hist->getPercentile(990), rec.noise);
+    response->printf("\"noise\":%u,\"spread\":%u,\"delta\":%u,\"minDelta\":%u,\"enter\":%u,\"exit\":%u",
+                     rec.noise, rec.spread, rec.delta, rec.minDelta, rec.enter, rec.exit);
+    if (withHistogram) {
+        const uint8_t first = hist->getMin();
+        const uint8_t last = hist->getMax();
+        response->printf(",\"histStart\":%u,\"hist\":[", first);
+        for (uint16_t i = first; i <= last && samples > 0; i++) {
+            response->printf(i == first ? "%u" : ",%u", hist->getBin(i));
+        }
+        response->print("]");
+    }
+    response->print("}");
+    request->send(response);
+}
+
+void Webserver::sendLaptimeEvent(uint32_t lapTimeUs)
 {
     if (!servicesStarted)
         return;
     char buf[16];
-    snprintf(buf, sizeof(buf), "%u", lapTime);
+    // "lap"保持毫秒整数，兼容现有页面；"lapUs"携带微秒精度
+    snprintf(buf, sizeof(buf), "%u", (lapTimeUs + 500) / 1000);
     events.send(buf, "lap");
+    snprintf(buf, sizeof(buf), "%u", lapTimeUs);
+    events.send(buf, "lapUs");
+}
+
+void Webserver::setScanner(FrequencyScanner *frequencyScanner)
+{
+    scanner = frequencyScanner;
+    if (!scanner->addEventSink(scanEventSink, this))
+        DEBUG("Scanner event sink for web events not registered, raise LAPTIMER_MAX_EVENT_SINKS\n");
+}
+
+// 扫描器的事件在parallelTask中分发
+void Webserver::scanEventSink(const laptimer_event_t *event, void *ctx)
+{
+    Webserver *self = (Webserver *)ctx;
+    if (event->type != LAPTIMER_EVENT_LAP || !self->servicesStarted)
+        return;
+    ScanChannel *channel = self->scanner->getChannel(event->channel);
+    char buf[80];
+    snprintf(buf, sizeof(buf), "{\"channel\":%u,\"freq\":%u,\"lap\":%u,\"lapUs\":%u}", event->channel,
+             channel ? channel->getFrequency() : 0, event->lapNumber, event->lapTimeUs);
+    events.send(buf, "scanLap");
+}
+
+void Webserver::setSpectrum(SpectrumSweep *spectrumSweep)
+{
+    spectrum = spectrumSweep;
+    spectrum->addEventSink(spectrumEventSink, this);
+}
+
+// 每扫完一个频率推送一次，页面据此逐个画出频谱；结束或中止时推送"spectrumDone"
+void Webserver::spectrumEventSink(const spectrum_event_t *event, void *ctx)
+{
+    Webserver *self = (Webserver *)ctx;
+    if (!self->servicesStarted)
+        return;
+    char buf[96];
+    if (event->type == SPECTRUM_EVENT_CHANNEL) {
+        snprintf(buf, sizeof(buf), "{\"index\":%u,\"count\":%u,\"freq\":%u,\"peak\":%u,\"mean\":%u}", event->index,
+                 event->count, event->channel.freq, event->channel.peak, event->channel.mean);
+        events.send(buf, "spectrum");
+    } else {
+        snprintf(buf, sizeof(buf), "{\"completed\":%u,\"count\":%u,\"aborted\":%s,\"elapsedMs\":%u}", event->index,
+                 event->count, event->type == SPECTRUM_EVENT_ABORTED ? "true" : "false", event->elapsedMs);
+        events.send(buf, "spectrumDone");
+    }
+}
+
+void Webserver::sendSpectrum(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->printf("{\"state\":\"%s\",\"count\":%u,\"completed\":%u,\"aborted\":%s,\"elapsedMs\":%u,",
+                     SpectrumSweep::stateToString(spectrum->getState()), spectrum->getCount(), spectrum->getCompleted(),
+                     spectrum->wasAborted() ? "true" : "false", spectrum->getElapsedMs());
+    response->printf("\"settleUs\":%u,\"dwellUs\":%u,\"restoreFreq\":%u,\"channels\":[", (uint32_t)SCANNER_SETTLE_US,
+                     (uint32_t)SPECTRUM_DWELL_US, conf->getFrequency());
+    const uint8_t completed = spectrum->getCompleted();
+    for (uint8_t i = 0; i < completed; i++) {
+        const spectrum_channel_t *channel = spectrum->getChannel(i);
+        response->printf("%s{\"freq\":%u,\"peak\":%u,\"mean\":%u}", i ? "," : "", channel->freq, channel->peak,
+                         channel->mean);
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+void Webserver::setRaceNet(RaceNode *node, RaceAggregator *aggregator, MdnsPeerFinder *finder)
+{
+    raceNode = node;
+    raceAggregator = aggregator;
+    peerFinder = finder;
+}
+
+// 在parallelTask中收发多节点的包（UDP或ESP-NOW）；每轮限量处理，避免挤占网页推送
+void Webserver::handleRaceNet()
+{
+    if (raceNode == nullptr || raceAggregator == nullptr)
+        return;
+    racenet_node_info_t *info = raceNode->getInfo();
+    const bool scanning = scanner != nullptr && scanner->isActive();
+    strlcpy(info->host, wifi_hostname, sizeof(info->host));
+    strlcpy(info->product, "QiYun-LapTimer", sizeof(info->product));
+    strlcpy(info->pilot, conf->getPilotName(), sizeof(info->pilot));
+    info->frequency = conf->getFrequency();
+    info->running = scanning ? scanner->isRunning() : timer->isRunning();
+    info->sector = conf->getSectorIndex();
+    info->sectorCount = conf->getSectorCount();
+
+    if (servicesStarted && !raceNetStarted)
+    {
+        // 选了ESP-NOW时RaceNet走ESP-NOW，UDP套接字仍要打开，留给圈速广播
+        raceNetStarted = raceTransport.begin(RACENET_PORT);
+        if (raceNetStarted && conf->getRaceLink() == 1)
+            espNowStarted = espNowTransport.begin(RACENET_PORT);
+        if (raceNetStarted)
+        {
+            RaceTransport *link = espNowStarted ? (RaceTransport *)&espNowTransport : &raceTransport;
+            raceNode->setTransport(link);
+            raceAggregator->setTransport(link);
+            if (lapCaster != nullptr)
+                lapCaster->setTransport(&raceTransport);
+        }
+    }
+    if (raceNetStarted)
+    {
+        pollRaceTransport(&raceTransport, !espNowStarted);
+        if (espNowStarted)
+            pollRaceTransport(&espNowTransport, true);
+    }
+
+    const uint64_t nowUs = esp_timer_get_time();
+    raceNode->service(nowUs);
+    raceAggregator->service(nowUs);
+    if (sectors != nullptr)
+        sectors->service(nowUs, raceAggregator->hasGaps());
+    if (lapCaster != nullptr)
+    {
+        lapCaster->setMode(conf->getLapCastMode());
+        lapCaster->service(nowUs);
+    }
+    if (peerFinder != nullptr)
+    {
+        peerFinder->setEnabled(raceNetStarted && !espNowStarted && raceAggregator->isActive());
+        racenet_addr_t addr;
+        while (peerFinder->poll(&addr))
+            raceAggregator->addPeer(&addr, nowUs);
+    }
+}
+
+// 每次最多处理RACENET_POLL_PACKETS个；raceNet为false时只交给圈速广播（RaceNet改走ESP-NOW后的UDP套接字）
+void Webserver::pollRaceTransport(RaceTransport *transport, bool raceNet)
+{
+    uint8_t buf[RACENET_MAX_PACKET];
+    racenet_addr_t from;
+    for (uint8_t i = 0; i < RACENET_POLL_PACKETS; i++)
+    {
+        const uint16_t len = transport->receive(&from, buf, sizeof(buf));
+        if (len == 0)
+            break;
+        const uint64_t nowUs = esp_timer_get_time();
+        if (raceNet && (raceNode->handlePacket(&from, buf, len, nowUs) || raceAggregator->handlePacket(&from, buf, len, nowUs)))
+            continue;
+        if (lapCaster != nullptr && transport == &raceTransport)
+            lapCaster->handlePacket(&from, buf, len, nowUs);
+    }
+}
+
+// ESP-NOW的对端地址是MAC，没有IP可显示
+static String raceNetIp(const racenet_addr_t *addr, bool espNow)
+{
+    if (addr->ip != 0 && espNow)
+        return String("ESP-NOW");
+    if (addr->ip != 0)
+        return IPAddress(addr->ip).toString();
+    return (WiFi.getMode() == WIFI_AP ? WiFi.softAPIP() : WiFi.localIP()).toString();
+}
+
+void Webserver::sendNodes(AsyncWebServerRequest *request)
+{
+    const uint64_t nowUs = esp_timer_get_time();
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->printf("{\"active\":%s,\"subscribers\":%u,\"sent\":%u,\"resent\":%u,\"nodes\":[",
+                     raceAggregator->isActive() ? "true" : "false", raceNode->getSubscriberCount(), raceNode->getSent(),
+                     raceNode->getResent());
+    const uint8_t count = raceAggregator->getPeerCount();
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const racenet_peer_t *peer = raceAggregator->getPeer(i);
+        response->printf("%s{\"host\":\"%s\",\"ip\":\"%s\",\"product\":\"%s\",", i ? "," : "", peer->host,
+                         raceNetIp(&peer->addr, espNowStarted).c_str(), peer->product);
+        response->printf("\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"pilot\":\"%s\",\"freq\":%u,", peer->mac[0],
+                         peer->mac[1], peer->mac[2], peer->mac[3], peer->mac[4], peer->mac[5], peer->pilot,
+                         peer->frequency);
+        response->printf("\"online\":%s,\"running\":%s,\"events\":%u,\"lost\":%u,\"self\":%s,",
+                         raceAggregator->isOnline(i, nowUs) ? "true" : "false", peer->running ? "true" : "false",
+                         peer->events, peer->lost, peer->addr.ip == 0 ? "true" : "false");
+        if (peer->uncertaintyUs == RACENET_UNSYNCED)
+            response->print("\"syncUs\":null}");
+        else
+            response->printf("\"syncUs\":%u}", peer->uncertaintyUs);
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+// 合并后的圈速，按过门时刻排序，只返回最近RACENET_WEB_LAPS圈；timeMs为相对第一圈的时刻
+void Webserver::sendRace(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    const uint16_t count = raceAggregator->getLapCount();
+    const uint16_t first = count > RACENET_WEB_LAPS ? count - RACENET_WEB_LAPS : 0;
+    response->printf("{\"active\":%s,\"count\":%u,\"dropped\":%u,\"orderFixes\":%u,\"laps\":[",
+                     raceAggregator->isActive() ? "true" : "false", count, raceAggregator->getLapsDropped(),
+                     raceAggregator->getOrderFixes());
+    const racenet_lap_t *origin = raceAggregator->getLap(0);
+    for (uint16_t i = first; i < count; i++)
+    {
+        const racenet_lap_t *lap = raceAggregator->getLap(i);
+        const racenet_peer_t *peer = raceAggregator->getPeer(lap->peer);
+        if (peer == nullptr)
+            continue;
+        response->printf("%s{\"host\":\"%s\",\"pilot\":\"%s\",\"mac\":\"%02X%02X%02X\",\"freq\":%u,", i > first ? "," : "",
+                         peer->host, peer->pilot, peer->mac[3], peer->mac[4], peer->mac[5], lap->frequency);
+        response->printf("\"lap\":%u,\"lapUs\":%u,\"timeMs\":%u,", lap->lapNumber, lap->lapTimeUs,
+                         (uint32_t)((lap->timeUs - origin->timeUs) / 1000));
+        // uncUs为过门时刻的同步误差上界，null表示节点未同步到本机，时刻按网络延迟估算
+        if (lap->uncertaintyUs == RACENET_UNSYNCED)
+            response->print("\"uncUs\":null}");
+        else
+            response->printf("\"uncUs\":%u}", lap->uncertaintyUs);
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+// 启动时日志里的最后一个会话：掉电中断的比赛可从这里取回已落盘的圈速。
+// 会话数据在begin()后不再改变，AsyncTCP任务直接读取；写入统计是单个32位计数，读到旧值无妨
+void Webserver::sendJournalLast(AsyncWebServerRequest *request)
+{
+    const journal_session_t *session = journal->getBootSession();
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->printf("{\"records\":%u,\"maxWriteUs\":%u,\"writeErrors\":%u,",
+                     journal->getRecordCount(), journal->getMaxWriteUs(), journal->getWriteErrors());
+    response->printf("\"session\":%u,\"recovered\":%s,\"truncatedBytes\":%u,\"startTime\":%u,\"laps\":%u,\"lapsUs\":[",
+                     session->session, journal->wasRecovered() ? "true" : "false", journal->getTruncatedBytes(),
+                     session->startTime, session->laps);
+    for (uint32_t i = 0; i < journal->getBootLapCount(); i++)
+    {
+        response->printf(i ? ",%u" : "%u", journal->getBootLapTimeUs(i));
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+void Webserver::setSectors(SectorCoordinator *coordinator)
+{
+    sectors = coordinator;
+    sectors->setResultSink(sectorResultSink, this);
+}
+
+size_t Webserver::sectorToJson(const racenet_sector_t *result, char *buf, size_t size)
+{
+    const racenet_peer_t *peer = raceAggregator ? raceAggregator->getPeer(result->peer) : nullptr;
+    int n = snprintf(buf, size,
+                     "{\"seq\":%u,\"freq\":%u,\"lap\":%u,\"sector\":%u,\"sectors\":%u,\"gate\":%u,\"status\":\"%s\",\"us\":%u,",
+                     result->seq, result->frequency, result->lap, result->sector, result->sectorCount, result->gate,
+                     SectorCoordinator::statusToString(result->status), result->timeUs);
+    if (n < 0 || (size_t)n >= size)
+        return 0;
+    if (result->uncertaintyUs == RACENET_UNSYNCED)
+        n += snprintf(buf + n, size - n, "\"uncUs\":null,\"host\":\"%s\"}", peer ? peer->host : "");
+    else
+        n += snprintf(buf + n, size - n, "\"uncUs\":%u,\"host\":\"%s\"}", result->uncertaintyUs, peer ? peer->host : "");
+    return (size_t)n < size ? n : 0;
+}
+
+// 协调器在parallelTask中处理过门，每产生一条结果（段、整圈或被拒绝的过门）推送一次
+void Webserver::sectorResultSink(const racenet_sector_t *result, void *ctx)
+{
+    Webserver *self = (Webserver *)ctx;
+    if (!self->servicesStarted)
+        return;
+    char buf[192];
+    if (self->sectorToJson(result, buf, sizeof(buf)) > 0)
+        events.send(buf, "sector");
+}
+
+// 返回序号大于after的结果，最多RACENET_WEB_SECTORS条；last为最新序号，下次请求带上即可增量获取
+void Webserver::sendSectors(AsyncWebServerRequest *request)
+{
+    const uint32_t last = sectors->getLastSeq();
+    uint32_t after = request->hasParam("after") ? request->getParam("after")->value().toInt() : 0;
+    if (after > last)
+        after = 0;  // 对方记录的序号来自上一次启动
+    if (last - after > RACENET_WEB_SECTORS)
+        after = last - RACENET_WEB_SECTORS;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->printf("{\"last\":%u,\"gate\":%u,\"gates\":%u,\"ok\":%u,\"missing\":%u,\"repeat\":%u,\"late\":%u,\"results\":[",
+                     last, conf->getSectorIndex(), conf->getSectorCount(), sectors->getCount(RACENET_SECTOR_OK),
+                     sectors->getCount(RACENET_SECTOR_MISSING), sectors->getCount(RACENET_SECTOR_REPEAT),
+                     sectors->getCount(RACENET_SECTOR_LATE));
+    bool first = true;
+    char buf[192];
+    for (uint32_t s = after + 1; s <= last; s++)
+    {
+        const racenet_sector_t *result = sectors->getResult(s);
+        if (result == nullptr || sectorToJson(result, buf, sizeof(buf)) == 0)
+            continue;
+        response->printf("%s%s", first ? "" : ",", buf);
+        first = false;
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+// 扫描模式下计时核运行的是扫描器，LapTimer收不到样本
+bool Webserver::postTimerCommand(laptimer_cmd_e cmd)
+{
+    if (scanner != nullptr && scanner->isActive())
+        return scanner->postCommand(cmd);
+    return timer->postCommand(cmd);
 }
 
 // 新增：lap事件处理函数
-void Webserver::lapEventHandler(uint32_t lapTime)
+void Webserver::lapEventHandler(uint32_t lapTimeUs)
 {
     if (gWebserverInstance != nullptr) {
-        gWebserverInstance->sendLaptimeEvent(lapTime);
+        gWebserverInstance->sendLaptimeEvent(lapTimeUs);
     }
 }
 
@@ -123,124 +492,103 @@ void Webserver::stopEventHandler()
 
 void Webserver::uploadTrainingData()
 {
-    DEBUG("Uploading training data...\n");
-    
-    // 检查WiFi连接状态
-    if (WiFi.status() != WL_CONNECTED) {
-        DEBUG("WiFi not connected, cannot upload data\n");
-        return;
-    }
-    
+    // 这里只做快照并交给后台上传任务，HTTP请求不在调用方的任务里执行
+    DEBUG("Queueing training data upload...\n");
+
     // 获取飞手信息
     char* pilotName = conf->getPilotName();
     char* pilotId = conf->getPilotId();
-    
+
     // 检查飞手ID是否为空
     if (strlen(pilotId) == 0) {
         DEBUG("Pilot ID is empty, cannot upload data\n");
         return;
     }
-    
-    // 获取圈速数据
-    uint32_t* lapTimes = timer->getLapTimes();
-    uint8_t lapCount = timer->getLapCount();
-    
-    // 计算总时间
-    uint32_t totalTime = 0;
-    uint32_t bestLapTime = 0;
-    
-    for (uint8_t i = 0; i < lapCount; i++) {
-        totalTime += lapTimes[i];
-        if (i == 0 || lapTimes[i] < bestLapTime) {
-            bestLapTime = lapTimes[i];
+
+    upload_job_t job;
+    memset(&job, 0, sizeof(job));
+    String deviceId = String(wifi_ap_ssid_prefix) + "_" + WiFi.macAddress().substring(WiFi.macAddress().length() - 6);
+    deviceId.replace(":", "");
+    strlcpy(job.deviceId, deviceId.c_str(), sizeof(job.deviceId));
+    strlcpy(job.pilotId, pilotId, sizeof(job.pilotId));
+    strlcpy(job.pilotName, pilotName, sizeof(job.pilotName));
+    strlcpy(job.apiAddress, conf->getApiAddress(), sizeof(job.apiAddress));
+    job.stopTime = time(NULL);
+
+    // 获取圈速数据（微秒），上传字段仍以毫秒为主；圈数不再有上限，按实际圈数分配
+    uint32_t lapCount = timer->getLapCount();
+    if (lapCount > 0) {
+        job.lapTimesUs = (uint32_t *)malloc(lapCount * sizeof(uint32_t));
+        if (job.lapTimesUs == nullptr) {
+            DEBUG("Out of memory for %u laps, cannot upload data\n", lapCount);
+            buz->beep(1000);
+            led->blink(200);
+            return;
         }
+        job.lapCount = timer->copyLapTimesUs(job.lapTimesUs, lapCount);
     }
-    
-    // 构建JSON数据
-    DynamicJsonDocument doc(1024);
-
-    String device_id  = String(wifi_ap_ssid_prefix) + "_" + WiFi.macAddress().substring(WiFi.macAddress().length() - 6);
-    device_id.replace(":", "");;
-
-    doc["device_id"] = device_id;
-    doc["pilot_id"] = pilotId;
-    doc["title"] = "训练测试";
-    doc["description"] = "计时器终端数据";
-// 获取当前时间
-    time_t nowTime = time(NULL);
-    struct tm timeInfo;
-    localtime_r(&nowTime, &timeInfo);
-    
-    char dateStr[11];
-    char timeStr[20];
-    
-    // 格式化日期 (YYYY-MM-DD)
-    snprintf(dateStr, sizeof(dateStr), "%04d-%02d-%02d", 
-             timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday);
-    
-    // 格式化时间 (YYYY-MM-DD HH:MM:SS)
-    snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02d %02d:%02d:%02d", 
-             timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
-             timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec);
-    
-    
-    doc["flight_date"] = timeStr;
-    doc["takeoff_time"] = timeStr;
-    doc["total_time"] = totalTime;
-    doc["total_laps"] = lapCount;
-    doc["average_lap_time"] = lapCount > 0 ? totalTime / lapCount : 0;
-    doc["best_lap_time"] = bestLapTime;
-    doc["record_type"] = "system";
-    doc["pilot_name"] = pilotName;
-    doc["updated_at"] = timeStr; // 使用当前时间作为更新时间
-    
-    // 添加圈速数据  去除首圈开圏的无效成绩
-    JsonArray laps = doc.createNestedArray("laps");
-    for (uint8_t i = 1; i < lapCount; i++) {
-        JsonObject lap = laps.createNestedObject();
-        lap["lap_time"] = lapTimes[i];
+
+    if (!uploader.submit(&job)) {
+        buz->beep(1000);
+        led->blink(200);
     }
-    
-    // 转换为JSON字符串
-    String jsonString;
-    serializeJson(doc, jsonString);
-    
-    DEBUG("Training data: %s\n", jsonString.c_str());
-    
-    // 发送HTTP请求
-    HTTPClient http;
-    String apiAddress = conf->getApiAddress();
-    http.begin(apiAddress + "/training/device_upload");
-    http.addHeader("Content-Type", "application/json");
- 
-    
-    int httpCode = http.POST(jsonString);
-    
-    if (httpCode > 0) {
-        String response = http.getString();
-        DEBUG("HTTP Response code: %d\n", httpCode);
-        DEBUG("Response: %s\n", response.c_str());
-        
-        // 检查上传是否成功
-        DynamicJsonDocument responseDoc(512);
-        DeserializationError error = deserializeJson(responseDoc, response);
-        
-        if (!error && responseDoc["success"] == true) {
-            DEBUG("Training data uploaded successfully\n");
-            buz->beep(200);
-            led->on(200);
+}
+
+// 新增：把计时核聚合好的RSSI桶打包成二进制帧发给所有WebSocket客户端和有线串口
+// buildFrame()只能有一个调用者，两边拿到的是同一串帧
+void Webserver::handleRssiStream(uint32_t currentTimeMs)
+{
+    if (stream == nullptr)
+        return;
+    if (servicesStarted && (currentTimeMs - wsCleanupMs) > WEB_WS_CLEANUP_MS) {
+        rssiSocket.cleanupClients();
+        wsCleanupMs = currentTimeMs;
+    }
+    // 每轮重新判断是否需要计时核聚合，setEnabled()只在本任务调用，不放进WebSocket回调
+    const bool serialStreaming = serialLink != nullptr && serialLink->getStreamBucketUs() != 0;
+    const bool wsClients = servicesStarted && rssiSocket.count() > 0;
+    stream->setEnabled(serialStreaming || wsClients);
+    if (!wsClients && !serialStreaming)
+        return;
+    static uint8_t frame[RSSI_STREAM_FRAME_MAX_BYTES];
+    size_t len;
+    // 帧头带生效的阈值：开启底噪跟踪时与配置值不同；扫描模式下计时核不刷新，用配置值
+    const bool scanning = scanner != nullptr && scanner->isActive();
+    const uint8_t enterRssi = scanning ? conf->getEnterRssi() : timer->getEnterRssi();
+    const uint8_t exitRssi = scanning ? conf->getExitRssi() : timer->getExitRssi();
+    while ((len = stream->buildFrame(frame, currentTimeMs, enterRssi, exitRssi)) > 0) {
+        // 串口发送缓冲不够时SerialLink自己丢帧计数，不阻塞计时事件
+        if (serialStreaming)
+            serialLink->sendRssi(frame, len);
+        if (!wsClients)
+            continue;
+        // 慢客户端的发送队列满了就丢帧，帧序号让客户端知道有缺口
+        if (rssiSocket.availableForWriteAll()) {
+            rssiSocket.binaryAll(frame, len);
         } else {
-            DEBUG("Failed to upload training data: %s\n", response.c_str());
-            buz->beep(1000);
-            led->blink(200);
+            streamFramesSkipped++;
         }
-    } else {
-        DEBUG("HTTP request failed, error: %s\n", http.errorToString(httpCode).c_str());
+    }
+}
+
+// 上传结果的蜂鸣/LED提示放回本任务执行，避免后台任务直接操作外设
+void Webserver::handleUploadResult()
+{
+    upload_status_t status;
+    uploader.getStatus(&status);
+    if (status.completed == uploadsReported)
+        return;
+    bool failed = status.failed != uploadFailuresReported;
+    uploadsReported = status.completed;
+    uploadFailuresReported = status.failed;
+    if (failed) {
         buz->beep(1000);
         led->blink(200);
+    } else {
+        DEBUG("Training data uploaded successfully\n");
+        buz->beep(200);
+        led->on(200);
     }
-    
-    http.end();
 }
 
 void Webserver::handleWebUpdate(uint32_t currentTimeMs)
@@ -260,10 +608,20 @@ void Webserver::handleWebUpdate(uint32_t currentTimeMs)
     //     sendLaptimeEvent(timer->getLapTime());
     // }
 
+    handleUploadResult();
+
+    handleRssiStream(currentTimeMs);
+
+    handleRaceNet();
+
     if (sendRssi && ((currentTimeMs - rssiSentMs) > WEB_RSSI_SEND_TIMEOUT_MS)) {
         sendRssiEvent(timer->getRssi());
         rssiSentMs = currentTimeMs;
     }
+    if (sendRssi && ((currentTimeMs - noiseSentMs) > WEB_NOISE_SEND_TIMEOUT_MS)) {
+        sendNoiseEvent();
+        noiseSentMs = currentTimeMs;
+    }
 
     // Check if configuration has changed requiring a reconnect
     // If we are in AP mode but have valid SSID/Password, try to connect?
@@ -544,6 +902,7 @@ static void startMDNS()
     instance.replace(":", "");
     MDNS.setInstanceName(instance);
     MDNS.addService("http", "tcp", 80);
+    MDNS.addService("qylap", "udp", RACENET_PORT);
 }
 
 static void startNTP()
@@ -606,10 +965,23 @@ void Webserver::startServices()
 
     server.on("/status", [this](AsyncWebServerRequest *request)
               {
-        char buf[1024];
-        char configBuf[256];
+        char buf[3072];
+        char configBuf[640];  // Config::toJsonString()最多写640字节
         conf->toJsonString(configBuf);
+        auto *cmdQueue = timer->getCommandQueue();
+        auto *eventQueue = timer->getEventQueue();
         float voltage = (float)monitor->getBatteryVoltage() / 10;
+        const bool scanning = scanner != nullptr && scanner->isActive();
+        const uint64_t nowUs = esp_timer_get_time();
+        ClockSync *clock = raceNode ? raceNode->getClock() : nullptr;
+        uint64_t sharedUs;
+        uint32_t boundUs;
+        const int syncBoundUs = raceNode && raceNode->toShared(nowUs, nowUs, &sharedUs, &boundUs) ? (int)boundUs : -1;
+        const char *syncState = "off";
+        if (raceNode != nullptr)
+            syncState = raceNode->isSelfMaster() ? "master" : raceNode->isSynced(nowUs) ? "synced" : raceNode->hasMaster() ? "syncing" : "no master";
+        const uint8_t castMode = lapCaster ? lapCaster->getMode() : LAPCAST_OFF;
+        const char *lapCastMode = castMode == LAPCAST_MULTICAST ? "multicast" : castMode == LAPCAST_BROADCAST ? "broadcast" : "off";
         const char *format =
             "\
 Heap:\n\
@@ -632,13 +1004,65 @@ Network:\n\
 \tMAC:\t%s\n\
 EEPROM:\n\
 %s\n\
-Battery Voltage:\t%0.1fv";
+Battery Voltage:\t%0.1fv\n\
+Queues:\n\
+\tCommands:\tdepth %u/%u, max %u, drops %u\n\
+\tEvents:\tdepth %u/%u, max %u, drops %u\n\
+RSSI Stream:\n\
+\tClients:\t%u, bucket %u us, dropped buckets %u, skipped frames %u\n\
+Noise Floor:\n\
+\tFloor:\t%u (%s, %u updates)\n\
+\tThresholds:\tenter %u, exit %u (tracking %s)\n\
+Scanner:\t%s, %u channels, revisit %u us, max tune %u us, %u cycles\n\
+RX5808:\t%s bus, state %s, last command %u us, max %u us, max service %u us, verify failures %u\n\
+RaceNet:\t%s over %s, %u nodes, %u laps, %u subscribers, sent %u, resent %u\n\
+ESP-NOW:\t%s, rx dropped %u, tx failures %u\n\
+Clock Sync:\t%s, offset %lld us, drift %.2f ppm, bound %d us, min rtt %u us, %u samples, %u replies served\n\
+Sectors:\tgate %u of %u, ok %u, missing %u, repeat %u, late %u\n\
+LapCast:\t%s, seq %u, sent %u, resent %u, nacks %u\n\
+Serial Link:\t%s, events %u, commands %u, resent %u, rssi frames %u, tx dropped %u, rx bad %u\n\
+Event Sinks:\ttimer %u/%u, scanner %u/%u\n\
+Stack:\tparallelTask min free %u of %u bytes";
 
         snprintf(buf, sizeof(buf), format,
                  ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getHeapSize(), ESP.getMaxAllocHeap(), LittleFS.usedBytes(), LittleFS.totalBytes(),
                  ESP.getChipModel(), ESP.getChipRevision(), ESP.getChipCores(), ESP.getSdkVersion(), ESP.getFlashChipSize(), ESP.getFlashChipSpeed() / 1000000, getCpuFrequencyMhz(),
                  FIRMWARE_VERSION,
-                 WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str(), configBuf, voltage);
+                 WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str(), configBuf, voltage,
+                 cmdQueue->depth(), cmdQueue->capacity(), cmdQueue->getHighWater(), cmdQueue->getDrops(),
+                 eventQueue->depth(), eventQueue->capacity(), eventQueue->getHighWater(), eventQueue->getDrops(),
+                 rssiSocket.count(), stream ? stream->getBucketUs() : 0, stream ? stream->getDroppedBuckets() : 0, streamFramesSkipped,
+                 timer->getNoiseFloor(), timer->isNoiseFloorValid() ? "valid" : "estimating", timer->getNoiseFloorUpdates(),
+                 timer->getEnterRssi(), timer->getExitRssi(), conf->getFloorTrack() ? "on" : "off",
+                 scanning ? (scanner->isRunning() ? "running" : "idle") : "off", scanning ? scanner->getChannelCount() : 0,
+                 scanning ? scanner->getRevisitUs() : 0, scanning ? scanner->getMaxTuneUs() : 0, scanning ? scanner->getCycles() : 0,
+                 rx ? (rx->getBus() == RX5808_BUS_FAST ? "fast" : "slow") : "n/a",
+                 rx ? RX5808::stateToString(rx->getState()) : "n/a", rx ? rx->getLastCommandUs() : 0,
+                 rx ? rx->getMaxCommandUs() : 0, rx ? rx->getMaxServiceUs() : 0, rx ? rx->getVerifyFailures() : 0,
+                 raceAggregator ? (raceAggregator->isActive() ? "aggregating" : "node") : "off",
+                 espNowStarted ? "ESP-NOW" : "UDP",
+                 raceAggregator ? raceAggregator->getPeerCount() : 0, raceAggregator ? raceAggregator->getLapCount() : 0,
+                 raceNode ? raceNode->getSubscriberCount() : 0, raceNode ? raceNode->getSent() : 0,
+                 raceNode ? raceNode->getResent() : 0,
+                 espNowStarted ? "on" : conf->getRaceLink() == 1 ? "failed" : "off",
+                 espNowStarted ? espNowTransport.getDropped() : 0, espNowStarted ? espNowTransport.getSendFailures() : 0,
+                 syncState,
+                 clock ? (long long)clock->getOffsetUs() : 0LL, clock ? clock->getDriftPpm() : 0.0f, syncBoundUs,
+                 clock ? clock->getMinDelayUs() : 0, clock ? clock->getSamples() : 0,
+                 raceAggregator ? raceAggregator->getSyncReplies() : 0,
+                 conf->getSectorIndex(), conf->getSectorCount(), sectors ? sectors->getCount(RACENET_SECTOR_OK) : 0,
+                 sectors ? sectors->getCount(RACENET_SECTOR_MISSING) : 0,
+                 sectors ? sectors->getCount(RACENET_SECTOR_REPEAT) : 0,
+                 sectors ? sectors->getCount(RACENET_SECTOR_LATE) : 0,
+                 lapCastMode, lapCaster ? lapCaster->getLastSeq() : 0, lapCaster ? lapCaster->getSent() : 0,
+                 lapCaster ? lapCaster->getResent() : 0, lapCaster ? lapCaster->getNacks() : 0,
+                 serialLink ? (serialLink->getStreamBucketUs() ? "streaming" : "on") : "off",
+                 serialLink ? serialLink->getLastSeq() : 0, serialLink ? serialLink->getCommands() : 0,
+                 serialLink ? serialLink->getResent() : 0, serialLink ? serialLink->getRssiFrames() : 0,
+                 serialLink ? serialLink->getTxDropped() : 0, serialLink ? serialLink->getRxBad() : 0,
+                 timer->getEventSinkCount(), LAPTIMER_MAX_EVENT_SINKS, scanner ? scanner->getEventSinkCount() : 0,
+                 LAPTIMER_MAX_EVENT_SINKS,
+                 parallelTask ? (unsigned)uxTaskGetStackHighWaterMark(parallelTask) : 0, parallelTaskStack);
         request->send(200, "text/plain", buf);
         led->on(200); });
 
@@ -653,8 +1077,9 @@ Battery Voltage:\t%0.1fv";
 
     server.on("/timer/start", HTTP_POST, [this](AsyncWebServerRequest *request)
               {
-        timer->start();
-        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
+        bool queued = postTimerCommand(LAPTIMER_CMD_START);
+        AsyncWebServerResponse* res = queued ? request->beginResponse(200, "application/json", "{\"status\": \"OK\"}")
+                                             : request->beginResponse(503, "application/json", "{\"status\": \"BUSY\"}");
         res->addHeader("Access-Control-Allow-Origin", "*");
         res->addHeader("Access-Control-Allow-Methods", "GET,POST,OPTIONS");
         res->addHeader("Access-Control-Allow-Headers", "Content-Type, Accept, Origin");
@@ -663,14 +1088,28 @@ Battery Voltage:\t%0.1fv";
 
     server.on("/timer/stop", HTTP_POST, [this](AsyncWebServerRequest *request)
               {
-        timer->stop();
-        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
+        bool queued = postTimerCommand(LAPTIMER_CMD_STOP);
+        AsyncWebServerResponse* res = queued ? request->beginResponse(200, "application/json", "{\"status\": \"OK\"}")
+                                             : request->beginResponse(503, "application/json", "{\"status\": \"BUSY\"}");
         res->addHeader("Access-Control-Allow-Origin", "*");
         res->addHeader("Access-Control-Allow-Methods", "GET,POST,OPTIONS");
         res->addHeader("Access-Control-Allow-Headers", "Content-Type, Accept, Origin");
         res->addHeader("Access-Control-Max-Age", "600");
         request->send(res); });
 
+    server.on("/upload/status", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        upload_status_t status;
+        uploader.getStatus(&status);
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "{\"state\":\"%s\",\"queued\":%u,\"completed\":%u,\"failed\":%u,\"dropped\":%u,\"timeouts\":%u,\"pending\":%u,\"httpCode\":%d,\"latencyMs\":%u,\"laps\":%u}",
+                 Uploader::stateToString(status.state), status.queued, status.completed, status.failed, status.dropped,
+                 status.timeouts, status.queued - status.completed, status.lastHttpCode, status.lastLatencyMs, status.lastLapCount);
+        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", buf);
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
     server.on("/timer/rssiStart", HTTP_POST, [this](AsyncWebServerRequest *request)
               {
         sendRssi = true;
@@ -695,29 +1134,224 @@ Battery Voltage:\t%0.1fv";
         request->send(res);
         led->on(200); });
 
-    server.on("/calibration/noise/start", HTTP_POST, [this](AsyncWebServerRequest *request)
+    // 新增：全速率RSSI录制，div参数为记录间隔（每div个样本记一个，默认1）
+    server.on("/trace/start", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        uint16_t div = 1;
+        if (request->hasParam("div")) {
+            long v = request->getParam("div")->value().toInt();
+            div = v < 1 ? 1 : (v > 1000 ? 1000 : v);
+        }
+        // 多频扫描时计时核不产生录制样本
+        if (scanner != nullptr && scanner->isActive()) {
+            AsyncWebServerResponse* res = request->beginResponse(409, "application/json", "{\"status\": \"SCAN_MODE\"}");
+            res->addHeader("Access-Control-Allow-Origin", "*");
+            request->send(res);
+            return;
+        }
+        bool ok = trace != nullptr && trace->requestStart(div, SAMPLER_RATE_HZ, conf->getEnterRssi(), conf->getExitRssi(), conf->getFrequency());
+        AsyncWebServerResponse* res = ok ? request->beginResponse(200, "application/json", "{\"status\": \"OK\"}")
+                                         : request->beginResponse(409, "application/json", "{\"status\": \"BUSY\"}");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    server.on("/trace/stop", HTTP_POST, [this](AsyncWebServerRequest *request)
               {
-        timer->startCalibrationNoise();
+        if (trace != nullptr) trace->requestStop();
         AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
         res->addHeader("Access-Control-Allow-Origin", "*");
         request->send(res); });
 
-    server.on("/calibration/noise/stop", HTTP_POST, [this](AsyncWebServerRequest *request)
+    server.on("/trace/status", HTTP_GET, [this](AsyncWebServerRequest *request)
               {
-        uint8_t maxNoise = timer->stopCalibrationNoise();
-        uint16_t samples = timer->getCalibrationNoiseSamples();
-        uint16_t target = conf->getCalibrationSamples();
-        bool ok = samples >= target;
-        char buf[128];
-        snprintf(buf, sizeof(buf), "{\"status\":\"OK\",\"maxNoise\":%u,\"samples\":%u,\"target\":%u,\"ok\":%s}", maxNoise, samples, target, ok ? "true" : "false");
+        if (trace == nullptr) {
+            request->send(404);
+            return;
+        }
+        static const char *stateNames[] = {"idle", "starting", "recording", "stopping"};
+        char buf[224];
+        snprintf(buf, sizeof(buf),
+                 "{\"state\":\"%s\",\"samples\":%u,\"dropped\":%u,\"bytes\":%u,\"capacity\":%u,\"maxWriteMs\":%u,\"fileBytes\":%u}",
+                 stateNames[trace->getState()], trace->getSamples(), trace->getDropped(), trace->getBytes(),
+                 trace->getCapacity(), trace->getMaxWriteMs(), trace->isRecording() ? 0 : trace->getStorage()->size());
         AsyncWebServerResponse* res = request->beginResponse(200, "application/json", buf);
         res->addHeader("Access-Control-Allow-Origin", "*");
         request->send(res); });
 
+    // 按块从存储读取后发送，不把整个文件读进内存
+    server.on("/trace/download", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (trace == nullptr || trace->isRecording()) {
+            request->send(409, "application/json", "{\"status\": \"BUSY\"}");
+            return;
+        }
+        TraceStorage *storage = trace->getStorage();
+        uint32_t size = storage->size();
+        if (size == 0) {
+            request->send(404, "application/json", "{\"status\": \"EMPTY\"}");
+            return;
+        }
+        AsyncWebServerResponse* res = request->beginResponse("application/octet-stream", size,
+            [storage](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return storage->read(index, buffer, maxLen);
+            });
+        res->addHeader("Content-Disposition", "attachment; filename=\"trace.bin\"");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    // 频谱扫描：band为频段字母（默认"ABEFR"），或用from/to/step（MHz）指定范围；扫描结束后自动恢复比赛频率
+    server.on("/spectrum/start", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        uint16_t freqs[SPECTRUM_MAX_CHANNELS];
+        uint8_t count;
+        if (request->hasParam("from") && request->hasParam("to")) {
+            long step = request->hasParam("step") ? request->getParam("step")->value().toInt() : 5;
+            count = SpectrumSweep::rangeFrequencies(request->getParam("from")->value().toInt(),
+                                                    request->getParam("to")->value().toInt(), step < 1 ? 1 : step,
+                                                    freqs, SPECTRUM_MAX_CHANNELS);
+        } else {
+            String bands = request->hasParam("band") ? request->getParam("band")->value() : String("ABEFR");
+            count = SpectrumSweep::bandFrequencies(bands.c_str(), freqs, SPECTRUM_MAX_CHANNELS);
+        }
+        AsyncWebServerResponse* res;
+        if (spectrum == nullptr || (scanner != nullptr && scanner->isActive())) {
+            res = request->beginResponse(409, "application/json", "{\"status\": \"SCAN_MODE\"}");
+        } else if (timer->isRunning() || timer->isCalibrationNoiseRunning()) {
+            res = request->beginResponse(409, "application/json", "{\"status\": \"TIMER_RUNNING\"}");
+        } else if (count == 0) {
+            res = request->beginResponse(400, "application/json", "{\"status\": \"NO_CHANNELS\"}");
+        } else if (!spectrum->request(freqs, count)) {
+            res = request->beginResponse(409, "application/json", "{\"status\": \"BUSY\"}");
+        } else {
+            char buf[48];
+            snprintf(buf, sizeof(buf), "{\"status\": \"OK\", \"count\": %u}", count);
+            res = request->beginResponse(200, "application/json", buf);
+        }
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    server.on("/spectrum/stop", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        if (spectrum != nullptr) spectrum->abort();
+        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    server.on("/spectrum", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (spectrum == nullptr) {
+            request->send(404);
+            return;
+        }
+        sendSpectrum(request); });
+
+    // 局域网内的计时节点；请求本身会让本机在RACENET_ACTIVE_MS内担任汇总方
+    server.on("/nodes", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (raceAggregator == nullptr) {
+            request->send(404);
+            return;
+        }
+        raceAggregator->requestActive();
+        sendNodes(request); });
+
+    // "/race"会匹配"/race/..."，子路径必须先注册
+    server.on("/race/clear", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        if (raceAggregator != nullptr) raceAggregator->requestClear();
+        if (sectors != nullptr) sectors->requestClear();
+        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    // lapsUs最多JOURNAL_BOOT_MAX_LAPS圈，laps为日志里该会话的总圈数
+    server.on("/journal/last", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (journal == nullptr) {
+            request->send(404);
+            return;
+        }
+        sendJournalLast(request); });
+
+    server.on("/race", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (raceAggregator == nullptr) {
+            request->send(404);
+            return;
+        }
+        raceAggregator->requestActive();
+        sendRace(request); });
+
+    // 分段计时结果，?after=<序号>增量获取；请求同样让本机担任汇总方
+    server.on("/sectors", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        if (sectors == nullptr || raceAggregator == nullptr) {
+            request->send(404);
+            return;
+        }
+        raceAggregator->requestActive();
+        sendSectors(request); });
+
+    // 扫描模式的状态和各频率最近的RSSI、圈速；未启用扫描时active为false
+    server.on("/scan", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        const bool scanning = scanner != nullptr && scanner->isActive();
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->addHeader("Access-Control-Allow-Origin", "*");
+        response->printf("{\"active\":%s,\"running\":%s,\"settleUs\":%u,\"dwellUs\":%u,",
+                         scanning ? "true" : "false", scanning && scanner->isRunning() ? "true" : "false",
+                         (uint32_t)SCANNER_SETTLE_US, (uint32_t)SCANNER_DWELL_US);
+        response->printf("\"revisitUs\":%u,\"maxTuneUs\":%u,\"cycles\":%u,\"channels\":[",
+                         scanning ? scanner->getRevisitUs() : 0, scanning ? scanner->getMaxTuneUs() : 0,
+                         scanning ? scanner->getCycles() : 0);
+        for (uint8_t i = 0; scanning && i < scanner->getChannelCount(); i++) {
+            ScanChannel *channel = scanner->getChannel(i);
+            response->printf("%s{\"freq\":%u,\"rssi\":%u,\"laps\":%u,\"lastLapUs\":%u,\"visits\":%u}", i ? "," : "",
+                             channel->getFrequency(), channel->getRssi(), channel->getLapCount(),
+                             channel->getLastLapUs(), channel->getVisits());
+        }
+        response->print("]}");
+        request->send(response); });
+
+    server.on("/noise", HTTP_GET, [this](AsyncWebServerRequest *request)
+              {
+        char buf[112];
+        noiseToJson(buf, sizeof(buf));
+        AsyncWebServerResponse* res = request->beginResponse(200, "application/json", buf);
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    server.on("/calibration/noise/start", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        bool queued = timer->postCommand(LAPTIMER_CMD_CALIB_NOISE_START);
+        AsyncWebServerResponse* res = queued ? request->beginResponse(200, "application/json", "{\"status\": \"OK\"}")
+                                             : request->beginResponse(503, "application/json", "{\"status\": \"BUSY\"}");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    server.on("/calibration/noise/stop", HTTP_POST, [this](AsyncWebServerRequest *request)
+              {
+        // 已自动停止时直方图不再变化，直接返回结果
+        if (!timer->isCalibrationNoiseRunning()) {
+            sendCalibrationNoise(request, true);
+            return;
+        }
+        // 停止命令在计时核执行，执行前直方图仍在写入，不在这里读；
+        // 客户端轮询/calibration/noise/status?hist=1直到running为false
+        bool queued = timer->postCommand(LAPTIMER_CMD_CALIB_NOISE_STOP);
+        AsyncWebServerResponse* res = queued ? request->beginResponse(202, "application/json", "{\"status\": \"PENDING\", \"running\": true}")
+                                             : request->beginResponse(503, "application/json", "{\"status\": \"BUSY\"}");
+        res->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(res); });
+
+    // 校准进度和实时推荐值；带hist=1且已停止时附带直方图
+    server.on("/calibration/noise/status", HTTP_GET, [this](AsyncWebServerRequest *request)
+              { sendCalibrationNoise(request, request->hasParam("hist") && !timer->isCalibrationNoiseRunning()); });
+
     server.on("/calibration/crossing/start", HTTP_POST, [this](AsyncWebServerRequest *request)
               {
         // Deprecated but kept for compatibility
-        timer->startCalibrationCrossing();
+        timer->postCommand(LAPTIMER_CMD_CALIB_CROSSING_START);
         AsyncWebServerResponse* res = request->beginResponse(200, "application/json", "{\"status\": \"OK\"}");
         res->addHeader("Access-Control-Allow-Origin", "*");
         request->send(res); });
@@ -789,8 +1423,10 @@ Battery Voltage:\t%0.1fv";
                                                                                      {
         JsonObject jsonObj = json.as<JsonObject>();
 #ifdef DEBUG_OUT
-        serializeJsonPretty(jsonObj, DEBUG_OUT);
-        DEBUG("\n");
+        if (!debugMuted) {
+            serializeJsonPretty(jsonObj, DEBUG_OUT);
+            DEBUG("\n");
+        }
 #endif
         conf->fromJson(jsonObj);
         conf->write(); // 立即将配置写入EEPROM
@@ -819,7 +1455,30 @@ Battery Voltage:\t%0.1fv";
 
     server.onNotFound(handleNotFound);
 
+    // 新增：二进制RSSI流。客户端发送文本"bucketUs=<微秒>"选择分辨率，
+    // 1个采样周期（200 us）为逐样本，更大时为每桶min/max包络，帧格式见rssi_stream.h
+    rssiSocket.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+                       {
+        if (stream == nullptr)
+            return;
+        if (type == WS_EVT_CONNECT) {
+            DEBUG("RSSI websocket client #%u connected\n", client->id());
+        } else if (type == WS_EVT_DATA) {
+            AwsFrameInfo *info = (AwsFrameInfo *)arg;
+            if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT && len < 32) {
+                char text[32];
+                memcpy(text, data, len);
+                text[len] = 0;
+                unsigned long bucketUs;
+                if (sscanf(text, "bucketUs=%lu", &bucketUs) == 1) {
+                    stream->setResolution(bucketUs, 1000000 / SAMPLER_RATE_HZ);
+                    DEBUG("RSSI stream resolution %u us\n", stream->getBucketUs());
+                }
+            }
+        } });
+
     server.addHandler(&events);
+    server.addHandler(&rssiSocket);
     server.addHandler(configJsonHandler);
 
     // 为了支持文件系统更新，我们需要添加一个额外的路由
@@ -2,34 +2,111 @@
 #include <ESPAsyncWebServer.h>
 
 #include "battery.h"
+#include "journal.h"
 #include "laptimer.h"
+#include "lapcast.h"
+#include "racenet.h"
+#include "rssi_stream.h"
+#include "sectors.h"
+#include "scanner.h"
+#include "serial_link.h"
+#include "spectrum.h"
+#include "trace.h"
+#include "uploader.h"
 
 #define WIFI_CONNECTION_TIMEOUT_MS 30000
 #define WIFI_RECONNECT_TIMEOUT_MS 500
 #define WEB_RSSI_SEND_TIMEOUT_MS 200
+#define WEB_NOISE_SEND_TIMEOUT_MS 1000  // 底噪和生效阈值随RSSI一起推送，变化缓慢
 #define RESTART_DELAY_MS 1000
+#define WEB_WS_CLEANUP_MS 1000
+#define RACENET_POLL_PACKETS 16  // parallelTask每轮最多处理的多节点UDP包
+#define RACENET_WEB_LAPS 50      // /race返回的最近圈数
+#define RACENET_WEB_SECTORS 32   // /sectors每次最多返回的结果数
 
 class Webserver {
    public:
     void init(Config *config, LapTimer *lapTimer, BatteryMonitor *batMonitor, Buzzer *buzzer, Led *l);
     void handleWebUpdate(uint32_t currentTimeMs);
+    void setTraceRecorder(TraceRecorder *recorder) { trace = recorder; }
+    void setRssiStream(RssiStream *rssiStream) { stream = rssiStream; }
+    // 扫描模式：开始/停止命令同时发给扫描器，圈速以"scanLap"事件推送
+    void setScanner(FrequencyScanner *frequencyScanner);
+    void setReceiver(RX5808 *rx5808) { rx = rx5808; }
+    // 赛前频谱扫描，结果以"spectrum"/"spectrumDone"事件逐个频率推送
+    void setSpectrum(SpectrumSweep *spectrumSweep);
+    // 多节点汇总：本机圈速经UDP（或ESP-NOW）推送给订阅者；页面请求/nodes或/race时本机同时做汇总方
+    void setRaceNet(RaceNode *node, RaceAggregator *aggregator, MdnsPeerFinder *finder);
+    // 分段计时：每跑完一段以"sector"事件推送，/sectors按序号增量返回
+    void setSectors(SectorCoordinator *coordinator);
+    // UDP圈速广播：与RaceNet共用套接字，按配置的模式发送，NACK在handleRaceNet()中分流
+    void setLapCast(LapCaster *caster) { lapCaster = caster; }
+    // 有线串口协议：电脑用STREAM命令打开后，RSSI帧同时发到串口，与WebSocket共用一个RssiStream
+    void setSerialLink(SerialLink *link) { serialLink = link; }
+    // 圈速日志：/journal/last返回启动时恢复出的最后一个会话
+    void setJournal(Journal *lapJournal) { journal = lapJournal; }
+    // /status显示parallelTask栈的历史最小剩余量，stackBytes为创建时分配的大小
+    void setParallelTask(TaskHandle_t task, uint32_t stackBytes) {
+        parallelTask = task;
+        parallelTaskStack = stackBytes;
+    }
 
    private:
     void startServices();
     void sendRssiEvent(uint8_t rssi);
-    void sendLaptimeEvent(uint32_t lapTime);
+    void sendNoiseEvent();
+    size_t noiseToJson(char *buf, size_t size);
+    void sendCalibrationNoise(AsyncWebServerRequest *request, bool withHistogram);
+    void sendLaptimeEvent(uint32_t lapTimeUs);
+    static void scanEventSink(const laptimer_event_t *event, void *ctx);
+    static void spectrumEventSink(const spectrum_event_t *event, void *ctx);
+    void sendSpectrum(AsyncWebServerRequest *request);
+    bool postTimerCommand(laptimer_cmd_e cmd);
     // 新增：lap事件处理函数
-    static void lapEventHandler(uint32_t lapTime);
+    static void lapEventHandler(uint32_t lapTimeUs);
     // 新增：stop事件处理函数
     static void stopEventHandler();
     // 新增：上传训练数据到平台
     void uploadTrainingData();
+    void handleUploadResult();
+    void handleRssiStream(uint32_t currentTimeMs);
+    void handleRaceNet();
+    void pollRaceTransport(RaceTransport *transport, bool raceNet);
+    void sendNodes(AsyncWebServerRequest *request);
+    void sendRace(AsyncWebServerRequest *request);
+    static void sectorResultSink(const racenet_sector_t *result, void *ctx);
+    size_t sectorToJson(const racenet_sector_t *result, char *buf, size_t size);
+    void sendSectors(AsyncWebServerRequest *request);
+    void sendJournalLast(AsyncWebServerRequest *request);
 
     Config *conf;
     LapTimer *timer;
     BatteryMonitor *monitor;
     Buzzer *buz;
     Led *led;
+    Uploader uploader;
+    TraceRecorder *trace = nullptr;
+    RssiStream *stream = nullptr;
+    FrequencyScanner *scanner = nullptr;
+    RX5808 *rx = nullptr;
+    SpectrumSweep *spectrum = nullptr;
+    RaceNode *raceNode = nullptr;
+    RaceAggregator *raceAggregator = nullptr;
+    MdnsPeerFinder *peerFinder = nullptr;
+    SectorCoordinator *sectors = nullptr;
+    LapCaster *lapCaster = nullptr;
+    SerialLink *serialLink = nullptr;
+    Journal *journal = nullptr;
+    TaskHandle_t parallelTask = nullptr;
+    uint32_t parallelTaskStack = 0;
+    WiFiUdpRaceTransport raceTransport;
+    EspNowRaceTransport espNowTransport;  // 配置选了ESP-NOW时RaceNet改走这里，重启后生效
+    bool raceNetStarted = false;
+    bool espNowStarted = false;
+    uint32_t wsCleanupMs = 0;
+    uint32_t streamFramesSkipped = 0;
+    uint32_t uploadsReported = 0;
+    uint32_t uploadFailuresReported = 0;
 
     wifi_mode_t wifiMode = WIFI_OFF;
     wl_status_t lastStatus = WL_IDLE_STATUS;
@@ -42,6 +119,7 @@ class Webserver {
 
     bool sendRssi = false;
     uint32_t rssiSentMs = 0;
+    uint32_t noiseSentMs = 0;
     uint32_t nodesRefreshMs = 0;
     uint8_t connectionAttempts = 0;
 };
\ No newline at end of file
@@ -1,26 +1,297 @@
+#include "bands.h"
 #include "debug.h"
+#include "journal.h"
+#include "lapcast.h"
 #include "led.h"
+#include "racenet.h"
+#include "scanner.h"
+#include "sectors.h"
+#include "serial_link.h"
+#include "spectrum.h"
+#include "trace.h"
 #include "webserver.h"
 #include <ElegantOTA.h>
+#include <esp_mac.h>
+#include <esp_timer.h>
 
 static RX5808 rx(PIN_RX5808_RSSI, PIN_RX5808_DATA, PIN_RX5808_SELECT, PIN_RX5808_CLOCK);
+static AdcDmaRssiSource adcSource(PIN_RX5808_RSSI, PIN_VBAT);
+static PolledRssiSource polledSource(&rx, RSSI_DECIMATION);
 static Config config;
 static Webserver ws;
 static Buzzer buzzer;
 static Led led;
 static LapTimer timer;
+static FrequencyScanner scanner;
+static SpectrumSweep spectrum;
 static BatteryMonitor monitor;
+static LittleFsJournalStorage journalStorage("/laps.jnl");
+static Journal journal;
+static LittleFsTraceStorage traceFsStorage("/trace.bin");
+static PsramTraceStorage tracePsramStorage(TRACE_PSRAM_BYTES);
+static TraceRecorder traceRecorder;
+static RssiStream rssiStream;
+static RaceNode raceNode;
+static RaceAggregator raceAggregator;
+static MdnsPeerFinder peerFinder;
+static SectorCoordinator sectorCoordinator;
+static LapCaster lapCaster;
+static HardwareSerialPort serialPort;
+static SerialLink serialLink;
 
+static_assert(RSSI_STREAM_FRAME_MAX_BYTES <= SERIAL_LINK_MAX_PAYLOAD, "RSSI frame must fit in a serial link frame");
+
+// 字节数。parallelTask里有LittleFS日志写入、网页/串口事件的格式化和全部事件订阅者，
+// 原来的4096没有为这些同时开启留出余量；实际用量见/status的Stack一行
+#define PARALLEL_TASK_STACK 8192
 static TaskHandle_t xTimerTask = NULL;
 
+static uint16_t readVbatRaw() {
+    return adcSource.getAuxRaw();
+}
+
+// 优先使用连续ADC/DMA定速采样，不支持时退回到每次loop()轮询一次
+// 原始采样率为检测器采样率乘以抽取比
+static RssiSource *initRssiSource() {
+    if (adcSource.begin(SAMPLER_RATE_HZ * RSSI_DECIMATION)) {
+        return &adcSource;
+    }
+    DEBUG("ADC DMA unavailable, falling back to polled RSSI\n");
+    polledSource.begin(SAMPLER_RATE_HZ * RSSI_DECIMATION);
+    return &polledSource;
+}
+
+static uint32_t journalClockUs() {
+    return micros();
+}
+
+static uint64_t raceNetClockUs() {
+    return esp_timer_get_time();
+}
+
+static uint32_t traceClockMs() {
+    return millis();
+}
+
+// 有PSRAM时录制到PSRAM，容量大且不磨损闪存；否则写LittleFS
+static void initTraceRecorder() {
+    traceRecorder.setStorage(psramFound() ? (TraceStorage *)&tracePsramStorage : (TraceStorage *)&traceFsStorage);
+    traceRecorder.setClock(traceClockMs);
+    timer.setTraceRecorder(&traceRecorder);
+    ws.setTraceRecorder(&traceRecorder);
+}
+
+// 未完成NTP同步时time()只是开机秒数，日志里记0表示未知
+static uint32_t wallTimeOrZero() {
+    time_t now = time(NULL);
+    return now > 1600000000 ? (uint32_t)now : 0;
+}
+
+// 计时事件写入闪存日志，在parallelTask中执行，不占用计时核
+static void journalEventSink(const laptimer_event_t *event, void *ctx) {
+    Journal *j = (Journal *)ctx;
+    switch (event->type) {
+        case LAPTIMER_EVENT_START:
+            j->sessionStart(wallTimeOrZero());
+            break;
+        case LAPTIMER_EVENT_LAP:
+            j->appendLap(event->lapNumber, event->lapTimeUs);
+            break;
+        case LAPTIMER_EVENT_STOP:
+            j->sessionStop(wallTimeOrZero());
+            break;
+        default:
+            break;
+    }
+}
+
+// 订阅者超过LAPTIMER_MAX_EVENT_SINKS时事件不会送达，启动时报出来；/status可看各自已用的订阅数
+static void checkEventSink(bool added, const char *name) {
+    if (!added) DEBUG("Event sink %s not registered, raise LAPTIMER_MAX_EVENT_SINKS\n", name);
+}
+
+static bool initJournal() {
+    journal.setClock(journalClockUs);
+    if (!journal.begin(&journalStorage)) {
+        DEBUG("Lap journal unavailable\n");
+        return false;
+    }
+    journal_session_t *last = journal.getLastSession();
+    if (journal.getTruncatedBytes() > 0) {
+        DEBUG("Lap journal: dropped %u bytes of torn records\n", journal.getTruncatedBytes());
+    }
+    if (journal.wasRecovered()) {
+        DEBUG("Lap journal: closed unfinished session %u with %u laps\n", last->session, last->laps);
+    }
+    checkEventSink(timer.addEventSink(journalEventSink, &journal), "journal");
+    return true;
+}
+
+static uint16_t eventFrequency(const laptimer_event_t *event) {
+    if (scanner.isActive()) {
+        ScanChannel *channel = scanner.getChannel(event->channel);
+        if (channel != nullptr) return channel->getFrequency();
+    }
+    return config.getFrequency();
+}
+
+// 计时和扫描事件交给多节点推送，与网页事件一样在parallelTask中执行
+static void raceNetEventSink(const laptimer_event_t *event, void *ctx) {
+    ((RaceNode *)ctx)->pushEvent(event->type, event->channel, eventFrequency(event), event->lapNumber,
+                                 event->lapTimeUs, event->timeUs, esp_timer_get_time());
+}
+
+// 每完成一圈立即广播给比赛控制软件，未开启时LapCaster只记入历史
+static void lapCastEventSink(const laptimer_event_t *event, void *ctx) {
+    if (event->type != LAPTIMER_EVENT_LAP) return;
+    ((LapCaster *)ctx)->publish(eventFrequency(event), event->lapNumber, event->lapTimeUs, event->timeUs,
+                                event->peakRssi, esp_timer_get_time());
+}
+
+// 汇总得到的每一圈都交给分段协调器，未配置分段的节点在addLap()中忽略
+static void raceNetLapSink(const racenet_lap_t *lap, void *ctx) {
+    ((SectorCoordinator *)ctx)->addLap(lap);
+}
+
+static void initRaceNet() {
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    // 每次启动换一个boot id，汇总方据此识别节点重启后序号归零
+    const uint32_t boot = esp_random();
+    raceNode.begin(nullptr, mac, boot);
+    raceAggregator.begin(nullptr, mac, boot);
+    raceAggregator.setClock(raceNetClockUs);
+    raceNode.setLocalAggregator(&raceAggregator);
+    raceAggregator.setLapSink(raceNetLapSink, &sectorCoordinator);
+    lapCaster.begin(nullptr, mac, boot);
+    lapCaster.setClockSource(&raceNode);
+    if (!peerFinder.begin()) {
+        DEBUG("mDNS peer finder unavailable\n");
+    }
+    checkEventSink(timer.addEventSink(raceNetEventSink, &raceNode), "raceNet");
+    checkEventSink(timer.addEventSink(lapCastEventSink, &lapCaster), "lapCast");
+    if (scanner.isActive()) {
+        checkEventSink(scanner.addEventSink(raceNetEventSink, &raceNode), "scanner raceNet");
+        checkEventSink(scanner.addEventSink(lapCastEventSink, &lapCaster), "scanner lapCast");
+    }
+    ws.setRaceNet(&raceNode, &raceAggregator, &peerFinder);
+    ws.setSectors(&sectorCoordinator);
+    ws.setLapCast(&lapCaster);
+}
+
+// 计时和扫描事件原样发给有线串口，包括开始/停止，电脑据此对齐比赛状态
+static void serialEventSink(const laptimer_event_t *event, void *ctx) {
+    ((SerialLink *)ctx)->sendEvent(event->type, event->channel, eventFrequency(event), event->lapNumber,
+                                   event->lapTimeUs, event->timeUs, event->peakRssi, esp_timer_get_time());
+}
+
+// 在parallelTask中执行，开始/停止走计时核的第二个命令队列，不与AsyncTCP任务抢同一个SPSC队列
+static uint8_t serialCommandHandler(const serial_link_cmd_t *cmd, void *ctx) {
+    (void)ctx;
+    switch (cmd->type) {
+        case SERIAL_CMD_START:
+        case SERIAL_CMD_STOP: {
+            const laptimer_cmd_e c = cmd->type == SERIAL_CMD_START ? LAPTIMER_CMD_START : LAPTIMER_CMD_STOP;
+            const bool queued = scanner.isActive() ? scanner.postIoCommand(c) : timer.postIoCommand(c);
+            return queued ? SERIAL_RESULT_OK : SERIAL_RESULT_REJECTED;
+        }
+        case SERIAL_CMD_SET_FREQ:
+            if (cmd->frequency < RX5808_FREQ_MIN_MHZ || cmd->frequency > RX5808_FREQ_MAX_MHZ) {
+                return SERIAL_RESULT_BAD_ARGS;
+            }
+            // 扫描模式下频率由扫描列表决定
+            if (scanner.isActive()) return SERIAL_RESULT_REJECTED;
+            config.setFrequency(cmd->frequency);
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_SET_RSSI:
+            if (cmd->exitRssi >= cmd->enterRssi) return SERIAL_RESULT_BAD_ARGS;
+            config.setEnterRssi(cmd->enterRssi);
+            config.setExitRssi(cmd->exitRssi);
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_STREAM:
+            // 分辨率与网页RSSI流共用，以最后一次设置为准；是否产出由Webserver::handleRssiStream()决定
+            if (cmd->bucketUs != 0) rssiStream.setResolution(cmd->bucketUs, 1000000 / SAMPLER_RATE_HZ);
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_STATUS: {
+            serial_status_t status;
+            memset(&status, 0, sizeof(status));
+            status.running = scanner.isActive() ? scanner.isRunning() : timer.isRunning();
+            status.frequency = config.getFrequency();
+            // 与/status一致报告生效的阈值（底噪跟踪时随底噪移动），扫描模式下为配置值
+            status.enterRssi = scanner.isActive() ? config.getEnterRssi() : timer.getEnterRssi();
+            status.exitRssi = scanner.isActive() ? config.getExitRssi() : timer.getExitRssi();
+            status.rssi = timer.getRssi();
+            status.nowUs = esp_timer_get_time();
+            serialLink.sendStatus(&status);
+            return SERIAL_RESULT_OK;
+        }
+        default:
+            return SERIAL_RESULT_UNKNOWN;
+    }
+}
+
+// 配置开启时串口整个交给二进制协议，之后DEBUG输出丢弃；开关在重启后生效
+static void initSerialLink() {
+    if (!config.getSerialLink()) return;
+    serialPort.begin(SERIAL_LINK_BAUD);
+    serialLink.begin(&serialPort, serialCommandHandler, nullptr);
+    // 串口协议开启后DEBUG输出被丢弃，失败只能在/status的Event Sinks一行看出
+    checkEventSink(timer.addEventSink(serialEventSink, &serialLink), "serial");
+    if (scanner.isActive()) {
+        checkEventSink(scanner.addEventSink(serialEventSink, &serialLink), "scanner serial");
+    }
+    ws.setSerialLink(&serialLink);
+}
+
+#ifdef KALMAN_BENCHMARK
+// 在设备上比较浮点与定点卡尔曼滤波器的每样本周期数，与tools/bench/kalman_bench.cpp对应
+static void runKalmanBenchmark() {
+    const uint16_t samples = 5000;
+    KalmanFilter f1;
+    KalmanFilterQ16 f2;
+    f1.setMeasurementNoise(20.0f);
+    f1.setProcessNoise(0.004f);
+    f2.setMeasurementNoise(20.0f);
+    f2.setProcessNoise(0.004f);
+    volatile int32_t sink = 0;
+
+    uint32_t c0 = ESP.getCycleCount();
+    for (uint16_t i = 0; i < samples; i++) sink = f1.filter(1280 + (i & 0xFF), 0);
+    uint32_t c1 = ESP.getCycleCount();
+    for (uint16_t i = 0; i < samples; i++) sink = f2.filterQ16(1280 + (i & 0xFF));
+    uint32_t c2 = ESP.getCycleCount();
+
+    DEBUG("Kalman benchmark @ %u MHz: float %u cycles/sample, q16 %u cycles/sample\n",
+          getCpuFrequencyMhz(), (c1 - c0) / samples, (c2 - c1) / samples);
+    (void)sink;
+}
+#endif
+
 static void parallelTask(void *pvArgs) {
     for (;;) {
         uint32_t currentTimeMs = millis();
         buzzer.handleBuzzer(currentTimeMs);
         led.handleLed(currentTimeMs);
+        timer.dispatchEvents();
+        scanner.dispatchEvents();
+        // 圈速存储的块在这里分配，计时核追加时不malloc
+        if (scanner.isActive()) {
+            scanner.refillLaps();
+        } else {
+            timer.refillLaps();
+        }
+        spectrum.service();
+        spectrum.dispatchEvents();
+        traceRecorder.service(esp_timer_get_time());
+        if (serialLink.isActive()) {
+            serialLink.service(esp_timer_get_time());
+        }
         ws.handleWebUpdate(currentTimeMs);
         config.handleEeprom(currentTimeMs);
-        rx.handleFrequencyChange(currentTimeMs, config.getFrequency());
+        // 扫描模式和频谱扫描期间由计时核调谐，不能再切回配置的单一频率
+        if (!scanner.isActive() && !spectrum.ownsReceiver()) {
+            rx.handleFrequencyChange(currentTimeMs, config.getFrequency());
+        }
         monitor.checkBatteryState(currentTimeMs, config.getAlarmThreshold());
         buzzer.handleBuzzer(currentTimeMs);
         led.handleLed(currentTimeMs);
@@ -36,11 +307,15 @@ static void initParallelTask() {
         // 对于ESP32-C3和ESP32-S3
         esp_task_wdt_delete(NULL);
     #endif
-    xTaskCreatePinnedToCore(parallelTask, "parallelTask", 3000, NULL, 0, &xTimerTask, 0);
+    xTaskCreatePinnedToCore(parallelTask, "parallelTask", PARALLEL_TASK_STACK, NULL, 0, &xTimerTask, 0);
+    ws.setParallelTask(xTimerTask, PARALLEL_TASK_STACK);
 }
 
 void setup() {
     DEBUG_INIT;
+#ifdef KALMAN_BENCHMARK
+    runKalmanBenchmark();
+#endif
     config.init();
     rx.init();
     buzzer.init(PIN_BUZZER, BUZZER_INVERTED);
@@ -51,16 +326,45 @@ void setup() {
     #else
         led.init(PIN_LED, false);
     #endif
-    timer.init(&config, &rx, &buzzer, &led);
+    RssiSource *source = initRssiSource();
+    timer.init(&config, &rx, source, &buzzer, &led);
+    const bool journalReady = initJournal();
+    if (adcSource.hasAux()) {
+        delay(5);  // 等待第一帧DMA数据
+        monitor.setRawReader(readVbatRaw);
+    }
     monitor.init(PIN_VBAT, VBAT_SCALE, VBAT_ADD, &buzzer, &led);
     ws.init(&config, &timer, &monitor, &buzzer, &led);
+    if (journalReady) ws.setJournal(&journal);
+    ws.setReceiver(&rx);
+    spectrum.init(&rx, source);
+    ws.setSpectrum(&spectrum);
+    // 配置了扫描列表时由扫描器取代单频计时，列表在重启后生效
+    if (scanner.begin(&config, &rx, source, &buzzer, &led)) {
+        ws.setScanner(&scanner);
+    }
+    initRaceNet();
+    initTraceRecorder();
+    // 默认每毫秒一个min/max桶，客户端可通过WebSocket修改
+    rssiStream.setResolution(1000, 1000000 / SAMPLER_RATE_HZ);
+    timer.setRssiStream(&rssiStream);
+    ws.setRssiStream(&rssiStream);
+    initSerialLink();
     led.on(400);
     buzzer.beep(200);
     initParallelTask();
 }
 
 void loop() {
-    uint32_t currentTimeMs = millis();
-    timer.handleLapTimerUpdate(currentTimeMs);
+    // 录制器的样本只来自单频计时，其他模式下由这里完成停止请求
+    if (spectrum.isSweeping()) {
+        spectrum.handleSweepUpdate();
+        traceRecorder.producerIdle();
+    } else if (scanner.isActive()) {
+        scanner.handleScanUpdate();
+        traceRecorder.producerIdle();
+    } else {
+        timer.handleLapTimerUpdate();
+    }
     ElegantOTA.loop();
 }
\ No newline at end of file
@@ -0,0 +1,412 @@
+/**
+ * 计时核的主机回放与检测精度基准（pio run -e native，程序为.pio/build/native/program）。
+ * 信号经过与固件相同的抽取、卡尔曼滤波和LapTimer，时钟是虚拟的，结果可重复。
+ *
+ * 用法：
+ *   program bench [选项]                 跑合成场景矩阵（门尺寸 × 速度 × 多径 × 底噪），输出汇总表
+ *   program synth [选项]                 单个合成场景，逐次打印检测结果
+ *   program replay trace.bin [truth.txt] 回放/trace/download得到的录制文件，有真值时打分
+ *   program scan [选项]                  单个RX5808分时扫描多个频率（每个频率一名飞手），逐频率打分
+ *   program spectrum [频段字母]          频谱扫描（默认ABEFR），R1和F4上各有一个常开图传，打印每个频率的峰值/平均值
+ *   program rx5808                       两种RX5808总线时序下每条命令的耗时和非阻塞切换频率时单次调用的最长耗时
+ *                                        （只含延时，设备上的实测见/status）
+ *
+ * 选项：--enter N --exit N --minlap 毫秒 --gate 1000|2000 --speed 米每秒 --laps N
+ *       --dips N --noise 原始值 --floor 原始值 --drift 原始值 --seed N
+ *       --detector 0|1（0为峰值下降检测，1为enter/exit滞回检测）
+ *       --track 0|1（阈值跟随底噪） --channels N（scan的频率数，2 - 8）
+ * 卡尔曼Q/R和minDelta通过build_flags覆盖（见laptimer.h），例如
+ *   PLATFORMIO_BUILD_FLAGS="-DLAPTIMER_FILTER_R=80" pio run -e native
+ *
+ * 输出：missed为漏检，phantom为误检/重复触发，误差为检测到的峰值时刻减真实穿越时刻，
+ * ns/sample为handleLapTimerUpdate()平摊到每个检测器样本的耗时。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "laptimer.h"
+#include "replay.h"
+#include "scan_sim.h"
+#include "scanner.h"
+#include "spectrum.h"
+#include "synth.h"
+
+#define BENCH_FIRST_CROSSING_US 12000000  // 晚于默认最小圈时，start()后第一次穿越即被计入
+#define SCAN_STAGGER_US 1300000           // 扫描仿真中相邻频率的飞手错开的时间
+
+static const uint16_t scanFreqs[] = {5658, 5695, 5732, 5769, 5806, 5843, 5880, 5917};  // RaceBand
+
+typedef struct {
+    replay_params_t params;
+    synth_scenario_t scenario;
+    bool enterSet;
+    bool exitSet;
+    bool gateSet;
+    bool speedSet;
+    bool dipsSet;
+    bool noiseSet;
+    uint8_t channels;
+} options_t;
+
+static bool parseOptions(int argc, char **argv, int first, options_t *opt) {
+    for (int i = first; i < argc; i++) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", argv[i]);
+            return false;
+        }
+        const char *key = argv[i];
+        const double v = atof(argv[++i]);
+        if (!strcmp(key, "--enter")) {
+            opt->params.enterRssi = v;
+            opt->enterSet = true;
+        } else if (!strcmp(key, "--exit")) {
+            opt->params.exitRssi = v;
+            opt->exitSet = true;
+        } else if (!strcmp(key, "--minlap")) {
+            opt->params.minLapMs = v;
+        } else if (!strcmp(key, "--gate")) {
+            opt->scenario.gateMm = v;
+            opt->gateSet = true;
+        } else if (!strcmp(key, "--speed")) {
+            opt->scenario.speedMps = v;
+            opt->speedSet = true;
+        } else if (!strcmp(key, "--laps")) {
+            opt->scenario.laps = v;
+        } else if (!strcmp(key, "--dips")) {
+            opt->scenario.multipathDips = v;
+            opt->dipsSet = true;
+        } else if (!strcmp(key, "--noise")) {
+            opt->scenario.noiseRaw = v;
+            opt->noiseSet = true;
+        } else if (!strcmp(key, "--floor")) {
+            opt->scenario.floorRaw = v;
+        } else if (!strcmp(key, "--drift")) {
+            opt->scenario.floorDriftRaw = v;
+        } else if (!strcmp(key, "--track")) {
+            opt->params.floorTrack = v != 0;
+        } else if (!strcmp(key, "--channels")) {
+            opt->channels = v;
+        } else if (!strcmp(key, "--detector")) {
+            opt->params.detector = v;
+        } else if (!strcmp(key, "--seed")) {
+            opt->scenario.seed = v;
+        } else {
+            fprintf(stderr, "unknown option %s\n", key);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printHeader() {
+    printf("%-28s %5s %5s %6s %7s %8s %8s %8s %8s %10s\n", "scenario", "truth", "det", "missed", "phantom",
+           "bias_us", "p50_us", "p99_us", "max_us", "ns/sample");
+}
+
+static void printRow(const char *name, const replay_score_t *score, const replay_result_t *result) {
+    printf("%-28s %5u %5u %6u %7u %8.0f %8.0f %8.0f %8.0f %10.1f\n", name, score->truth, score->detected,
+           score->missed, score->phantom, score->biasUs, score->p50Us, score->p99Us, score->maxUs,
+           result->detectorSamples ? result->elapsedNs / result->detectorSamples : 0);
+}
+
+static void runScenario(const synth_scenario_t *scenario, const replay_params_t *params, bool verbose,
+                        replay_score_t *score) {
+    const uint32_t rawRateHz = SAMPLER_RATE_HZ * RSSI_DECIMATION;
+    std::vector<uint16_t> raw;
+    std::vector<uint64_t> truthUs;
+    synthGenerate(scenario, rawRateHz, BENCH_FIRST_CROSSING_US, &raw, &truthUs);
+
+    replay_params_t p = *params;
+    p.gateMm = scenario->gateMm;
+    replay_result_t result;
+    replayRun(&raw, rawRateHz, &p, &result);
+    replayScore(&truthUs, &result.crossingsUs, score);
+
+    if (verbose) {
+        for (size_t i = 0; i < result.crossingsUs.size(); i++) {
+            printf("crossing %zu: %.6f s\n", i, result.crossingsUs[i] / 1e6);
+        }
+        printHeader();
+    }
+    printRow(scenario->name, score, &result);
+}
+
+// 门尺寸 × 速度 × 多径 × 底噪，命令行给定的维度固定不变
+static int runBench(options_t *opt) {
+    const uint16_t gates[] = {1000, 2000};
+    const float speeds[] = {5, 15, 30};
+    const uint8_t dips[] = {0, 2};
+    const float noises[] = {10, 40};
+
+    printf("detector %s, enter %u, exit %u, floor tracking %s, min lap %u ms, filter Q %u R %u, lag comp %u%%, "
+           "minDelta %u/%u\n",
+           opt->params.detector == LAPTIMER_DETECTOR_HYSTERESIS ? "hysteresis" : "peak", opt->params.enterRssi,
+           opt->params.exitRssi, opt->params.floorTrack ? "on" : "off", opt->params.minLapMs, LAPTIMER_FILTER_Q,
+           LAPTIMER_FILTER_R, LAPTIMER_LAG_COMP_PCT, LAPTIMER_MIN_DELTA_SMALL_GATE, LAPTIMER_MIN_DELTA_LARGE_GATE);
+    printHeader();
+    replay_score_t total;
+    memset(&total, 0, sizeof(total));
+    for (uint8_t g = 0; g < 2; g++) {
+        for (uint8_t s = 0; s < 3; s++) {
+            for (uint8_t d = 0; d < 2; d++) {
+                for (uint8_t n = 0; n < 2; n++) {
+                    synth_scenario_t sc = opt->scenario;
+                    if (!opt->gateSet) sc.gateMm = gates[g];
+                    if (!opt->speedSet) sc.speedMps = speeds[s];
+                    if (!opt->dipsSet) sc.multipathDips = dips[d];
+                    if (!opt->noiseSet) sc.noiseRaw = noises[n];
+                    char name[48];
+                    snprintf(name, sizeof(name), "gate%u v%.0f dips%u noise%.0f", sc.gateMm, sc.speedMps,
+                             sc.multipathDips, sc.noiseRaw);
+                    sc.name = name;
+                    sc.seed = opt->scenario.seed + g * 1000 + s * 100 + d * 10 + n;
+                    replay_score_t score;
+                    runScenario(&sc, &opt->params, false, &score);
+                    total.truth += score.truth;
+                    total.detected += score.detected;
+                    total.missed += score.missed;
+                    total.phantom += score.phantom;
+                }
+            }
+        }
+    }
+    printf("total: %u crossings, %u detected, %u missed, %u phantom\n", total.truth, total.detected, total.missed,
+           total.phantom);
+    return 0;
+}
+
+static void collectScanCrossings(const laptimer_event_t *event, void *ctx) {
+    std::vector<uint64_t> *crossings = (std::vector<uint64_t> *)ctx;
+    if (event->type == LAPTIMER_EVENT_LAP) crossings[event->channel].push_back(event->timeUs);
+}
+
+// 每个频率一名飞手，信号互不串扰，检测器为FrequencyScanner
+static int runScan(options_t *opt) {
+    const uint8_t n = opt->channels < 2 ? 2 : (opt->channels > 8 ? 8 : opt->channels);
+    const uint32_t rawRateHz = SAMPLER_RATE_HZ * RSSI_DECIMATION;
+    std::vector<uint16_t> raw[8];
+    std::vector<uint64_t> truthUs[8];
+    std::vector<uint64_t> crossingsUs[8];
+    for (uint8_t c = 0; c < n; c++) {
+        synth_scenario_t sc = opt->scenario;
+        sc.seed = opt->scenario.seed + c * 7919;
+        synthGenerate(&sc, rawRateHz, BENCH_FIRST_CROSSING_US + c * SCAN_STAGGER_US, &raw[c], &truthUs[c]);
+    }
+
+    Config config;
+    RX5808 rx(PIN_RX5808_RSSI, PIN_RX5808_DATA, PIN_RX5808_SELECT, PIN_RX5808_CLOCK);
+    ScanSimSource source(&rx, opt->scenario.floorRaw);
+    Buzzer buzzer;
+    Led led;
+    FrequencyScanner *scanner = new FrequencyScanner();
+
+    halNativeSetTimeUs(0);
+    config.init();
+    config.setEnterRssi(opt->params.enterRssi);
+    config.setExitRssi(opt->params.exitRssi);
+    config.setMinLapMs(opt->params.minLapMs);
+    config.setScanFrequencies(scanFreqs, n);
+    rx.init();
+    buzzer.init(PIN_BUZZER, BUZZER_INVERTED);
+    led.init(PIN_LED, false);
+    for (uint8_t c = 0; c < n; c++) {
+        source.addChannel(scanFreqs[c], &raw[c]);
+    }
+    source.begin(rawRateHz);
+    if (!scanner->begin(&config, &rx, &source, &buzzer, &led)) {
+        fprintf(stderr, "%u channels exceed the revisit budget (max %u)\n", n,
+                FrequencyScanner::maxChannels(SCANNER_SETTLE_US, SCANNER_DWELL_US, SCANNER_MAX_REVISIT_US));
+        delete scanner;
+        return 1;
+    }
+    scanner->addEventSink(collectScanCrossings, crossingsUs);
+    scanner->postCommand(LAPTIMER_CMD_START);
+
+    double elapsedNs = 0;
+    while (!source.isDone()) {
+        // 取到的块已经采集完毕，当前时刻为块末
+        halNativeSetTimeUs(source.getNextBlockEndUs());
+        const auto t0 = std::chrono::steady_clock::now();
+        scanner->handleScanUpdate();
+        const auto t1 = std::chrono::steady_clock::now();
+        elapsedNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        scanner->dispatchEvents();
+        scanner->refillLaps();
+    }
+
+    printf("scan: %u of %u channels, settle %u us, dwell %u us, revisit %u us, max tune %u us\n",
+           scanner->getChannelCount(), n, (uint32_t)SCANNER_SETTLE_US, (uint32_t)SCANNER_DWELL_US,
+           scanner->getRevisitUs(), scanner->getMaxTuneUs());
+    printHeader();
+    replay_score_t total;
+    memset(&total, 0, sizeof(total));
+    for (uint8_t c = 0; c < scanner->getChannelCount(); c++) {
+        ScanChannel *channel = scanner->getChannel(c);
+        replay_score_t score;
+        replayScore(&truthUs[c], &crossingsUs[c], &score);
+        replay_result_t result;
+        result.detectorSamples = channel->getVisits();
+        result.elapsedNs = elapsedNs / scanner->getChannelCount();
+        char name[32];
+        snprintf(name, sizeof(name), "ch%u %u MHz", c, channel->getFrequency());
+        printRow(name, &score, &result);
+        total.truth += score.truth;
+        total.detected += score.detected;
+        total.missed += score.missed;
+        total.phantom += score.phantom;
+    }
+    printf("total: %u crossings, %u detected, %u missed, %u phantom\n", total.truth, total.detected, total.missed,
+           total.phantom);
+    delete scanner;
+    return 0;
+}
+
+// 模拟parallelTask与计时核交替运行：每块样本之间调用一次service()
+static int runSpectrum(const char *bands) {
+    const uint32_t rawRateHz = SAMPLER_RATE_HZ * RSSI_DECIMATION;
+    const size_t length = rawRateHz * 10;  // 10秒足够扫完64个频率
+    std::vector<uint16_t> vtxR1(length, 1700);
+    std::vector<uint16_t> vtxF4(length, 1100);
+
+    RX5808 rx(PIN_RX5808_RSSI, PIN_RX5808_DATA, PIN_RX5808_SELECT, PIN_RX5808_CLOCK);
+    ScanSimSource source(&rx, 400);
+    SpectrumSweep sweep;
+    halNativeSetTimeUs(0);
+    rx.init();
+    source.addChannel(5658, &vtxR1);
+    source.addChannel(5800, &vtxF4);
+    source.begin(rawRateHz);
+    sweep.init(&rx, &source);
+
+    uint16_t freqs[SPECTRUM_MAX_CHANNELS];
+    const uint8_t n = SpectrumSweep::bandFrequencies(bands, freqs, SPECTRUM_MAX_CHANNELS);
+    if (!sweep.request(freqs, n)) {
+        fprintf(stderr, "no channels for bands '%s'\n", bands);
+        return 1;
+    }
+    while (!source.isDone()) {
+        sweep.service();
+        if (sweep.getState() == SPECTRUM_IDLE) break;
+        halNativeSetTimeUs(source.getNextBlockEndUs());
+        if (sweep.isSweeping()) sweep.handleSweepUpdate();
+    }
+    printf("spectrum %s: %u of %u channels in %u ms (%.1f ms/channel), settle %u us, dwell %u us\n", bands,
+           sweep.getCompleted(), n, sweep.getElapsedMs(), n ? sweep.getElapsedMs() / (double)n : 0,
+           (uint32_t)SCANNER_SETTLE_US, (uint32_t)SPECTRUM_DWELL_US);
+    printf("freq  peak  mean  samples\n");
+    for (uint8_t i = 0; i < sweep.getCompleted(); i++) {
+        const spectrum_channel_t *ch = sweep.getChannel(i);
+        printf("%4u  %4u  %4u  %7u\n", ch->freq, ch->peak, ch->mean, ch->samples);
+    }
+    return 0;
+}
+
+static int runBus() {
+    static const rx5808_bus_e buses[] = {RX5808_BUS_SLOW, RX5808_BUS_FAST};
+    printf("bus    write_us  read_us  wake_us  change_us  calls  max_call_us\n");
+    for (rx5808_bus_e mode : buses) {
+        RX5808 rx(0, 1, 2, 3);
+        rx.init();
+        rx.setBus(mode);
+        // 掉电状态下阻塞设频率：复位、上电设置、写频率三条命令加上复位等待
+        uint64_t t0 = halMicros();
+        rx.setFrequency(5800);
+        const uint32_t wakeUs = (uint32_t)(halMicros() - t0);
+        rx.tune(5800);  // 跳过对5800的校验，从空闲开始
+        halNativeAdvanceUs((RX5808_MIN_BUSTIME + 1) * 1000);
+
+        // 像parallelTask一样每100 us调用一次，直到第一次回读校验结束（主机上DATA读回全1，校验必然失败）
+        uint32_t writeUs = 0;
+        uint32_t calls = 0;
+        t0 = halMicros();
+        for (;;) {
+            const rx5808_state_e before = rx.getState();
+            rx.handleFrequencyChange(halMillis(), 5840);
+            calls++;
+            const rx5808_state_e after = rx.getState();
+            if (before == RX5808_STATE_WRITING && after != RX5808_STATE_WRITING) writeUs = rx.getLastCommandUs();
+            if (before == RX5808_STATE_VERIFYING && after != RX5808_STATE_VERIFYING) break;
+            halNativeAdvanceUs(100);
+        }
+        const uint32_t changeUs = (uint32_t)(halMicros() - t0);
+        printf("%-6s %8u %8u %8u %10u %6u %12u\n", mode == RX5808_BUS_FAST ? "fast" : "slow", writeUs,
+               rx.getLastCommandUs(), wakeUs, changeUs, calls, rx.getMaxServiceUs());
+    }
+    return 0;
+}
+
+static int runReplay(int argc, char **argv, options_t *opt) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s replay trace.bin [truth.txt] [options]\n", argv[0]);
+        return 1;
+    }
+    std::vector<uint16_t> raw;
+    uint32_t rawRateHz;
+    int32_t skewUs;
+    uint8_t enter, exit;
+    if (!replayLoadTrace(argv[2], &raw, &rawRateHz, &skewUs, &enter, &exit)) return 1;
+
+    int first = 3;
+    const char *truthPath = nullptr;
+    if (argc > 3 && strncmp(argv[3], "--", 2) != 0) {
+        truthPath = argv[3];
+        first = 4;
+    }
+    if (!parseOptions(argc, argv, first, opt)) return 1;
+    // 默认沿用录制时的阈值
+    if (!opt->enterSet) opt->params.enterRssi = enter;
+    if (!opt->exitSet) opt->params.exitRssi = exit;
+    opt->params.gateMm = opt->scenario.gateMm;
+
+    replay_result_t result;
+    replayRun(&raw, rawRateHz, &opt->params, &result);
+    for (size_t i = 0; i < result.crossingsUs.size(); i++) {
+        result.crossingsUs[i] -= skewUs;
+    }
+    printf("%s: %.1f s at %u Hz, enter %u, exit %u\n", argv[2], raw.size() / (double)rawRateHz, rawRateHz,
+           opt->params.enterRssi, opt->params.exitRssi);
+    for (size_t i = 0; i < result.crossingsUs.size(); i++) {
+        printf("crossing %zu: %.6f s\n", i, result.crossingsUs[i] / 1e6);
+    }
+    if (truthPath != nullptr) {
+        std::vector<uint64_t> truthUs;
+        if (!replayLoadTruth(truthPath, &truthUs)) return 1;
+        replay_score_t score;
+        replayScore(&truthUs, &result.crossingsUs, &score);
+        printHeader();
+        printRow(argv[2], &score, &result);
+    } else {
+        printf("%.1f ns/sample\n", result.detectorSamples ? result.elapsedNs / result.detectorSamples : 0);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    options_t opt;
+    memset(&opt, 0, sizeof(opt));
+    synthDefaults(&opt.scenario);
+    opt.params.enterRssi = 120;  // 与Config的默认值一致
+    opt.params.exitRssi = 100;
+    opt.params.minLapMs = 10000;
+    opt.params.gateMm = opt.scenario.gateMm;
+    opt.channels = 4;
+
+    const char *cmd = argc > 1 ? argv[1] : "bench";
+    if (!strcmp(cmd, "replay")) return runReplay(argc, argv, &opt);
+    if (!strcmp(cmd, "spectrum")) return runSpectrum(argc > 2 ? argv[2] : "ABEFR");
+    if (!parseOptions(argc, argv, argc > 1 ? 2 : 1, &opt)) return 1;
+    if (!strcmp(cmd, "bench")) return runBench(&opt);
+    if (!strcmp(cmd, "scan")) return runScan(&opt);
+    if (!strcmp(cmd, "rx5808")) return runBus();
+    if (!strcmp(cmd, "synth")) {
+        replay_score_t score;
+        runScenario(&opt.scenario, &opt.params, true, &score);
+        return 0;
+    }
+    fprintf(stderr, "usage: %s bench|synth|replay|scan|spectrum|rx5808 [options]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,202 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "hal.h"
+#include "laptimer.h"
+
+BufferRssiSource::BufferRssiSource(const std::vector<uint16_t> *samples) {
+    data = samples;
+}
+
+bool BufferRssiSource::begin(uint32_t rateHz) {
+    if (rateHz == 0) return false;
+    sampleRateHz = rateHz;
+    periodUs = 1000000UL / rateHz;
+    pos = 0;
+    return true;
+}
+
+uint16_t BufferRssiSource::readBlock(rssi_block_t *block) {
+    const size_t left = data->size() - pos;
+    if (left == 0) return 0;
+    block->startUs = (uint64_t)pos * periodUs;
+    block->periodUs = periodUs;
+    block->count = left < SAMPLER_BLOCK_SIZE ? left : SAMPLER_BLOCK_SIZE;
+    memcpy(block->raw, data->data() + pos, block->count * sizeof(uint16_t));
+    pos += block->count;
+    return block->count;
+}
+
+static void collectCrossings(const laptimer_event_t *event, void *ctx) {
+    std::vector<uint64_t> *crossings = (std::vector<uint64_t> *)ctx;
+    if (event->type == LAPTIMER_EVENT_LAP) crossings->push_back(event->timeUs);
+}
+
+void replayRun(const std::vector<uint16_t> *raw, uint32_t rawRateHz, const replay_params_t *params,
+               replay_result_t *result) {
+    Config config;
+    RX5808 rx(PIN_RX5808_RSSI, PIN_RX5808_DATA, PIN_RX5808_SELECT, PIN_RX5808_CLOCK);
+    BufferRssiSource source(raw);
+    Buzzer buzzer;
+    Led led;
+    LapTimer *timer = new LapTimer();
+
+    halNativeSetTimeUs(0);
+    config.init();
+    config.setEnterRssi(params->enterRssi);
+    config.setExitRssi(params->exitRssi);
+    config.setMinLapMs(params->minLapMs);
+    config.setDroneSize(params->gateMm == 1000 ? 2 : 5);
+    config.setDetector(params->detector);
+    config.setFloorTrack(params->floorTrack, config.getEnterOffset(), config.getExitOffset(), config.getTrackMax());
+    rx.init();
+    buzzer.init(PIN_BUZZER, BUZZER_INVERTED);
+    led.init(PIN_LED, false);
+    source.begin(rawRateHz);
+    timer->init(&config, &rx, &source, &buzzer, &led);
+
+    result->crossingsUs.clear();
+    timer->addEventSink(collectCrossings, &result->crossingsUs);
+    timer->postCommand(LAPTIMER_CMD_START);
+
+    double elapsedNs = 0;
+    while (!source.isDone()) {
+        const auto t0 = std::chrono::steady_clock::now();
+        timer->handleLapTimerUpdate();
+        const auto t1 = std::chrono::steady_clock::now();
+        elapsedNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        halNativeSetTimeUs(source.getTimeUs());
+        timer->dispatchEvents();
+        timer->refillLaps();  // 与设备上的parallelTask一致
+    }
+    timer->postCommand(LAPTIMER_CMD_STOP);
+    timer->handleLapTimerUpdate();
+    timer->dispatchEvents();
+
+    result->rawSamples = raw->size();
+    result->detectorSamples = raw->size() / RSSI_DECIMATION;
+    result->elapsedNs = elapsedNs;
+    delete timer;
+}
+
+static double percentile(std::vector<double> *values, double p) {
+    if (values->empty()) return 0;
+    std::sort(values->begin(), values->end());
+    size_t i = (size_t)(p * (values->size() - 1) + 0.5);
+    return (*values)[i];
+}
+
+void replayScore(const std::vector<uint64_t> *truthUs, const std::vector<uint64_t> *detectedUs, replay_score_t *score) {
+    memset(score, 0, sizeof(*score));
+    score->truth = truthUs->size();
+    score->detected = detectedUs->size();
+
+    // 两个序列都按时间排序，双指针匹配：窗口内取最近的一个，其余算误检
+    std::vector<double> absErrors;
+    double sum = 0;
+    size_t d = 0;
+    for (size_t t = 0; t < truthUs->size(); t++) {
+        const int64_t truth = (int64_t)(*truthUs)[t];
+        while (d < detectedUs->size() && (int64_t)(*detectedUs)[d] < truth - REPLAY_MATCH_WINDOW_US) {
+            score->phantom++;
+            d++;
+        }
+        if (d < detectedUs->size() && (int64_t)(*detectedUs)[d] <= truth + REPLAY_MATCH_WINDOW_US) {
+            const double errorUs = (double)((int64_t)(*detectedUs)[d] - truth);
+            sum += errorUs;
+            absErrors.push_back(errorUs < 0 ? -errorUs : errorUs);
+            score->matched++;
+            d++;
+            // 同一次穿越的重复触发
+            while (d < detectedUs->size() && (int64_t)(*detectedUs)[d] <= truth + REPLAY_MATCH_WINDOW_US) {
+                score->phantom++;
+                d++;
+            }
+        } else {
+            score->missed++;
+        }
+    }
+    score->phantom += detectedUs->size() - d;
+    if (score->matched > 0) score->biasUs = sum / score->matched;
+    score->p50Us = percentile(&absErrors, 0.50);
+    score->p99Us = percentile(&absErrors, 0.99);
+    score->maxUs = absErrors.empty() ? 0 : absErrors.back();
+}
+
+bool replayLoadTrace(const char *path, std::vector<uint16_t> *raw, uint32_t *rawRateHz, int32_t *skewUs,
+                     uint8_t *enterRssi, uint8_t *exitRssi) {
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "QYTR", 4) != 0 ||
+        header.version != TRACE_FILE_VERSION || header.sampleRateHz == 0) {
+        fprintf(stderr, "%s: not a supported trace file\n", path);
+        fclose(f);
+        return false;
+    }
+    fseek(f, header.headerBytes, SEEK_SET);
+    if (header.divider > 1) {
+        fprintf(stderr, "warning: trace recorded with divider %u, timing resolution is reduced\n", header.divider);
+    }
+
+    // 录制样本落在固定间隔的网格上，丢失的样本用前一个值补齐，保持时间轴
+    const double periodUs = 1e6 / header.sampleRateHz;
+    std::vector<uint16_t> rssiQ4;
+    trace_block_header_t block;
+    trace_sample_t sample;
+    while (fread(&block, sizeof(block), 1, f) == 1 && block.magic == TRACE_BLOCK_MAGIC) {
+        uint64_t t = block.startUs;
+        for (uint16_t i = 0; i < block.count; i++) {
+            if (fread(&sample, sizeof(sample), 1, f) != 1) break;
+            t += sample.dtUs;
+            const size_t index = (size_t)((t - header.startUs) / periodUs + 0.5);
+            const uint16_t fill = rssiQ4.empty() ? sample.rawQ4 : rssiQ4.back();
+            while (rssiQ4.size() < index) rssiQ4.push_back(fill);
+            if (rssiQ4.size() == index) rssiQ4.push_back(sample.rawQ4);
+        }
+    }
+    fclose(f);
+
+    // rawQ4是scaleRssiQ4()的输出（ADC值 * 2），每个样本重复R次还原为抽取前的ADC值，
+    // 抽取器对相同的输入输出原值，检测器看到的RSSI与录制时一致（只丢掉最低1/16位）
+    const uint32_t R = RSSI_DECIMATION;
+    raw->resize(rssiQ4.size() * R);
+    for (size_t k = 0; k < rssiQ4.size(); k++) {
+        for (uint32_t j = 0; j < R; j++) {
+            (*raw)[k * R + j] = (rssiQ4[k] + 1) >> 1;
+        }
+    }
+    *rawRateHz = header.sampleRateHz * R;
+    // 第k组的输出在组末，扣除群延迟后比录制时刻晚(R - 1 - 群延迟)个原始采样周期
+    Decimator decimator;
+    decimator.init(RSSI_DECIMATOR_MODE, RSSI_READS, RSSI_DECIMATION, RSSI_CIC_ORDER);
+    *skewUs = ((int32_t)(R - 1) * 2 - decimator.getGroupDelayHalfSamples()) * (int32_t)(1000000UL / *rawRateHz) / 2;
+    *enterRssi = header.enterRssi;
+    *exitRssi = header.exitRssi;
+    return true;
+}
+
+bool replayLoadTruth(const char *path, std::vector<uint64_t> *truthUs) {
+    FILE *f = fopen(path, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char line[64];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        truthUs->push_back(strtoull(line, nullptr, 10));
+    }
+    fclose(f);
+    std::sort(truthUs->begin(), truthUs->end());
+    return true;
+}
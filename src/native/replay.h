@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "sampler.h"
+
+/**
+ * 从内存缓冲区按块回放的采样源。信号事先生成或载入，
+ * 计时不包含信号生成的开销，只统计检测器本身。
+ */
+class BufferRssiSource : public RssiSource {
+   public:
+    BufferRssiSource(const std::vector<uint16_t> *samples);
+    bool begin(uint32_t sampleRateHz) override;
+    uint16_t readBlock(rssi_block_t *block) override;
+    bool isDone() { return pos >= data->size(); }
+    uint64_t getTimeUs() { return (uint64_t)pos * periodUs; }
+
+   private:
+    const std::vector<uint16_t> *data;
+    size_t pos = 0;
+    uint32_t periodUs = 0;
+};
+
+typedef struct {
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+    uint32_t minLapMs;
+    uint16_t gateMm;
+    uint8_t detector;  // laptimer_detector_e
+    bool floorTrack;   // 阈值跟随底噪，偏移和上限用Config默认值
+} replay_params_t;
+
+typedef struct {
+    std::vector<uint64_t> crossingsUs;  // 检测到的穿越时刻（LAP事件的峰值时刻）
+    uint64_t rawSamples;
+    uint64_t detectorSamples;
+    double elapsedNs;  // handleLapTimerUpdate()累计耗时
+} replay_result_t;
+
+typedef struct {
+    uint32_t truth;
+    uint32_t detected;
+    uint32_t matched;
+    uint32_t missed;
+    uint32_t phantom;
+    double biasUs;  // 匹配误差的平均值（检测 - 真值）
+    double p50Us;   // |误差|分位数
+    double p99Us;
+    double maxUs;
+} replay_score_t;
+
+#define REPLAY_MATCH_WINDOW_US 500000  // 与真值相差超过此值不算命中
+
+/**
+ * 用固件的LapTimer处理一段原始采样（rawRateHz为抽取前的采样率），
+ * 计时在t=0时启动，返回全部检测到的穿越。
+ */
+void replayRun(const std::vector<uint16_t> *raw, uint32_t rawRateHz, const replay_params_t *params,
+               replay_result_t *result);
+
+// 按时间顺序把检测结果与真值一一匹配
+void replayScore(const std::vector<uint64_t> *truthUs, const std::vector<uint64_t> *detectedUs, replay_score_t *score);
+
+/**
+ * 载入/trace/download得到的录制文件，还原为抽取前的12位原始值，
+ * 每个录制样本重复RSSI_DECIMATION次，使抽取器输出与录制时的滤波前RSSI一致。
+ * 回放得到的时刻比录制时晚skewUs，打分前需扣除。
+ * 录制时divider大于1会降低时间分辨率，此时给出警告。
+ */
+bool replayLoadTrace(const char *path, std::vector<uint16_t> *raw, uint32_t *rawRateHz, int32_t *skewUs,
+                     uint8_t *enterRssi, uint8_t *exitRssi);
+
+// 真值文件：每行一个穿越时刻（微秒，相对录制开始），#开头为注释
+bool replayLoadTruth(const char *path, std::vector<uint64_t> *truthUs);
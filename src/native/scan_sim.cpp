@@ -0,0 +1,41 @@
+#include "scan_sim.h"
+
+ScanSimSource::ScanSimSource(RX5808 *rx5808, uint16_t floorRaw) {
+    rx = rx5808;
+    floor = floorRaw;
+}
+
+void ScanSimSource::addChannel(uint16_t frequency, const std::vector<uint16_t> *samples) {
+    if (count >= SCAN_SIM_MAX_CHANNELS) return;
+    freqs[count] = frequency;
+    data[count] = samples;
+    count++;
+    // 以最长的一段为仿真时长，较短的频率结束后只有底噪；
+    // 取最短的一段会截掉其他频率最后一次穿越之后的访问，把未结束的检测窗口算成漏圈
+    if (samples->size() > length) length = samples->size();
+}
+
+bool ScanSimSource::begin(uint32_t rateHz) {
+    if (rateHz == 0) return false;
+    sampleRateHz = rateHz;
+    periodUs = 1000000UL / rateHz;
+    pos = 0;
+    return true;
+}
+
+uint16_t ScanSimSource::readBlock(rssi_block_t *block) {
+    const size_t left = length - pos;
+    if (left == 0) return 0;
+    const std::vector<uint16_t> *samples = nullptr;
+    for (uint8_t i = 0; i < count; i++) {
+        if (freqs[i] == rx->getFrequency()) samples = data[i];
+    }
+    block->startUs = (uint64_t)pos * periodUs;
+    block->periodUs = periodUs;
+    block->count = left < SAMPLER_BLOCK_SIZE ? left : SAMPLER_BLOCK_SIZE;
+    for (uint16_t i = 0; i < block->count; i++) {
+        block->raw[i] = samples != nullptr && pos + i < samples->size() ? (*samples)[pos + i] : floor;
+    }
+    pos += block->count;
+    return block->count;
+}
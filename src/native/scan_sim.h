@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "RX5808.h"
+#include "sampler.h"
+
+#define SCAN_SIM_MAX_CHANNELS 8
+
+/**
+ * 多频扫描的仿真采样源：每个频率有一段独立生成的原始信号，
+ * readBlock()按RX5808当前调谐的频率取对应信号，未列出的频率只有底噪。
+ * 同一块内不会切换频率，调谐后的前几个样本本来就在稳定期内被扫描器丢弃。
+ */
+class ScanSimSource : public RssiSource {
+   public:
+    ScanSimSource(RX5808 *rx5808, uint16_t floorRaw);
+    void addChannel(uint16_t frequency, const std::vector<uint16_t> *samples);
+    bool begin(uint32_t sampleRateHz) override;
+    uint16_t readBlock(rssi_block_t *block) override;
+    bool isDone() { return pos >= length; }
+    // 下一块结束的时刻，仿真中作为“当前时间”
+    uint64_t getNextBlockEndUs() { return (uint64_t)(pos + SAMPLER_BLOCK_SIZE) * periodUs; }
+
+   private:
+    RX5808 *rx;
+    uint16_t floor;
+    uint16_t freqs[SCAN_SIM_MAX_CHANNELS];
+    const std::vector<uint16_t> *data[SCAN_SIM_MAX_CHANNELS];
+    uint8_t count = 0;
+    size_t pos = 0;
+    size_t length = 0;
+    uint32_t periodUs = 0;
+};
@@ -0,0 +1,89 @@
+#include "synth.h"
+
+#include <math.h>
+
+#include <random>
+
+typedef struct {
+    uint64_t timeUs;
+    float lateralMm;
+    float dipOffsetUs[8];
+    uint8_t dips;
+} synth_pass_t;
+
+void synthDefaults(synth_scenario_t *scenario) {
+    scenario->name = "default";
+    scenario->gateMm = 2000;
+    scenario->speedMps = 15;
+    scenario->lapSeconds = 15;
+    scenario->lapJitter = 2;
+    scenario->laps = 10;
+    scenario->floorRaw = 400;
+    scenario->peakRaw = 1700;
+    scenario->noiseRaw = 20;
+    scenario->floorDriftRaw = 0;
+    scenario->multipathDips = 0;
+    scenario->dipDepthRaw = 150;
+    scenario->seed = 1;
+}
+
+// 第n次穿越对t时刻的贡献（原始值，未加底噪）
+static float passSignal(const synth_scenario_t *s, const synth_pass_t *pass, double tUs) {
+    const double dtUs = tUs - (double)pass->timeUs;
+    const double alongMm = s->speedMps * dtUs / 1000.0;
+    double distMm = sqrt(alongMm * alongMm + pass->lateralMm * pass->lateralMm);
+    if (distMm < SYNTH_REF_MM) distMm = SYNTH_REF_MM;
+    const double lossDb = SYNTH_DB_PER_DECADE * log10(distMm / SYNTH_REF_MM);
+    double v = s->peakRaw - lossDb * SYNTH_RAW_PER_DB - s->floorRaw;
+    if (v < 0) v = 0;
+
+    // 多径凹陷：宽度约为飞过20 cm所需时间
+    const double dipWidthUs = 200.0 * 1000.0 / s->speedMps;
+    for (uint8_t i = 0; i < pass->dips; i++) {
+        const double x = (dtUs - pass->dipOffsetUs[i]) / dipWidthUs;
+        v -= s->dipDepthRaw * exp(-x * x);
+    }
+    return v;
+}
+
+void synthGenerate(const synth_scenario_t *s, uint32_t sampleRateHz, uint64_t startUs,
+                   std::vector<uint16_t> *raw, std::vector<uint64_t> *truthUs) {
+    std::mt19937 rng(s->seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, s->noiseRaw);
+
+    // 穿越时刻和每圈的偏离、凹陷位置
+    std::vector<synth_pass_t> passes(s->laps);
+    uint64_t t = startUs;
+    const uint8_t dips = s->multipathDips > 8 ? 8 : s->multipathDips;
+    for (uint16_t n = 0; n < s->laps; n++) {
+        synth_pass_t *p = &passes[n];
+        p->timeUs = t;
+        p->lateralMm = unit(rng) * s->gateMm / 2;
+        p->dips = dips;
+        // 凹陷落在峰值两侧±(半个门宽 + 1米)飞行距离内，最容易导致提前判定
+        const float spanUs = (s->gateMm / 2 + 1000) * 1000.0f / s->speedMps;
+        for (uint8_t i = 0; i < dips; i++) {
+            p->dipOffsetUs[i] = (unit(rng) * 2 - 1) * spanUs;
+        }
+        truthUs->push_back(t);
+        t += (uint64_t)((s->lapSeconds + (unit(rng) * 2 - 1) * s->lapJitter) * 1e6);
+    }
+
+    const uint64_t endUs = passes.empty() ? startUs : passes.back().timeUs + (uint64_t)(s->lapSeconds * 1e6 / 2);
+    const double periodUs = 1e6 / sampleRateHz;
+    const size_t count = (size_t)(endUs / periodUs);
+    raw->resize(count);
+    size_t next = 0;  // 离当前时刻最近的穿越
+    for (size_t i = 0; i < count; i++) {
+        const double tUs = i * periodUs;
+        while (next + 1 < passes.size() && tUs > (passes[next].timeUs + passes[next + 1].timeUs) / 2.0) {
+            next++;
+        }
+        float v = s->floorRaw + s->floorDriftRaw * i / count + noise(rng);
+        if (!passes.empty()) v += passSignal(s, &passes[next], tUs);
+        if (v < 0) v = 0;
+        if (v > 4095) v = 4095;
+        (*raw)[i] = (uint16_t)v;
+    }
+}
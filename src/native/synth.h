@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * 合成穿越信号的场景参数。
+ * 飞机以speedMps直线穿过门，横向偏离门中心lateralMm（每圈在门半径内随机），
+ * RSSI按距离的对数衰减（每10倍距离下降dbPerDecade），RX5808的RSSI电压与dBm近似线性，
+ * 换算到12位ADC为rawPerDb。门越大平均偏离越远，峰值越低越平。
+ */
+typedef struct {
+    const char *name;
+    uint16_t gateMm;        // 1000或2000，同时决定检测器的minDelta
+    float speedMps;         // 穿越速度
+    float lapSeconds;       // 平均圈速
+    float lapJitter;        // 圈速随机变化（秒，均匀分布±）
+    uint16_t laps;          // 真实穿越次数
+    uint16_t floorRaw;      // 底噪（12位ADC原始值）
+    uint16_t peakRaw;       // 距天线refMm时的读数
+    float noiseRaw;         // 高斯噪声标准差（原始值）
+    float floorDriftRaw;    // 底噪在整段信号内线性抬高的量（原始值），模拟附近其他图传开机等
+    uint8_t multipathDips;  // 每次穿越附近的多径凹陷个数
+    float dipDepthRaw;      // 凹陷深度（原始值）
+    uint32_t seed;
+} synth_scenario_t;
+
+#define SYNTH_REF_MM 300       // peakRaw对应的距离
+#define SYNTH_DB_PER_DECADE 20  // 自由空间
+#define SYNTH_RAW_PER_DB 24     // RX5808约20 mV/dB，ESP32 ADC约0.8 mV/LSB
+
+void synthDefaults(synth_scenario_t *scenario);
+
+/**
+ * 生成整段信号：sampleRateHz为原始（抽取前）采样率，raw为12位ADC值，
+ * truthUs为每次穿越（离天线最近）的真实时刻。第一次穿越在startUs。
+ */
+void synthGenerate(const synth_scenario_t *scenario, uint32_t sampleRateHz, uint64_t startUs,
+                   std::vector<uint16_t> *raw, std::vector<uint64_t> *truthUs);
@@ -0,0 +1,241 @@
+/**
+ * Config::load()的版本迁移与默认值回退（pio test -e native -f test_config）。
+ * 旧版本的EEPROM映像由当前结构体构造：该版本之后新增的字段全部填0xFF，模拟从未写过的区域。
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unity.h>
+
+#include "config.h"
+#include "hal.h"
+
+typedef struct {
+    uint32_t version;
+    size_t newFieldsOffset;  // 该版本之后新增字段的起始偏移
+} config_version_t;
+
+static const config_version_t oldVersions[] = {
+    {1, offsetof(laptimer_config_t, detector)},
+    {2, offsetof(laptimer_config_t, detector)},
+    {4, offsetof(laptimer_config_t, detector)},
+    {5, offsetof(laptimer_config_t, floorTrack)},
+    {6, offsetof(laptimer_config_t, scanCount)},
+    {7, offsetof(laptimer_config_t, sectorIndex)},
+    {8, offsetof(laptimer_config_t, lapCast)},
+    {9, offsetof(laptimer_config_t, raceLink)},
+    {10, offsetof(laptimer_config_t, serialLink)},
+};
+
+// 用户改过的设置，迁移后必须保留
+static void userConfig(laptimer_config_t *conf, uint32_t version) {
+    memset(conf, 0, sizeof(*conf));
+    conf->version = version | CONFIG_MAGIC;
+    conf->frequency = 5800;
+    conf->minLap = 55;
+    conf->alarm = 33;
+    conf->announcerType = 1;
+    conf->announcerRate = 12;
+    conf->enterRssi = 140;
+    conf->exitRssi = 110;
+    conf->droneSize = 2;
+    conf->calibSamples = 50;
+    strcpy(conf->pilotName, "pilot");
+    strcpy(conf->pilotId, "p-01");
+    strcpy(conf->ssid, "field");
+    strcpy(conf->password, "secret");
+    strcpy(conf->apiAddress, "http://10.0.0.2/api");
+    conf->detector = LAPTIMER_DETECTOR_HYSTERESIS;
+    conf->floorTrack = 1;
+    conf->enterOffset = 45;
+    conf->exitOffset = 25;
+    conf->trackMax = 35;
+    conf->scanCount = 2;
+    conf->scanFreqs[0] = 5658;
+    conf->scanFreqs[1] = 5695;
+    conf->sectorIndex = 1;
+    conf->sectorCount = 3;
+    conf->lapCast = 2;
+    conf->raceLink = 1;
+    conf->serialLink = 1;
+}
+
+static void writeImage(const void *image, size_t len) {
+    halStorageBegin(EEPROM_RESERVED_SIZE);
+    halStorageWrite(0, image, len);
+}
+
+static uint32_t storedVersion() {
+    uint32_t version = 0;
+    halStorageRead(0, &version, sizeof(version));
+    return version;
+}
+
+static void assertDefaults(Config *config) {
+    TEST_ASSERT_EQUAL_HEX32(CONFIG_VERSION | CONFIG_MAGIC, storedVersion());
+    TEST_ASSERT_EQUAL_UINT16(1111, config->getFrequency());
+    TEST_ASSERT_EQUAL_UINT32(10000, config->getMinLapMs());
+    TEST_ASSERT_EQUAL_UINT8(120, config->getEnterRssi());
+    TEST_ASSERT_EQUAL_UINT8(100, config->getExitRssi());
+    TEST_ASSERT_EQUAL_UINT8(5, config->getDroneSize());
+    TEST_ASSERT_EQUAL_UINT16(20, config->getCalibrationSamples());
+    TEST_ASSERT_EQUAL_UINT8(LAPTIMER_DETECTOR_PEAK, config->getDetector());
+    TEST_ASSERT_FALSE(config->getFloorTrack());
+    TEST_ASSERT_EQUAL_UINT8(50, config->getEnterOffset());
+    TEST_ASSERT_EQUAL_STRING("", config->getPilotId());
+    TEST_ASSERT_EQUAL_STRING("http://192.168.31.136:8888/api", config->getApiAddress());
+}
+
+#define IS_NEW(field) (offsetof(laptimer_config_t, field) >= newFieldsOffset)
+
+// 该版本已有的字段保留用户值，新增字段取迁移默认值：峰值检测、不跟踪底噪、单频、不分段、不广播、UDP汇总、串口调试
+static void assertMigratedFields(Config *config, size_t newFieldsOffset) {
+    uint16_t freqs[CONFIG_MAX_SCAN_CHANNELS];
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(detector) ? LAPTIMER_DETECTOR_PEAK : LAPTIMER_DETECTOR_HYSTERESIS, config->getDetector());
+    TEST_ASSERT_EQUAL(!IS_NEW(floorTrack), config->getFloorTrack());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(enterOffset) ? 50 : 45, config->getEnterOffset());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(exitOffset) ? 30 : 25, config->getExitOffset());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(trackMax) ? 40 : 35, config->getTrackMax());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(scanCount) ? 0 : 2, config->getScanFrequencies(freqs));
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(sectorIndex) ? 0 : 1, config->getSectorIndex());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(sectorCount) ? 0 : 3, config->getSectorCount());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(lapCast) ? 0 : 2, config->getLapCastMode());
+    TEST_ASSERT_EQUAL_UINT8(IS_NEW(raceLink) ? 0 : 1, config->getRaceLink());
+    TEST_ASSERT_FALSE(config->getSerialLink());  // 版本11才有
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_blank_storage_gets_defaults(void) {
+    Config config;
+    config.init();  // 存储全为0xFF
+    assertDefaults(&config);
+}
+
+static void test_migrates_every_old_version(void) {
+    for (const config_version_t &v : oldVersions) {
+        laptimer_config_t image;
+        userConfig(&image, v.version);
+        memset((uint8_t *)&image + v.newFieldsOffset, 0xFF, sizeof(image) - v.newFieldsOffset);
+        writeImage(&image, sizeof(image));
+
+        Config config;
+        config.load();
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(CONFIG_VERSION | CONFIG_MAGIC, storedVersion(), "migrated version not written");
+        TEST_ASSERT_EQUAL_UINT16(5800, config.getFrequency());
+        TEST_ASSERT_EQUAL_UINT32(5500, config.getMinLapMs());
+        TEST_ASSERT_EQUAL_UINT8(140, config.getEnterRssi());
+        TEST_ASSERT_EQUAL_UINT8(110, config.getExitRssi());
+        TEST_ASSERT_EQUAL_UINT8(2, config.getDroneSize());
+        TEST_ASSERT_EQUAL_UINT16(50, config.getCalibrationSamples());
+        TEST_ASSERT_EQUAL_STRING("pilot", config.getPilotName());
+        TEST_ASSERT_EQUAL_STRING("field", config.getSsid());
+        TEST_ASSERT_EQUAL_STRING("http://10.0.0.2/api", config.getApiAddress());
+        if (v.version > 1) TEST_ASSERT_EQUAL_STRING("p-01", config.getPilotId());
+        assertMigratedFields(&config, v.newFieldsOffset);
+
+        // 迁移后的映像再次加载应保持不变
+        laptimer_config_t migrated;
+        halStorageRead(0, &migrated, sizeof(migrated));
+        Config reloaded;
+        reloaded.load();
+        laptimer_config_t again;
+        halStorageRead(0, &again, sizeof(again));
+        TEST_ASSERT_EQUAL_MEMORY(&migrated, &again, sizeof(migrated));
+    }
+}
+
+// 版本1没有pilotId，droneSize和calibSamples也可能是无效值
+static void test_version_1_fixes_invalid_fields(void) {
+    laptimer_config_t image;
+    userConfig(&image, 1);
+    image.droneSize = 7;
+    image.calibSamples = 500;
+    memset(image.pilotId, 'x', sizeof(image.pilotId));
+    memset(&image.detector, 0xFF, sizeof(image) - offsetof(laptimer_config_t, detector));
+    writeImage(&image, sizeof(image));
+
+    Config config;
+    config.load();
+    TEST_ASSERT_EQUAL_UINT8(5, config.getDroneSize());
+    TEST_ASSERT_EQUAL_UINT16(20, config.getCalibrationSamples());
+    TEST_ASSERT_EQUAL_STRING("", config.getPilotId());
+    TEST_ASSERT_EQUAL_UINT16(5800, config.getFrequency());
+}
+
+// 当前版本原样加载，不改写存储
+static void test_current_version_loads_unchanged(void) {
+    laptimer_config_t image;
+    userConfig(&image, CONFIG_VERSION);
+    writeImage(&image, sizeof(image));
+
+    Config config;
+    config.load();
+    uint16_t freqs[CONFIG_MAX_SCAN_CHANNELS];
+    TEST_ASSERT_EQUAL_UINT8(LAPTIMER_DETECTOR_HYSTERESIS, config.getDetector());
+    TEST_ASSERT_EQUAL_UINT8(2, config.getScanFrequencies(freqs));
+    TEST_ASSERT_EQUAL_UINT16(5695, freqs[1]);
+    TEST_ASSERT_TRUE(config.getSerialLink());
+    laptimer_config_t stored;
+    halStorageRead(0, &stored, sizeof(stored));
+    TEST_ASSERT_EQUAL_MEMORY(&image, &stored, sizeof(image));
+}
+
+static void test_garbage_falls_back_to_defaults(void) {
+    uint8_t image[sizeof(laptimer_config_t)];
+    uint32_t state = 12345;
+    for (size_t i = 0; i < sizeof(image); i++) {
+        state = state * 1103515245 + 12345;
+        image[i] = state >> 16;
+    }
+    writeImage(image, sizeof(image));
+
+    Config config;
+    config.load();
+    assertDefaults(&config);
+}
+
+// 版本号合法但标志位不对（例如其他固件留下的数据）
+static void test_magic_mismatch_falls_back_to_defaults(void) {
+    const uint32_t magics[] = {0, 0b10U << 30, 0b11U << 30};
+    for (uint32_t magic : magics) {
+        laptimer_config_t image;
+        userConfig(&image, CONFIG_VERSION);
+        image.version = CONFIG_VERSION | magic;
+        writeImage(&image, sizeof(image));
+
+        Config config;
+        config.load();
+        assertDefaults(&config);
+    }
+}
+
+// 没有迁移路径的版本（0、3）和比当前新的版本都回退到默认值
+static void test_unknown_version_falls_back_to_defaults(void) {
+    const uint32_t versions[] = {0, 3, CONFIG_VERSION + 1};
+    for (uint32_t version : versions) {
+        laptimer_config_t image;
+        userConfig(&image, version);
+        writeImage(&image, sizeof(image));
+
+        Config config;
+        config.load();
+        assertDefaults(&config);
+    }
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_blank_storage_gets_defaults);
+    RUN_TEST(test_migrates_every_old_version);
+    RUN_TEST(test_version_1_fixes_invalid_fields);
+    RUN_TEST(test_current_version_loads_unchanged);
+    RUN_TEST(test_garbage_falls_back_to_defaults);
+    RUN_TEST(test_magic_mismatch_falls_back_to_defaults);
+    RUN_TEST(test_unknown_version_falls_back_to_defaults);
+    return UNITY_END();
+}
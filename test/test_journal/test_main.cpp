@@ -0,0 +1,224 @@
+/**
+ * Journal掉电恢复（pio test -e native -f test_journal）。
+ * 在最后一条记录的每个字节处截断或改写，begin()必须恰好保留之前完整的记录，
+ * 并在会话未结束时补写一条RECOVERED。
+ */
+#include <stdint.h>
+#include <string.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "journal.h"
+
+#define RECORD_SIZE sizeof(journal_record_t)
+
+// 内存后端，append()即落盘
+class MemoryJournalStorage : public JournalStorage {
+   public:
+    std::vector<uint8_t> data;
+
+    bool open() override { return true; }
+    uint32_t size() override { return data.size(); }
+    bool read(uint32_t offset, uint8_t *buf, uint32_t len) override {
+        if (offset + len > data.size()) return false;
+        memcpy(buf, data.data() + offset, len);
+        return true;
+    }
+    bool append(const uint8_t *buf, uint32_t len) override {
+        data.insert(data.end(), buf, buf + len);
+        return true;
+    }
+    bool truncate(uint32_t length) override {
+        if (length > data.size()) return false;
+        data.resize(length);
+        return true;
+    }
+    bool reset() override {
+        data.clear();
+        return true;
+    }
+};
+
+static const uint32_t session1Laps[] = {15200000, 14800000, 15050000};
+static const uint32_t session2Laps[] = {16100000, 15900000};
+
+// 会话1完整结束；会话2记了两圈，closeLast为true时再写STOP
+static std::vector<uint8_t> writeLog(bool closeLast) {
+    MemoryJournalStorage storage;
+    Journal journal;
+    TEST_ASSERT_TRUE(journal.begin(&storage));
+    journal.sessionStart(1700000000);
+    for (uint32_t i = 0; i < 3; i++) journal.appendLap(i, session1Laps[i]);
+    journal.sessionStop(1700000100);
+    journal.sessionStart(1700000200);
+    for (uint32_t i = 0; i < 2; i++) journal.appendLap(i, session2Laps[i]);
+    if (closeLast) journal.sessionStop(1700000300);
+    return storage.data;
+}
+
+static journal_record_t recordAt(const std::vector<uint8_t> &data, uint32_t index) {
+    journal_record_t record;
+    memcpy(&record, data.data() + index * RECORD_SIZE, RECORD_SIZE);
+    return record;
+}
+
+/**
+ * 对只剩intactRecords条完整记录（其后还有truncatedBytes字节残缺数据）的日志做恢复检查。
+ * 最后一条完整记录之前的内容必须逐字节不变。
+ */
+static void checkRecovery(const std::vector<uint8_t> &log, MemoryJournalStorage *storage, uint32_t intactRecords,
+                          uint32_t truncatedBytes) {
+    Journal journal;
+    TEST_ASSERT_TRUE(journal.begin(storage));
+    TEST_ASSERT_EQUAL_UINT32(truncatedBytes, journal.getTruncatedBytes());
+
+    const uint32_t prefixBytes = intactRecords * RECORD_SIZE;
+    TEST_ASSERT_TRUE(storage->data.size() >= prefixBytes);
+    TEST_ASSERT_EQUAL_MEMORY(log.data(), storage->data.data(), prefixBytes);
+
+    // 完整前缀里最后一个会话是否已结束、记了几圈
+    const journal_record_t last = recordAt(log, intactRecords - 1);
+    const bool open = last.type != JOURNAL_SESSION_STOP;
+    uint32_t laps = 0;
+    for (uint32_t i = intactRecords; i-- > 0;) {
+        const journal_record_t record = recordAt(log, i);
+        if (record.type == JOURNAL_SESSION_START) break;
+        if (record.type == JOURNAL_LAP) laps++;
+    }
+
+    TEST_ASSERT_EQUAL(open, journal.wasRecovered());
+    TEST_ASSERT_EQUAL_UINT32(intactRecords + (open ? 1 : 0), journal.getRecordCount());
+    TEST_ASSERT_EQUAL_UINT32(prefixBytes + (open ? RECORD_SIZE : 0), storage->data.size());
+    if (open) {
+        const journal_record_t recovered = recordAt(storage->data, intactRecords);
+        TEST_ASSERT_TRUE(Journal::isValid(&recovered));
+        TEST_ASSERT_EQUAL_UINT8(JOURNAL_SESSION_RECOVERED, recovered.type);
+        TEST_ASSERT_EQUAL_UINT16(last.session, recovered.session);
+        TEST_ASSERT_EQUAL_UINT32(laps, recovered.lapNumber);
+        TEST_ASSERT_EQUAL_UINT32(intactRecords, recovered.sequence);
+    }
+
+    const journal_session_t *boot = journal.getBootSession();
+    TEST_ASSERT_EQUAL_UINT16(last.session, boot->session);
+    TEST_ASSERT_EQUAL(open, boot->open);
+    TEST_ASSERT_EQUAL_UINT32(laps, boot->laps);
+    TEST_ASSERT_EQUAL_UINT32(laps, journal.getBootLapCount());
+    const uint32_t *expectedLaps = last.session == 1 ? session1Laps : session2Laps;
+    for (uint32_t i = 0; i < laps; i++) {
+        TEST_ASSERT_EQUAL_UINT32(expectedLaps[i], journal.getBootLapTimeUs(i));
+    }
+
+    // 恢复后的日志再次启动不需要任何修复
+    Journal again;
+    TEST_ASSERT_TRUE(again.begin(storage));
+    TEST_ASSERT_EQUAL_UINT32(0, again.getTruncatedBytes());
+    TEST_ASSERT_FALSE(again.wasRecovered());
+    TEST_ASSERT_EQUAL_UINT32(storage->data.size() / RECORD_SIZE, again.getRecordCount());
+}
+
+static void checkTruncatedTail(bool closeLast) {
+    const std::vector<uint8_t> log = writeLog(closeLast);
+    const uint32_t records = log.size() / RECORD_SIZE;
+    TEST_ASSERT_EQUAL_UINT32(records * RECORD_SIZE, log.size());
+    // 最后一条只写了length字节（0表示整条都没写上）
+    for (uint32_t length = 0; length < RECORD_SIZE; length++) {
+        MemoryJournalStorage storage;
+        storage.data.assign(log.begin(), log.end() - RECORD_SIZE + length);
+        checkRecovery(log, &storage, records - 1, length);
+    }
+}
+
+static void checkCorruptedTail(bool closeLast) {
+    const std::vector<uint8_t> log = writeLog(closeLast);
+    const uint32_t records = log.size() / RECORD_SIZE;
+    for (uint32_t offset = 0; offset < RECORD_SIZE; offset++) {
+        for (uint8_t flip : {0x01, 0x80, 0xFF}) {
+            MemoryJournalStorage storage;
+            storage.data = log;
+            storage.data[log.size() - RECORD_SIZE + offset] ^= flip;
+            checkRecovery(log, &storage, records - 1, RECORD_SIZE);
+        }
+    }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static void test_intact_open_session_is_recovered(void) {
+    const std::vector<uint8_t> log = writeLog(false);
+    MemoryJournalStorage storage;
+    storage.data = log;
+    checkRecovery(log, &storage, log.size() / RECORD_SIZE, 0);
+}
+
+static void test_intact_closed_session_is_untouched(void) {
+    const std::vector<uint8_t> log = writeLog(true);
+    MemoryJournalStorage storage;
+    storage.data = log;
+    checkRecovery(log, &storage, log.size() / RECORD_SIZE, 0);
+}
+
+// 最后一条是LAP：会话本来就未结束
+static void test_truncated_lap_keeps_intact_prefix(void) {
+    checkTruncatedTail(false);
+}
+
+// 最后一条是STOP：丢掉后会话变成未结束，需要补写RECOVERED
+static void test_truncated_stop_keeps_intact_prefix(void) {
+    checkTruncatedTail(true);
+}
+
+static void test_corrupted_lap_keeps_intact_prefix(void) {
+    checkCorruptedTail(false);
+}
+
+static void test_corrupted_stop_keeps_intact_prefix(void) {
+    checkCorruptedTail(true);
+}
+
+// 中间一条损坏时其后的记录即使完整也一并截掉
+static void test_corruption_in_middle_drops_the_rest(void) {
+    const std::vector<uint8_t> log = writeLog(true);
+    const uint32_t records = log.size() / RECORD_SIZE;
+    MemoryJournalStorage storage;
+    storage.data = log;
+    storage.data[2 * RECORD_SIZE + 8] ^= 0x01;  // 会话1第二圈的圈速
+    checkRecovery(log, &storage, 2, (records - 2) * RECORD_SIZE);
+}
+
+// 恢复后继续写：会话号和记录序号接着旧日志
+static void test_new_session_after_recovery(void) {
+    const std::vector<uint8_t> log = writeLog(false);
+    MemoryJournalStorage storage;
+    storage.data.assign(log.begin(), log.end() - 7);
+    Journal journal;
+    TEST_ASSERT_TRUE(journal.begin(&storage));
+    TEST_ASSERT_TRUE(journal.sessionStart(1700000400));
+    TEST_ASSERT_TRUE(journal.appendLap(0, 14000000));
+    TEST_ASSERT_EQUAL_UINT16(3, journal.getLastSession()->session);
+    TEST_ASSERT_EQUAL_UINT32(1, journal.getLastSession()->laps);
+
+    const uint32_t records = storage.data.size() / RECORD_SIZE;
+    for (uint32_t i = 0; i < records; i++) {
+        const journal_record_t record = recordAt(storage.data, i);
+        TEST_ASSERT_TRUE(Journal::isValid(&record));
+        TEST_ASSERT_EQUAL_UINT32(i, record.sequence);
+    }
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_intact_open_session_is_recovered);
+    RUN_TEST(test_intact_closed_session_is_untouched);
+    RUN_TEST(test_truncated_lap_keeps_intact_prefix);
+    RUN_TEST(test_truncated_stop_keeps_intact_prefix);
+    RUN_TEST(test_corrupted_lap_keeps_intact_prefix);
+    RUN_TEST(test_corrupted_stop_keeps_intact_prefix);
+    RUN_TEST(test_corruption_in_middle_drops_the_rest);
+    RUN_TEST(test_new_session_after_recovery);
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+/**
+ * 定点卡尔曼滤波器与浮点版的一致性（pio test -e native -f test_kalman）。
+ * 误差上界见kalman.h：|filterQ16()/65536 - KalmanFilter::filter()| <= 1 输入单位（12.4定点RSSI），
+ * 8位RSSI最多相差1。
+ */
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+
+#include <random>
+#include <vector>
+
+#include "kalman.h"
+
+// 与laptimer.cpp中的参数一致
+static const float measurementNoise = 2000 * 0.01f;
+static const float processNoise = 40 * 0.0001f;
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// 每2秒一次穿越：底噪80、峰值200的高斯形脉冲，叠加高斯噪声，输入为rssi * 16
+static void crossingTrace(std::vector<uint16_t> *z, double noiseQ4) {
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0.0, noiseQ4);
+    for (int i = 0; i < 5000 * 20; i++) {
+        const double t = i / 5000.0;
+        const double phase = fmod(t, 2.0) - 1.0;
+        double v = 16 * (80 + 120 * exp(-(phase * phase) / (2 * 0.05 * 0.05))) + noise(rng);
+        z->push_back((uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v)));
+    }
+}
+
+// 对同一输入跑两个滤波器，返回最大差值（输入单位）和8位RSSI的最大差值
+static void compare(const std::vector<uint16_t> &z, float q, float r, double *maxErr, long *maxRssiDiff) {
+    KalmanFilter ref;
+    KalmanFilterQ16 fixed;
+    ref.setMeasurementNoise(q);
+    ref.setProcessNoise(r);
+    fixed.setMeasurementNoise(q);
+    fixed.setProcessNoise(r);
+    *maxErr = 0;
+    *maxRssiDiff = 0;
+    for (uint16_t v : z) {
+        const float a = ref.filter(v, 0);
+        const float b = fixed.filterQ16(v) / 65536.0f;
+        const double e = fabs(a - b);
+        if (e > *maxErr) *maxErr = e;
+        const long d = labs(lroundf(a / 16.0f) - lroundf(b / 16.0f));
+        if (d > *maxRssiDiff) *maxRssiDiff = d;
+    }
+}
+
+static void test_q16_matches_float_on_crossings(void) {
+    std::vector<uint16_t> z;
+    crossingTrace(&z, 24.0);
+    double maxErr;
+    long maxRssiDiff;
+    compare(z, measurementNoise, processNoise, &maxErr, &maxRssiDiff);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, maxErr);
+    TEST_ASSERT_LESS_OR_EQUAL(1, maxRssiDiff);
+}
+
+static void test_q16_matches_float_without_noise(void) {
+    std::vector<uint16_t> z;
+    crossingTrace(&z, 0.0);
+    double maxErr;
+    long maxRssiDiff;
+    compare(z, measurementNoise, processNoise, &maxErr, &maxRssiDiff);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, maxErr);
+    TEST_ASSERT_LESS_OR_EQUAL(1, maxRssiDiff);
+}
+
+// 满量程阶跃是定点版最容易溢出或累积舍入误差的输入
+static void test_q16_matches_float_on_full_scale_steps(void) {
+    std::vector<uint16_t> z;
+    for (int step = 0; step < 20; step++) {
+        const uint16_t level = (step & 1) ? 4095 : 0;
+        for (int i = 0; i < 2000; i++) z.push_back(level);
+    }
+    double maxErr;
+    long maxRssiDiff;
+    compare(z, measurementNoise, processNoise, &maxErr, &maxRssiDiff);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, maxErr);
+    TEST_ASSERT_LESS_OR_EQUAL(1, maxRssiDiff);
+}
+
+// 其他Q/R组合（过程噪声不小于0.004）同样满足上界
+static void test_q16_matches_float_with_other_noise_settings(void) {
+    std::vector<uint16_t> z;
+    crossingTrace(&z, 24.0);
+    const float settings[][2] = {{1.0f, 0.01f}, {20.0f, 0.04f}, {100.0f, 0.004f}};
+    for (const auto &s : settings) {
+        double maxErr;
+        long maxRssiDiff;
+        compare(z, s[0], s[1], &maxErr, &maxRssiDiff);
+        TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, maxErr);
+        TEST_ASSERT_LESS_OR_EQUAL(1, maxRssiDiff);
+    }
+}
+
+static void test_q16_first_sample_and_reset(void) {
+    KalmanFilterQ16 fixed;
+    fixed.setMeasurementNoise(measurementNoise);
+    fixed.setProcessNoise(processNoise);
+    TEST_ASSERT_EQUAL_INT(1600 << 16, fixed.filterQ16(1600));
+    for (int i = 0; i < 5000; i++) fixed.filterQ16(800);
+    TEST_ASSERT_INT_WITHIN(16 << 16, 800 << 16, fixed.filterQ16(800));
+    // reset()后第一个样本直接作为估计值
+    fixed.reset();
+    TEST_ASSERT_EQUAL_INT(3000 << 16, fixed.filterQ16(3000));
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_q16_matches_float_on_crossings);
+    RUN_TEST(test_q16_matches_float_without_noise);
+    RUN_TEST(test_q16_matches_float_on_full_scale_steps);
+    RUN_TEST(test_q16_matches_float_with_other_noise_settings);
+    RUN_TEST(test_q16_first_sample_and_reset);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+/**
+ * LapStore编解码与空闲块补充（pio test -e native -f test_lapstore）。
+ * append()不分配内存：预分配的块用完后只有refill()补充的块可用。
+ */
+#include <stdint.h>
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "lapstore.h"
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// 圈速在15秒上下波动，偶尔有大跳变（撞门、漏圈）
+static uint32_t lapTime(uint32_t i) {
+    uint32_t v = 15000000 + (i * 7919) % 400000;
+    if (i % 37 == 0) v = 45000000;
+    return v;
+}
+
+static void assertLaps(const LapStore &laps, uint32_t count) {
+    TEST_ASSERT_EQUAL_UINT32(count, laps.getCount());
+    LapStore::Iterator it = laps.iterate();
+    uint32_t v;
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(it.next(&v));
+        TEST_ASSERT_EQUAL_UINT32(lapTime(i), v);
+    }
+    TEST_ASSERT_FALSE(it.next(&v));
+}
+
+static void test_round_trip(void) {
+    LapStore laps;
+    laps.reserve(LAPSTORE_PREALLOC_CHUNKS);
+    for (uint32_t i = 0; i < 200; i++) TEST_ASSERT_TRUE(laps.append(lapTime(i)));
+    assertLaps(laps, 200);
+    TEST_ASSERT_EQUAL_UINT32(lapTime(199), laps.getLast());
+    TEST_ASSERT_EQUAL_UINT32(0, laps.getDrops());
+}
+
+// 不补充时预分配的块用完即丢圈，append()本身从不malloc
+static void test_append_never_allocates(void) {
+    LapStore laps;
+    laps.reserve(2);
+    uint32_t stored = 0;
+    for (uint32_t i = 0; i < 200; i++) {
+        if (laps.append(lapTime(i))) stored++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(2, laps.getChunkCount());
+    TEST_ASSERT_TRUE(stored < 200);
+    TEST_ASSERT_EQUAL_UINT32(200 - stored, laps.getDrops());
+    assertLaps(laps, stored);
+}
+
+// 每圈之后补充一次（对应parallelTask的节奏），耐力赛的上千圈都能记下
+static void test_refill_keeps_up(void) {
+    LapStore laps;
+    laps.reserve(2);
+    for (uint32_t i = 0; i < 3000; i++) {
+        TEST_ASSERT_TRUE(laps.append(lapTime(i)));
+        laps.refill();
+    }
+    assertLaps(laps, 3000);
+    TEST_ASSERT_EQUAL_UINT32(0, laps.getDrops());
+}
+
+// clear()后块留在空闲链表里复用，并使正在进行的遍历作废
+static void test_clear_reuses_chunks(void) {
+    LapStore laps;
+    laps.reserve(2);
+    for (uint32_t i = 0; i < 500; i++) {
+        laps.append(lapTime(i));
+        laps.refill();
+    }
+    const uint16_t chunks = laps.getChunkCount();
+    const uint32_t generation = laps.getGeneration();
+    laps.clear();
+    TEST_ASSERT_TRUE(laps.getGeneration() != generation);
+    TEST_ASSERT_EQUAL_UINT32(0, laps.getCount());
+    for (uint32_t i = 0; i < 500; i++) TEST_ASSERT_TRUE(laps.append(lapTime(i)));
+    TEST_ASSERT_EQUAL_UINT16(chunks, laps.getChunkCount());
+    assertLaps(laps, 500);
+}
+
+// 写者、补充者、读者各一个线程，读者每次看到的都是完整的前缀
+static void test_concurrent_writer_refill_reader(void) {
+    LapStore laps;
+    laps.reserve(2);
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> bad{0};
+    std::thread refiller([&] {
+        while (!done.load()) laps.refill();
+    });
+    std::thread reader([&] {
+        std::vector<uint32_t> buf(4000);
+        while (!done.load()) {
+            const uint32_t generation = laps.getGeneration();
+            uint32_t n = 0;
+            LapStore::Iterator it = laps.iterate();
+            while (n < buf.size() && it.next(&buf[n])) n++;
+            if (!laps.isGeneration(generation)) continue;
+            for (uint32_t i = 0; i < n; i++) {
+                if (buf[i] != lapTime(i)) bad++;
+            }
+        }
+    });
+    for (uint32_t round = 0; round < 3; round++) {
+        laps.clear();
+        for (uint32_t i = 0; i < 3000; i++) {
+            while (!laps.append(lapTime(i))) std::this_thread::yield();
+        }
+    }
+    done.store(true);
+    refiller.join();
+    reader.join();
+    TEST_ASSERT_EQUAL_UINT32(0, bad.load());
+    assertLaps(laps, 3000);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_append_never_allocates);
+    RUN_TEST(test_refill_keeps_up);
+    RUN_TEST(test_clear_reuses_chunks);
+    RUN_TEST(test_concurrent_writer_refill_reader);
+    return UNITY_END();
+}
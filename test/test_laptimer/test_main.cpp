@@ -0,0 +1,271 @@
+/**
+ * LapTimer开始/停止/圈速与两种穿越检测（pio test -e native -f test_laptimer）。
+ * 信号为合成的无噪声RSSI，经过与固件相同的抽取、卡尔曼滤波和检测，时钟是虚拟的。
+ */
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "laptimer.h"
+
+#define RAW_RATE_HZ (SAMPLER_RATE_HZ * RSSI_DECIMATION)
+#define FLOOR_RSSI 60
+#define PEAK_RSSI 190
+#define CROSSING_SIGMA_US 40000  // 脉冲宽度，约等于15 m/s穿过2米门
+#define TIME_TOLERANCE_US 5000
+#define SEC(s) ((uint64_t)((s) * 1000000.0))
+
+// 从内存按块回放抽取前的原始值，采样时刻从0开始
+class VectorRssiSource : public RssiSource {
+   public:
+    VectorRssiSource(const std::vector<uint16_t> *samples) : data(samples) {}
+    bool begin(uint32_t rateHz) override {
+        sampleRateHz = rateHz;
+        periodUs = 1000000UL / rateHz;
+        pos = 0;
+        return true;
+    }
+    uint16_t readBlock(rssi_block_t *block) override {
+        const size_t left = data->size() - pos;
+        if (left == 0) return 0;
+        block->startUs = (uint64_t)pos * periodUs;
+        block->periodUs = periodUs;
+        block->count = left < SAMPLER_BLOCK_SIZE ? left : SAMPLER_BLOCK_SIZE;
+        memcpy(block->raw, data->data() + pos, block->count * sizeof(uint16_t));
+        pos += block->count;
+        return block->count;
+    }
+    bool isDone() { return pos >= data->size(); }
+    uint64_t getTimeUs() { return (uint64_t)pos * periodUs; }
+
+   private:
+    const std::vector<uint16_t> *data;
+    size_t pos = 0;
+    uint32_t periodUs = 0;
+};
+
+typedef struct {
+    double timeS;     // 穿越时刻（秒）
+    uint8_t peak;     // 峰值RSSI
+    uint16_t humpUs;  // 非0时为两个等高的峰，各偏离穿越时刻humpUs，中间形成多径凹陷
+} crossing_t;
+
+// 原始值为12位ADC，RX5808::scaleRssiQ4()把它除以8得到8位RSSI
+static void synthesize(const crossing_t *crossings, size_t count, double durationS, std::vector<uint16_t> *raw) {
+    const double periodUs = 1e6 / RAW_RATE_HZ;
+    raw->resize((size_t)(durationS * RAW_RATE_HZ));
+    for (size_t i = 0; i < raw->size(); i++) {
+        const double tUs = i * periodUs;
+        double rssi = FLOOR_RSSI;
+        for (size_t c = 0; c < count; c++) {
+            const double centerUs = crossings[c].timeS * 1e6;
+            const double height = crossings[c].peak - FLOOR_RSSI;
+            const double offsets[2] = {-(double)crossings[c].humpUs, (double)crossings[c].humpUs};
+            double v = 0;
+            for (uint8_t h = 0; h < (crossings[c].humpUs ? 2 : 1); h++) {
+                const double x = (tUs - centerUs - offsets[h]) / CROSSING_SIGMA_US;
+                if (x * x < 50) v = fmax(v, height * exp(-x * x / 2));
+            }
+            rssi += v;
+        }
+        (*raw)[i] = (uint16_t)lround(rssi * 8);
+    }
+}
+
+static void collectEvents(const laptimer_event_t *event, void *ctx) {
+    ((std::vector<laptimer_event_t> *)ctx)->push_back(*event);
+}
+
+/**
+ * 用默认配置（进入120、退出100、最小圈时10秒、2米门）跑完整段信号，
+ * startAtS < 0表示不开始计时；结束时发送停止命令。
+ */
+static void runTimer(const std::vector<uint16_t> &raw, uint8_t detector, double startAtS,
+                     std::vector<laptimer_event_t> *events) {
+    Config config;
+    RX5808 rx(PIN_RX5808_RSSI, PIN_RX5808_DATA, PIN_RX5808_SELECT, PIN_RX5808_CLOCK);
+    VectorRssiSource source(&raw);
+    Buzzer buzzer;
+    Led led;
+    LapTimer *timer = new LapTimer();
+
+    halNativeSetTimeUs(0);
+    config.init();
+    config.setEnterRssi(120);
+    config.setExitRssi(100);
+    config.setMinLapMs(10000);
+    config.setDroneSize(5);
+    config.setDetector(detector);
+    rx.init();
+    buzzer.init(PIN_BUZZER, BUZZER_INVERTED);
+    led.init(PIN_LED, false);
+    source.begin(RAW_RATE_HZ);
+    timer->init(&config, &rx, &source, &buzzer, &led);
+    timer->addEventSink(collectEvents, events);
+
+    bool started = startAtS < 0;
+    while (!source.isDone()) {
+        if (!started && source.getTimeUs() >= SEC(startAtS)) {
+            timer->postCommand(LAPTIMER_CMD_START);
+            started = true;
+        }
+        timer->handleLapTimerUpdate();
+        halNativeSetTimeUs(source.getTimeUs());
+        timer->dispatchEvents();
+    }
+    timer->postCommand(LAPTIMER_CMD_STOP);
+    timer->handleLapTimerUpdate();
+    timer->dispatchEvents();
+    delete timer;
+}
+
+static std::vector<laptimer_event_t> lapsOf(const std::vector<laptimer_event_t> &events) {
+    std::vector<laptimer_event_t> laps;
+    for (const laptimer_event_t &e : events) {
+        if (e.type == LAPTIMER_EVENT_LAP) laps.push_back(e);
+    }
+    return laps;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+static const crossing_t threeLaps[] = {{12, PEAK_RSSI, 0}, {27, PEAK_RSSI, 0}, {43, PEAK_RSSI, 0}};
+
+// 开始、三次穿越、停止：第0圈从start()算起，之后为相邻两次穿越的间隔
+static void checkThreeLaps(uint8_t detector) {
+    std::vector<uint16_t> raw;
+    synthesize(threeLaps, 3, 50, &raw);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, detector, 0, &events);
+
+    TEST_ASSERT_EQUAL(5, events.size());
+    TEST_ASSERT_EQUAL(LAPTIMER_EVENT_START, events.front().type);
+    TEST_ASSERT_EQUAL(LAPTIMER_EVENT_STOP, events.back().type);
+    TEST_ASSERT_EQUAL_UINT32(3, events.back().lapNumber);
+
+    std::vector<laptimer_event_t> laps = lapsOf(events);
+    TEST_ASSERT_EQUAL(3, laps.size());
+    const uint64_t startUs = events.front().timeUs;
+    for (uint32_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, laps[i].lapNumber);
+        TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(threeLaps[i].timeS), laps[i].timeUs);
+        TEST_ASSERT_TRUE(laps[i].peakRssi >= 120);
+    }
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(12) - startUs, laps[0].lapTimeUs);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(15), laps[1].lapTimeUs);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(16), laps[2].lapTimeUs);
+}
+
+static void test_peak_detector_times_laps(void) {
+    checkThreeLaps(LAPTIMER_DETECTOR_PEAK);
+}
+
+static void test_hysteresis_detector_times_laps(void) {
+    checkThreeLaps(LAPTIMER_DETECTOR_HYSTERESIS);
+}
+
+// 多径凹陷不低于exitRssi时窗口不关闭，一次穿越只判定一次
+static void test_hysteresis_ignores_dip_above_exit(void) {
+    const crossing_t crossings[] = {{12, PEAK_RSSI, 60000}, {27, PEAK_RSSI, 60000}, {43, PEAK_RSSI, 60000}};
+    std::vector<uint16_t> raw;
+    synthesize(crossings, 3, 50, &raw);
+    // 两峰之间的谷底仍高于exitRssi（100）
+    TEST_ASSERT_TRUE(raw[(size_t)(12 * RAW_RATE_HZ)] / 8 > 100);
+    TEST_ASSERT_TRUE(raw[(size_t)(12 * RAW_RATE_HZ)] / 8 < 120);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, LAPTIMER_DETECTOR_HYSTERESIS, 0, &events);
+
+    std::vector<laptimer_event_t> laps = lapsOf(events);
+    TEST_ASSERT_EQUAL(3, laps.size());
+    for (uint32_t i = 0; i < 3; i++) {
+        // 峰值落在两个峰中的一个上
+        TEST_ASSERT_UINT32_WITHIN(60000 + TIME_TOLERANCE_US, SEC(crossings[i].timeS), laps[i].timeUs);
+    }
+}
+
+// 上一圈后不到最小圈时的穿越被丢弃，下一圈仍从上一次计入的穿越算起
+static void checkMinLap(uint8_t detector) {
+    const crossing_t crossings[] = {{12, PEAK_RSSI, 0}, {27, PEAK_RSSI, 0}, {29, PEAK_RSSI, 0}, {43, PEAK_RSSI, 0}};
+    std::vector<uint16_t> raw;
+    synthesize(crossings, 4, 50, &raw);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, detector, 0, &events);
+
+    std::vector<laptimer_event_t> laps = lapsOf(events);
+    TEST_ASSERT_EQUAL(3, laps.size());
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(27), laps[1].timeUs);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(43), laps[2].timeUs);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(16), laps[2].lapTimeUs);
+}
+
+static void test_peak_detector_respects_min_lap(void) {
+    checkMinLap(LAPTIMER_DETECTOR_PEAK);
+}
+
+static void test_hysteresis_detector_respects_min_lap(void) {
+    checkMinLap(LAPTIMER_DETECTOR_HYSTERESIS);
+}
+
+// 第0圈从start()时刻算起（而不是开机时刻），且不受最小圈时限制
+static void test_lap_zero_starts_at_start_command(void) {
+    const crossing_t crossings[] = {{12, PEAK_RSSI, 0}, {27, PEAK_RSSI, 0}};
+    std::vector<uint16_t> raw;
+    synthesize(crossings, 2, 30, &raw);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, LAPTIMER_DETECTOR_HYSTERESIS, 7, &events);
+
+    TEST_ASSERT_EQUAL(LAPTIMER_EVENT_START, events.front().type);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(7), events.front().timeUs);
+    std::vector<laptimer_event_t> laps = lapsOf(events);
+    TEST_ASSERT_EQUAL(2, laps.size());
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(5), laps[0].lapTimeUs);
+    TEST_ASSERT_UINT32_WITHIN(TIME_TOLERANCE_US, SEC(15), laps[1].lapTimeUs);
+}
+
+// 停止状态下穿越不计圈，也不发事件
+static void test_no_laps_while_stopped(void) {
+    std::vector<uint16_t> raw;
+    synthesize(threeLaps, 3, 50, &raw);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, LAPTIMER_DETECTOR_PEAK, -1, &events);
+    TEST_ASSERT_EQUAL(0, events.size());
+}
+
+// 峰值低于enterRssi的信号（例如相邻频道的图传）不算穿越
+static void checkBelowEnter(uint8_t detector) {
+    const crossing_t crossings[] = {{12, 115, 0}, {27, 115, 0}};
+    std::vector<uint16_t> raw;
+    synthesize(crossings, 2, 30, &raw);
+    std::vector<laptimer_event_t> events;
+    runTimer(raw, detector, 0, &events);
+    TEST_ASSERT_EQUAL(0, lapsOf(events).size());
+}
+
+static void test_peak_detector_ignores_signal_below_enter(void) {
+    checkBelowEnter(LAPTIMER_DETECTOR_PEAK);
+}
+
+static void test_hysteresis_detector_ignores_signal_below_enter(void) {
+    checkBelowEnter(LAPTIMER_DETECTOR_HYSTERESIS);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    UNITY_BEGIN();
+    RUN_TEST(test_peak_detector_times_laps);
+    RUN_TEST(test_hysteresis_detector_times_laps);
+    RUN_TEST(test_hysteresis_ignores_dip_above_exit);
+    RUN_TEST(test_peak_detector_respects_min_lap);
+    RUN_TEST(test_hysteresis_detector_respects_min_lap);
+    RUN_TEST(test_lap_zero_starts_at_start_command);
+    RUN_TEST(test_no_laps_while_stopped);
+    RUN_TEST(test_peak_detector_ignores_signal_below_enter);
+    RUN_TEST(test_hysteresis_detector_ignores_signal_below_enter);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+/*
+ * 卡尔曼滤波器主机基准测试：比较浮点版KalmanFilter与定点版KalmanFilterQ16
+ * 每个样本的耗时（x86上同时报告TSC周期数），并核对kalman.h中给出的误差上界。
+ *
+ * 编译：
+ *   g++ -O2 -std=c++17 -Ilib/KALMAN tools/bench/kalman_bench.cpp lib/KALMAN/kalman.cpp -o kalman_bench
+ * 运行：
+ *   ./kalman_bench [trace.txt]
+ *
+ * trace.txt 每行一个12.4定点RSSI值（rssi * 16，0-4095），或"时间戳 值"，取最后一列；
+ * 不给文件时使用合成的穿越波形。设备端的周期数用 -DKALMAN_BENCHMARK 编译固件，
+ * 启动时串口会打印同样的对比结果。
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "kalman.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+// 与laptimer.cpp中的参数一致
+static const float measurementNoise = 2000 * 0.01f;
+static const float processNoise = 40 * 0.0001f;
+
+static bool loadTrace(const char *path, std::vector<uint16_t> &z) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char *last = nullptr;
+        for (char *tok = strtok(line, " \t,\r\n"); tok; tok = strtok(nullptr, " \t,\r\n")) last = tok;
+        if (last) z.push_back((uint16_t)atoi(last));
+    }
+    fclose(f);
+    return !z.empty();
+}
+
+static void synthTrace(std::vector<uint16_t> &z) {
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0.0, 24.0);
+    for (int i = 0; i < 5000 * 20; i++) {
+        double t = i / 5000.0;
+        double phase = fmod(t, 2.0) - 1.0;
+        double v = 16 * (80 + 120 * exp(-(phase * phase) / (2 * 0.05 * 0.05))) + noise(rng);
+        z.push_back((uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v)));
+    }
+}
+
+template <typename F>
+static void timeIt(const char *name, const std::vector<uint16_t> &z, F step) {
+    const int repeats = 50;
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    for (int r = 0; r < repeats; r++) {
+        for (uint16_t v : z) sink = step(v);
+    }
+#ifdef HAVE_TSC
+    uint64_t c1 = __rdtsc();
+#endif
+    auto t1 = std::chrono::steady_clock::now();
+    double n = double(z.size()) * repeats;
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+#ifdef HAVE_TSC
+    printf("%-10s %8.2f ns/sample %8.2f TSC cycles/sample\n", name, ns, (c1 - c0) / n);
+#else
+    printf("%-10s %8.2f ns/sample\n", name, ns);
+#endif
+    (void)sink;
+}
+
+int main(int argc, char **argv) {
+    std::vector<uint16_t> z;
+    if (argc > 1) {
+        if (!loadTrace(argv[1], z)) {
+            fprintf(stderr, "cannot read trace %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        synthTrace(z);
+    }
+    printf("samples: %zu\n", z.size());
+
+    KalmanFilter ref;
+    KalmanFilterQ16 fixed;
+    ref.setMeasurementNoise(measurementNoise);
+    ref.setProcessNoise(processNoise);
+    fixed.setMeasurementNoise(measurementNoise);
+    fixed.setProcessNoise(processNoise);
+
+    double maxErr = 0, sumErr = 0;
+    size_t rssiMismatch = 0;
+    long maxRssiDiff = 0;
+    for (uint16_t v : z) {
+        float a = ref.filter(v, 0);
+        float b = fixed.filterQ16(v) / 65536.0f;
+        double e = fabs(a - b);
+        if (e > maxErr) maxErr = e;
+        sumErr += e;
+        long d = lroundf(a / 16.0f) - lroundf(b / 16.0f);
+        if (d != 0) rssiMismatch++;
+        if (labs(d) > maxRssiDiff) maxRssiDiff = labs(d);
+    }
+    printf("max |fixed - float| = %.4f input units (%.5f RSSI), mean %.5f, bound 1.0 -> %s\n", maxErr, maxErr / 16,
+           sumErr / z.size(), maxErr <= 1.0 ? "OK" : "EXCEEDED");
+    printf("8-bit RSSI mismatches: %zu of %zu samples, max difference %ld\n", rssiMismatch, z.size(), maxRssiDiff);
+
+    KalmanFilter f1;
+    f1.setMeasurementNoise(measurementNoise);
+    f1.setProcessNoise(processNoise);
+    KalmanFilterQ16 f2;
+    f2.setMeasurementNoise(measurementNoise);
+    f2.setProcessNoise(processNoise);
+    timeIt("float", z, [&](uint16_t v) { return f1.filter(v, 0); });
+    timeIt("q16", z, [&](uint16_t v) { return (float)f2.filterQ16(v); });
+    return maxErr <= 1.0 ? 0 : 1;
+}
@@ -0,0 +1,530 @@
+/*
+ * UDP圈速广播（LapCast）的主机端接收工具：逐圈打印各节点的圈速，向节点NACK补发丢包，统计延迟和丢包。
+ *
+ * 编译：
+ *   g++ -O2 -std=c++17 -Ilib/RACENET -Ilib/CRC -Ilib/QUEUE tools/lapcast/lapcast_listen.cpp lib/RACENET/lapcast.cpp \
+ *       lib/RACENET/racenet.cpp lib/RACENET/clocksync.cpp lib/RACENET/racenet_posix.cpp lib/CRC/crc.cpp -o lapcast_listen
+ * 运行：
+ *   ./lapcast_listen listen [端口=7371] [组播组=239.255.73.71]
+ *       加入组播组并同时接收本网段广播，逐圈打印；每10秒和Ctrl-C时打印各节点的统计。
+ *       主机与节点的时钟不同步，端到端延迟按 到达时刻 - 过门时刻 减去心跳中见到的最小值估计，
+ *       即不含最小的单程网络延迟（局域网内约1-3 ms）
+ *   ./lapcast_listen sim [节点数=4] [圈数=50] [丢包率%=10] [平均圈时ms=300]
+ *       fork出N个发送进程（127.0.0.1单播，按丢包率丢弃发出的所有包，包括重发和心跳），父进程接收，
+ *       结束后核对每圈是否收到且只交付一次、内容是否正确，报告真实的端到端延迟（收发用同一个CLOCK_MONOTONIC）
+ *       以及listen模式下的估计值
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "lapcast.h"
+#include "racenet.h"
+
+#define SIM_BASE_PORT 17371
+#define SIM_START_DELAY_MS 500
+#define SIM_LINGER_MS 3000     // 最后一圈后发送进程继续运行的时间，留给心跳和补发
+#define STATS_INTERVAL_MS 10000
+#define OFFSET_WINDOW 16       // 估计时钟偏差所用的最近心跳数
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleepUs(uint32_t us) {
+    struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static volatile bool stopRequested = false;
+
+static void onSignal(int) {
+    stopRequested = true;
+}
+
+// 按丢包率随机丢弃发出的包，模拟WiFi组播没有链路层重传
+class LossyTransport : public RaceTransport {
+   public:
+    LossyTransport(RaceTransport *t, uint8_t percent, uint32_t seed) : inner(t), lossPercent(percent), rng(seed) {}
+    bool begin(uint16_t port) override { return inner->begin(port); }
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override {
+        if (drop()) return true;
+        return inner->send(to, buf, len);
+    }
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override {
+        if (drop()) return true;
+        return inner->broadcast(port, buf, len);
+    }
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override {
+        return inner->receive(from, buf, size);
+    }
+
+   private:
+    RaceTransport *inner;
+    uint8_t lossPercent;
+    std::mt19937 rng;
+
+    bool drop() { return lossPercent > 0 && rng() % 100 < lossPercent; }
+};
+
+// ---------------------------------------------------------------- 接收方
+
+typedef struct {
+    uint64_t sinceUs;  // 发现缺号的时刻
+    uint64_t nackUs;   // 最近一次NACK的时刻，0表示还没发
+    uint8_t tries;
+} missing_t;
+
+typedef struct {
+    uint32_t node;
+    uint32_t boot;
+    racenet_addr_t addr;  // NACK发往最近一个包的来源
+    uint32_t highest;     // 已知的最大序号（收到的圈包或心跳）
+    std::set<uint32_t> got;
+    std::map<uint32_t, missing_t> missing;
+    uint32_t laps = 0;
+    uint32_t duplicates = 0;
+    uint32_t recovered = 0;
+    uint32_t lost = 0;
+    uint32_t beforeJoin = 0;  // 开始接收时已不在节点历史中的序号，不计丢失
+    uint32_t nacksSent = 0;
+    // 心跳的 到达时刻 - 发送时刻，取最近几次的最小值作为时钟偏差 + 最小单程延迟
+    std::vector<int64_t> hbOffsets;
+    uint8_t hbFlags = 0;
+    std::vector<double> nodeDelayMs;
+    std::vector<double> latencyMs;  // 估计的端到端延迟
+    std::vector<double> recoveryMs;  // 发现缺号到补到的时间
+} stream_t;
+
+typedef struct {
+    uint32_t node;
+    uint32_t seq;
+    uint64_t arriveUs;
+    lapcast_lap_t lap;
+} delivered_t;
+
+class Listener {
+   public:
+    bool begin(uint16_t port, uint32_t groupIp, bool loopbackOnly);
+    // 阻塞到有包或timeoutMs，处理收到的所有包，再做一次NACK重试
+    void poll(uint32_t timeoutMs);
+    void printStats();
+    bool verbose = true;
+    std::vector<delivered_t> delivered;
+    std::vector<stream_t> streams;
+
+   private:
+    int fd = -1;
+
+    stream_t *findStream(const lapcast_lap_t *p, const racenet_addr_t *from);
+    void markMissing(stream_t *s, uint32_t upTo, uint64_t nowUs);
+    void handle(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs);
+    void sendNack(stream_t *s, uint32_t firstSeq, uint8_t count);
+    void service(uint64_t nowUs);
+};
+
+bool Listener::begin(uint16_t port, uint32_t groupIp, bool loopbackOnly) {
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) return false;
+    if (groupIp != 0) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = groupIp;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            fprintf(stderr, "cannot join multicast group, receiving broadcast only\n");
+        }
+    }
+    return true;
+}
+
+stream_t *Listener::findStream(const lapcast_lap_t *p, const racenet_addr_t *from) {
+    for (stream_t &s : streams) {
+        if (s.node != p->node) continue;
+        if (s.boot == p->boot) {
+            s.addr = *from;
+            return &s;
+        }
+        // 节点重启：上一次启动还没补到的都算丢失
+        s.lost += s.missing.size();
+        s.missing.clear();
+    }
+    stream_t s;
+    s.node = p->node;
+    s.boot = p->boot;
+    s.addr = *from;
+    s.highest = 0;
+    streams.push_back(s);
+    return &streams.back();
+}
+
+// 序号highest+1..upTo缺失；已经不在节点历史中的直接记为丢失（刚开始接收时不计）
+void Listener::markMissing(stream_t *s, uint32_t upTo, uint64_t nowUs) {
+    const uint32_t oldest = upTo >= LAPCAST_HISTORY ? upTo - LAPCAST_HISTORY + 1 : 1;
+    for (uint32_t seq = s->highest + 1; seq <= upTo; seq++) {
+        if (seq == upTo && s->got.count(seq)) continue;
+        if (seq < oldest) {
+            if (s->highest == 0)
+                s->beforeJoin++;
+            else
+                s->lost++;
+            continue;
+        }
+        if (!s->got.count(seq)) s->missing[seq] = {nowUs, 0, 0};
+    }
+    if (upTo > s->highest) s->highest = upTo;
+}
+
+void Listener::handle(const racenet_addr_t *from, const uint8_t *buf, uint16_t len, uint64_t nowUs) {
+    const uint8_t type = lapcastCheck(buf, len);
+    if (type != LAPCAST_LAP && type != LAPCAST_HEARTBEAT) return;
+    lapcast_lap_t p;
+    memcpy(&p, buf, sizeof(p));
+    stream_t *s = findStream(&p, from);
+    if (type == LAPCAST_HEARTBEAT) {
+        if ((p.flags & LAPCAST_FLAG_SHARED) != s->hbFlags) s->hbOffsets.clear();
+        s->hbFlags = p.flags & LAPCAST_FLAG_SHARED;
+        s->hbOffsets.push_back((int64_t)(nowUs - p.timeUs));
+        if (s->hbOffsets.size() > OFFSET_WINDOW) s->hbOffsets.erase(s->hbOffsets.begin());
+        if (p.seq > s->highest) markMissing(s, p.seq, nowUs);
+        return;
+    }
+    if (s->got.count(p.seq)) {
+        s->duplicates++;
+        return;
+    }
+    s->got.insert(p.seq);
+    auto it = s->missing.find(p.seq);
+    if (it != s->missing.end()) {
+        s->recovered++;
+        s->recoveryMs.push_back((nowUs - it->second.sinceUs) / 1000.0);
+        s->missing.erase(it);
+    }
+    if (p.seq > s->highest) markMissing(s, p.seq, nowUs);
+    s->laps++;
+    s->nodeDelayMs.push_back(p.sendDelayUs / 1000.0);
+    double latency = -1;
+    if (!s->hbOffsets.empty() && (p.flags & LAPCAST_FLAG_SHARED) == s->hbFlags) {
+        const int64_t minOffset = *std::min_element(s->hbOffsets.begin(), s->hbOffsets.end());
+        latency = ((int64_t)(nowUs - p.timeUs) - minOffset) / 1000.0;
+        s->latencyMs.push_back(latency);
+    }
+    delivered.push_back({p.node, p.seq, nowUs, p});
+    if (!verbose) return;
+    char ip[16];
+    racenetFormatIp(from->ip, ip, sizeof(ip));
+    printf("%08X %-15s seq %4u  lap %3u  %4u MHz  %8.3f s  peak %3u  node %6.2f ms", p.node, ip, p.seq, p.lapNumber,
+           p.frequency, p.lapMs / 1000.0, p.peakRssi, p.sendDelayUs / 1000.0);
+    if (latency >= 0) printf("  e2e ~%.2f ms", latency);
+    printf("%s\n", p.flags & LAPCAST_FLAG_RESENT ? "  (resent)" : "");
+    fflush(stdout);
+}
+
+void Listener::sendNack(stream_t *s, uint32_t firstSeq, uint8_t count) {
+    uint8_t buf[LAPCAST_MAX_PACKET];
+    lapcast_nack_t nack;
+    memset(&nack, 0, sizeof(nack));
+    nack.magic = LAPCAST_MAGIC;
+    nack.version = LAPCAST_VERSION;
+    nack.type = LAPCAST_NACK;
+    nack.node = s->node;
+    nack.boot = s->boot;
+    nack.firstSeq = firstSeq;
+    nack.count = count;
+    memcpy(buf, &nack, sizeof(nack));
+    const uint16_t len = lapcastSeal(buf, sizeof(nack));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = s->addr.ip;
+    addr.sin_port = htons(s->addr.port);
+    sendto(fd, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    s->nacksSent++;
+}
+
+// 到期的缺号按连续区间合并成NACK；超过重试次数或已滑出节点历史的记为丢失
+void Listener::service(uint64_t nowUs) {
+    for (stream_t &s : streams) {
+        const uint32_t oldest = s.highest >= LAPCAST_HISTORY ? s.highest - LAPCAST_HISTORY + 1 : 1;
+        uint32_t first = 0;
+        uint8_t count = 0;
+        for (auto it = s.missing.begin(); it != s.missing.end();) {
+            missing_t &m = it->second;
+            const uint32_t seq = it->first;
+            if (m.nackUs != 0 && nowUs - m.nackUs < (uint64_t)LAPCAST_NACK_RETRY_MS * 1000) {
+                ++it;
+                continue;
+            }
+            if (seq < oldest || m.tries >= LAPCAST_NACK_TRIES) {
+                s.lost++;
+                it = s.missing.erase(it);
+                continue;
+            }
+            if (count > 0 && (seq != first + count || count == LAPCAST_NACK_MAX)) {
+                sendNack(&s, first, count);
+                count = 0;
+            }
+            if (count == 0) first = seq;
+            count++;
+            m.nackUs = nowUs;
+            m.tries++;
+            ++it;
+        }
+        if (count > 0) sendNack(&s, first, count);
+        // 去重集合只需覆盖节点历史
+        while (!s.got.empty() && *s.got.begin() + 4 * LAPCAST_HISTORY < s.highest) s.got.erase(s.got.begin());
+    }
+}
+
+void Listener::poll(uint32_t timeoutMs) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    ::poll(&pfd, 1, timeoutMs);
+    uint8_t buf[256];
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    ssize_t n;
+    while ((n = recvfrom(fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&addr, &addrLen)) > 0) {
+        const racenet_addr_t from = {addr.sin_addr.s_addr, ntohs(addr.sin_port)};
+        handle(&from, buf, (uint16_t)n, monotonicUs());
+        addrLen = sizeof(addr);
+    }
+    service(monotonicUs());
+}
+
+void Listener::printStats() {
+    for (const stream_t &s : streams) {
+        printf("node %08X boot %08X: %u laps, %u recovered, %u lost, %u duplicates, %u nacks, %u before join\n", s.node,
+               s.boot, s.laps, s.recovered, s.lost, s.duplicates, s.nacksSent, s.beforeJoin);
+        printf("  node delay p50 %.2f ms p95 %.2f ms; e2e p50 %.2f ms p95 %.2f ms max %.2f ms; recovery p50 %.1f ms max %.1f ms\n",
+               percentile(s.nodeDelayMs, 0.5), percentile(s.nodeDelayMs, 0.95), percentile(s.latencyMs, 0.5),
+               percentile(s.latencyMs, 0.95), percentile(s.latencyMs, 1.0), percentile(s.recoveryMs, 0.5),
+               percentile(s.recoveryMs, 1.0));
+    }
+    fflush(stdout);
+}
+
+static int runListen(uint16_t port, const char *group) {
+    struct in_addr groupAddr;
+    if (inet_pton(AF_INET, group, &groupAddr) != 1) {
+        fprintf(stderr, "bad group address %s\n", group);
+        return 1;
+    }
+    Listener listener;
+    if (!listener.begin(port, groupAddr.s_addr, false)) {
+        fprintf(stderr, "cannot bind port %u\n", port);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("listening on port %u, group %s\n", port, group);
+    uint64_t statsUs = monotonicUs();
+    while (!stopRequested) {
+        listener.poll(10);
+        listener.delivered.clear();
+        if (monotonicUs() - statsUs >= STATS_INTERVAL_MS * 1000ULL) {
+            statsUs = monotonicUs();
+            listener.printStats();
+        }
+    }
+    listener.printStats();
+    return 0;
+}
+
+// ---------------------------------------------------------------- 仿真
+
+typedef struct {
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t crossingUs;  // 相对开始时刻
+} sim_lap_t;
+
+// 发送进程和父进程用同一个种子生成相同的圈速序列，父进程据此核对
+static std::vector<sim_lap_t> makeSchedule(uint32_t node, uint32_t laps, uint32_t lapMs) {
+    std::mt19937 rng(2000 + node);
+    std::uniform_int_distribution<int32_t> jitter(-(int32_t)lapMs * 3 / 10, (int32_t)lapMs * 3 / 10);
+    std::vector<sim_lap_t> out;
+    uint64_t t = (uint64_t)lapMs * 1000;
+    for (uint32_t i = 1; i <= laps; i++) {
+        const uint32_t lapUs = (uint32_t)(lapMs + jitter(rng)) * 1000 + (rng() % 1000);
+        t += lapUs;
+        out.push_back({i, lapUs, t});
+    }
+    return out;
+}
+
+static void makeMac(uint32_t index, uint8_t *mac) {
+    const uint8_t base[6] = {0x02, 0x51, 0x59, 0x43, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[4] = (uint8_t)(index >> 8);
+    mac[5] = (uint8_t)index;
+}
+
+// 发送进程：节点时钟即CLOCK_MONOTONIC，过门时刻到了立即发出
+static int runPublisher(uint32_t index, uint16_t listenPort, uint32_t laps, uint32_t lapMs, uint8_t loss,
+                        uint64_t startUs) {
+    PosixUdpRaceTransport udp;
+    if (!udp.begin(SIM_BASE_PORT + 1 + index)) {
+        fprintf(stderr, "publisher %u: cannot bind\n", index);
+        return 1;
+    }
+    LossyTransport transport(&udp, loss, 11 * index + 5);
+    uint8_t mac[6];
+    makeMac(index, mac);
+    LapCaster caster;
+    caster.begin(&transport, mac, 0x7000 + index * 7919 + (uint32_t)(monotonicUs() & 0xFFFF));
+    const racenet_addr_t to = {htonl(INADDR_LOOPBACK), listenPort};
+    caster.setUnicast(&to);
+    caster.setMode(LAPCAST_UNICAST);
+
+    signal(SIGTERM, onSignal);
+    const std::vector<sim_lap_t> schedule = makeSchedule(index, laps, lapMs);
+    const uint64_t endUs = startUs + schedule.back().crossingUs + SIM_LINGER_MS * 1000ULL;
+    size_t next = 0;
+    while (!stopRequested && monotonicUs() < endUs) {
+        const uint64_t nowUs = monotonicUs();
+        if (next < schedule.size() && nowUs >= startUs + schedule[next].crossingUs) {
+            const sim_lap_t &lap = schedule[next];
+            caster.publish(5658 + (index % 8) * 37, lap.lapNumber, lap.lapTimeUs, startUs + lap.crossingUs,
+                           100 + index, monotonicUs());
+            next++;
+        }
+        uint8_t buf[RACENET_MAX_PACKET];
+        racenet_addr_t from;
+        uint16_t len;
+        while ((len = transport.receive(&from, buf, sizeof(buf))) > 0) caster.handlePacket(&from, buf, len, monotonicUs());
+        caster.service(monotonicUs());
+        sleepUs(100);
+    }
+    return 0;
+}
+
+static int runSim(uint32_t nodes, uint32_t laps, uint8_t loss, uint32_t lapMs) {
+    Listener listener;
+    if (!listener.begin(SIM_BASE_PORT, 0, true)) {
+        fprintf(stderr, "cannot bind port %u\n", SIM_BASE_PORT);
+        return 1;
+    }
+    listener.verbose = false;
+    const uint64_t startUs = monotonicUs() + SIM_START_DELAY_MS * 1000ULL;
+    std::vector<pid_t> children;
+    for (uint32_t i = 0; i < nodes; i++) {
+        const pid_t pid = fork();
+        if (pid == 0) _exit(runPublisher(i, SIM_BASE_PORT, laps, lapMs, loss, startUs));
+        children.push_back(pid);
+    }
+    uint32_t running = nodes;
+    while (running > 0) {
+        listener.poll(1);
+        int status;
+        while (waitpid(-1, &status, WNOHANG) > 0) running--;
+    }
+    // 发送进程退出后再等一会儿，确认没有迟到的包
+    const uint64_t drainUs = monotonicUs() + 200000;
+    while (monotonicUs() < drainUs) listener.poll(1);
+
+    // 核对：每个节点的每一圈恰好交付一次，内容与计划一致
+    uint32_t wrong = 0, missing = 0, resentDelivered = 0;
+    std::vector<double> latencyMs, directMs, estimateErrMs;
+    for (uint32_t i = 0; i < nodes; i++) {
+        uint8_t mac[6];
+        makeMac(i, mac);
+        const uint32_t node = lapcastNodeId(mac);
+        const std::vector<sim_lap_t> schedule = makeSchedule(i, laps, lapMs);
+        std::vector<uint32_t> count(laps + 1, 0);
+        for (const delivered_t &d : listener.delivered) {
+            if (d.node != node) continue;
+            if (d.seq == 0 || d.seq > laps) {
+                wrong++;
+                continue;
+            }
+            const sim_lap_t &lap = schedule[d.seq - 1];
+            count[d.seq]++;
+            if (d.lap.lapNumber != lap.lapNumber || d.lap.lapMs != (lap.lapTimeUs + 500) / 1000 ||
+                d.lap.timeUs != startUs + lap.crossingUs)
+                wrong++;
+            const double ms = (d.arriveUs - d.lap.timeUs) / 1000.0;
+            latencyMs.push_back(ms);
+            if (d.lap.flags & LAPCAST_FLAG_RESENT)
+                resentDelivered++;
+            else
+                directMs.push_back(ms);
+        }
+        for (uint32_t seq = 1; seq <= laps; seq++) {
+            if (count[seq] == 0) missing++;
+            if (count[seq] > 1) wrong++;
+        }
+    }
+    uint32_t lost = 0, recovered = 0, nacks = 0;
+    std::vector<double> estimateMs, recoveryMs;
+    for (const stream_t &s : listener.streams) {
+        lost += s.lost;
+        recovered += s.recovered;
+        nacks += s.nacksSent;
+        estimateMs.insert(estimateMs.end(), s.latencyMs.begin(), s.latencyMs.end());
+        recoveryMs.insert(recoveryMs.end(), s.recoveryMs.begin(), s.recoveryMs.end());
+    }
+
+    printf("lapcast: %u nodes, %u laps each, %u%% loss on every packet sent\n", nodes, laps, loss);
+    printf("delivered %u of %u laps, %u recovered by %u nacks (%u resent copies used), %u lost, %u wrong or duplicate\n",
+           (uint32_t)listener.delivered.size(), nodes * laps, recovered, nacks, resentDelivered, lost, wrong);
+    printf("e2e latency: first try p50 %.3f ms p99 %.3f ms max %.3f ms; all p50 %.3f ms p99 %.3f ms max %.3f ms\n",
+           percentile(directMs, 0.5), percentile(directMs, 0.99), percentile(directMs, 1.0), percentile(latencyMs, 0.5),
+           percentile(latencyMs, 0.99), percentile(latencyMs, 1.0));
+    printf("recovery after gap detected: p50 %.1f ms max %.1f ms; listen-mode estimate p50 %.3f ms\n",
+           percentile(recoveryMs, 0.5), percentile(recoveryMs, 1.0), percentile(estimateMs, 0.5));
+    for (pid_t pid : children) kill(pid, SIGTERM);
+    return wrong == 0 && missing == 0 ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "listen") == 0) {
+        return runListen(argc > 2 ? atoi(argv[2]) : LAPCAST_PORT, argc > 3 ? argv[3] : "239.255.73.71");
+    }
+    if (argc >= 2 && strcmp(argv[1], "sim") == 0) {
+        const uint32_t nodes = argc > 2 ? atoi(argv[2]) : 4;
+        const uint32_t laps = argc > 3 ? atoi(argv[3]) : 50;
+        const uint8_t loss = argc > 4 ? atoi(argv[4]) : 10;
+        const uint32_t lapMs = argc > 5 ? atoi(argv[5]) : 300;
+        if (nodes == 0 || laps == 0 || loss >= 100 || lapMs < 50) {
+            fprintf(stderr, "bad arguments\n");
+            return 1;
+        }
+        return runSim(nodes, laps, loss, lapMs);
+    }
+    fprintf(stderr,
+            "usage:\n"
+            "  %s listen [port=%u] [group=239.255.73.71]\n"
+            "  %s sim [nodes=4] [laps=50] [loss%%=10] [lapMs=300]\n",
+            argv[0], LAPCAST_PORT, argv[0]);
+    return 1;
+}
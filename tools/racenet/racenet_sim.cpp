@@ -0,0 +1,887 @@
+/*
+ * 多节点圈速汇总的主机端工具：模拟节点、常驻汇总方，以及本机多进程仿真。
+ *
+ * 编译：
+ *   g++ -O2 -std=c++17 -Ilib/RACENET -Ilib/CRC -Ilib/QUEUE tools/racenet/racenet_sim.cpp \
+ *       lib/RACENET/racenet.cpp lib/RACENET/clocksync.cpp lib/RACENET/sectors.cpp lib/RACENET/racenet_posix.cpp \
+ *       lib/RACENET/racenet_loopback.cpp lib/CRC/crc.cpp -o racenet_sim
+ * 运行：
+ *   ./racenet_sim sim [节点数=8] [圈数=10] [丢包率%=10] [平均圈时ms=800]
+ *       fork出N个节点进程（127.0.0.1上的不同端口，时钟各带偏移和几十ppm的漂移），父进程做汇总方和时钟主站，
+ *       结束后核对是否每圈都收到且只收到一次、合并顺序与真实过门顺序是否一致，并报告时刻误差和送达延迟
+ *   ./racenet_sim espnow [节点数=8] [圈数=30] [丢帧率%=20] [平均圈时ms=800]
+ *       ESP-NOW场景：节点和汇总方在同一进程内经回环总线按MAC收发，虚拟时间推进；汇总方只靠广播发现节点，
+ *       核对项与sim相同，另外报告空中丢帧数和靠续订补发的事件数。节点被发现前的事件只留在历史中，
+ *       圈数超过RACENET_HISTORY - 1时，迟迟没被发现的节点最早的圈会补不回来
+ *   ./racenet_sim sync [节点数=4] [秒数=30] [丢包率%=10] [发送抖动us=0]
+ *       只测时钟同步：各节点每250 ms把自己换算出的主站时刻与真实时刻比较，
+ *       报告误差分位数、报告的误差上界是否覆盖实际误差、估计的漂移与设定值之差；发送抖动模拟WiFi排队造成的不对称延迟
+ *   ./racenet_sim sectors [门数=4] [频率数=4] [圈数=20] [异常率%=5]
+ *       只测分段协调器（按仿真时间投递，不经过网络）：注入漏检、重发、迟到和误检，
+ *       核对每个OK段和OK整圈的用时与真实值一致，完好的圈全部判为OK、有缺段的圈都被拒绝
+ *   ./racenet_sim node <端口> <名称> [圈数=10] [平均圈时ms=800]
+ *       单个模拟节点，可与设备或其他主机上的汇总方联调
+ *   ./racenet_sim aggregate [ip:端口 ...]
+ *       常驻汇总方，绑定RACENET_PORT，广播发现本网段节点并实时打印合并后的圈速
+ */
+#include <arpa/inet.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "racenet.h"
+#include "sectors.h"
+
+#define SIM_BASE_PORT 17370
+#define SIM_START_DELAY_MS 1500  // 等所有节点被发现、订阅后再开始计圈
+#define SIM_DETECT_DELAY_MS 40   // 过门到事件发出的延迟（计时核确认峰值 + 事件分发）
+#define SIM_LINGER_MS 5000       // 最后一圈后节点继续运行的时间，留给重发
+#define SIM_SYNC_POLL_US 50      // 同步测试的轮询间隔，包在套接字里等待的时间直接计入测量误差
+#define SIM_ESPNOW_START_MS 6000  // ESP-NOW仿真没有预先登记的节点，多等一个发现周期
+#define SIM_ESPNOW_TICK_US 500    // ESP-NOW仿真的步长，即每个帧在空中和队列中的延迟
+#define SIM_ESPNOW_LINGER_MS 30000  // 虚拟时间不花真实时间，丢帧严重时留够几个发现周期
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleepUs(uint32_t us) {
+    struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+// 按丢包率随机丢弃发出的包，模拟WiFi丢包；jitterUs非0时每个包发出前随机等待，模拟排队
+class LossyTransport : public RaceTransport {
+   public:
+    LossyTransport(RaceTransport *t, uint8_t percent, uint32_t seed, uint32_t jitter = 0)
+        : inner(t), lossPercent(percent), jitterUs(jitter), rng(seed) {}
+    bool begin(uint16_t port) override { return inner->begin(port); }
+    bool send(const racenet_addr_t *to, const uint8_t *buf, uint16_t len) override {
+        if (drop()) return true;
+        if (jitterUs > 0) sleepUs(rng() % jitterUs);
+        return inner->send(to, buf, len);
+    }
+    bool broadcast(uint16_t port, const uint8_t *buf, uint16_t len) override {
+        if (drop()) return true;
+        return inner->broadcast(port, buf, len);
+    }
+    uint16_t receive(racenet_addr_t *from, uint8_t *buf, uint16_t size) override {
+        return inner->receive(from, buf, size);
+    }
+    uint32_t getDropped() { return dropped; }
+
+   private:
+    RaceTransport *inner;
+    uint8_t lossPercent;
+    uint32_t jitterUs;
+    std::mt19937 rng;
+    uint32_t dropped = 0;
+
+    bool drop() {
+        if (lossPercent == 0 || rng() % 100 >= lossPercent) return false;
+        dropped++;
+        return true;
+    }
+};
+
+// 模拟节点的晶振：节点时钟 = 真实时刻 + offsetUs + (真实时刻 - baseUs) * driftPpm / 1e6
+typedef struct {
+    int64_t offsetUs;
+    double driftPpm;
+    uint64_t baseUs;
+} sim_clock_t;
+
+static uint64_t simClock(const sim_clock_t *clock, uint64_t realUs) {
+    return realUs + clock->offsetUs + (int64_t)llround(((double)realUs - (double)clock->baseUs) * clock->driftPpm / 1e6);
+}
+
+// 各节点时钟相差数秒、漂移在±40 ppm之间，验证同步同时跟上偏差和漂移
+static sim_clock_t makeClock(uint32_t index, uint64_t baseUs) {
+    sim_clock_t clock;
+    clock.offsetUs = (int64_t)(index * 7 + 3) * 1234567 - 20000000;
+    clock.driftPpm = ((int32_t)(index * 5 % 9) - 4) * 10.0 + 0.7;
+    clock.baseUs = baseUs;
+    return clock;
+}
+
+typedef struct {
+    uint32_t lapNumber;
+    uint32_t lapTimeUs;
+    uint64_t crossingUs;  // 相对开始时刻
+} sim_lap_t;
+
+// 节点和父进程用同一个种子生成相同的圈速序列，父进程据此核对
+static std::vector<sim_lap_t> makeSchedule(uint32_t node, uint32_t laps, uint32_t lapMs) {
+    std::mt19937 rng(1000 + node);
+    std::uniform_int_distribution<int32_t> jitter(-(int32_t)lapMs * 3 / 10, (int32_t)lapMs * 3 / 10);
+    std::vector<sim_lap_t> out;
+    uint64_t t = (uint64_t)(lapMs / 2 + jitter(rng) + (int32_t)lapMs / 2) * 1000;  // 第一次过门
+    for (uint32_t i = 0; i < laps; i++) {
+        const uint32_t lapUs = (uint32_t)(lapMs + jitter(rng)) * 1000 + (rng() % 1000);
+        t += lapUs;
+        out.push_back({i, lapUs, t});
+    }
+    return out;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static void makeMac(uint32_t index, uint8_t *mac) {
+    const uint8_t base[6] = {0x02, 0x51, 0x59, 0x00, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[4] = (uint8_t)(index >> 8);
+    mac[5] = (uint8_t)index;
+}
+
+// 每个包取到后立即读时钟，SYNC回复的t4不能用进入循环时的时刻
+static void pollNode(RaceTransport *transport, RaceNode *node, const sim_clock_t *clock) {
+    uint8_t buf[RACENET_MAX_PACKET];
+    racenet_addr_t from;
+    uint16_t len;
+    while ((len = transport->receive(&from, buf, sizeof(buf))) > 0) {
+        node->handlePacket(&from, buf, len, simClock(clock, monotonicUs()));
+    }
+    node->service(simClock(clock, monotonicUs()));
+}
+
+static volatile bool stopRequested = false;
+
+static void onSignal(int) {
+    stopRequested = true;
+}
+
+// 模拟节点：startUs为共同的起始时刻（CLOCK_MONOTONIC），节点时钟由clock换算
+static int runNode(uint16_t port, uint32_t index, const char *name, uint32_t laps, uint32_t lapMs, uint8_t loss,
+                   uint64_t startUs, const sim_clock_t *clock) {
+    PosixUdpRaceTransport udp;
+    if (!udp.begin(port)) {
+        fprintf(stderr, "%s: cannot bind port %u\n", name, port);
+        return 1;
+    }
+    LossyTransport transport(&udp, loss, 7 * index + 1);
+    uint8_t mac[6];
+    makeMac(index, mac);
+    RaceNode node;
+    node.begin(&transport, mac, 0x5000 + index * 7919 + (uint32_t)(monotonicUs() & 0xFFFF));
+    racenet_node_info_t *info = node.getInfo();
+    snprintf(info->host, sizeof(info->host), "%s", name);
+    snprintf(info->product, sizeof(info->product), "QiYun-Sim");
+    snprintf(info->pilot, sizeof(info->pilot), "pilot%u", index);
+    info->frequency = 5658 + (index % 8) * 37;
+
+    signal(SIGTERM, onSignal);
+    signal(SIGINT, onSignal);
+    const std::vector<sim_lap_t> schedule = makeSchedule(index, laps, lapMs);
+    size_t next = 0;
+    bool started = false;
+    const uint64_t endUs = startUs + (schedule.empty() ? 0 : schedule.back().crossingUs) +
+                           (SIM_DETECT_DELAY_MS + SIM_LINGER_MS) * 1000ULL;
+    while (!stopRequested) {
+        const uint64_t realUs = monotonicUs();
+        const uint64_t nodeUs = simClock(clock, realUs);
+        if (!started && realUs >= startUs) {
+            started = true;
+            info->running = true;
+            node.pushEvent(RACENET_EVENT_START, 0, info->frequency, 0, 0, simClock(clock, startUs), nodeUs);
+        }
+        if (next < schedule.size() && realUs >= startUs + schedule[next].crossingUs + SIM_DETECT_DELAY_MS * 1000) {
+            const sim_lap_t &lap = schedule[next];
+            node.pushEvent(RACENET_EVENT_LAP, 0, info->frequency, lap.lapNumber, lap.lapTimeUs,
+                           simClock(clock, startUs + lap.crossingUs), nodeUs);
+            next++;
+        }
+        pollNode(&transport, &node, clock);
+        if (laps > 0 && realUs > endUs) break;
+        sleepUs(200);
+    }
+    ClockSync *sync = node.getClock();
+    fprintf(stderr, "%s: %u events, sent %u, resent %u, dropped %u, drift %.2f ppm (true %.2f)\n", name,
+            node.getLastSeq(), node.getSent(), node.getResent(), transport.getDropped(), sync->getDriftPpm(),
+            clock->driftPpm);
+    return 0;
+}
+
+// 只做时钟同步的节点：主站时钟即父进程的CLOCK_MONOTONIC，可以直接算出换算误差
+static int runSyncNode(uint16_t port, uint32_t index, uint32_t seconds, uint8_t loss, uint32_t jitterUs,
+                       const sim_clock_t *clock) {
+    PosixUdpRaceTransport udp;
+    if (!udp.begin(port)) {
+        fprintf(stderr, "node%u: cannot bind port %u\n", index, port);
+        return 1;
+    }
+    LossyTransport transport(&udp, loss, 7 * index + 1, jitterUs);
+    uint8_t mac[6];
+    makeMac(index, mac);
+    RaceNode node;
+    node.begin(&transport, mac, 0x5000 + index);
+    snprintf(node.getInfo()->host, sizeof(node.getInfo()->host), "node%u", index);
+
+    signal(SIGTERM, onSignal);
+    const uint64_t beginUs = monotonicUs();
+    const uint64_t endUs = beginUs + (uint64_t)seconds * 1000000;
+    uint64_t syncedAtUs = 0;
+    uint64_t checkUs = 0;
+    std::vector<double> errorUs;
+    std::vector<double> boundUs;
+    uint32_t outside = 0;
+    while (!stopRequested && monotonicUs() < endUs) {
+        pollNode(&transport, &node, clock);
+        const uint64_t realUs = monotonicUs();
+        const uint64_t nodeUs = simClock(clock, realUs);
+        uint64_t sharedUs;
+        uint32_t uncertaintyUs;
+        if (realUs - checkUs >= 250000 && node.toShared(nodeUs, nodeUs, &sharedUs, &uncertaintyUs)) {
+            checkUs = realUs;
+            if (syncedAtUs == 0) syncedAtUs = realUs;
+            const double err = (double)(int64_t)(sharedUs - realUs);
+            errorUs.push_back(fabs(err));
+            boundUs.push_back(uncertaintyUs);
+            if (fabs(err) > uncertaintyUs) outside++;
+        }
+        sleepUs(SIM_SYNC_POLL_US);
+    }
+    if (syncedAtUs == 0) {
+        printf("node%u: never synced\n", index);
+        return 2;
+    }
+    ClockSync *sync = node.getClock();
+    const double covered = 100.0 * (errorUs.size() - outside) / errorUs.size();
+    printf("node%u: synced after %.2f s, |error| us p50 %.0f p99 %.0f max %.0f, bound p50 %.0f, covered %.1f%%, "
+           "drift %.2f ppm (true %.2f), min rtt %u us, dropped %u\n",
+           index, (syncedAtUs - beginUs) / 1e6, percentile(errorUs, 0.5), percentile(errorUs, 0.99),
+           percentile(errorUs, 1), percentile(boundUs, 0.5), covered, sync->getDriftPpm(), clock->driftPpm,
+           sync->getMinDelayUs(), transport.getDropped());
+    fflush(stdout);
+    return covered >= 95.0 ? 0 : 2;
+}
+
+static uint32_t pollAggregator(RaceTransport *transport, RaceAggregator *aggregator) {
+    uint8_t buf[RACENET_MAX_PACKET];
+    racenet_addr_t from;
+    uint16_t len;
+    uint32_t packets = 0;
+    while ((len = transport->receive(&from, buf, sizeof(buf))) > 0) {
+        aggregator->handlePacket(&from, buf, len, monotonicUs());
+        packets++;
+    }
+    aggregator->service(monotonicUs());
+    return packets;
+}
+
+static bool parseAddr(const char *s, racenet_addr_t *addr) {
+    char ip[32];
+    unsigned port;
+    if (sscanf(s, "%31[^:]:%u", ip, &port) != 2) return false;
+    struct in_addr in;
+    if (inet_pton(AF_INET, ip, &in) != 1) return false;
+    addr->ip = in.s_addr;
+    addr->port = (uint16_t)port;
+    return true;
+}
+
+static int runAggregate(int argc, char **argv) {
+    PosixUdpRaceTransport transport;
+    if (!transport.begin(RACENET_PORT)) {
+        fprintf(stderr, "cannot bind port %u\n", RACENET_PORT);
+        return 1;
+    }
+    const uint8_t mac[6] = {0x02, 0x51, 0x59, 0xFF, 0xFF, 0xFF};
+    RaceAggregator aggregator;
+    aggregator.begin(&transport, mac, (uint32_t)monotonicUs());
+    aggregator.setClock(monotonicUs);
+    aggregator.setAlwaysActive(true);
+    for (int i = 0; i < argc; i++) {
+        racenet_addr_t addr;
+        if (!parseAddr(argv[i], &addr)) {
+            fprintf(stderr, "bad address %s\n", argv[i]);
+            return 1;
+        }
+        aggregator.addPeer(&addr, monotonicUs());
+    }
+    signal(SIGINT, onSignal);
+    uint8_t peersShown = 0;
+    uint16_t lapsShown = 0;
+    while (!stopRequested) {
+        pollAggregator(&transport, &aggregator);
+        for (; peersShown < aggregator.getPeerCount(); peersShown++) {
+            const racenet_peer_t *peer = aggregator.getPeer(peersShown);
+            char ip[16], macStr[18];
+            racenetFormatIp(peer->addr.ip, ip, sizeof(ip));
+            racenetFormatMac(peer->mac, macStr, sizeof(macStr));
+            printf("node %s %s (%s:%u) %s %u MHz %s\n", peer->product, peer->host, ip, peer->addr.port, macStr,
+                   peer->frequency, peer->pilot);
+        }
+        // 晚到的圈会插到中间，这里只打印新追加在末尾的，足够观察
+        for (; lapsShown < aggregator.getLapCount(); lapsShown++) {
+            const racenet_lap_t *lap = aggregator.getLap(lapsShown);
+            const racenet_peer_t *peer = aggregator.getPeer(lap->peer);
+            char bound[16] = "unsynced";
+            if (lap->uncertaintyUs != RACENET_UNSYNCED) snprintf(bound, sizeof(bound), "+-%u us", lap->uncertaintyUs);
+            printf("%10.3f  %-16s %-20s lap %3u  %8.3f s  %s\n", lap->timeUs / 1e6, peer->host, peer->pilot,
+                   lap->lapNumber, lap->lapTimeUs / 1e6, bound);
+        }
+        fflush(stdout);
+        sleepUs(1000);
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t truthUs;   // 真实过门时刻（父进程时钟）
+    uint64_t pushUs;    // 节点发出事件的时刻
+    uint64_t arriveUs;  // 首次出现在汇总结果中的时刻
+    bool seen;
+} sim_expect_t;
+
+// 期望结果：按节点序号和圈号索引，返回最后一次过门的时刻
+static uint64_t makeExpected(std::vector<std::vector<sim_expect_t>> *expect, uint32_t laps, uint32_t lapMs,
+                             uint64_t startUs) {
+    uint64_t lastCrossingUs = 0;
+    for (uint32_t i = 0; i < expect->size(); i++) {
+        for (const sim_lap_t &lap : makeSchedule(i, laps, lapMs)) {
+            (*expect)[i].push_back({startUs + lap.crossingUs, startUs + lap.crossingUs + SIM_DETECT_DELAY_MS * 1000ULL,
+                                    0, false});
+            lastCrossingUs = std::max(lastCrossingUs, startUs + lap.crossingUs);
+        }
+    }
+    return lastCrossingUs;
+}
+
+// 每次有新圈时整表扫一遍，标记首次出现的时刻；返回汇总结果中可识别的圈数
+static uint32_t markArrivals(RaceAggregator *aggregator, std::vector<std::vector<sim_expect_t>> *expect,
+                             uint32_t laps, uint64_t nowUs, uint32_t *unknown) {
+    uint32_t received = 0;
+    for (uint16_t k = 0; k < aggregator->getLapCount(); k++) {
+        const racenet_lap_t *lap = aggregator->getLap(k);
+        const racenet_peer_t *peer = aggregator->getPeer(lap->peer);
+        uint32_t idx;
+        if (sscanf(peer->host, "node%u", &idx) != 1 || idx >= expect->size() || lap->lapNumber >= laps) {
+            (*unknown)++;
+            continue;
+        }
+        sim_expect_t &e = (*expect)[idx][lap->lapNumber];
+        if (!e.seen) {
+            e.seen = true;
+            e.arriveUs = nowUs;
+        }
+        received++;
+    }
+    return received;
+}
+
+// 核对：缺圈、重复、顺序和时刻误差；dropped为汇总方一侧丢掉的包
+static int reportRace(RaceAggregator *aggregator, const std::vector<std::vector<sim_expect_t>> &expect, uint32_t laps,
+                      uint32_t received, uint32_t unknown, uint8_t loss, uint32_t dropped) {
+    const uint32_t nodes = expect.size();
+    uint32_t missing = 0;
+    std::vector<double> latencyMs;
+    for (uint32_t i = 0; i < nodes; i++) {
+        for (const sim_expect_t &e : expect[i]) {
+            if (!e.seen) {
+                missing++;
+                continue;
+            }
+            latencyMs.push_back((e.arriveUs - e.pushUs) / 1000.0);
+        }
+    }
+    std::vector<double> errorMs;
+    std::vector<double> boundMs;
+    uint32_t synced = 0;
+    uint32_t outside = 0;
+    uint32_t inversions = 0;
+    uint32_t duplicates = 0;
+    uint64_t prevTruth = 0;
+    std::vector<std::vector<bool>> listed(nodes, std::vector<bool>(laps, false));
+    for (uint16_t k = 0; k < aggregator->getLapCount(); k++) {
+        const racenet_lap_t *lap = aggregator->getLap(k);
+        uint32_t idx;
+        if (sscanf(aggregator->getPeer(lap->peer)->host, "node%u", &idx) != 1 || idx >= nodes ||
+            lap->lapNumber >= laps)
+            continue;
+        if (listed[idx][lap->lapNumber]) duplicates++;
+        listed[idx][lap->lapNumber] = true;
+        const uint64_t truth = expect[idx][lap->lapNumber].truthUs;
+        if (truth < prevTruth) inversions++;
+        prevTruth = truth;
+        const double err = ((double)lap->timeUs - (double)truth) / 1000.0;
+        errorMs.push_back(err);
+        if (lap->uncertaintyUs != RACENET_UNSYNCED) {
+            synced++;
+            boundMs.push_back(lap->uncertaintyUs / 1000.0);
+            if (fabs(err) * 1000 > lap->uncertaintyUs) outside++;
+        }
+    }
+    uint32_t lost = 0;
+    uint32_t dupPackets = 0;
+    for (uint8_t i = 0; i < aggregator->getPeerCount(); i++) {
+        lost += aggregator->getPeer(i)->lost;
+        dupPackets += aggregator->getPeer(i)->duplicates;
+    }
+
+    printf("nodes %u, laps %u/%u, missing %u, duplicates %u, order inversions %u, unknown %u\n",
+           aggregator->getPeerCount(), received, nodes * laps, missing, duplicates, inversions, unknown);
+    printf("loss %u%%: %u packets dropped, %u duplicate events filtered, %u declared lost\n", loss,
+           dropped, dupPackets, lost);
+    printf("crossing time error ms: p50 %.3f, max %.3f\n", percentile(errorMs, 0.5),
+           errorMs.empty() ? 0 : std::max(fabs(percentile(errorMs, 0)), fabs(percentile(errorMs, 1))));
+    printf("clock sync: %u/%u laps on the shared timebase, reported bound ms p50 %.3f max %.3f, %u outside bound\n",
+           synced, (uint32_t)errorMs.size(), percentile(boundMs, 0.5), percentile(boundMs, 1), outside);
+    printf("delivery latency ms: p50 %.2f, p99 %.2f, max %.2f\n", percentile(latencyMs, 0.5),
+           percentile(latencyMs, 0.99), percentile(latencyMs, 1));
+    return missing == 0 && duplicates == 0 && unknown == 0 ? 0 : 2;
+}
+
+static int runSim(uint32_t nodes, uint32_t laps, uint8_t loss, uint32_t lapMs) {
+    if (nodes == 0 || nodes > RACENET_MAX_PEERS) {
+        fprintf(stderr, "node count must be 1 - %u\n", RACENET_MAX_PEERS);
+        return 1;
+    }
+    PosixUdpRaceTransport udp;
+    if (!udp.begin(SIM_BASE_PORT)) {
+        fprintf(stderr, "cannot bind port %u\n", SIM_BASE_PORT);
+        return 1;
+    }
+    LossyTransport transport(&udp, loss, 99);
+    const uint64_t startUs = monotonicUs() + SIM_START_DELAY_MS * 1000ULL;
+    std::vector<pid_t> children;
+    for (uint32_t i = 0; i < nodes; i++) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            char name[16];
+            snprintf(name, sizeof(name), "node%u", i);
+            const sim_clock_t clock = makeClock(i, startUs);
+            _exit(runNode(SIM_BASE_PORT + 1 + i, i, name, laps, lapMs, loss, startUs, &clock));
+        }
+        children.push_back(pid);
+    }
+
+    const uint8_t mac[6] = {0x02, 0x51, 0x59, 0xFF, 0xFF, 0xFE};
+    RaceAggregator aggregator;
+    aggregator.begin(&transport, mac, 1);
+    aggregator.setClock(monotonicUs);
+    aggregator.setAlwaysActive(true);
+    const uint32_t loopback = htonl(INADDR_LOOPBACK);
+    for (uint32_t i = 0; i < nodes; i++) {
+        racenet_addr_t addr = {loopback, (uint16_t)(SIM_BASE_PORT + 1 + i)};
+        aggregator.addPeer(&addr, monotonicUs());
+    }
+
+    std::vector<std::vector<sim_expect_t>> expect(nodes);
+    const uint64_t lastCrossingUs = makeExpected(&expect, laps, lapMs, startUs);
+    const uint64_t deadlineUs = lastCrossingUs + (SIM_DETECT_DELAY_MS + SIM_LINGER_MS) * 1000ULL;
+    const uint32_t total = nodes * laps;
+    uint32_t received = 0;
+    uint32_t packets = 0;
+    uint16_t lapsChecked = 0;
+    uint32_t unknown = 0;
+    uint64_t firstPacketUs = 0;
+    uint64_t lastPacketUs = 0;
+    while (monotonicUs() < deadlineUs && received < total) {
+        const uint64_t nowUs = monotonicUs();
+        const uint32_t n = pollAggregator(&transport, &aggregator);
+        if (n > 0) {
+            if (firstPacketUs == 0) firstPacketUs = nowUs;
+            lastPacketUs = nowUs;
+            packets += n;
+        }
+        if (aggregator.getLapCount() != lapsChecked) {
+            lapsChecked = aggregator.getLapCount();
+            received = markArrivals(&aggregator, &expect, laps, nowUs, &unknown);
+        }
+        sleepUs(200);
+    }
+    for (pid_t pid : children) kill(pid, SIGTERM);
+    for (pid_t pid : children) waitpid(pid, NULL, 0);
+
+    const double spanS = lastPacketUs > firstPacketUs ? (lastPacketUs - firstPacketUs) / 1e6 : 1;
+    const int result = reportRace(&aggregator, expect, laps, received, unknown, loss, transport.getDropped());
+    printf("fan-in %u packets in %.1f s (%.0f packets/s), late inserts %u\n", packets, spanS, packets / spanS,
+           aggregator.getOrderFixes());
+    return result;
+}
+
+// ESP-NOW仿真的虚拟时钟：汇总方的setClock()只接受函数指针
+static uint64_t virtualNowUs = 0;
+
+static uint64_t virtualUs() {
+    return virtualNowUs;
+}
+
+// ESP-NOW场景：节点和汇总方都在本进程内，经RaceLoopbackBus按MAC收发，按虚拟时间推进，几秒跑完。
+// 汇总方不预先知道任何节点，靠广播DISCOVER发现，与设备上没有mDNS时相同；总线按丢帧率随机丢弃单播和广播
+static int runEspNowSim(uint32_t nodes, uint32_t laps, uint8_t loss, uint32_t lapMs) {
+    if (nodes == 0 || nodes > RACENET_MAX_PEERS || nodes >= RACENET_LOOPBACK_ENDPOINTS) {
+        fprintf(stderr, "node count must be 1 - %u\n", RACENET_MAX_PEERS);
+        return 1;
+    }
+    if (nodes * laps > RACENET_MAX_LAPS) {
+        fprintf(stderr, "nodes * laps must not exceed %u (aggregator lap table)\n", RACENET_MAX_LAPS);
+        return 1;
+    }
+    RaceLoopbackBus bus;
+    bus.setLoss(loss, 99);
+    const uint8_t baseMac[6] = {0x02, 0x51, 0x59, 0xFF, 0xFF, 0xFD};
+    LoopbackRaceTransport baseLink(&bus, baseMac);
+    baseLink.begin(RACENET_PORT);
+    RaceAggregator aggregator;
+    aggregator.begin(&baseLink, baseMac, 1);
+    aggregator.setClock(virtualUs);
+    aggregator.setAlwaysActive(true);
+
+    const uint64_t startUs = SIM_ESPNOW_START_MS * 1000ULL;
+    std::vector<LoopbackRaceTransport *> links;
+    std::vector<RaceNode *> raceNodes;
+    std::vector<sim_clock_t> clocks;
+    std::vector<std::vector<sim_lap_t>> schedules;
+    for (uint32_t i = 0; i < nodes; i++) {
+        uint8_t mac[6];
+        makeMac(i, mac);
+        links.push_back(new LoopbackRaceTransport(&bus, mac));
+        links.back()->begin(RACENET_PORT);
+        RaceNode *node = new RaceNode();
+        node->begin(links.back(), mac, 0x5000 + i);
+        racenet_node_info_t *info = node->getInfo();
+        snprintf(info->host, sizeof(info->host), "node%u", i);
+        snprintf(info->product, sizeof(info->product), "QiYun-Sim");
+        snprintf(info->pilot, sizeof(info->pilot), "pilot%u", i);
+        info->frequency = 5658 + (i % 8) * 37;
+        raceNodes.push_back(node);
+        clocks.push_back(makeClock(i, 0));
+        schedules.push_back(makeSchedule(i, laps, lapMs));
+    }
+    std::vector<std::vector<sim_expect_t>> expect(nodes);
+    const uint64_t lastCrossingUs = makeExpected(&expect, laps, lapMs, startUs);
+    const uint64_t deadlineUs = lastCrossingUs + (SIM_DETECT_DELAY_MS + SIM_ESPNOW_LINGER_MS) * 1000ULL;
+
+    std::vector<size_t> next(nodes, 0);
+    std::vector<bool> started(nodes, false);
+    const uint32_t total = nodes * laps;
+    uint32_t received = 0;
+    uint32_t unknown = 0;
+    uint16_t lapsChecked = 0;
+    uint8_t buf[RACENET_MAX_PACKET];
+    racenet_addr_t from;
+    uint16_t len;
+    for (virtualNowUs = 0; virtualNowUs < deadlineUs && received < total; virtualNowUs += SIM_ESPNOW_TICK_US) {
+        for (uint32_t i = 0; i < nodes; i++) {
+            RaceNode *node = raceNodes[i];
+            const sim_clock_t *clock = &clocks[i];
+            const uint64_t nodeUs = simClock(clock, virtualNowUs);
+            const uint16_t freq = node->getInfo()->frequency;
+            if (!started[i] && virtualNowUs >= startUs) {
+                started[i] = true;
+                node->getInfo()->running = true;
+                node->pushEvent(RACENET_EVENT_START, 0, freq, 0, 0, simClock(clock, startUs), nodeUs);
+            }
+            const std::vector<sim_lap_t> &schedule = schedules[i];
+            if (next[i] < schedule.size() &&
+                virtualNowUs >= startUs + schedule[next[i]].crossingUs + SIM_DETECT_DELAY_MS * 1000) {
+                const sim_lap_t &lap = schedule[next[i]];
+                node->pushEvent(RACENET_EVENT_LAP, 0, freq, lap.lapNumber, lap.lapTimeUs,
+                                simClock(clock, startUs + lap.crossingUs), nodeUs);
+                next[i]++;
+            }
+            while ((len = links[i]->receive(&from, buf, sizeof(buf))) > 0) node->handlePacket(&from, buf, len, nodeUs);
+            node->service(nodeUs);
+        }
+        while ((len = baseLink.receive(&from, buf, sizeof(buf))) > 0) {
+            aggregator.handlePacket(&from, buf, len, virtualNowUs);
+        }
+        aggregator.service(virtualNowUs);
+        if (aggregator.getLapCount() != lapsChecked) {
+            lapsChecked = aggregator.getLapCount();
+            received = markArrivals(&aggregator, &expect, laps, virtualNowUs, &unknown);
+        }
+    }
+
+    uint32_t sent = 0, resent = 0, queueDrops = baseLink.getDropped();
+    for (uint32_t i = 0; i < nodes; i++) {
+        sent += raceNodes[i]->getSent();
+        resent += raceNodes[i]->getResent();
+        queueDrops += links[i]->getDropped();
+    }
+    const int result = reportRace(&aggregator, expect, laps, received, unknown, loss, bus.getDropped());
+    printf("espnow: %u frames delivered, %u dropped on air, %u dropped by full queues; nodes sent %u events, "
+           "resent %u after renewals\n",
+           bus.getDelivered(), bus.getDropped(), queueDrops, sent, resent);
+    for (uint32_t i = 0; i < nodes; i++) {
+        delete raceNodes[i];
+        delete links[i];
+    }
+    return result;
+}
+
+static int runSyncSim(uint32_t nodes, uint32_t seconds, uint8_t loss, uint32_t jitterUs) {
+    if (nodes == 0 || nodes > RACENET_MAX_PEERS) {
+        fprintf(stderr, "node count must be 1 - %u\n", RACENET_MAX_PEERS);
+        return 1;
+    }
+    PosixUdpRaceTransport udp;
+    if (!udp.begin(SIM_BASE_PORT)) {
+        fprintf(stderr, "cannot bind port %u\n", SIM_BASE_PORT);
+        return 1;
+    }
+    LossyTransport transport(&udp, loss, 99, jitterUs);
+    const uint64_t baseUs = monotonicUs();
+    std::vector<pid_t> children;
+    fflush(stdout);
+    for (uint32_t i = 0; i < nodes; i++) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            const sim_clock_t clock = makeClock(i, baseUs);
+            _exit(runSyncNode(SIM_BASE_PORT + 1 + i, i, seconds, loss, jitterUs, &clock));
+        }
+        children.push_back(pid);
+    }
+
+    const uint8_t mac[6] = {0x02, 0x51, 0x59, 0xFF, 0xFF, 0xFE};
+    RaceAggregator aggregator;
+    aggregator.begin(&transport, mac, 1);
+    aggregator.setClock(monotonicUs);
+    aggregator.setAlwaysActive(true);
+    const uint32_t loopback = htonl(INADDR_LOOPBACK);
+    for (uint32_t i = 0; i < nodes; i++) {
+        racenet_addr_t addr = {loopback, (uint16_t)(SIM_BASE_PORT + 1 + i)};
+        aggregator.addPeer(&addr, monotonicUs());
+    }
+    uint32_t running = nodes;
+    uint32_t failed = 0;
+    while (running > 0) {
+        pollAggregator(&transport, &aggregator);
+        int status;
+        while (running > 0 && waitpid(-1, &status, WNOHANG) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        }
+        sleepUs(SIM_SYNC_POLL_US);
+    }
+    printf("sync: %u nodes, %u sync replies, %u failed (error outside reported bound more than 5%% of the time)\n",
+           nodes, aggregator.getSyncReplies(), failed);
+    return failed == 0 ? 0 : 2;
+}
+
+// 分段计时仿真中的一次过门：kind为注入的异常
+typedef enum { SIM_PASS_NORMAL, SIM_PASS_MISSED, SIM_PASS_RESENT, SIM_PASS_LATE, SIM_PASS_REPEAT } sim_pass_e;
+
+typedef struct {
+    uint32_t pilot;
+    uint8_t gate;
+    uint32_t lap;        // 门0过门时为新一圈的序号，从1开始
+    uint64_t truthUs;    // 过门时刻（汇总方时钟）
+    uint64_t arriveUs;   // 到达协调器的时刻
+    uint8_t kind;
+} sim_pass_t;
+
+// 只测SectorCoordinator：按仿真时间投递，不经过网络，几秒内跑完几百圈。
+// 每个频率依次经过各个门，注入漏检、重发（晚到但在保留期内）、迟到（超过保留期）和同一门的误检，
+// 核对每个OK段、每个OK整圈的用时与真实值完全一致，并且没有异常的圈全部判为OK、有异常的圈都被拒绝
+static int runSectorSim(uint32_t gates, uint32_t pilots, uint32_t laps, uint8_t faultPercent) {
+    if (gates < 2 || gates > RACENET_MAX_SECTORS || pilots == 0 || pilots > RACENET_SECTOR_PILOTS) {
+        fprintf(stderr, "gates must be 2 - %u, pilots 1 - %u\n", RACENET_MAX_SECTORS, RACENET_SECTOR_PILOTS);
+        return 1;
+    }
+    std::mt19937 rng(4242);
+    std::uniform_int_distribution<uint32_t> sectorBaseUs(1500000, 4000000);
+    std::uniform_int_distribution<int32_t> sectorJitter(-15, 15);  // 同一段每圈相差±15%
+    std::uniform_int_distribution<uint32_t> lanUs(5000, 80000);
+    const uint64_t startUs = 10000000;
+    std::vector<sim_pass_t> passes;
+    for (uint32_t p = 0; p < pilots; p++) {
+        uint64_t t = startUs + p * 500000ULL;
+        std::vector<uint32_t> baseUs(gates);
+        for (uint32_t g = 0; g < gates; g++) baseUs[g] = sectorBaseUs(rng);
+        for (uint32_t lap = 1; lap <= laps + 1; lap++) {
+            for (uint8_t g = 0; g < gates; g++) {
+                if (lap == laps + 1 && g > 0) break;  // 最后一次过门0结束第laps圈
+                sim_pass_t pass = {p, g, lap, t, t + SIM_DETECT_DELAY_MS * 1000 + lanUs(rng), SIM_PASS_NORMAL};
+                // 第一圈不注入异常：协调器要先记下各段用时，才能识别整圈漏检；最后一次过门后没有过门，迟到也无从判断
+                const bool last = lap == laps + 1;
+                const uint32_t roll = lap == 1 ? 100 : rng() % 100;
+                if (roll < faultPercent) {
+                    pass.kind = SIM_PASS_MISSED;
+                } else if (roll < faultPercent * 2) {
+                    pass.kind = SIM_PASS_RESENT;
+                    pass.arriveUs = t + 1000000 + rng() % 800000;  // 一两个续订周期后重发到达
+                } else if (roll < faultPercent * 3 && !last) {
+                    pass.kind = SIM_PASS_LATE;
+                    pass.arriveUs = t + 12000000;  // 后面的过门早已处理
+                }
+                passes.push_back(pass);
+                // 误检只加在正常送达的过门之后，真实过门漏掉时误检无从分辨
+                if (pass.kind == SIM_PASS_NORMAL && rng() % 100 < faultPercent) {
+                    const uint64_t falseUs = t + 200000 + rng() % 600000;
+                    passes.push_back({p, g, lap, falseUs, falseUs + SIM_DETECT_DELAY_MS * 1000 + lanUs(rng),
+                                      SIM_PASS_REPEAT});
+                }
+                t += baseUs[g] + (int64_t)baseUs[g] * sectorJitter(rng) / 100;
+            }
+        }
+    }
+    std::vector<size_t> order(passes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return passes[a].arriveUs < passes[b].arriveUs; });
+
+    std::vector<racenet_sector_t> results;
+    SectorCoordinator coordinator;
+    coordinator.setResultSink([](const racenet_sector_t *r, void *ctx) { ((std::vector<racenet_sector_t> *)ctx)->push_back(*r); },
+                              &results);
+    const uint64_t endUs = passes[order.back()].arriveUs + 20000000;
+    size_t next = 0;
+    for (uint64_t nowUs = startUs; nowUs < endUs; nowUs += 1000) {
+        for (; next < order.size() && passes[order[next]].arriveUs <= nowUs; next++) {
+            const sim_pass_t &pass = passes[order[next]];
+            if (pass.kind == SIM_PASS_MISSED) continue;
+            coordinator.addCrossing(5658 + pass.pilot * 37, pass.gate, gates, pass.truthUs, 100, pass.pilot);
+        }
+        // 汇总方的hasGaps()：有重发中的事件时延长保留期
+        bool waiting = false;
+        for (const sim_pass_t &pass : passes) {
+            if (pass.kind == SIM_PASS_RESENT && pass.truthUs < nowUs && pass.arriveUs > nowUs) waiting = true;
+        }
+        coordinator.service(nowUs, waiting);
+    }
+
+    // 真实值：按频率和过门时刻查找；每圈是否完好（所有过门都按时送达）、是否有漏检。
+    // 迟到的过门如果之后的过门也都漏了，到达时仍是按顺序的，该圈报OK也对，所以只有漏检的圈报OK才算错
+    std::vector<std::vector<bool>> lapClean(pilots, std::vector<bool>(laps + 2, true));
+    std::vector<std::vector<bool>> lapMissed(pilots, std::vector<bool>(laps + 2, false));
+    uint32_t injected[SIM_PASS_REPEAT + 1] = {};
+    for (const sim_pass_t &pass : passes) {
+        injected[pass.kind]++;
+        if (pass.kind != SIM_PASS_MISSED && pass.kind != SIM_PASS_LATE) continue;
+        // 门0的过门同时结束上一圈、开始这一圈
+        const uint32_t lap = pass.gate == 0 ? pass.lap - 1 : pass.lap;
+        lapClean[pass.pilot][lap] = false;
+        if (pass.gate == 0) lapClean[pass.pilot][pass.lap] = false;
+        if (pass.kind != SIM_PASS_MISSED) continue;
+        lapMissed[pass.pilot][lap] = true;
+        if (pass.gate == 0) lapMissed[pass.pilot][pass.lap] = true;
+    }
+    auto findPass = [&](uint16_t freq, uint64_t timeUs) -> const sim_pass_t * {
+        for (const sim_pass_t &pass : passes) {
+            if (5658 + pass.pilot * 37 == freq && pass.truthUs == timeUs) return &pass;
+        }
+        return nullptr;
+    };
+    auto previousTrue = [&](const sim_pass_t *pass) -> const sim_pass_t * {
+        const sim_pass_t *best = nullptr;
+        for (const sim_pass_t &other : passes) {
+            if (other.pilot != pass->pilot || other.kind == SIM_PASS_REPEAT || other.truthUs >= pass->truthUs) continue;
+            if (best == nullptr || other.truthUs > best->truthUs) best = &other;
+        }
+        return best;
+    };
+    uint32_t wrong = 0;
+    uint32_t okSectors = 0, okLaps = 0, badLaps = 0, missing = 0, repeats = 0, late = 0;
+    std::vector<std::vector<bool>> lapOk(pilots, std::vector<bool>(laps + 2, false));
+    std::vector<std::vector<uint64_t>> sectorSum(pilots, std::vector<uint64_t>(laps + 2, 0));
+    for (const racenet_sector_t &r : results) {
+        const sim_pass_t *pass = findPass(r.frequency, r.crossingUs);
+        if (pass == nullptr) {
+            wrong++;
+            continue;
+        }
+        if (r.status == RACENET_SECTOR_REPEAT) repeats++;
+        if (r.status == RACENET_SECTOR_LATE) late++;
+        if (r.status == RACENET_SECTOR_MISSING && r.sector != 0) missing++;
+        if (r.status != RACENET_SECTOR_OK) {
+            if (r.sector == 0 && r.status == RACENET_SECTOR_MISSING) badLaps++;
+            continue;
+        }
+        const uint32_t lap = pass->gate == 0 ? pass->lap - 1 : pass->lap;
+        if (r.sector == 0) {
+            okLaps++;
+            lapOk[pass->pilot][lap] = true;
+            if (r.timeUs != sectorSum[pass->pilot][lap] || lapMissed[pass->pilot][lap]) wrong++;
+            continue;
+        }
+        okSectors++;
+        const sim_pass_t *prev = previousTrue(pass);
+        const uint8_t expectGate = (uint8_t)((pass->gate + gates - 1) % gates);
+        if (pass->kind == SIM_PASS_REPEAT || prev == nullptr || prev->gate != expectGate ||
+            r.timeUs != pass->truthUs - prev->truthUs)
+            wrong++;
+        sectorSum[pass->pilot][lap] += r.timeUs;
+    }
+    uint32_t cleanLaps = 0, lostLaps = 0;
+    for (uint32_t p = 0; p < pilots; p++) {
+        for (uint32_t lap = 1; lap <= laps; lap++) {
+            if (!lapClean[p][lap]) continue;
+            cleanLaps++;
+            if (!lapOk[p][lap]) lostLaps++;
+        }
+    }
+
+    printf("sectors: %u gates, %u pilots, %u laps each, %u crossings, %u results\n", gates, pilots, laps,
+           (uint32_t)passes.size(), (uint32_t)results.size());
+    printf("injected: %u missed, %u resent within hold, %u late, %u false repeats\n", injected[SIM_PASS_MISSED],
+           injected[SIM_PASS_RESENT], injected[SIM_PASS_LATE], injected[SIM_PASS_REPEAT]);
+    printf("reported: %u ok sectors, %u missing sectors, %u late, %u repeats\n", okSectors, missing, late, repeats);
+    printf("laps: %u ok, %u rejected, %u clean laps not reported ok, %u results with wrong time or status\n", okLaps,
+           badLaps, lostLaps, wrong);
+    return wrong == 0 && lostLaps == 0 ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "sim") == 0) {
+        const uint32_t nodes = argc > 2 ? atoi(argv[2]) : 8;
+        const uint32_t laps = argc > 3 ? atoi(argv[3]) : 10;
+        const uint8_t loss = argc > 4 ? atoi(argv[4]) : 10;
+        const uint32_t lapMs = argc > 5 ? atoi(argv[5]) : 800;
+        return runSim(nodes, laps, loss, lapMs);
+    }
+    if (argc >= 2 && strcmp(argv[1], "espnow") == 0) {
+        const uint32_t nodes = argc > 2 ? atoi(argv[2]) : 8;
+        const uint32_t laps = argc > 3 ? atoi(argv[3]) : 30;
+        const uint8_t loss = argc > 4 ? atoi(argv[4]) : 20;
+        const uint32_t lapMs = argc > 5 ? atoi(argv[5]) : 800;
+        return runEspNowSim(nodes, laps, loss, lapMs);
+    }
+    if (argc >= 2 && strcmp(argv[1], "sync") == 0) {
+        const uint32_t nodes = argc > 2 ? atoi(argv[2]) : 4;
+        const uint32_t seconds = argc > 3 ? atoi(argv[3]) : 30;
+        const uint8_t loss = argc > 4 ? atoi(argv[4]) : 10;
+        const uint32_t jitterUs = argc > 5 ? atoi(argv[5]) : 0;
+        return runSyncSim(nodes, seconds, loss, jitterUs);
+    }
+    if (argc >= 2 && strcmp(argv[1], "sectors") == 0) {
+        const uint32_t gates = argc > 2 ? atoi(argv[2]) : 4;
+        const uint32_t pilots = argc > 3 ? atoi(argv[3]) : 4;
+        const uint32_t laps = argc > 4 ? atoi(argv[4]) : 20;
+        const uint8_t faults = argc > 5 ? atoi(argv[5]) : 5;
+        return runSectorSim(gates, pilots, laps, faults);
+    }
+    if (argc >= 4 && strcmp(argv[1], "node") == 0) {
+        const uint32_t laps = argc > 4 ? atoi(argv[4]) : 10;
+        const uint32_t lapMs = argc > 5 ? atoi(argv[5]) : 800;
+        const sim_clock_t clock = {0, 0, 0};
+        return runNode(atoi(argv[2]), atoi(argv[2]) % 1000, argv[3], laps, lapMs, 0,
+                       monotonicUs() + SIM_START_DELAY_MS * 1000ULL, &clock);
+    }
+    if (argc >= 2 && strcmp(argv[1], "aggregate") == 0) {
+        return runAggregate(argc - 2, argv + 2);
+    }
+    fprintf(stderr, "usage: %s sim [nodes] [laps] [loss%%] [lapMs]\n", argv[0]);
+    fprintf(stderr, "       %s espnow [nodes] [laps] [loss%%] [lapMs]\n", argv[0]);
+    fprintf(stderr, "       %s sync [nodes] [seconds] [loss%%] [jitterUs]\n", argv[0]);
+    fprintf(stderr, "       %s sectors [gates] [pilots] [laps] [fault%%]\n", argv[0]);
+    fprintf(stderr, "       %s node <port> <name> [laps] [lapMs]\n", argv[0]);
+    fprintf(stderr, "       %s aggregate [ip:port ...]\n", argv[0]);
+    return 1;
+}
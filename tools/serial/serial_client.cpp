@@ -0,0 +1,752 @@
+/*
+ * 有线串口二进制协议（lib/SERIALLINK）的主机端工具：接收计时事件和RSSI帧、发送命令，以及基于pty的吞吐/延迟测试。
+ *
+ * 编译：
+ *   g++ -O2 -std=c++17 -Ilib/SERIALLINK -Ilib/CRC -Ilib/RSSISTREAM -Ilib/QUEUE tools/serial/serial_client.cpp \
+ *       lib/SERIALLINK/serial_link.cpp lib/SERIALLINK/serial_link_posix.cpp lib/RSSISTREAM/rssi_stream.cpp \
+ *       lib/CRC/crc.cpp -lutil -o serial_client
+ * 运行：
+ *   ./serial_client monitor /dev/ttyUSB0 [波特率=921600] [bucketUs=0]
+ *       逐个打印计时事件（缺号时自动RESEND），bucketUs非0时打开RSSI帧并每10秒打印统计；
+ *       每秒PING一次，用最小RTT的一半估计设备时钟与本机CLOCK_MONOTONIC的偏差，事件时刻据此换算成本机时间。
+ *   ./serial_client send /dev/ttyUSB0 start|stop|status|freq <MHz>|rssi <enter> <exit>|stream <bucketUs>
+ *       发一条命令，等ACK（丢了重发），打印结果；返回值0为设备接受。
+ *   ./serial_client ptytest [秒数=10] [每秒圈数=20] [bucketUs=200] [波特率=921600] [误码ppm=0]
+ *       openpty()得到一对串口，fork出的子进程用SerialLink + RssiStream模拟设备：发送端按波特率限速
+ *       （每字节10位，4 KB发送缓冲，与设备上的UART一致），按误码率随机改写两个方向的字节。
+ *       父进程做电脑端：测PING往返、检查每条命令的ACK、按事件序号补齐丢失的圈，统计圈事件从设备发出到
+ *       本机解出的延迟（两端用同一个CLOCK_MONOTONIC）和RSSI帧的吞吐，结束时核对每圈恰好交付一次。
+ */
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "rssi_stream.h"
+#include "serial_link.h"
+
+#define SAMPLE_RATE_HZ 5000        // 与SAMPLER_RATE_HZ一致
+#define EVENT_LAP 1                // 与laptimer_event_e一致
+#define CMD_TIMEOUT_MS 100         // 等ACK的时间，超时重发
+#define CMD_TRIES 5
+#define RESEND_RETRY_MS 30         // RESEND之后这么久还没补到就再发一次
+#define RESEND_TRIES 10            // 超过这么多次仍没补到记为丢失
+#define STATUS_INTERVAL_MS 500     // 定期STATUS带回最新事件序号，最后一个事件丢了也能发现
+#define PING_INTERVAL_MS 20
+#define STATS_INTERVAL_MS 10000
+#define UART_TX_BUFFER 4096        // 与设备上Serial.setTxBufferSize()一致
+#define PTY_START_MS 200
+#define PTY_DRAIN_MS 500
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void sleepUs(uint32_t us) {
+    struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static const char *resultName(uint8_t result) {
+    switch (result) {
+        case SERIAL_RESULT_OK:
+            return "ok";
+        case SERIAL_RESULT_REJECTED:
+            return "rejected";
+        case SERIAL_RESULT_BAD_ARGS:
+            return "bad args";
+        case SERIAL_RESULT_UNKNOWN:
+            return "unknown";
+        default:
+            return "?";
+    }
+}
+
+static volatile bool stopRequested = false;
+
+static void onSignal(int) {
+    stopRequested = true;
+}
+
+// ---------------------------------------------------------------- 电脑端
+
+typedef struct {
+    uint64_t sinceUs;  // 发现缺号的时刻
+    uint64_t resendUs;  // 最近一次RESEND的时刻，0表示还没发
+    uint8_t tries;
+} missing_t;
+
+typedef struct {
+    serial_event_t event;
+    uint64_t arriveUs;
+} delivered_t;
+
+class HostLink {
+   public:
+    bool open(const char *path, uint32_t baud) { return port.open(path, baud) && init(); }
+    bool attach(int fd) { return port.attach(fd) && init(); }
+
+    uint8_t send(uint8_t type, const void *payload, uint16_t len);
+    // 发命令并等ACK，丢了重发；返回serial_link_result_e，一直没有ACK时返回0xFF
+    uint8_t command(uint8_t type, const void *payload, uint16_t len);
+    void ping() {
+        const uint64_t now = monotonicUs();
+        send(SERIAL_CMD_PING, &now, sizeof(now));
+    }
+    // 阻塞到有数据或timeoutMs，处理收到的所有帧，再做一次RESEND重试
+    void poll(uint32_t timeoutMs);
+
+    bool verbose = true;
+    std::vector<delivered_t> delivered;
+    std::vector<double> rttMs;
+    std::vector<double> recoveryMs;  // 发现缺号到补到
+    int64_t offsetUs = 0;            // 设备时钟 - 本机时钟，取RTT最小的一次估计
+    uint32_t minRttUs = UINT32_MAX;
+    uint32_t highest = 0;  // 已知的最大事件序号（收到的事件或STATUS）
+    uint32_t duplicates = 0;
+    uint32_t recovered = 0;
+    uint32_t lost = 0;
+    uint32_t resendsSent = 0;
+    bool haveStatus = false;
+    serial_status_t status;
+    // RSSI帧
+    uint32_t rssiFrames = 0;
+    uint32_t rssiBuckets = 0;
+    uint32_t rssiMissing = 0;  // 帧序号缺口（串口忙时丢帧或误码）
+    uint32_t rssiDroppedBuckets = 0;
+    uint64_t rssiBytes = 0;
+    uint64_t rxBytes = 0;
+    SerialFrameDecoder decoder;
+
+   private:
+    PosixSerialPort port;
+    uint8_t txSeq = 0;
+    uint8_t txBuf[SERIAL_LINK_MAX_ENCODED];
+    std::set<uint32_t> got;
+    std::map<uint32_t, missing_t> missing;
+    bool haveRssiSeq = false;
+    uint32_t rssiSeq = 0;
+    bool acked = false;
+    uint8_t ackSeq = 0;
+    uint8_t ackResult = 0;
+
+    bool init() {
+        decoder.setHandler(onFrame, this);
+        return true;
+    }
+    static void onFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len, void *ctx) {
+        ((HostLink *)ctx)->handleFrame(type, seq, payload, len);
+    }
+    void handleFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len);
+    void handleEvent(const serial_event_t *e, uint64_t now);
+    void handleRssi(const uint8_t *payload, uint16_t len);
+    void markMissing(uint32_t upTo, uint64_t now);
+    void requestResends(uint64_t now);
+};
+
+uint8_t HostLink::send(uint8_t type, const void *payload, uint16_t len) {
+    const uint8_t seq = txSeq++;
+    const size_t n = serialLinkEncode(type, seq, (const uint8_t *)payload, len, txBuf);
+    port.write(txBuf, n);
+    return seq;
+}
+
+uint8_t HostLink::command(uint8_t type, const void *payload, uint16_t len) {
+    for (uint8_t i = 0; i < CMD_TRIES && !stopRequested; i++) {
+        acked = false;
+        ackSeq = send(type, payload, len);
+        const uint64_t deadlineUs = monotonicUs() + CMD_TIMEOUT_MS * 1000ULL;
+        while (!acked && monotonicUs() < deadlineUs) poll(1);
+        if (acked) return ackResult;
+    }
+    return 0xFF;
+}
+
+void HostLink::poll(uint32_t timeoutMs) {
+    struct pollfd p = {port.getFd(), POLLIN, 0};
+    ::poll(&p, 1, timeoutMs);
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = port.read(buf, sizeof(buf))) > 0) {
+        rxBytes += n;
+        decoder.feed(buf, n);
+    }
+    requestResends(monotonicUs());
+}
+
+void HostLink::handleFrame(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len) {
+    (void)seq;
+    const uint64_t now = monotonicUs();
+    switch (type) {
+        case SERIAL_MSG_ACK: {
+            if (len < sizeof(serial_ack_t)) return;
+            serial_ack_t a;
+            memcpy(&a, payload, sizeof(a));
+            if (a.cmdSeq == ackSeq) {
+                acked = true;
+                ackResult = a.result;
+            }
+            break;
+        }
+        case SERIAL_MSG_PONG: {
+            if (len < sizeof(serial_pong_t)) return;
+            serial_pong_t pong;
+            memcpy(&pong, payload, sizeof(pong));
+            const uint32_t rtt = (uint32_t)(now - pong.hostUs);
+            rttMs.push_back(rtt / 1000.0);
+            if (rtt < minRttUs) {
+                minRttUs = rtt;
+                offsetUs = (int64_t)pong.deviceUs - (int64_t)(pong.hostUs + rtt / 2);
+            }
+            break;
+        }
+        case SERIAL_MSG_EVENT: {
+            if (len < sizeof(serial_event_t)) return;
+            serial_event_t e;
+            memcpy(&e, payload, sizeof(e));
+            handleEvent(&e, now);
+            break;
+        }
+        case SERIAL_MSG_RSSI:
+            handleRssi(payload, len);
+            break;
+        case SERIAL_MSG_STATUS:
+            if (len < sizeof(serial_status_t)) return;
+            memcpy(&status, payload, sizeof(status));
+            haveStatus = true;
+            markMissing(status.lastSeq, now);
+            break;
+        default:
+            break;
+    }
+}
+
+void HostLink::handleEvent(const serial_event_t *e, uint64_t now) {
+    if (e->seq == 0) return;
+    if (got.count(e->seq)) {
+        duplicates++;
+        return;
+    }
+    markMissing(e->seq - 1, now);
+    auto m = missing.find(e->seq);
+    if (m != missing.end()) {
+        recoveryMs.push_back((now - m->second.sinceUs) / 1000.0);
+        recovered++;
+        missing.erase(m);
+    }
+    got.insert(e->seq);
+    if (e->seq > highest) highest = e->seq;
+    delivered.push_back({*e, now});
+    if (verbose) {
+        const double atMs = ((int64_t)e->eventUs - offsetUs) / 1000.0;
+        if (e->event == EVENT_LAP) {
+            printf("#%u lap %u %.3f s at %.3f ms, %u MHz, peak %u%s\n", e->seq, e->lapNumber, e->lapTimeUs / 1e6, atMs,
+                   e->frequency, e->peakRssi, e->resent ? " (resent)" : "");
+        } else {
+            printf("#%u %s at %.3f ms%s\n", e->seq, e->event == 0 ? "start" : "stop", atMs, e->resent ? " (resent)" : "");
+        }
+        fflush(stdout);
+    }
+}
+
+// 序号不超过upTo且还没收到的都记为缺号
+void HostLink::markMissing(uint32_t upTo, uint64_t now) {
+    for (uint32_t s = highest + 1; s <= upTo; s++) {
+        if (!got.count(s) && !missing.count(s)) missing[s] = {now, 0, 0};
+    }
+    if (upTo > highest) highest = upTo;
+}
+
+// 把到期的缺号合并成连续区间发RESEND
+void HostLink::requestResends(uint64_t now) {
+    uint32_t first = 0;
+    uint8_t count = 0;
+    for (auto it = missing.begin(); it != missing.end();) {
+        missing_t &m = it->second;
+        if (m.resendUs != 0 && now - m.resendUs < RESEND_RETRY_MS * 1000ULL) {
+            ++it;
+            continue;
+        }
+        if (m.tries >= RESEND_TRIES) {
+            lost++;
+            it = missing.erase(it);
+            continue;
+        }
+        m.tries++;
+        m.resendUs = now;
+        if (count > 0 && it->first == first + count && count < 255) {
+            count++;
+        } else {
+            if (count > 0) {
+                uint8_t payload[5];
+                memcpy(payload, &first, 4);
+                payload[4] = count;
+                send(SERIAL_CMD_RESEND, payload, sizeof(payload));
+                resendsSent++;
+            }
+            first = it->first;
+            count = 1;
+        }
+        ++it;
+    }
+    if (count > 0) {
+        uint8_t payload[5];
+        memcpy(payload, &first, 4);
+        payload[4] = count;
+        send(SERIAL_CMD_RESEND, payload, sizeof(payload));
+        resendsSent++;
+    }
+}
+
+void HostLink::handleRssi(const uint8_t *payload, uint16_t len) {
+    if (len < sizeof(rssi_frame_header_t)) return;
+    rssi_frame_header_t h;
+    memcpy(&h, payload, sizeof(h));
+    if (h.magic != RSSI_STREAM_MAGIC) return;
+    if (haveRssiSeq && h.sequence != rssiSeq + 1) rssiMissing += h.sequence - rssiSeq - 1;
+    haveRssiSeq = true;
+    rssiSeq = h.sequence;
+    rssiFrames++;
+    rssiBuckets += h.count;
+    rssiDroppedBuckets += h.dropped;
+    rssiBytes += len;
+}
+
+static int runSend(const char *path, int argc, char **argv) {
+    HostLink link;
+    if (!link.open(path, SERIAL_LINK_BAUD)) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    link.verbose = false;
+    uint8_t type;
+    uint8_t payload[4];
+    uint16_t len = 0;
+    if (strcmp(argv[0], "start") == 0) {
+        type = SERIAL_CMD_START;
+    } else if (strcmp(argv[0], "stop") == 0) {
+        type = SERIAL_CMD_STOP;
+    } else if (strcmp(argv[0], "status") == 0) {
+        type = SERIAL_CMD_STATUS;
+    } else if (strcmp(argv[0], "freq") == 0 && argc >= 2) {
+        type = SERIAL_CMD_SET_FREQ;
+        const uint16_t freq = atoi(argv[1]);
+        memcpy(payload, &freq, sizeof(freq));
+        len = sizeof(freq);
+    } else if (strcmp(argv[0], "rssi") == 0 && argc >= 3) {
+        type = SERIAL_CMD_SET_RSSI;
+        payload[0] = atoi(argv[1]);
+        payload[1] = atoi(argv[2]);
+        len = 2;
+    } else if (strcmp(argv[0], "stream") == 0 && argc >= 2) {
+        type = SERIAL_CMD_STREAM;
+        const uint32_t bucketUs = atoi(argv[1]);
+        memcpy(payload, &bucketUs, sizeof(bucketUs));
+        len = sizeof(bucketUs);
+    } else {
+        fprintf(stderr, "unknown command %s\n", argv[0]);
+        return 1;
+    }
+    const uint8_t result = link.command(type, payload, len);
+    if (result == 0xFF) {
+        fprintf(stderr, "no ack\n");
+        return 2;
+    }
+    if (type == SERIAL_CMD_STATUS) {
+        const uint64_t deadlineUs = monotonicUs() + CMD_TIMEOUT_MS * 1000ULL;
+        while (!link.haveStatus && monotonicUs() < deadlineUs) link.poll(1);
+        if (link.haveStatus) {
+            const serial_status_t &s = link.status;
+            printf("version %u, %s, %u MHz, enter %u, exit %u, rssi %u, stream %u us, last event %u, rx bad %u, "
+                   "rssi frames dropped %u\n",
+                   s.version, s.running ? "running" : "stopped", s.frequency, s.enterRssi, s.exitRssi, s.rssi,
+                   s.bucketUs, s.lastSeq, s.rxBad, s.txDropped);
+        }
+    }
+    printf("%s\n", resultName(result));
+    return result == SERIAL_RESULT_OK ? 0 : 2;
+}
+
+static int runMonitor(const char *path, uint32_t baud, uint32_t bucketUs) {
+    HostLink link;
+    if (!link.open(path, baud)) {
+        fprintf(stderr, "cannot open %s at %u baud\n", path, baud);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    for (uint8_t i = 0; i < 5; i++) {
+        link.ping();
+        link.poll(20);
+    }
+    if (bucketUs != 0) {
+        const uint8_t result = link.command(SERIAL_CMD_STREAM, &bucketUs, sizeof(bucketUs));
+        printf("rssi stream %u us: %s\n", bucketUs, result == 0xFF ? "no ack" : resultName(result));
+    }
+    uint64_t pingUs = 0, statusUs = 0, statsUs = monotonicUs();
+    uint32_t lastFrames = 0, lastBuckets = 0;
+    uint64_t lastRssiBytes = 0, lastRxBytes = 0;
+    while (!stopRequested) {
+        link.poll(10);
+        const uint64_t now = monotonicUs();
+        if (now - pingUs >= 1000000) {
+            link.ping();
+            pingUs = now;
+        }
+        if (now - statusUs >= STATUS_INTERVAL_MS * 1000ULL) {
+            link.send(SERIAL_CMD_STATUS, nullptr, 0);
+            statusUs = now;
+        }
+        if (now - statsUs >= STATS_INTERVAL_MS * 1000ULL) {
+            const double s = (now - statsUs) / 1e6;
+            printf("-- rtt min %.3f ms, clock offset %lld us; rssi %.1f frames/s %.0f buckets/s %.0f B/s, "
+                   "line %.0f B/s, %u frames missing; events %u, recovered %u, lost %u; bad frames %u\n",
+                   link.minRttUs / 1000.0, (long long)link.offsetUs, (link.rssiFrames - lastFrames) / s,
+                   (link.rssiBuckets - lastBuckets) / s, (link.rssiBytes - lastRssiBytes) / s,
+                   (link.rxBytes - lastRxBytes) / s, link.rssiMissing, link.highest, link.recovered, link.lost,
+                   link.decoder.getBad());
+            fflush(stdout);
+            lastFrames = link.rssiFrames;
+            lastBuckets = link.rssiBuckets;
+            lastRssiBytes = link.rssiBytes;
+            lastRxBytes = link.rxBytes;
+            statsUs = now;
+        }
+    }
+    if (bucketUs != 0) {
+        const uint32_t off = 0;
+        link.command(SERIAL_CMD_STREAM, &off, sizeof(off));
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------- 模拟设备
+
+// 按波特率限速的发送端：写入先进UART_TX_BUFFER，pump()按每字节10位的速率写到pty；
+// 缓冲写不下时和设备上的Serial.write()一样阻塞等待
+class UartPacedPort : public SerialPort {
+   public:
+    UartPacedPort(int f, uint32_t baud, uint32_t errorPpm, uint32_t seed)
+        : fd(f), bytesPerSec(baud / 10), ppm(errorPpm), rng(seed) {}
+
+    size_t write(const uint8_t *buf, size_t len) override {
+        for (size_t i = 0; i < len; i++) {
+            while (queued() >= UART_TX_BUFFER) {
+                sleepUs(100);
+                pump(monotonicUs());
+            }
+            buffer[(head++) % UART_TX_BUFFER] = corrupt(buf[i]);
+        }
+        return len;
+    }
+    size_t availableForWrite() override { return UART_TX_BUFFER - queued(); }
+    size_t read(uint8_t *buf, size_t size) override {
+        const ssize_t n = ::read(fd, buf, size);
+        if (n <= 0) return 0;
+        for (ssize_t i = 0; i < n; i++) buf[i] = corrupt(buf[i]);
+        return n;
+    }
+
+    void pump(uint64_t nowUs) {
+        if (lastUs == 0) lastUs = nowUs;
+        credit += (nowUs - lastUs) * bytesPerSec / 1e6;
+        lastUs = nowUs;
+        if (queued() == 0 && credit > 1) credit = 1;  // 线路空闲时不攒额度
+        while (credit >= 1 && queued() > 0) {
+            uint8_t chunk[256];
+            size_t n = 0;
+            while (n < sizeof(chunk) && n < (size_t)credit && tail + n < head) {
+                chunk[n] = buffer[(tail + n) % UART_TX_BUFFER];
+                n++;
+            }
+            const ssize_t w = ::write(fd, chunk, n);
+            if (w <= 0) break;  // pty满了，下次再写
+            tail += w;
+            credit -= w;
+        }
+    }
+
+   private:
+    int fd;
+    double bytesPerSec;
+    uint32_t ppm;
+    std::mt19937 rng;
+    uint8_t buffer[UART_TX_BUFFER];
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    uint64_t lastUs = 0;
+    double credit = 0;
+
+    size_t queued() { return head - tail; }
+    uint8_t corrupt(uint8_t b) {
+        if (ppm == 0 || rng() % 1000000 >= ppm) return b;
+        return b ^ (1 << (rng() % 8));
+    }
+};
+
+typedef struct {
+    SerialLink *link;
+    RssiStream *stream;
+    bool running;
+    uint16_t frequency;
+    uint8_t enterRssi;
+    uint8_t exitRssi;
+} sim_device_t;
+
+static uint8_t simCommand(const serial_link_cmd_t *cmd, void *ctx) {
+    sim_device_t *d = (sim_device_t *)ctx;
+    switch (cmd->type) {
+        case SERIAL_CMD_START:
+        case SERIAL_CMD_STOP:
+            d->running = cmd->type == SERIAL_CMD_START;
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_SET_FREQ:
+            if (cmd->frequency < 5300 || cmd->frequency > 5950) return SERIAL_RESULT_BAD_ARGS;
+            d->frequency = cmd->frequency;
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_SET_RSSI:
+            if (cmd->exitRssi >= cmd->enterRssi) return SERIAL_RESULT_BAD_ARGS;
+            d->enterRssi = cmd->enterRssi;
+            d->exitRssi = cmd->exitRssi;
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_STREAM:
+            if (cmd->bucketUs != 0) d->stream->setResolution(cmd->bucketUs, 1000000 / SAMPLE_RATE_HZ);
+            d->stream->setEnabled(cmd->bucketUs != 0);
+            return SERIAL_RESULT_OK;
+        case SERIAL_CMD_STATUS: {
+            serial_status_t status;
+            memset(&status, 0, sizeof(status));
+            status.running = d->running;
+            status.frequency = d->frequency;
+            status.enterRssi = d->enterRssi;
+            status.exitRssi = d->exitRssi;
+            status.nowUs = monotonicUs();
+            d->link->sendStatus(&status);
+            return SERIAL_RESULT_OK;
+        }
+        default:
+            return SERIAL_RESULT_UNKNOWN;
+    }
+}
+
+// 主循环与设备上的parallelTask对应：处理命令、产出圈事件、打包RSSI帧，串口只有这一个写者
+static int runDevice(int fd, uint32_t baud, uint32_t lapsPerSec, uint32_t errorPpm) {
+    UartPacedPort port(fd, baud, errorPpm, 1234);
+    SerialLink link;
+    static RssiStream stream;
+    sim_device_t device = {&link, &stream, false, 5658, 120, 100};
+    link.begin(&port, simCommand, &device);
+    std::mt19937 rng(42);
+    const uint64_t startUs = monotonicUs();
+    const uint32_t lapUs = 1000000 / lapsPerSec;
+    const uint32_t periodUs = 1000000 / SAMPLE_RATE_HZ;
+    uint64_t sampleUs = startUs;
+    uint64_t lapStartUs = 0;
+    uint32_t lapNumber = 0;
+    bool wasRunning = false;
+    static uint8_t frame[RSSI_STREAM_FRAME_MAX_BYTES];
+    for (;;) {
+        const uint64_t now = monotonicUs();
+        port.pump(now);
+        link.service(now);
+        if (device.running != wasRunning) {
+            wasRunning = device.running;
+            lapStartUs = now;
+            lapNumber = 0;
+            link.sendEvent(wasRunning ? 0 : 2, 0, device.frequency, 0, 0, now, 0, monotonicUs());
+        }
+        if (device.running && now - lapStartUs >= lapUs) {
+            lapNumber++;
+            lapStartUs += lapUs;
+            link.sendEvent(EVENT_LAP, 0, device.frequency, lapNumber, lapUs, lapStartUs, 150, monotonicUs());
+        }
+        // 计时核的采样：底噪附近抖动，每圈开头一个峰
+        for (; sampleUs + periodUs <= now; sampleUs += periodUs) {
+            const uint32_t phase = (uint32_t)((sampleUs - startUs) % lapUs);
+            const uint16_t rssi = (phase < 20000 ? 150 : 60) + rng() % 8;
+            stream.push(sampleUs, rssi << 4);
+        }
+        size_t len;
+        while ((len = stream.buildFrame(frame, (uint32_t)(now / 1000), device.enterRssi, device.exitRssi)) > 0) {
+            link.sendRssi(frame, len);
+        }
+        sleepUs(100);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------- pty测试
+
+static bool expectResult(HostLink *link, const char *name, uint8_t type, const void *payload, uint16_t len,
+                         uint8_t expected) {
+    const uint8_t result = link->command(type, payload, len);
+    const bool ok = result == expected;
+    printf("  %-18s %s%s\n", name, result == 0xFF ? "no ack" : resultName(result), ok ? "" : "  <-- FAIL");
+    return ok;
+}
+
+static int runPtyTest(uint32_t seconds, uint32_t lapsPerSec, uint32_t bucketUs, uint32_t baud, uint32_t errorPpm) {
+    int master, slave;
+    if (openpty(&master, &slave, NULL, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(master);
+        PosixSerialPort devicePort;  // 只借用它把pty切到原始、非阻塞模式
+        devicePort.attach(slave);
+        _exit(runDevice(slave, baud, lapsPerSec, errorPpm));
+    }
+    close(slave);
+    HostLink link;
+    link.attach(master);
+    link.verbose = false;
+    sleepUs(PTY_START_MS * 1000);
+
+    printf("serial link over pty: %u baud, %u s, %u laps/s, rssi bucket %u us, %u ppm byte errors\n", baud, seconds,
+           lapsPerSec, bucketUs, errorPpm);
+    printf("commands:\n");
+    bool commandsOk = true;
+    const uint16_t goodFreq = 5800, badFreq = 1000;
+    const uint8_t goodRssi[2] = {130, 100}, badRssi[2] = {100, 130};
+    commandsOk &= expectResult(&link, "freq 5800", SERIAL_CMD_SET_FREQ, &goodFreq, 2, SERIAL_RESULT_OK);
+    commandsOk &= expectResult(&link, "freq 1000", SERIAL_CMD_SET_FREQ, &badFreq, 2, SERIAL_RESULT_BAD_ARGS);
+    commandsOk &= expectResult(&link, "rssi 130 100", SERIAL_CMD_SET_RSSI, goodRssi, 2, SERIAL_RESULT_OK);
+    commandsOk &= expectResult(&link, "rssi 100 130", SERIAL_CMD_SET_RSSI, badRssi, 2, SERIAL_RESULT_BAD_ARGS);
+    commandsOk &= expectResult(&link, "unknown 0x7f", 0x7F, nullptr, 0, SERIAL_RESULT_UNKNOWN);
+    if (bucketUs != 0) {
+        commandsOk &= expectResult(&link, "stream", SERIAL_CMD_STREAM, &bucketUs, 4, SERIAL_RESULT_OK);
+    }
+    commandsOk &= expectResult(&link, "start", SERIAL_CMD_START, nullptr, 0, SERIAL_RESULT_OK);
+
+    const uint64_t runStartUs = monotonicUs();
+    const uint64_t endUs = runStartUs + seconds * 1000000ULL;
+    const uint32_t framesBefore = link.rssiFrames;
+    const uint32_t bucketsBefore = link.rssiBuckets;
+    const uint64_t rssiBytesBefore = link.rssiBytes, rxBytesBefore = link.rxBytes;
+    uint64_t pingUs = 0, statusUs = 0;
+    while (monotonicUs() < endUs) {
+        link.poll(1);
+        const uint64_t now = monotonicUs();
+        if (now - pingUs >= PING_INTERVAL_MS * 1000ULL) {
+            link.ping();
+            pingUs = now;
+        }
+        if (now - statusUs >= STATUS_INTERVAL_MS * 1000ULL) {
+            link.send(SERIAL_CMD_STATUS, nullptr, 0);
+            statusUs = now;
+        }
+    }
+    const double runSec = (monotonicUs() - runStartUs) / 1e6;
+    const uint32_t rssiFrames = link.rssiFrames - framesBefore;
+    const uint32_t rssiBuckets = link.rssiBuckets - bucketsBefore;
+    const uint64_t rssiBytes = link.rssiBytes - rssiBytesBefore, rxBytes = link.rxBytes - rxBytesBefore;
+    commandsOk &= expectResult(&link, "stop", SERIAL_CMD_STOP, nullptr, 0, SERIAL_RESULT_OK);
+    // 停止后再要几次STATUS，补齐最后几个事件
+    for (uint32_t i = 0; i < PTY_DRAIN_MS / 50; i++) {
+        link.send(SERIAL_CMD_STATUS, nullptr, 0);
+        const uint64_t waitUs = monotonicUs() + 50000;
+        while (monotonicUs() < waitUs) link.poll(1);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    // 核对：1..highest每个序号恰好交付一次，圈号在两次开始之间连续
+    uint32_t wrong = 0, laps = 0;
+    std::vector<double> latencyMs;  // 首次发送的圈：设备sendUs到本机解出，两端是同一个时钟
+    std::vector<uint32_t> count(link.highest + 1, 0);
+    uint32_t expectLap = 0;
+    std::vector<delivered_t> bySeq = link.delivered;
+    std::sort(bySeq.begin(), bySeq.end(),
+              [](const delivered_t &a, const delivered_t &b) { return a.event.seq < b.event.seq; });
+    for (const delivered_t &d : bySeq) {
+        if (d.event.seq > link.highest) {
+            wrong++;
+            continue;
+        }
+        count[d.event.seq]++;
+        if (d.event.event == 0) expectLap = 0;
+        if (d.event.event != EVENT_LAP) continue;
+        laps++;
+        if (!d.event.resent) latencyMs.push_back((d.arriveUs - d.event.sendUs) / 1000.0);
+        if (d.event.lapNumber != ++expectLap || d.event.lapTimeUs != 1000000 / lapsPerSec ||
+            d.event.frequency != goodFreq) {
+            wrong++;
+        }
+    }
+    uint32_t missing = 0;
+    for (uint32_t s = 1; s <= link.highest; s++) {
+        if (count[s] == 0) missing++;
+        if (count[s] > 1) wrong++;
+    }
+
+    printf("events: %u delivered (%u laps), %u recovered by %u resends, %u lost, %u duplicates ignored, %u wrong\n",
+           (uint32_t)link.delivered.size(), laps, link.recovered, link.resendsSent, link.lost, link.duplicates, wrong);
+    printf("lap latency (device send -> host decoded): p50 %.3f ms p99 %.3f ms max %.3f ms; recovery p50 %.1f ms "
+           "max %.1f ms\n",
+           percentile(latencyMs, 0.5), percentile(latencyMs, 0.99), percentile(latencyMs, 1.0),
+           percentile(link.recoveryMs, 0.5), percentile(link.recoveryMs, 1.0));
+    printf("ping rtt: %u pings, p50 %.3f ms p99 %.3f ms max %.3f ms, clock offset %lld us\n",
+           (uint32_t)link.rttMs.size(), percentile(link.rttMs, 0.5), percentile(link.rttMs, 0.99),
+           percentile(link.rttMs, 1.0), (long long)link.offsetUs);
+    if (bucketUs != 0) {
+        printf("rssi: %.1f frames/s, %.0f buckets/s (expected %.0f), %.0f B/s payload; %u frames missing, "
+               "%u buckets dropped on device\n",
+               rssiFrames / runSec, rssiBuckets / runSec, 1e6 / bucketUs, rssiBytes / runSec, link.rssiMissing,
+               link.rssiDroppedBuckets);
+    }
+    printf("line: %.0f B/s of %u B/s (%.1f%%), %u frames ok, %u bad frames, %u seq gaps\n", rxBytes / runSec,
+           baud / 10, rxBytes / runSec * 1000.0 / baud, link.decoder.getFrames(), link.decoder.getBad(),
+           link.decoder.getSeqGaps());
+    const bool pass = commandsOk && missing == 0 && wrong == 0 && laps > 0 && (bucketUs == 0 || rssiFrames > 0);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "monitor") == 0) {
+        return runMonitor(argv[2], argc > 3 ? atoi(argv[3]) : SERIAL_LINK_BAUD, argc > 4 ? atoi(argv[4]) : 0);
+    }
+    if (argc >= 4 && strcmp(argv[1], "send") == 0) {
+        return runSend(argv[2], argc - 3, argv + 3);
+    }
+    if (argc >= 2 && strcmp(argv[1], "ptytest") == 0) {
+        const uint32_t seconds = argc > 2 ? atoi(argv[2]) : 10;
+        const uint32_t lapsPerSec = argc > 3 ? atoi(argv[3]) : 20;
+        const uint32_t bucketUs = argc > 4 ? atoi(argv[4]) : 200;
+        const uint32_t baud = argc > 5 ? atoi(argv[5]) : SERIAL_LINK_BAUD;
+        const uint32_t errorPpm = argc > 6 ? atoi(argv[6]) : 0;
+        if (seconds == 0 || lapsPerSec == 0 || lapsPerSec > 1000 || baud < 9600 || errorPpm > 100000) {
+            fprintf(stderr, "bad arguments\n");
+            return 1;
+        }
+        return runPtyTest(seconds, lapsPerSec, bucketUs, baud, errorPpm);
+    }
+    fprintf(stderr,
+            "usage:\n"
+            "  %s monitor <device> [baud=%u] [bucketUs=0]\n"
+            "  %s send <device> start|stop|status|freq <MHz>|rssi <enter> <exit>|stream <bucketUs>\n"
+            "  %s ptytest [seconds=10] [lapsPerSec=20] [bucketUs=200] [baud=%u] [errorPpm=0]\n",
+            argv[0], SERIAL_LINK_BAUD, argv[0], argv[0], SERIAL_LINK_BAUD);
+    return 1;
+}
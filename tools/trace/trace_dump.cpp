@@ -0,0 +1,69 @@
+/*
+ * RSSI录制文件（/trace/download下载的trace.bin）解析工具，输出CSV。
+ *
+ * 编译：
+ *   g++ -O2 -std=c++17 -Ilib/TRACE tools/trace/trace_dump.cpp -o trace_dump
+ * 运行：
+ *   ./trace_dump trace.bin > trace.csv
+ *
+ * CSV列：time_us（相对录制开始）, raw, filtered（RSSI，已除以16）, gap（本样本前丢失的样本数）。
+ * 文件头和统计信息输出到stderr。
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s trace.bin\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "QYTR", 4) != 0) {
+        fprintf(stderr, "not a trace file\n");
+        return 1;
+    }
+    if (header.version != TRACE_FILE_VERSION) {
+        fprintf(stderr, "unsupported trace version %u\n", header.version);
+        return 1;
+    }
+    // 以后的版本可能加长文件头，按headerBytes跳过
+    fseek(f, header.headerBytes, SEEK_SET);
+    fprintf(stderr, "rate %u Hz (divider %u), enter %u, exit %u, frequency %u MHz\n", header.sampleRateHz,
+            header.divider, header.enterRssi, header.exitRssi, header.frequency);
+
+    printf("time_us,raw,filtered,gap\n");
+    trace_block_header_t block;
+    trace_sample_t sample;
+    unsigned long long samples = 0, dropped = 0, blocks = 0;
+    while (fread(&block, sizeof(block), 1, f) == 1) {
+        if (block.magic != TRACE_BLOCK_MAGIC) {
+            fprintf(stderr, "bad block magic at block %llu, stopping\n", blocks);
+            break;
+        }
+        blocks++;
+        dropped += block.droppedBefore;
+        uint64_t t = block.startUs;
+        for (uint16_t i = 0; i < block.count; i++) {
+            if (fread(&sample, sizeof(sample), 1, f) != 1) {
+                fprintf(stderr, "truncated block %llu\n", blocks);
+                goto done;
+            }
+            t += sample.dtUs;
+            printf("%llu,%.4f,%.4f,%u\n", (unsigned long long)(t - header.startUs), sample.rawQ4 / 16.0,
+                   sample.filteredQ4 / 16.0, i == 0 ? block.droppedBefore : 0);
+            samples++;
+        }
+    }
+done:
+    fprintf(stderr, "%llu blocks, %llu samples, %llu dropped\n", blocks, samples, dropped);
+    fclose(f);
+    return 0;
+}